@@ -38,8 +38,27 @@ const uint16_t LED_COUNT = 525;
 CRGB ledChain[LED_COUNT]; // = NULL;
 uint16_t chainLength = LED_COUNT;
 uint8_t wdtTimer = 0;
+uint32_t wdtTick = 0;
 CHSV lastCol;
 
+//LED effects, animated locally after the ESP32 sent the descriptor. RAM is mostly used by the chain, so only a few slots
+#define FX_SLOTS 6
+#define FX_INTERVAL 50 //ms between animation frames, same as the LED refresh of the ESP32. FastLED.show() blocks the interrupts
+#define FX_NOLED 0xFFFF
+
+typedef struct
+{
+  uint16_t ledNr; //FX_NOLED for a free slot
+  uint8_t fxMode; //colorMode of IoTT_LEDChain
+  CHSV baseCol;
+  CHSV altCol;
+  uint16_t period; //ms
+  uint16_t cyclePos; //ms into the cycle for local modes, phase offset for global modes
+} fxSlot;
+
+fxSlot fxList[FX_SLOTS];
+uint32_t lastFxTime = 0;
+
 void(* resetFunc) (void) = 0; //declare reset function @ address 0
 
 void setup() {
@@ -58,8 +77,12 @@ void setup() {
 
 void loop()
 {
-  delay(100);
-  wdtTimer++;
-  if (wdtTimer > 50) 
-    resetFunc(); //if communication with Hat breaks down, we reset the Arduino to rearbitrate the I2C bus
+  processEffects();
+  if (millis() - wdtTick >= 100)
+  {
+    wdtTick += 100;
+    wdtTimer++;
+    if (wdtTimer > 50) 
+      resetFunc(); //if communication with Hat breaks down, we reset the Arduino to rearbitrate the I2C bus
+  }
 }
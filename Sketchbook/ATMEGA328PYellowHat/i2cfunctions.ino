@@ -18,6 +18,7 @@ void requestEvent(int bytes)
   thisData = eeprom_read_word ((uint16_t *) 2);
   i2cConnection.writeProc((thisData & 0xFF00)>>8);
   i2cConnection.writeProc(thisData & 0xFF);
+  i2cConnection.writeProc(FX_SLOTS);
 }
 
 /*
@@ -31,6 +32,17 @@ void requestEvent(int bytes)
  * 3 : Sat
  * 4 : Val
  * 
+ * Effect commands are 12 bytes long. The LED is animated here until the next pixel or effect command for it
+ * 0,1 : # of LED in Chain
+ * 2 : mode as colorMode in IoTT_LEDChain: 1/2 local blink pos/neg, 3/4 global blink pos/neg, 5/6 local ramp up/down, 7/8 global ramp up/down
+ *     0 sets the base color without animation
+ * 3,4,5 : base color HSV (on color, ramp color)
+ * 6,7,8 : alternate color HSV (off color of the blink modes)
+ * 9,10 : period in ms, max 32767. Blink modes change the color after each period, ramps restart after each period
+ * 11 : phase, start position in 1/256 of the cycle. Local modes start at the time of the command, global modes run from
+ *      the clock of the Hat, so all global LEDs are in step
+ * The number of effect slots is sent as 6th byte of the device data, 0 or no 6th byte means no effects
+ * 
  * Ctrl commands are 4 bytes long
  * if LED# = 254, this is not LED update, but a command, specified in the second byte
  * pos 1 val 0: pos 2/3 determine LED chain length, store in EEPROM pos 0
@@ -134,5 +146,20 @@ void receiveEvent(uint8_t howMany)
         break;
       }
       break;
+    case 12:
+    {
+      thisData = (i2cConnection.readProc() << 8) + i2cConnection.readProc();
+      byte fxMode = i2cConnection.readProc();
+      hue = i2cConnection.readProc();
+      sat = i2cConnection.readProc();
+      val = i2cConnection.readProc();
+      CHSV baseCol = CHSV(hue,sat,val);
+      hue = i2cConnection.readProc();
+      sat = i2cConnection.readProc();
+      val = i2cConnection.readProc();
+      thisParam = (i2cConnection.readProc()<<8) + i2cConnection.readProc();
+      setEffect(thisData, fxMode, baseCol, CHSV(hue,sat,val), thisParam, i2cConnection.readProc());
+    }
+    break;
   }
 }
@@ -1,5 +1,7 @@
 void initLEDChain()
 {
+  for (uint8_t i = 0; i < FX_SLOTS; i++)
+    fxList[i].ledNr = FX_NOLED;
   chainLength = eeprom_read_word ((uint16_t *) 0);
   if (chainLength > LED_COUNT)
     chainLength = LED_COUNT;
@@ -32,5 +34,103 @@ void setCurrColHSV(uint16_t ledNr, CHSV newCol)
 {
 //  Serial.printf("Set HSV %i to %i\n", ledNr, newCol);
   if ((ledNr >= 0) && (ledNr < chainLength))
-      ledChain[ledNr] = newCol;
+  {
+    int8_t thisSlot = findEffect(ledNr); //a pixel write ends the effect of the LED
+    if (thisSlot >= 0)
+      fxList[thisSlot].ledNr = FX_NOLED;
+    ledChain[ledNr] = newCol;
+  }
+}
+
+int8_t findEffect(uint16_t ledNr)
+{
+  for (uint8_t i = 0; i < FX_SLOTS; i++)
+    if (fxList[i].ledNr == ledNr)
+      return i;
+  return -1;
+}
+
+bool isGlobalEffect(uint8_t fxMode)
+{
+  return (fxMode == 3) || (fxMode == 4) || (fxMode == 7) || (fxMode == 8);
+}
+
+uint16_t getCycleLen(uint8_t fxMode, uint16_t period)
+{
+  return fxMode < 5 ? 2 * period : period; //blink modes have an on and an off period
+}
+
+//called from receiveEvent
+void setEffect(uint16_t ledNr, uint8_t fxMode, CHSV baseCol, CHSV altCol, uint16_t period, uint8_t phase)
+{
+  if (ledNr >= chainLength)
+    return;
+  if ((fxMode == 0) || (fxMode > 8) || (period == 0))
+  {
+    setCurrColHSV(ledNr, baseCol);
+    return;
+  }
+  int8_t thisSlot = findEffect(ledNr);
+  if (thisSlot < 0)
+    thisSlot = findEffect(FX_NOLED);
+  if (thisSlot < 0) //all slots in use, show the base color
+  {
+    ledChain[ledNr] = baseCol;
+    return;
+  }
+  if (period > 32767)
+    period = 32767;
+  fxList[thisSlot].fxMode = fxMode;
+  fxList[thisSlot].baseCol = baseCol;
+  fxList[thisSlot].altCol = altCol;
+  fxList[thisSlot].period = period;
+  fxList[thisSlot].cyclePos = ((uint32_t)getCycleLen(fxMode, period) * phase) >> 8;
+  fxList[thisSlot].ledNr = ledNr;
+  ledChain[ledNr] = getEffectColor(&fxList[thisSlot], millis());
+}
+
+CHSV getEffectColor(fxSlot * thisFx, uint32_t thisMillis)
+{
+  bool flipFx = (thisFx->fxMode & 0x01) == 0; //even modes are neg/down
+  uint16_t cycleLen = getCycleLen(thisFx->fxMode, thisFx->period);
+  uint16_t cyclePos = isGlobalEffect(thisFx->fxMode) ? (thisMillis + thisFx->cyclePos) % cycleLen : thisFx->cyclePos;
+  if (thisFx->fxMode >= 5) //ramp
+  {
+    uint8_t faderVal = ((uint32_t)cyclePos * 255) / thisFx->period;
+    if (flipFx)
+      faderVal = 255 - faderVal;
+    return CHSV(thisFx->baseCol.h, thisFx->baseCol.s, scale8(thisFx->baseCol.v, faderVal));
+  }
+  if ((cyclePos < thisFx->period) ^ flipFx)
+    return thisFx->baseCol;
+  else
+    return thisFx->altCol;
+}
+
+//called from loop, advances the local effects and shows the new frame
+void processEffects()
+{
+  uint32_t thisMillis = millis();
+  uint16_t timeElapsed = thisMillis - lastFxTime;
+  if (timeElapsed < FX_INTERVAL)
+    return;
+  lastFxTime = thisMillis;
+  bool fxActive = false;
+  for (uint8_t i = 0; i < FX_SLOTS; i++)
+  {
+    noInterrupts(); //receiveEvent may change the slot
+    fxSlot thisFx = fxList[i];
+    if ((thisFx.ledNr != FX_NOLED) && !isGlobalEffect(thisFx.fxMode))
+    {
+      thisFx.cyclePos = (thisFx.cyclePos + timeElapsed) % getCycleLen(thisFx.fxMode, thisFx.period);
+      fxList[i].cyclePos = thisFx.cyclePos;
+    }
+    interrupts();
+    if (thisFx.ledNr == FX_NOLED)
+      continue;
+    ledChain[thisFx.ledNr] = getEffectColor(&thisFx, thisMillis);
+    fxActive = true;
+  }
+  if (fxActive)
+    FastLED.show();
 }
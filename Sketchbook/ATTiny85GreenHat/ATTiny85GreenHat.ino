@@ -83,6 +83,24 @@ do not use
 
 #define wdtInterval 500
 
+//LED effects, animated locally after the ESP32 sent the descriptor
+#define FX_SLOTS 6
+#define FX_INTERVAL 50 //ms between animation frames, same as the LED refresh of the ESP32
+#define FX_NOLED 0xFFFF
+
+typedef struct
+{
+  uint16_t ledNr; //FX_NOLED for a free slot
+  uint8_t fxMode; //colorMode of IoTT_LEDChain
+  uint8_t baseCol[3]; //HSV
+  uint8_t altCol[3];
+  uint16_t period; //ms
+  uint16_t cyclePos; //ms into the cycle for local modes, phase offset for global modes
+} fxSlot;
+
+fxSlot fxList[FX_SLOTS];
+uint32_t lastFxTime = 0;
+
 void(* resetFunc) (void) = 0; //declare reset function @ address 0
 
 void setup() {
@@ -101,6 +119,7 @@ void setup() {
 //uint16_t oldHue = 0;
 void loop()
 {
+  processEffects();
 /*
   uint32_t rgbcolor = strip->ColorHSV(oldHue, 255, 50);
   oldHue = oldHue + 1;
@@ -24,6 +24,8 @@ void initLEDChain()
 
 void initLEDChain()
 {
+  for (uint8_t i = 0; i < FX_SLOTS; i++)
+    fxList[i].ledNr = FX_NOLED;
   chainLength = eeprom_read_word ((uint16_t *) 0);
   if (chainLength > LED_COUNT)
     chainLength = LED_COUNT;
@@ -86,12 +88,17 @@ uint32_t getColorHSV(uint16_t hue, uint8_t sat, uint8_t lval)
 
 void fillStrip(uint32_t newCol)
 {
+  for (uint8_t i = 0; i < FX_SLOTS; i++)
+    fxList[i].ledNr = FX_NOLED;
   strip->fill(newCol);
   strip->show(); 
 }
 
 void setSinglePixel(uint16_t ledNr, uint32_t thisCol)
 {
+  int8_t thisSlot = findEffect(ledNr); //a pixel write ends the effect of the LED
+  if (thisSlot >= 0)
+    fxList[thisSlot].ledNr = FX_NOLED;
   strip->setPixelColor(ledNr, thisCol);
 }
 
@@ -101,3 +108,94 @@ void showChain()
 }
 
 #endif
+
+int8_t findEffect(uint16_t ledNr)
+{
+  for (uint8_t i = 0; i < FX_SLOTS; i++)
+    if (fxList[i].ledNr == ledNr)
+      return i;
+  return -1;
+}
+
+bool isGlobalEffect(uint8_t fxMode)
+{
+  return (fxMode == 3) || (fxMode == 4) || (fxMode == 7) || (fxMode == 8);
+}
+
+uint16_t getCycleLen(uint8_t fxMode, uint16_t period)
+{
+  return fxMode < 5 ? 2 * period : period; //blink modes have an on and an off period
+}
+
+//called from receiveEvent with mode, base color, alternate color, period high, period low, phase
+void setEffect(uint16_t ledNr, uint8_t * fxData)
+{
+  if (ledNr >= chainLength)
+    return;
+  uint16_t period = (fxData[7] << 8) + fxData[8];
+  if ((fxData[0] == 0) || (fxData[0] > 8) || (period == 0))
+  {
+    setSinglePixel(ledNr, getColorHSV(fxData[1] << 8, fxData[2], fxData[3]));
+    return;
+  }
+  int8_t thisSlot = findEffect(ledNr);
+  if (thisSlot < 0)
+    thisSlot = findEffect(FX_NOLED);
+  if (thisSlot < 0) //all slots in use, show the base color
+  {
+    strip->setPixelColor(ledNr, getColorHSV(fxData[1] << 8, fxData[2], fxData[3]));
+    return;
+  }
+  if (period > 32767)
+    period = 32767;
+  fxList[thisSlot].fxMode = fxData[0];
+  memcpy(fxList[thisSlot].baseCol, &fxData[1], 3);
+  memcpy(fxList[thisSlot].altCol, &fxData[4], 3);
+  fxList[thisSlot].period = period;
+  fxList[thisSlot].cyclePos = ((uint32_t)getCycleLen(fxData[0], period) * fxData[9]) >> 8;
+  fxList[thisSlot].ledNr = ledNr;
+}
+
+uint32_t getEffectColor(fxSlot * thisFx, uint32_t thisMillis)
+{
+  bool flipFx = (thisFx->fxMode & 0x01) == 0; //even modes are neg/down
+  uint16_t cycleLen = getCycleLen(thisFx->fxMode, thisFx->period);
+  uint16_t cyclePos = isGlobalEffect(thisFx->fxMode) ? (thisMillis + thisFx->cyclePos) % cycleLen : thisFx->cyclePos;
+  if (thisFx->fxMode >= 5) //ramp
+  {
+    uint8_t faderVal = ((uint32_t)cyclePos * 255) / thisFx->period;
+    if (flipFx)
+      faderVal = 255 - faderVal;
+    return getColorHSV(thisFx->baseCol[0] << 8, thisFx->baseCol[1], ((uint16_t)thisFx->baseCol[2] * (faderVal + 1)) >> 8);
+  }
+  uint8_t * thisCol = ((cyclePos < thisFx->period) ^ flipFx) ? thisFx->baseCol : thisFx->altCol;
+  return getColorHSV(thisCol[0] << 8, thisCol[1], thisCol[2]);
+}
+
+//called from loop, advances the local effects and shows the new frame
+void processEffects()
+{
+  uint32_t thisMillis = millis();
+  uint16_t timeElapsed = thisMillis - lastFxTime;
+  if (timeElapsed < FX_INTERVAL)
+    return;
+  lastFxTime = thisMillis;
+  bool fxActive = false;
+  for (uint8_t i = 0; i < FX_SLOTS; i++)
+  {
+    noInterrupts(); //receiveEvent may change the slot
+    fxSlot thisFx = fxList[i];
+    if ((thisFx.ledNr != FX_NOLED) && !isGlobalEffect(thisFx.fxMode))
+    {
+      thisFx.cyclePos = (thisFx.cyclePos + timeElapsed) % getCycleLen(thisFx.fxMode, thisFx.period);
+      fxList[i].cyclePos = thisFx.cyclePos;
+    }
+    interrupts();
+    if (thisFx.ledNr == FX_NOLED)
+      continue;
+    strip->setPixelColor(thisFx.ledNr, getEffectColor(&thisFx, thisMillis));
+    fxActive = true;
+  }
+  if (fxActive)
+    strip->show();
+}
@@ -0,0 +1,189 @@
+#include "ADCSampler.h"
+#include "DIAG.h"
+
+#if defined(ARDUINO_ARCH_AVR)
+
+byte ADCSampler::pinList[ADC_MAX_CHANNELS];
+bool ADCSampler::fastList[ADC_MAX_CHANNELS];
+volatile uint16_t ADCSampler::sampleList[ADC_MAX_CHANNELS];
+volatile byte ADCSampler::sampleCtr[ADC_MAX_CHANNELS];
+volatile uint16_t ADCSampler::minList[ADC_MAX_CHANNELS];
+volatile uint16_t ADCSampler::maxList[ADC_MAX_CHANNELS];
+volatile uint16_t ADCSampler::numList[ADC_MAX_CHANNELS];
+byte ADCSampler::numChannels = 0;
+byte ADCSampler::fastIdx = 0;
+byte ADCSampler::slowIdx = 0;
+bool ADCSampler::useFast = true;
+volatile byte ADCSampler::convSlot = 0;
+volatile byte ADCSampler::queuedSlot = 0;
+volatile uint32_t ADCSampler::convCtr = 0;
+bool ADCSampler::running = false;
+
+byte ADCSampler::addChannel(byte pin, bool fastChannel) {
+  if (running || (numChannels >= ADC_MAX_CHANNELS)) {
+    DIAG(F("ADCSampler ** WARNING ** no slot for pin %d"), pin);
+    return ADC_NO_CHANNEL;
+  }
+  pinList[numChannels] = pin;
+  fastList[numChannels] = fastChannel;
+  minList[numChannels] = 0xFFFF;
+  return numChannels++;
+}
+
+byte ADCSampler::muxValue(byte slot) {
+  byte adcChannel = pinList[slot] >= A0 ? pinList[slot] - A0 : pinList[slot];
+#if defined(MUX5)
+  if (adcChannel > 7)
+    ADCSRB |= _BV(MUX5);
+  else
+    ADCSRB &= ~_BV(MUX5);
+#endif
+  return _BV(REFS0) | (adcChannel & 0x07); // AVcc reference, same as analogRead with DEFAULT
+}
+
+// round robin, alternating between the fast and the slow channels as long as there are both
+byte ADCSampler::nextSlot() {
+  for (byte i = 0; i < 2; i++) { // if there is no channel of the preferred type, take one of the other
+    bool thisType = useFast;
+    byte *thisIdx = thisType ? &fastIdx : &slowIdx;
+    useFast = !useFast;
+    for (byte j = 0; j < numChannels; j++) {
+      if (++(*thisIdx) >= numChannels) *thisIdx = 0;
+      if (fastList[*thisIdx] == thisType)
+        return *thisIdx;
+    }
+  }
+  return 0;
+}
+
+void ADCSampler::begin() {
+  if (numChannels == 0) return;
+  noInterrupts();
+  fastIdx = numChannels - 1; // so the first round starts at slot 0
+  slowIdx = numChannels - 1;
+  convSlot = nextSlot();
+  queuedSlot = convSlot; // the second conversion uses the same channel, the interrupt sets the third one
+  ADMUX = muxValue(convSlot);
+  ADCSRB &= ~(_BV(ADTS2) | _BV(ADTS1) | _BV(ADTS0)); // auto trigger source: free running
+  ADCSRA = _BV(ADEN) | _BV(ADSC) | _BV(ADATE) | _BV(ADIF) | _BV(ADIE) | ADC_PRESCALER;
+  running = true;
+  interrupts();
+  DIAG(F("ADCSampler running, %d channels"), numChannels);
+}
+
+bool ADCSampler::isRunning() {
+  return running;
+}
+
+void ADCSampler::interruptHandler() {
+  uint16_t newSample = ADC;
+  byte thisSlot = convSlot;
+  sampleList[thisSlot] = newSample;
+  sampleCtr[thisSlot]++;
+  if (newSample < minList[thisSlot]) minList[thisSlot] = newSample;
+  if (newSample > maxList[thisSlot]) maxList[thisSlot] = newSample;
+  if (numList[thisSlot] < 0xFFFF) numList[thisSlot]++;
+  convCtr++;
+  convSlot = queuedSlot; // this one is running now
+  queuedSlot = nextSlot();
+  ADMUX = muxValue(queuedSlot); // takes effect with the next conversion start
+}
+
+ISR(ADC_vect) { ADCSampler::interruptHandler(); }
+
+uint16_t ADCSampler::getValue(byte slot) {
+  if (slot >= numChannels) return 0;
+  if (!running) return analogRead(pinList[slot]);
+  uint16_t thisSample;
+  do { // 16 bit read is not atomic, read again if the interrupt changed the value in between
+    thisSample = sampleList[slot];
+  } while (thisSample != sampleList[slot]);
+  return thisSample;
+}
+
+byte ADCSampler::getSampleCount(byte slot) {
+  if (slot >= numChannels) return 0;
+  return sampleCtr[slot];
+}
+
+void ADCSampler::getMinMax(byte slot, uint16_t &minVal, uint16_t &maxVal, uint16_t &numSamples) {
+  if (slot >= numChannels) {
+    minVal = 0;
+    maxVal = 0;
+    numSamples = 0;
+    return;
+  }
+  if (!running) {
+    minVal = analogRead(pinList[slot]);
+    maxVal = minVal;
+    numSamples = 1;
+    return;
+  }
+  byte sregBackup = SREG; // a few cycles to take the values and start the next window
+  cli();
+  minVal = minList[slot];
+  maxVal = maxList[slot];
+  numSamples = numList[slot];
+  minList[slot] = 0xFFFF;
+  maxList[slot] = 0;
+  numList[slot] = 0;
+  SREG = sregBackup;
+}
+
+uint32_t ADCSampler::getConversionCount() {
+  byte sregBackup = SREG;
+  cli();
+  uint32_t thisCtr = convCtr;
+  SREG = sregBackup;
+  return thisCtr;
+}
+
+#else
+
+// other platforms have no free running sampler, the values are read with analogRead when they are asked for
+byte ADCSampler::pinList[ADC_MAX_CHANNELS];
+byte ADCSampler::numChannels = 0;
+bool ADCSampler::running = false;
+
+byte ADCSampler::addChannel(byte pin, bool fastChannel) {
+  if (numChannels >= ADC_MAX_CHANNELS) {
+    DIAG(F("ADCSampler ** WARNING ** no slot for pin %d"), pin);
+    return ADC_NO_CHANNEL;
+  }
+  pinList[numChannels] = pin;
+  return numChannels++;
+}
+
+void ADCSampler::begin() {
+}
+
+bool ADCSampler::isRunning() {
+  return running;
+}
+
+uint16_t ADCSampler::getValue(byte slot) {
+  if (slot >= numChannels) return 0;
+  return analogRead(pinList[slot]);
+}
+
+byte ADCSampler::getSampleCount(byte slot) {
+  return 0;
+}
+
+void ADCSampler::getMinMax(byte slot, uint16_t &minVal, uint16_t &maxVal, uint16_t &numSamples) {
+  if (slot >= numChannels) {
+    minVal = 0;
+    maxVal = 0;
+    numSamples = 0;
+    return;
+  }
+  minVal = analogRead(pinList[slot]);
+  maxVal = minVal;
+  numSamples = 1;
+}
+
+uint32_t ADCSampler::getConversionCount() {
+  return 0;
+}
+
+#endif
@@ -0,0 +1,46 @@
+#ifndef ADCSampler_h
+#define ADCSampler_h
+#include <Arduino.h>
+
+// Interrupt driven ADC scheduler for the RedHat (ATmega328P)
+// The ADC runs in free running mode, the conversion complete interrupt stores each result in the slot of its channel and
+// selects the channel after the next, as the next conversion is already running. Fast channels (track current) take every
+// second conversion, the slow channels (supply voltage, input banks) share the others. Callers read the latest sample
+// of a slot at any time, nobody waits for a conversion.
+// Channels are added before begin(). Until then, and on other platforms than AVR, getValue and getMinMax fall back to analogRead. After begin(),
+// analogRead must not be used anymore, it would break the conversion sequence.
+
+#define ADC_MAX_CHANNELS 8
+#define ADC_NO_CHANNEL 0xFF
+#define ADC_PRESCALER 0b110 // 16MHz / 64 = 250kHz ADC clock, 52us per conversion
+
+class ADCSampler {
+  public:
+    static byte addChannel(byte pin, bool fastChannel); // returns the slot number or ADC_NO_CHANNEL
+    static void begin();
+    static bool isRunning();
+    static uint16_t getValue(byte slot); // latest sample 0..1023
+    static byte getSampleCount(byte slot); // counts up with each sample of the slot, wraps around
+    static void getMinMax(byte slot, uint16_t &minVal, uint16_t &maxVal, uint16_t &numSamples); // since the previous call
+    static uint32_t getConversionCount();
+    static void interruptHandler(); // called from ISR(ADC_vect)
+  private:
+    static byte nextSlot();
+    static byte muxValue(byte slot);
+    static byte pinList[ADC_MAX_CHANNELS];
+    static bool fastList[ADC_MAX_CHANNELS];
+    static volatile uint16_t sampleList[ADC_MAX_CHANNELS];
+    static volatile byte sampleCtr[ADC_MAX_CHANNELS];
+    static volatile uint16_t minList[ADC_MAX_CHANNELS];
+    static volatile uint16_t maxList[ADC_MAX_CHANNELS];
+    static volatile uint16_t numList[ADC_MAX_CHANNELS];
+    static byte numChannels;
+    static byte fastIdx, slowIdx;
+    static bool useFast;
+    static volatile byte convSlot; // slot of the conversion in progress
+    static volatile byte queuedSlot; // slot of the conversion after that, already set in ADMUX
+    static volatile uint32_t convCtr;
+    static bool running;
+};
+
+#endif
@@ -0,0 +1,298 @@
+#include "BinLink.h"
+#include "DCCEXParser.h"
+#include "DCC.h"
+#include "DCCWaveform.h"
+#include "StringFormatter.h"
+
+Print * BinLink::linkStream = NULL;
+bool BinLink::active = false;
+byte BinLink::rxBuf[BINLINK_MAXENC];
+byte BinLink::rxLen = 0;
+bool BinLink::inFrame = false;
+byte BinLink::txBuf[BINLINK_MAXFRAME];
+byte BinLink::txLen = 0;
+byte BinLink::txSeq = 0;
+int16_t BinLink::lastSeq = -1;
+uint16_t BinLink::rxFrames = 0;
+uint16_t BinLink::rxRecords = 0;
+uint16_t BinLink::dupFrames = 0;
+uint16_t BinLink::badFrames = 0;
+uint16_t BinLink::txFrames = 0;
+unsigned long BinLink::execTime = 0;
+unsigned long BinLink::maxExecTime = 0;
+
+bool BinLink::receive(DCCEXParser * parser, Print * stream, byte inData) {
+  if ((inData != 0) && !inFrame) return false; // text
+  linkStream = stream;
+  if (inData == 0) {
+    if (inFrame && (rxLen > 0)) { // end of frame
+      processFrame(parser);
+      inFrame = false;
+    }
+    else
+      inFrame = true; // start of frame, or two delimiters in a row after losing sync
+    rxLen = 0;
+    return true;
+  }
+  if (rxLen < BINLINK_MAXENC)
+    rxBuf[rxLen++] = inData;
+  else { // no delimiter, this is not a frame of ours
+    badFrames++;
+    inFrame = false;
+  }
+  return true;
+}
+
+void BinLink::processFrame(DCCEXParser * parser) {
+  byte frameLen = cobsDecode(rxBuf, rxLen);
+  if ((frameLen < 2) || (crc8(rxBuf, frameLen - 1) != rxBuf[frameLen - 1])) {
+    badFrames++;
+    return;
+  }
+  frameLen--; // without crc
+  byte thisSeq = rxBuf[0];
+  if (thisSeq == lastSeq) // our ack got lost, the ESP32 sent the frame again
+    dupFrames++;
+  else {
+    unsigned long startTime = micros();
+    uint8_t outStat = PORTB & 0x01;
+    PORTB |= 0x01; //to keep the power relay going, same as for text commands
+    byte recPos = 1;
+    while (recPos < frameLen) {
+      byte recLen = recordSize(&rxBuf[recPos], frameLen - recPos);
+      if (recLen == 0) { // unknown or truncated record, the length of the rest is unknown
+        badFrames++;
+        break;
+      }
+      execRecord(parser, &rxBuf[recPos]);
+      rxRecords++;
+      recPos += recLen;
+    }
+    if (outStat == 0)
+      PORTB &= 0xFE; //restore s0
+    unsigned long thisTime = micros() - startTime; // DCC packets are handed to the waveform when this returns
+    execTime += thisTime;
+    if (thisTime > maxExecTime) maxExecTime = thisTime;
+    rxFrames++;
+    lastSeq = thisSeq;
+  }
+  byte ackRec[2] = {BLR_ACK, thisSeq};
+  addRecord(ackRec, 2);
+}
+
+byte BinLink::recordSize(const byte * rec, byte maxLen) {
+  byte recLen = 0;
+  switch (rec[0]) {
+    case BLR_POWER: recLen = 2; break;
+    case BLR_SPEED: recLen = 4; break;
+    case BLR_FORGET: recLen = 3; break;
+    case BLR_FUNCTION: recLen = 4; break;
+    case BLR_ACCESSORY: recLen = 3; break;
+    case BLR_CONFIG: recLen = 5; break;
+    case BLR_PROG: recLen = 7; break;
+    case BLR_PACKET:
+      if ((maxLen < 2) || (rec[1] == 0) || (rec[1] > MAX_PACKET_SIZE)) return 0;
+      recLen = rec[1] + 2;
+      break;
+  }
+  return recLen <= maxLen ? recLen : 0;
+}
+
+// appends a decimal number to a text command
+static char * addNum(char * txtPtr, int16_t numVal) {
+  *txtPtr++ = ' ';
+  itoa(numVal, txtPtr, 10);
+  return txtPtr + strlen(txtPtr);
+}
+
+// same checks and calls as the corresponding text commands in DCCEXParser::parse
+void BinLink::execRecord(DCCEXParser * parser, const byte * rec) {
+  int16_t addr = (rec[1] << 8) | rec[2];
+  switch (rec[0]) {
+    case BLR_POWER:
+      if (rec[1] == 2) {
+        DCC::setThrottle(0, 1, 1); // <!>
+        break;
+      }
+      {
+        POWERMODE mode = rec[1] == 1 ? POWERMODE::ON : POWERMODE::OFF;
+        DCC::setProgTrackSyncMain(false);
+        DCCWaveform::mainTrack.setPowerMode(mode);
+        DCCWaveform::progTrack.setPowerMode(mode);
+        if (mode == POWERMODE::OFF)
+          DCC::setProgTrackBoost(false);
+      }
+      break;
+    case BLR_SPEED:
+    {
+      byte tSpeed = rec[3] & 0x7F;
+      if (tSpeed > 126) break;
+      if (tSpeed > 0) tSpeed++; // map 1-126 -> 2-127
+      if ((addr == 0) && (tSpeed > 1)) break;
+      DCC::setThrottle(addr, tSpeed, rec[3] >> 7);
+      break;
+    }
+    case BLR_FORGET:
+      if (addr == 0) DCC::forgetAllLocos();
+      else DCC::forgetLoco(addr);
+      break;
+    case BLR_FUNCTION:
+      DCC::setFn(addr, rec[3] & 0x7F, rec[3] >> 7);
+      break;
+    case BLR_ACCESSORY:
+    {
+      int16_t linAddr = addr & 0x7FFF;
+      if (linAddr == 0) break;
+      int accAddr = (linAddr - 1) / 4 + 1;
+      if ((accAddr & 0x01FF) != accAddr) break;
+      DCC::setAccessory(accAddr, (linAddr - 1) % 4, rec[1] >> 7);
+      break;
+    }
+    case BLR_PACKET:
+      DCCWaveform::mainTrack.schedulePacket(&rec[2], rec[1], 3);
+      break;
+    case BLR_CONFIG:
+    case BLR_PROG:
+    { // rare and slow anyway, these go through the text parser for the board settings and the programming callbacks
+      char txtCmd[32];
+      char * txtPtr = &txtCmd[1];
+      if (rec[0] == BLR_CONFIG) {
+        txtCmd[0] = 'Z';
+        txtPtr = addNum(txtPtr, addr);
+        txtPtr = addNum(txtPtr, (rec[3] << 8) | rec[4]);
+      }
+      else {
+        int16_t cvNr = (rec[2] << 8) | rec[3];
+        switch (rec[1]) {
+          case BLP_READ: // <R cv 0 0>
+            txtCmd[0] = 'R';
+            txtPtr = addNum(txtPtr, cvNr);
+            txtPtr = addNum(txtPtr, 0);
+            txtPtr = addNum(txtPtr, 0);
+            break;
+          case BLP_WRITE: // <W cv value 0 0>
+            txtCmd[0] = 'W';
+            txtPtr = addNum(txtPtr, cvNr);
+            txtPtr = addNum(txtPtr, rec[4]);
+            txtPtr = addNum(txtPtr, 0);
+            txtPtr = addNum(txtPtr, 0);
+            break;
+          case BLP_WRITEBIT: // <B cv bit value 0 0>
+            txtCmd[0] = 'B';
+            txtPtr = addNum(txtPtr, cvNr);
+            txtPtr = addNum(txtPtr, rec[4] & 0x07);
+            txtPtr = addNum(txtPtr, (rec[4] >> 3) & 0x01);
+            txtPtr = addNum(txtPtr, 0);
+            txtPtr = addNum(txtPtr, 0);
+            break;
+          case BLP_WRITEMAIN: // <w addr cv value>
+            txtCmd[0] = 'w';
+            txtPtr = addNum(txtPtr, (rec[5] << 8) | rec[6]);
+            txtPtr = addNum(txtPtr, cvNr);
+            txtPtr = addNum(txtPtr, rec[4]);
+            break;
+          default:
+            return;
+        }
+      }
+      *txtPtr = '\0';
+      parser->parse(linkStream, (byte *)txtCmd, NULL);
+      break;
+    }
+  }
+}
+
+void BinLink::addRecord(const byte * rec, byte len) {
+  if ((txLen + len + 1) > BINLINK_MAXFRAME) flush(); // +1 for the crc
+  if (txLen == 0) txBuf[txLen++] = txSeq;
+  memcpy(&txBuf[txLen], rec, len);
+  txLen += len;
+}
+
+void BinLink::flush() {
+  if ((txLen < 2) || (linkStream == NULL)) return;
+  txBuf[txLen] = crc8(txBuf, txLen);
+  byte encBuf[BINLINK_MAXENC];
+  byte encLen = cobsEncode(txBuf, txLen + 1, encBuf);
+  linkStream->write((byte)0);
+  linkStream->write(encBuf, encLen);
+  linkStream->write((byte)0);
+  txLen = 0;
+  txSeq++;
+  txFrames++;
+}
+
+void BinLink::start(Print * stream) {
+  linkStream = stream;
+  active = true;
+  lastSeq = -1; // the ESP32 may have restarted its sequence
+  byte helloRec[2] = {BLR_HELLO, BINLINK_VERSION};
+  addRecord(helloRec, 2);
+}
+
+void BinLink::stop() {
+  active = false;
+}
+
+bool BinLink::addSensor(byte sensorNr, bool sensorState) {
+  if (!active) return false;
+  byte sensorRec[2] = {BLR_SENSOR, (byte)((sensorState ? 0x80 : 0x00) | sensorNr)};
+  addRecord(sensorRec, 2);
+  return true;
+}
+
+bool BinLink::addProgReply(int16_t cv, int16_t value) {
+  if (!active) return false;
+  byte replyRec[5] = {BLR_PROGREPLY, highByte(cv), lowByte(cv), highByte(value), lowByte(value)};
+  addRecord(replyRec, 5);
+  return true;
+}
+
+void BinLink::printStats(Print * stream) {
+  StringFormatter::send(stream, F("<* BinLink %S: %d frames %d records in, %d repeated, %d bad, %d frames out *>\n"),
+    active ? F("active") : F("text replies"), rxFrames, rxRecords, dupFrames, badFrames, txFrames);
+  StringFormatter::send(stream, F("<* Frame to rail: avg %l us max %l us *>\n"),
+    rxFrames ? execTime / rxFrames : 0UL, maxExecTime);
+}
+
+// in place, returns the decoded length or 0 for an invalid frame
+byte BinLink::cobsDecode(byte * buf, byte len) {
+  byte inPos = 0;
+  byte outPos = 0;
+  while (inPos < len) {
+    byte code = buf[inPos++];
+    if ((code == 0) || ((inPos + code - 1) > len)) return 0;
+    for (byte i = 1; i < code; i++)
+      buf[outPos++] = buf[inPos++];
+    if ((code < 0xFF) && (inPos < len))
+      buf[outPos++] = 0;
+  }
+  return outPos;
+}
+
+// frames are shorter than 254 bytes, so there is never a 0xFF block
+byte BinLink::cobsEncode(const byte * src, byte len, byte * dst) {
+  byte codePos = 0;
+  byte outPos = 1;
+  for (byte i = 0; i < len; i++) {
+    if (src[i] == 0) {
+      dst[codePos] = outPos - codePos;
+      codePos = outPos++;
+    }
+    else
+      dst[outPos++] = src[i];
+  }
+  dst[codePos] = outPos - codePos;
+  return outPos;
+}
+
+// CRC-8, polynomial 0x07
+byte BinLink::crc8(const byte * data, byte len) {
+  byte crc = 0;
+  for (byte i = 0; i < len; i++) {
+    crc ^= data[i];
+    for (byte j = 0; j < 8; j++)
+      crc = (crc & 0x80) ? (crc << 1) ^ 0x07 : crc << 1;
+  }
+  return crc;
+}
@@ -0,0 +1,66 @@
+#ifndef BinLink_h
+#define BinLink_h
+#include <Arduino.h>
+
+// Binary framed link to the ESP32 (IoTT_SerInjector in DCCEx mode), shares the serial port with the DCC-EX text commands
+// A frame is 0x00, COBS encoded [seq][record][record]...[crc8], 0x00. Text never contains 0x00, so the parser loop hands
+// every byte from a 0x00 up to the next 0x00 to BinLink and everything else to the text parser.
+// Incoming frames are always accepted. Each executed frame is acknowledged with an ACK record carrying its sequence number,
+// a repeated frame (ack lost) is acknowledged again but not executed. Sensor changes and programming replies are only sent
+// in binary after the ESP32 asked for it with <D BINLINK ON>, <D BINLINK OFF> goes back to text, <D BINLINK> shows the stats.
+// Replies are collected during a loop and sent as one frame at the end of DCCEXParser::loop
+
+#define BINLINK_MAXFRAME 32 // decoded frame size including seq and crc, the ESP32 uses the same limit
+#define BINLINK_MAXENC (BINLINK_MAXFRAME + 1) // COBS adds one byte for frames up to 254 bytes
+#define BINLINK_VERSION 1
+
+enum BINLINK_REC : byte {
+  BLR_POWER = 0x01, // mode: 0 off, 1 on, 2 emergency stop all
+  BLR_SPEED = 0x02, // addr hi, addr lo, direction << 7 | speed 0..126 as in <t 1 addr speed dir>
+  BLR_FORGET = 0x03, // addr hi, addr lo, 0 forgets all locos
+  BLR_FUNCTION = 0x04, // addr hi, addr lo, on << 7 | function number
+  BLR_ACCESSORY = 0x05, // activate << 7 | linear addr hi, addr lo as in <a addr 0|1>
+  BLR_CONFIG = 0x06, // id hi, id lo, value hi, value lo as in <Z id value>
+  BLR_PROG = 0x07, // BINLINK_PROG op, cv hi, cv lo, value, addr hi, addr lo
+  BLR_PACKET = 0x08, // length, DCC packet bytes as in <M 0 ...>
+  BLR_ACK = 0x80, // seq of the executed frame
+  BLR_SENSOR = 0x81, // state << 7 | sensor number
+  BLR_PROGREPLY = 0x82, // cv hi, cv lo, value hi, value lo, value -1 if the decoder did not respond
+  BLR_HELLO = 0x83 // BINLINK_VERSION, answer to <D BINLINK ON>
+};
+
+enum BINLINK_PROG : byte { BLP_READ, BLP_WRITE, BLP_WRITEBIT, BLP_WRITEMAIN }; // WRITEBIT value is bit number | bit value << 3
+
+class DCCEXParser;
+
+class BinLink {
+  public:
+    static bool receive(DCCEXParser * parser, Print * stream, byte inData); // returns true if the byte belongs to a frame
+    static void flush(); // sends the collected records
+    static void start(Print * stream);
+    static void stop();
+    static bool addSensor(byte sensorNr, bool sensorState); // false if the link is not active, send as text then
+    static bool addProgReply(int16_t cv, int16_t value);
+    static void printStats(Print * stream);
+  private:
+    static void processFrame(DCCEXParser * parser);
+    static byte recordSize(const byte * rec, byte maxLen);
+    static void execRecord(DCCEXParser * parser, const byte * rec);
+    static void addRecord(const byte * rec, byte len);
+    static byte cobsDecode(byte * buf, byte len);
+    static byte cobsEncode(const byte * src, byte len, byte * dst);
+    static byte crc8(const byte * data, byte len);
+    static Print * linkStream;
+    static bool active;
+    static byte rxBuf[BINLINK_MAXENC];
+    static byte rxLen;
+    static bool inFrame;
+    static byte txBuf[BINLINK_MAXFRAME];
+    static byte txLen;
+    static byte txSeq;
+    static int16_t lastSeq;
+    static uint16_t rxFrames, rxRecords, dupFrames, badFrames, txFrames;
+    static unsigned long execTime, maxExecTime;
+};
+
+#endif
@@ -0,0 +1,309 @@
+#include "CVCache.h"
+#include "EEStore.h"
+#include "StringFormatter.h"
+#include "DIAG.h"
+
+// EEPROM layout from CVCACHE_EEBASE: 'C' 'V' lastDecoder nextTag nextVictim
+// decoder table: CVCACHE_DECODERS x {address low, address high, CV7, CV8, tag}, tag CVCACHE_NOTAG for an unused decoder
+// entries: CVCACHE_ENTRIES x {tag << 2 | (cv - 1) >> 8, (cv - 1) & 0xFF, value}, 0xFF in the first byte for an empty entry
+// An entry is found by probing CVCACHE_PROBES entries from its hash position. A replaced decoder gets a new tag, so its
+// entries don't have to be erased, they are free for reuse as soon as the tag is not in the decoder table anymore
+#define CVCACHE_HEADER 5
+#define CVCACHE_DECLEN 5
+#define CVCACHE_ENTRYBASE (CVCACHE_EEBASE + CVCACHE_HEADER + (CVCACHE_DECODERS * CVCACHE_DECLEN))
+
+enum { ID_CV1, ID_CV7, ID_CV8, ID_CV17, ID_CV18, ID_CV29 };
+
+byte CVCache::idValue[6];
+byte CVCache::idKnown = 0;
+int16_t CVCache::locoId = -1;
+byte CVCache::sessDecoder = CVCACHE_NOTAG;
+bool CVCache::sessConfirmed = false;
+CVCACHE_OP CVCache::pendingOp = CVC_NONE;
+int16_t CVCache::pendingCv = 0;
+int16_t CVCache::pendingValue = 0;
+int16_t CVCache::pendingCached = -1;
+unsigned long CVCache::opStart = 0;
+unsigned long CVCache::lastOpTime = 0;
+uint16_t CVCache::coldReads = 0;
+uint16_t CVCache::warmReads = 0;
+uint16_t CVCache::warmHits = 0;
+unsigned long CVCache::coldTime = 0;
+unsigned long CVCache::warmTime = 0;
+
+void CVCache::begin() {
+  if ((EEPROM.read(CVCACHE_EEBASE) != 'C') || (EEPROM.read(CVCACHE_EEBASE + 1) != 'V'))
+    clear();
+  newSession(true);
+}
+
+void CVCache::clear() {
+  for (int i = CVCACHE_EEBASE + 2; i < CVCACHE_ENTRYBASE + (CVCACHE_ENTRIES * 3); i++)
+    EEPROM.update(i, 0xFF);
+  EEPROM.update(CVCACHE_EEBASE + 3, 0); // nextTag
+  EEPROM.update(CVCACHE_EEBASE + 4, 0); // nextVictim
+  EEPROM.update(CVCACHE_EEBASE, 'C');
+  EEPROM.update(CVCACHE_EEBASE + 1, 'V');
+  newSession(false);
+  DIAG(F("CV cache cleared"));
+}
+
+int CVCache::decoderAddr(byte decoder) {
+  return CVCACHE_EEBASE + CVCACHE_HEADER + (decoder * CVCACHE_DECLEN);
+}
+
+int CVCache::entryAddr(uint16_t entry) {
+  return CVCACHE_ENTRYBASE + (entry * 3);
+}
+
+byte CVCache::getTag(byte decoder) {
+  if (decoder >= CVCACHE_DECODERS) return CVCACHE_NOTAG;
+  return EEPROM.read(decoderAddr(decoder) + 4);
+}
+
+bool CVCache::tagInUse(byte tag) {
+  for (byte i = 0; i < CVCACHE_DECODERS; i++)
+    if (getTag(i) == tag) return true;
+  return false;
+}
+
+uint16_t CVCache::homeEntry(byte tag, int16_t cv) {
+  return ((uint16_t)tag * 97 + cv) % CVCACHE_ENTRIES;
+}
+
+int8_t CVCache::identityIndex(int16_t cv) {
+  switch (cv) {
+    case 1: return ID_CV1;
+    case 7: return ID_CV7;
+    case 8: return ID_CV8;
+    case 17: return ID_CV17;
+    case 18: return ID_CV18;
+    case 29: return ID_CV29;
+    default: return -1;
+  }
+}
+
+void CVCache::newSession(bool guessDecoder) {
+  idKnown = 0;
+  locoId = -1;
+  sessConfirmed = false;
+  sessDecoder = CVCACHE_NOTAG;
+  if (guessDecoder) {
+    byte lastDecoder = EEPROM.read(CVCACHE_EEBASE + 2);
+    if (getTag(lastDecoder) != CVCACHE_NOTAG)
+      sessDecoder = lastDecoder;
+  }
+}
+
+int16_t CVCache::sessionAddress() {
+  if (locoId > 0) return locoId;
+  if ((idKnown & bit(ID_CV29)) == 0) return -1;
+  if (idValue[ID_CV29] & 0x20) { // long address in use
+    if ((idKnown & (bit(ID_CV17) | bit(ID_CV18))) != (bit(ID_CV17) | bit(ID_CV18))) return -1;
+    return ((idValue[ID_CV17] & 0x3F) << 8) | idValue[ID_CV18];
+  }
+  if ((idKnown & bit(ID_CV1)) == 0) return -1;
+  return idValue[ID_CV1] & 0x7F;
+}
+
+byte CVCache::findDecoder(int16_t addr, byte cv7, byte cv8) {
+  for (byte i = 0; i < CVCACHE_DECODERS; i++) {
+    int decAddr = decoderAddr(i);
+    if ((EEPROM.read(decAddr + 4) != CVCACHE_NOTAG) && (EEPROM.read(decAddr + 2) == cv7) && (EEPROM.read(decAddr + 3) == cv8) &&
+        ((EEPROM.read(decAddr) | (EEPROM.read(decAddr + 1) << 8)) == addr))
+      return i;
+  }
+  return CVCACHE_NOTAG;
+}
+
+byte CVCache::addDecoder(int16_t addr, byte cv7, byte cv8) {
+  byte decoder = CVCACHE_NOTAG;
+  for (byte i = 0; i < CVCACHE_DECODERS; i++)
+    if (getTag(i) == CVCACHE_NOTAG) {
+      decoder = i;
+      break;
+    }
+  if (decoder == CVCACHE_NOTAG) { // table full, replace the decoders round robin
+    decoder = EEPROM.read(CVCACHE_EEBASE + 4) % CVCACHE_DECODERS;
+    EEPROM.update(CVCACHE_EEBASE + 4, (decoder + 1) % CVCACHE_DECODERS);
+    EEPROM.update(decoderAddr(decoder) + 4, CVCACHE_NOTAG); // release the old tag before looking for a new one
+  }
+  byte newTag = EEPROM.read(CVCACHE_EEBASE + 3) % CVCACHE_MAXTAG;
+  while (tagInUse(newTag)) // at most CVCACHE_DECODERS tags are in use, so this ends
+    newTag = (newTag + 1) % CVCACHE_MAXTAG;
+  EEPROM.update(CVCACHE_EEBASE + 3, (newTag + 1) % CVCACHE_MAXTAG); // rotate the tags, so old entries are unlikely to show up again
+  int decAddr = decoderAddr(decoder);
+  EEPROM.update(decAddr, addr & 0xFF);
+  EEPROM.update(decAddr + 1, addr >> 8);
+  EEPROM.update(decAddr + 2, cv7);
+  EEPROM.update(decAddr + 3, cv8);
+  EEPROM.update(decAddr + 4, newTag);
+  return decoder;
+}
+
+int16_t CVCache::lookup(int16_t cv) {
+  byte tag = getTag(sessDecoder);
+  if ((tag == CVCACHE_NOTAG) || (cv < 1) || (cv > 1024)) return -1;
+  byte keyHigh = (tag << 2) | ((cv - 1) >> 8);
+  byte keyLow = (cv - 1) & 0xFF;
+  uint16_t entry = homeEntry(tag, cv);
+  for (byte i = 0; i < CVCACHE_PROBES; i++) {
+    int eeAddr = entryAddr(entry);
+    if ((EEPROM.read(eeAddr) == keyHigh) && (EEPROM.read(eeAddr + 1) == keyLow))
+      return EEPROM.read(eeAddr + 2);
+    if (++entry >= CVCACHE_ENTRIES) entry = 0;
+  }
+  return -1;
+}
+
+void CVCache::storeValue(int16_t cv, byte value) {
+  byte tag = getTag(sessDecoder);
+  if (!sessConfirmed || (tag == CVCACHE_NOTAG) || (cv < 1) || (cv > 1024)) return;
+  byte keyHigh = (tag << 2) | ((cv - 1) >> 8);
+  byte keyLow = (cv - 1) & 0xFF;
+  uint16_t homePos = homeEntry(tag, cv);
+  uint16_t entry = homePos;
+  uint16_t freeEntry = CVCACHE_ENTRIES;
+  for (byte i = 0; i < CVCACHE_PROBES; i++) {
+    int eeAddr = entryAddr(entry);
+    byte entryKey = EEPROM.read(eeAddr);
+    if ((entryKey == keyHigh) && (EEPROM.read(eeAddr + 1) == keyLow)) {
+      EEPROM.update(eeAddr + 2, value);
+      return;
+    }
+    if ((freeEntry == CVCACHE_ENTRIES) && ((entryKey == 0xFF) || !tagInUse(entryKey >> 2)))
+      freeEntry = entry;
+    if (++entry >= CVCACHE_ENTRIES) entry = 0;
+  }
+  int eeAddr = entryAddr(freeEntry < CVCACHE_ENTRIES ? freeEntry : homePos); // no free entry, replace the first one
+  EEPROM.update(eeAddr, 0xFF); // mark empty while the entry is incomplete
+  EEPROM.update(eeAddr + 1, keyLow);
+  EEPROM.update(eeAddr + 2, value);
+  EEPROM.update(eeAddr, keyHigh);
+}
+
+// keeps the values of the identity CVs and checks them against the decoder in use
+void CVCache::updateIdentity(int16_t cv, int16_t value) {
+  int8_t idIndex = identityIndex(cv);
+  if (idIndex < 0) return;
+  if ((idIndex == ID_CV7) || (idIndex == ID_CV8)) {
+    if ((idKnown & bit(idIndex)) && (idValue[idIndex] != value)) // different decoder on the track
+      newSession(false);
+    if ((sessDecoder != CVCACHE_NOTAG) && (EEPROM.read(decoderAddr(sessDecoder) + (idIndex == ID_CV7 ? 2 : 3)) != value)) {
+      if (sessConfirmed) // the identity of a known decoder does not change, so this is another decoder
+        newSession(false);
+      else
+        sessDecoder = CVCACHE_NOTAG; // guessed wrong
+    }
+  }
+  idValue[idIndex] = value;
+  idKnown |= bit(idIndex);
+  if ((idIndex != ID_CV7) && (idIndex != ID_CV8))
+    locoId = -1; // address CVs read or written, derive the address from them
+}
+
+int16_t CVCache::startOp(CVCACHE_OP opType, int16_t cv, int16_t value) {
+  if (millis() - lastOpTime > CVCACHE_IDLE)
+    newSession(true);
+  pendingOp = opType;
+  pendingCv = cv;
+  pendingValue = value;
+  pendingCached = opType == CVC_READ ? lookup(cv) : -1;
+  opStart = millis();
+  return pendingCached;
+}
+
+void CVCache::opDone(int16_t result) {
+  CVCACHE_OP thisOp = pendingOp;
+  pendingOp = CVC_NONE;
+  lastOpTime = millis();
+  if ((thisOp == CVC_NONE) || (result < 0)) return;
+  int16_t newValue = -1;
+  switch (thisOp) {
+    case CVC_READ:
+      newValue = result;
+      if (pendingCached >= 0) {
+        warmReads++;
+        warmTime += lastOpTime - opStart;
+        if (result == pendingCached) warmHits++;
+      } else {
+        coldReads++;
+        coldTime += lastOpTime - opStart;
+      }
+      break;
+    case CVC_VERIFY:
+      newValue = result;
+      break;
+    case CVC_WRITE:
+      newValue = pendingValue;
+      if (pendingCv == 8) { // writing CV8 resets the decoder, forget all its values
+        if (sessConfirmed)
+          EEPROM.update(decoderAddr(sessDecoder) + 4, CVCACHE_NOTAG);
+        newSession(false);
+        return;
+      }
+      break;
+    case CVC_WRITEBIT: {
+      int8_t idIndex = identityIndex(pendingCv);
+      int16_t oldValue = idIndex >= 0 && (idKnown & bit(idIndex)) ? idValue[idIndex] : lookup(pendingCv);
+      if (oldValue >= 0)
+        newValue = bitWrite(oldValue, pendingValue & 0x07, pendingValue >> 7);
+      break;
+    }
+    case CVC_LOCOID:
+      locoId = result;
+      break;
+    case CVC_SETLOCOID: // CV1 or CV17/18 and CV29 are written
+      idKnown &= ~(bit(ID_CV1) | bit(ID_CV17) | bit(ID_CV18) | bit(ID_CV29));
+      locoId = pendingValue;
+      break;
+    default:
+      break;
+  }
+  if (newValue >= 0) {
+    updateIdentity(pendingCv, newValue);
+    storeValue(pendingCv, newValue);
+  }
+  int16_t addr = sessionAddress();
+  if (sessConfirmed) {
+    if ((addr >= 0) && ((thisOp == CVC_SETLOCOID) || (identityIndex(pendingCv) >= 0))) { // address may be changed by a write, same decoder
+      int decAddr = decoderAddr(sessDecoder);
+      EEPROM.update(decAddr, addr & 0xFF);
+      EEPROM.update(decAddr + 1, addr >> 8);
+    }
+    return;
+  }
+  if ((addr < 0) || ((idKnown & (bit(ID_CV7) | bit(ID_CV8))) != (bit(ID_CV7) | bit(ID_CV8))))
+    return;
+  // decoder identified, store what was read before
+  sessDecoder = findDecoder(addr, idValue[ID_CV7], idValue[ID_CV8]);
+  if (sessDecoder == CVCACHE_NOTAG)
+    sessDecoder = addDecoder(addr, idValue[ID_CV7], idValue[ID_CV8]);
+  sessConfirmed = true;
+  EEPROM.update(CVCACHE_EEBASE + 2, sessDecoder);
+  const int16_t idCVs[] = {1, 7, 8, 17, 18, 29};
+  for (byte i = 0; i < 6; i++)
+    if (idKnown & bit(i))
+      storeValue(idCVs[i], idValue[i]);
+  DIAG(F("CV cache: decoder %d, address %d, CV7=%d CV8=%d"), sessDecoder, addr, idValue[ID_CV7], idValue[ID_CV8]);
+}
+
+void CVCache::printStats(Print * stream) {
+  uint16_t usedEntries = 0;
+  for (uint16_t i = 0; i < CVCACHE_ENTRIES; i++) {
+    byte entryKey = EEPROM.read(entryAddr(i));
+    if ((entryKey != 0xFF) && tagInUse(entryKey >> 2)) usedEntries++;
+  }
+  StringFormatter::send(stream, F("<* CV cache: %d of %d entries used, decoder %d%S *>\n"), usedEntries, CVCACHE_ENTRIES,
+    sessDecoder == CVCACHE_NOTAG ? -1 : sessDecoder, sessConfirmed ? F("") : F(" (not identified)"));
+  for (byte i = 0; i < CVCACHE_DECODERS; i++) {
+    int decAddr = decoderAddr(i);
+    if (EEPROM.read(decAddr + 4) != CVCACHE_NOTAG)
+      StringFormatter::send(stream, F("<* Decoder %d: address %d CV7=%d CV8=%d *>\n"), i,
+        EEPROM.read(decAddr) | (EEPROM.read(decAddr + 1) << 8), EEPROM.read(decAddr + 2), EEPROM.read(decAddr + 3));
+  }
+  StringFormatter::send(stream, F("<* Cold reads: %d in %l ms, %l CVs per minute *>\n"), coldReads, coldTime,
+    coldTime ? (60000UL * coldReads) / coldTime : 0UL);
+  StringFormatter::send(stream, F("<* Cached reads: %d in %l ms, %l CVs per minute, %d verified at first try *>\n"), warmReads, warmTime,
+    warmTime ? (60000UL * warmReads) / warmTime : 0UL, warmHits);
+}
@@ -0,0 +1,61 @@
+#ifndef CVCache_h
+#define CVCache_h
+#include <Arduino.h>
+
+// EEPROM cache of the CV values read from or written to decoders on the programming track
+// A decoder is identified by its address, CV7 (version) and CV8 (manufacturer). Reading a cached CV starts with a single
+// byte verify of the cached value, only if the decoder does not acknowledge it the bitwise read follows (VERIFY_BYTE_PROG
+// does both). So a stale entry costs one verify, and the result is always what the decoder returns.
+// Until the decoder on the track is identified, the cache of the previous decoder is tried. Values are stored once the
+// decoder is identified. A read of CV7 or CV8 with a different value, or 60s without programming, start a new session.
+// <D CVCACHE> shows the read rates with and without cached values, <D CVCACHE CLEAR> erases the cache
+
+#define CVCACHE_EEBASE 64 // EEStore uses the bytes before
+#define CVCACHE_DECODERS 8
+#define CVCACHE_ENTRIES 300 // 3 bytes each, together with the tables this fills the 1k EEPROM of the 328P
+#define CVCACHE_PROBES 8
+#define CVCACHE_NOTAG 0xFF
+#define CVCACHE_MAXTAG 63 // tag 63 with the high CV bits 11 would read as an empty entry
+#define CVCACHE_IDLE 60000 // ms without programming track activity, the decoder may have been exchanged
+
+enum CVCACHE_OP : byte { CVC_NONE, CVC_READ, CVC_VERIFY, CVC_WRITE, CVC_WRITEBIT, CVC_LOCOID, CVC_SETLOCOID };
+
+class CVCache {
+  public:
+    static void begin();
+    static int16_t lookup(int16_t cv); // cached value for the decoder on the programming track or -1
+    // value is the byte for CVC_WRITE, bit number | (bit value << 7) for CVC_WRITEBIT and the address for CVC_SETLOCOID
+    // returns the cached value to verify for CVC_READ, -1 if there is none
+    static int16_t startOp(CVCACHE_OP opType, int16_t cv, int16_t value);
+    static void opDone(int16_t result); // called with the callback value of the ack manager
+    static void clear();
+    static void printStats(Print * stream);
+  private:
+    static void newSession(bool guessDecoder);
+    static void storeValue(int16_t cv, byte value);
+    static void updateIdentity(int16_t cv, int16_t value);
+    static int16_t sessionAddress();
+    static byte findDecoder(int16_t addr, byte cv7, byte cv8);
+    static byte addDecoder(int16_t addr, byte cv7, byte cv8);
+    static bool tagInUse(byte tag);
+    static byte getTag(byte decoder);
+    static int decoderAddr(byte decoder);
+    static int entryAddr(uint16_t entry);
+    static uint16_t homeEntry(byte tag, int16_t cv);
+    static int8_t identityIndex(int16_t cv);
+    static byte idValue[6]; // CV1, 7, 8, 17, 18, 29 of the decoder on the track
+    static byte idKnown;
+    static int16_t locoId;
+    static byte sessDecoder;
+    static bool sessConfirmed;
+    static CVCACHE_OP pendingOp;
+    static int16_t pendingCv;
+    static int16_t pendingValue;
+    static int16_t pendingCached;
+    static unsigned long opStart;
+    static unsigned long lastOpTime;
+    static uint16_t coldReads, warmReads, warmHits;
+    static unsigned long coldTime, warmTime;
+};
+
+#endif
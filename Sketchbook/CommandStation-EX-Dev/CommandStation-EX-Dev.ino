@@ -55,6 +55,7 @@
 #ifdef cycleCount
   uint32_t lastCount = millis();
   uint16_t cycCtr = 0; 
+  uint32_t lastConvCount = 0;
 #endif
   
 void setup()
@@ -107,7 +108,9 @@ void loop()
   cycCtr++;
   if ((millis() - lastCount) > 1000)
   {
-    DIAG(F("Loops: %d"), cycCtr);
+    uint32_t convCount = ADCSampler::getConversionCount();
+    DIAG(F("Loops: %d ADC conversions: %l"), cycCtr, convCount - lastConvCount);
+    lastConvCount = convCount;
     lastCount += 1000;
     cycCtr = 0; 
   }
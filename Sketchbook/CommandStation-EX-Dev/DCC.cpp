@@ -21,6 +21,7 @@
 #include "DCC.h"
 #include "DCCWaveform.h"
 #include "EEStore.h"
+#include "CVCache.h"
 #include "GITHUB_SHA.h"
 #include "version.h"
 #include "FSH.h"
@@ -43,6 +44,7 @@ const byte FN_GROUP_2=0x02;
 const byte FN_GROUP_3=0x04;         
 const byte FN_GROUP_4=0x08;         
 const byte FN_GROUP_5=0x10;         
+const byte REMIND_SPEED=0x80;
 
 FSH* DCC::shieldName=NULL;
 byte DCC::joinRelay=UNUSED_PIN;
@@ -55,6 +57,7 @@ void DCC::begin(const FSH * motorShieldName, MotorDriver * mainDriver, MotorDriv
 //  // Load stuff from EEprom
 //  (void)EEPROM; // tell compiler not to warn this is unused
 //  EEStore::init();
+  CVCache::begin();
 
   DCCWaveform::begin(mainDriver,progDriver); 
 }
@@ -177,6 +180,7 @@ void DCC::setFn( int cab, int16_t functionNumber, bool on) {
       speedTable[reg].functions &= ~funcmask;
   }
   updateGroupflags(speedTable[reg].groupFlags, functionNumber);
+  markChanged(reg, functionGroup(functionNumber));
   return;
 }
 
@@ -210,6 +214,7 @@ int DCC::changeFn( int cab, int16_t functionNumber, bool pressed) {
       funcstate = (speedTable[reg].functions & funcmask)? 1 : 0;
   }
   updateGroupflags(speedTable[reg].groupFlags, functionNumber);
+  markChanged(reg, functionGroup(functionNumber));
   return funcstate;
 }
 
@@ -225,13 +230,15 @@ int DCC::getFn( int cab, int16_t functionNumber) {
 // Set the group flag to say we have touched the particular group.
 // A group will be reminded only if it has been touched.  
 void DCC::updateGroupflags(byte & flags, int16_t functionNumber) {
-  byte groupMask;
-  if (functionNumber<=4)       groupMask=FN_GROUP_1;
-  else if (functionNumber<=8)  groupMask=FN_GROUP_2;
-  else if (functionNumber<=12) groupMask=FN_GROUP_3;
-  else if (functionNumber<=20) groupMask=FN_GROUP_4;
-  else                         groupMask=FN_GROUP_5;
-  flags |= groupMask; 
+  flags |= functionGroup(functionNumber); 
+}
+
+byte DCC::functionGroup(int16_t functionNumber) {
+  if (functionNumber<=4)       return FN_GROUP_1;
+  else if (functionNumber<=8)  return FN_GROUP_2;
+  else if (functionNumber<=12) return FN_GROUP_3;
+  else if (functionNumber<=20) return FN_GROUP_4;
+  else                         return FN_GROUP_5;
 }
 
 void DCC::setAccessory(int address, byte number, bool activate) {
@@ -504,15 +511,20 @@ const ackOp FLASH LONG_LOCO_ID_PROG[] = {
 };    
 
 void  DCC::writeCVByte(int16_t cv, byte byteValue, ACK_CALLBACK callback)  {
+  CVCache::startOp(CVC_WRITE, cv, byteValue);
   ackManagerSetup(cv, byteValue,  WRITE_BYTE_PROG, callback);
 }
 
 void DCC::writeCVBit(int16_t cv, byte bitNum, bool bitValue, ACK_CALLBACK callback)  {
   if (bitNum >= 8) callback(-1);
-  else ackManagerSetup(cv, bitNum, bitValue?WRITE_BIT1_PROG:WRITE_BIT0_PROG, callback);
+  else {
+    CVCache::startOp(CVC_WRITEBIT, cv, bitNum | (bitValue << 7));
+    ackManagerSetup(cv, bitNum, bitValue?WRITE_BIT1_PROG:WRITE_BIT0_PROG, callback);
+  }
 }
 
 void  DCC::verifyCVByte(int16_t cv, byte byteValue, ACK_CALLBACK callback)  {
+  CVCache::startOp(CVC_VERIFY, cv, byteValue);
   ackManagerSetup(cv, byteValue,  VERIFY_BYTE_PROG, callback);
 }
 
@@ -528,10 +540,15 @@ void DCC::readCVBit(int16_t cv, byte bitNum, ACK_CALLBACK callback)  {
 }
 
 void DCC::readCV(int16_t cv, ACK_CALLBACK callback)  {
-  ackManagerSetup(cv, 0,READ_CV_PROG, callback);
+  int16_t cachedValue = CVCache::startOp(CVC_READ, cv, 0);
+  if (cachedValue >= 0) // one verify if the decoder still has the cached value, VERIFY_BYTE_PROG reads bitwise if not
+    ackManagerSetup(cv, cachedValue, VERIFY_BYTE_PROG, callback);
+  else
+    ackManagerSetup(cv, 0,READ_CV_PROG, callback);
 }
 
 void DCC::getLocoId(ACK_CALLBACK callback) {
+  CVCache::startOp(CVC_LOCOID, 0, 0);
   ackManagerSetup(0,0, LOCO_ID_PROG, callback);
 }
 
@@ -540,6 +557,7 @@ void DCC::setLocoId(int id,ACK_CALLBACK callback) {
     callback(-1);
     return;
   }
+  CVCache::startOp(CVC_SETLOCOID, 0, id);
   if (id<=127)
       ackManagerSetup(id, SHORT_LOCO_ID_PROG, callback);
   else
@@ -549,15 +567,26 @@ void DCC::setLocoId(int id,ACK_CALLBACK callback) {
 void DCC::forgetLoco(int cab) {  // removes any speed reminders for this loco
   setThrottle2(cab,1); // ESTOP this loco if still on track  
   int reg=lookupSpeedTable(cab);
-  if (reg>=0) speedTable[reg].loco=0;
+  if (reg>=0) {
+    speedTable[reg].loco=0;
+    rebuildLocoIndex();
+  }
   setThrottle2(cab,1); // ESTOP if this loco still on track
 }
 void DCC::forgetAllLocos() {  // removes all speed reminders
   setThrottle2(0,1); // ESTOP all locos still on track      
-  for (int i=0;i<MAX_LOCOS;i++) speedTable[i].loco=0;
+  for (int i=0;i<MAX_LOCOS;i++) {
+    speedTable[i].loco=0;
+    speedTable[i].heat=0;
+  }
+  rebuildLocoIndex();
+  hotCount=0;
+  reminderReg=-1;
 }
 
-byte DCC::loopStatus=0;  
+byte DCC::reminderMask=0;  
+int DCC::reminderReg=-1;
+bool DCC::lastVisitHot=false;
 
 void DCC::loop()  {
   DCCWaveform::loop(ackManagerProg!=NULL); // power overload checks
@@ -565,64 +594,139 @@ void DCC::loop()  {
   issueReminders();
 }
 
+// Reminders are scheduled per loco rather than strictly round robin:
+// a loco whose speed or functions just changed is queued as "hot" and gets
+// HOT_REMINDERS visits interleaved with the rest of the roster, so it does not
+// wait behind the whole table. Idle locos are reminded from a background scan
+// that doubles their skip count every visit up to 2^MAX_IDLE_LEVEL rounds.
+// Skips are only consumed while the scan passes by, so with few locos on the
+// track everyone is still reminded as fast as the waveform allows.
 void DCC::issueReminders() {
   // if the main track transmitter still has a pending packet, skip this time around.
   if ( DCCWaveform::mainTrack.packetPending) return;
 
+  if (reminderReg<0) {
+    reminderReg=nextReminderReg();
+    if (reminderReg<0) return;
+  }
+  // issueReminder will return true if this loco is completed (ie speed and functions)
+  if (issueReminder(reminderReg)) reminderReg=-1;
+}
+
+int DCC::nextReminderReg() {
+  // alternate hot and background visits so a burst of throttle changes cannot starve the roster
+  int reg=-1;
+  if (!lastVisitHot) reg=popHotLoco();
+  if (reg<0) {
+    reg=nextIdleLoco();
+    if (reg<0) reg=popHotLoco();
+    else {
+      lastVisitHot=false;
+      // background refresh: speed and the short function groups, F13 and up only when changed
+      LOCO & l=speedTable[reg];
+      reminderMask=REMIND_SPEED | (l.groupFlags & (FN_GROUP_1 | FN_GROUP_2 | FN_GROUP_3)) | l.pendingFlags;
+      l.pendingFlags=0;
+      return reg;
+    }
+  }
+  if (reg>=0) {
+    lastVisitHot=true;
+    // hot visit: speed plus only the groups that changed
+    reminderMask=REMIND_SPEED | speedTable[reg].pendingFlags;
+    speedTable[reg].pendingFlags=0;
+  }
+  return reg;
+}
+
+int DCC::popHotLoco() {
+  while (hotCount>0) {
+    byte reg=hotQueue[hotHead];
+    if (++hotHead>=MAX_LOCOS) hotHead=0;
+    hotCount--;
+    LOCO & l=speedTable[reg];
+    if (l.loco<=0) { // forgotten since it was queued
+      l.heat=0;
+      continue;
+    }
+    if (--l.heat>0) {
+      byte tail=hotHead+hotCount;
+      if (tail>=MAX_LOCOS) tail-=MAX_LOCOS;
+      hotQueue[tail]=reg;
+      hotCount++;
+    }
+    return reg;
+  }
+  return -1;
+}
+
+int DCC::nextIdleLoco() {
   // This loop searches for a loco in the speed table starting at nextLoco and cycling back around
-  for (int reg=0;reg<MAX_LOCOS;reg++) {
-       int slot=reg+nextLoco;
-       if (slot>=MAX_LOCOS) slot-=MAX_LOCOS; 
-       if (speedTable[slot].loco > 0) {
-          // have found the next loco to remind 
-          // issueReminder will return true if this loco is completed (ie speed and functions)
-          if (issueReminder(slot)) nextLoco=slot+1; 
-          return;
-        }
+  for (int i=0;i<MAX_LOCOS;i++) {
+    int reg=i+nextLoco;
+    if (reg>=MAX_LOCOS) reg-=MAX_LOCOS;
+    LOCO & l=speedTable[reg];
+    if (l.loco<=0 || l.heat>0) continue; // hot locos are served from the hot queue
+    if (l.idle & 0x0F) {
+      l.idle--;
+      continue;
+    }
+    nextLoco=reg+1;
+    byte level=l.idle>>4;
+    if (level<MAX_IDLE_LEVEL) level++;
+    l.idle=(level<<4) | ((1<<level)-1);
+    return reg;
+  }
+  return -1;
+}
+
+void DCC::markChanged(int reg, byte groupMask) {
+  LOCO & l=speedTable[reg];
+  l.pendingFlags|=groupMask;
+  l.idle=0;
+  if (l.heat==0) {
+    byte tail=hotHead+hotCount;
+    if (tail>=MAX_LOCOS) tail-=MAX_LOCOS;
+    hotQueue[tail]=reg;
+    hotCount++;
   }
+  l.heat=HOT_REMINDERS;
 }
  
 bool DCC::issueReminder(int reg) {
   unsigned long functions=speedTable[reg].functions;
   int loco=speedTable[reg].loco;
-  byte flags=speedTable[reg].groupFlags;
-  
-  switch (loopStatus) {
-        case 0:
+  if (loco<=0) return true;  // forgotten while being reminded
+
+  // send one packet per call, lowest outstanding part of the reminder first
+  if (reminderMask & REMIND_SPEED) {
       //   DIAG(F("Reminder %d speed %d"),loco,speedTable[reg].speedCode);
-         setThrottle2(loco, speedTable[reg].speedCode);
-         break;
-       case 1: // remind function group 1 (F0-F4)
-          if (flags & FN_GROUP_1) 
-              setFunctionInternal(loco,0, 128 | ((functions>>1)& 0x0F) | ((functions & 0x01)<<4)); // 100D DDDD
-          break;     
-       case 2: // remind function group 2 F5-F8
-          if (flags & FN_GROUP_2) 
-              setFunctionInternal(loco,0, 176 | ((functions>>5)& 0x0F));                           // 1011 DDDD
-          break;     
-       case 3: // remind function group 3 F9-F12
-          if (flags & FN_GROUP_3) 
-              setFunctionInternal(loco,0, 160 | ((functions>>9)& 0x0F));                           // 1010 DDDD
-          break;   
-       case 4: // remind function group 4 F13-F20
-          if (flags & FN_GROUP_4) 
-              setFunctionInternal(loco,222, ((functions>>13)& 0xFF)); 
-          flags&= ~FN_GROUP_4;  // dont send them again
-          break;  
-       case 5: // remind function group 5 F21-F28
-          if (flags & FN_GROUP_5)
-              setFunctionInternal(loco,223, ((functions>>21)& 0xFF)); 
-          flags&= ~FN_GROUP_5;  // dont send them again
-          break; 
-      }
-      loopStatus++;
-      // if we reach status 6 then this loco is done so
-      // reset status to 0 for next loco and return true so caller 
-      // moves on to next loco. 
-      if (loopStatus>5) loopStatus=0;
-      return loopStatus==0;
-    }
- 
+      setThrottle2(loco, speedTable[reg].speedCode);
+      reminderMask&= ~REMIND_SPEED;
+  }
+  else if (reminderMask & FN_GROUP_1) { // remind function group 1 (F0-F4)
+      setFunctionInternal(loco,0, 128 | ((functions>>1)& 0x0F) | ((functions & 0x01)<<4)); // 100D DDDD
+      reminderMask&= ~FN_GROUP_1;
+  }
+  else if (reminderMask & FN_GROUP_2) { // remind function group 2 F5-F8
+      setFunctionInternal(loco,0, 176 | ((functions>>5)& 0x0F));                           // 1011 DDDD
+      reminderMask&= ~FN_GROUP_2;
+  }
+  else if (reminderMask & FN_GROUP_3) { // remind function group 3 F9-F12
+      setFunctionInternal(loco,0, 160 | ((functions>>9)& 0x0F));                           // 1010 DDDD
+      reminderMask&= ~FN_GROUP_3;
+  }
+  else if (reminderMask & FN_GROUP_4) { // remind function group 4 F13-F20
+      setFunctionInternal(loco,222, ((functions>>13)& 0xFF)); 
+      reminderMask&= ~FN_GROUP_4;
+  }
+  else if (reminderMask & FN_GROUP_5) { // remind function group 5 F21-F28
+      setFunctionInternal(loco,223, ((functions>>21)& 0xFF)); 
+      reminderMask&= ~FN_GROUP_5;
+  }
+  else reminderMask=0;
+  // once the mask is empty this loco is done so return true so caller moves on to next loco.
+  return reminderMask==0;
+}
  
 
 
@@ -637,25 +741,44 @@ byte DCC::cv2(int cv)  {
   return lowByte(cv);
 }
 
+// Open addressing hash of cab number to speed table register, so lookups
+// do not scan the whole table. Returns the slot holding locoId or the empty
+// slot where it would go.
+byte DCC::locoIndexPos(int locoId) {
+  byte pos=(locoId ^ (locoId>>7)) & (LOCO_INDEX_SIZE-1);
+  while (locoIndex[pos]!=0 && speedTable[locoIndex[pos]-1].loco!=locoId)
+    pos=(pos+1) & (LOCO_INDEX_SIZE-1);
+  return pos;
+}
+
+void DCC::rebuildLocoIndex() {
+  memset(locoIndex,0,sizeof(locoIndex));
+  for (byte reg=0; reg<MAX_LOCOS; reg++)
+    if (speedTable[reg].loco>0) locoIndex[locoIndexPos(speedTable[reg].loco)]=reg+1;
+}
+
 int DCC::lookupSpeedTable(int locoId) {
   // determine speed reg for this loco
-  int firstEmpty = MAX_LOCOS;
+  if (locoId<=0) return -1;
+  byte pos=locoIndexPos(locoId);
+  if (locoIndex[pos]!=0) return locoIndex[pos]-1;
+
+  // new loco, take the first free register
   int reg;
-  for (reg = 0; reg < MAX_LOCOS; reg++) {
-    if (speedTable[reg].loco == locoId) break;
-    if (speedTable[reg].loco == 0 && firstEmpty == MAX_LOCOS) firstEmpty = reg;
-  }
-  if (reg == MAX_LOCOS) reg = firstEmpty;
+  for (reg = 0; reg < MAX_LOCOS; reg++)
+    if (speedTable[reg].loco == 0) break;
   if (reg >= MAX_LOCOS) {
     DIAG(F("Too many locos"));
     return -1;
   }
-  if (reg==firstEmpty){
-        speedTable[reg].loco = locoId;
-        speedTable[reg].speedCode=128;  // default direction forward
-        speedTable[reg].groupFlags=0;
-        speedTable[reg].functions=0;
-  }
+  speedTable[reg].loco = locoId;
+  speedTable[reg].speedCode=128;  // default direction forward
+  speedTable[reg].groupFlags=0;
+  speedTable[reg].functions=0;
+  speedTable[reg].pendingFlags=0;
+  speedTable[reg].idle=0;
+  // heat is left alone: a register still in the hot queue keeps its single entry
+  locoIndex[pos]=reg+1;
   return reg;
 }
   
@@ -665,16 +788,24 @@ void  DCC::updateLocoReminder(int loco, byte speedCode) {
      // broadcast stop/estop but dont change direction
      for (int reg = 0; reg < MAX_LOCOS; reg++) {
        speedTable[reg].speedCode = (speedTable[reg].speedCode & 0x80) |  (speedCode & 0x7f);
+       if (speedTable[reg].loco > 0) markChanged(reg, 0);
      }
      return; 
   }
   
   // determine speed reg for this loco
   int reg=lookupSpeedTable(loco);       
-  if (reg>=0) speedTable[reg].speedCode = speedCode;
+  if (reg>=0 && speedTable[reg].speedCode != speedCode) {
+    speedTable[reg].speedCode = speedCode;
+    markChanged(reg, 0);
+  }
 }
 
 DCC::LOCO DCC::speedTable[MAX_LOCOS];
+byte DCC::hotQueue[MAX_LOCOS];
+byte DCC::hotHead=0;
+byte DCC::hotCount=0;
+byte DCC::locoIndex[LOCO_INDEX_SIZE];
 int DCC::nextLoco = 0;
 
 //ACK MANAGER
@@ -693,6 +824,7 @@ ACK_CALLBACK DCC::ackManagerCallback;
 
 void  DCC::ackManagerSetup(int cv, byte byteValueOrBitnum, ackOp const program[], ACK_CALLBACK callback) {
   if (!DCCWaveform::progTrack.canMeasureCurrent()) {
+    CVCache::opDone(-2);
     callback(-2);
     return;
   }
@@ -945,6 +1077,7 @@ void DCC::callback(int value) {
     
           ackManagerProg=NULL;  // no more steps to execute
           if (Diag::ACK) DIAG(F("Callback(%d)"),value);
+          CVCache::opDone(value);
           (ackManagerCallback)( value);
     }
 }
@@ -955,8 +1088,9 @@ void DCC::displayCabList(Print * stream) {
     for (int reg = 0; reg < MAX_LOCOS; reg++) {
        if (speedTable[reg].loco>0) {
         used ++;
-        StringFormatter::send(stream,F("cab=%d, speed=%d, dir=%c \n"),       
-           speedTable[reg].loco,  speedTable[reg].speedCode & 0x7f,(speedTable[reg].speedCode & 0x80) ? 'F':'R');
+        StringFormatter::send(stream,F("cab=%d, speed=%d, dir=%c, refresh=%c1/%d \n"),       
+           speedTable[reg].loco,  speedTable[reg].speedCode & 0x7f,(speedTable[reg].speedCode & 0x80) ? 'F':'R',
+           speedTable[reg].heat ? '*' : ' ', 1 << (speedTable[reg].idle >> 4));
        }
      }
      StringFormatter::send(stream,F("Used=%d, max=%d\n"),used,MAX_LOCOS);
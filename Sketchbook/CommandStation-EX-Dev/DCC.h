@@ -66,8 +66,10 @@ enum   CALLBACK_STATE : byte {
 // Base system takes approx 900 bytes + 8 per loco. Turnouts, Sensors etc are dynamically created
 #ifdef ARDUINO_AVR_UNO
 const byte MAX_LOCOS = 20;
+const byte LOCO_INDEX_SIZE = 32;  // power of 2, comfortably above MAX_LOCOS for short probe chains
 #else
 const byte MAX_LOCOS = 50;
+const byte LOCO_INDEX_SIZE = 128;
 #endif
 
 class DCC
@@ -121,18 +123,36 @@ private:
     byte speedCode;
     byte groupFlags;
     unsigned long functions;
+    byte pendingFlags; // function groups changed since they were last sent
+    byte heat;         // remaining fast reminders after a change, 0 if idle
+    byte idle;         // idle level (high nibble) and remaining skips (low nibble)
   };
   static byte joinRelay;
-  static byte loopStatus;
+  static byte reminderMask;
+  static int reminderReg;
+  static bool lastVisitHot;
   static void setThrottle2(uint16_t cab, uint8_t speedCode);
   static void updateLocoReminder(int loco, byte speedCode);
   static void setFunctionInternal(int cab, byte fByte, byte eByte);
   static bool issueReminder(int reg);
+  static int nextReminderReg();
+  static int popHotLoco();
+  static int nextIdleLoco();
+  static void markChanged(int reg, byte groupMask);
+  static byte functionGroup(int16_t functionNumber);
   static int nextLoco;
   static FSH *shieldName;
   static byte globalSpeedsteps;
 
   static LOCO speedTable[MAX_LOCOS];
+  static byte hotQueue[MAX_LOCOS];
+  static byte hotHead;
+  static byte hotCount;
+  static byte locoIndex[LOCO_INDEX_SIZE];  // cab -> register+1, 0 if empty
+  static byte locoIndexPos(int locoId);
+  static void rebuildLocoIndex();
+  static const byte HOT_REMINDERS = 4;    // fast reminders a loco gets after a change
+  static const byte MAX_IDLE_LEVEL = 3;   // idle locos are reminded every 2^level rounds at most
   static byte cv1(byte opcode, int cv);
   static byte cv2(int cv);
   static int lookupSpeedTable(int locoId);
@@ -27,6 +27,8 @@
 #include "version.h"
 
 #include "EEStore.h"
+#include "CVCache.h"
+#include "BinLink.h"
 #include "DIAG.h"
 #include <avr/wdt.h>
 
@@ -54,6 +56,9 @@ const int16_t HASH_KEYWORD_LCN = 15137;
 const int16_t HASH_KEYWORD_RESET = 26133;
 const int16_t HASH_KEYWORD_SPEED28 = -17064;
 const int16_t HASH_KEYWORD_SPEED128 = 25816;
+const int16_t HASH_KEYWORD_CVCACHE = -15367;
+const int16_t HASH_KEYWORD_BINLINK = -5531;
+const int16_t HASH_KEYWORD_CLEAR = -5959;
 
 int16_t DCCEXParser::stashP[MAX_COMMAND_PARAMS];
 bool DCCEXParser::stashBusy;
@@ -91,6 +96,8 @@ void DCCEXParser::loop(Stream &stream)
             flush();
         }
         char ch = stream.read();
+        if (BinLink::receive(this, &stream, ch))
+            continue; // binary frame from the ESP32
         if (ch == '<')
         {
             inCommandPayload = true;
@@ -115,6 +122,7 @@ void DCCEXParser::loop(Stream &stream)
     }
     if (boardMgr)
       boardMgr->checkAllSensors(&stream); // Update and print changes
+    BinLink::flush(); // acks and sensor changes of this loop in one frame
 }
 
 int16_t DCCEXParser::splitValues(int16_t result[MAX_COMMAND_PARAMS], const byte *cmd)
@@ -864,6 +872,23 @@ bool DCCEXParser::parseD(Print *stream, int16_t params, int16_t p[])
 	    EEStore::dump(p[1]);
 	return true;
 
+    case HASH_KEYWORD_CVCACHE: // <D CVCACHE> <D CVCACHE CLEAR>
+        if (params >= 2 && p[1] == HASH_KEYWORD_CLEAR)
+            CVCache::clear();
+        CVCache::printStats(stream);
+        return true;
+
+    case HASH_KEYWORD_BINLINK: // <D BINLINK> <D BINLINK ON/OFF>
+        if (params >= 2) {
+            if (onOff)
+                BinLink::start(stream);
+            else
+                BinLink::stop();
+        }
+        else
+            BinLink::printStats(stream);
+        return true;
+
     case HASH_KEYWORD_SPEED28:
         DCC::setGlobalSpeedsteps(28);
 	StringFormatter::send(stream, F("28 Speedsteps"));
@@ -908,7 +933,8 @@ void DCCEXParser::commitAsyncReplyStream() {
 
 void DCCEXParser::callback_W(int16_t result)
 {
-    StringFormatter::send(getAsyncReplyStream(),
+    if (!BinLink::addProgReply(stashP[0], result == 1 ? stashP[1] : -1))
+        StringFormatter::send(getAsyncReplyStream(),
           F("<r%d|%d|%d %d>\n"), stashP[2], stashP[3], stashP[0], result == 1 ? stashP[1] : -1);
     commitAsyncReplyStream();
 //    if (thisBoard)
@@ -917,7 +943,8 @@ void DCCEXParser::callback_W(int16_t result)
 
 void DCCEXParser::callback_B(int16_t result)
 {
-    StringFormatter::send(getAsyncReplyStream(), 
+    if (!BinLink::addProgReply(stashP[0], result == 1 ? stashP[2] : -1))
+        StringFormatter::send(getAsyncReplyStream(), 
           F("<r%d|%d|%d %d %d>\n"), stashP[3], stashP[4], stashP[0], stashP[1], result == 1 ? stashP[2] : -1);
     commitAsyncReplyStream();
 //    if (thisBoard)
@@ -940,7 +967,8 @@ void DCCEXParser::callback_Vbyte(int16_t result)
 
 void DCCEXParser::callback_R(int16_t result)
 {
-    StringFormatter::send(getAsyncReplyStream(), F("<r%d|%d|%d %d>\n"), stashP[1], stashP[2], stashP[0], result);
+    if (!BinLink::addProgReply(stashP[0], result))
+        StringFormatter::send(getAsyncReplyStream(), F("<r%d|%d|%d %d>\n"), stashP[1], stashP[2], stashP[0], result);
     commitAsyncReplyStream();
 //    if (thisBoard)
 //      thisBoard->setProgTrack(false);
@@ -19,6 +19,7 @@
 #include <Arduino.h>
 #include "MotorDriver.h"
 #include "DCCTimer.h"
+#include "ADCSampler.h"
 #include "DIAG.h"
 
 #define setHIGH(fastpin)  *fastpin.inout |= fastpin.maskHIGH
@@ -61,6 +62,9 @@ MotorDriver::MotorDriver(byte power_pin, byte signal_pin, byte signal_pin2, int8
   if (currentPin!=UNUSED_PIN) {
     pinMode(currentPin, INPUT);
     senseOffset=analogRead(currentPin); // value of sensor at zero current
+#if defined(ARDUINO_ARCH_AVR)
+    currentSlot=ADCSampler::addChannel(currentPin, true);
+#endif
   }
 
   faultPin=fault_pin;
@@ -155,6 +159,11 @@ int MotorDriver::getCurrentRaw() {
   current = analogRead(currentPin)-senseOffset;
   overflow_count = 0;
   SREG = sreg_backup;    /* restore interrupt state */
+#elif defined(ARDUINO_ARCH_AVR)
+  if (currentSlot != ADC_NO_CHANNEL)
+    current = ADCSampler::getValue(currentSlot)-senseOffset; // latest sample from the ADC interrupt, no waiting
+  else
+    current = analogRead(currentPin)-senseOffset;
 #else
   current = analogRead(currentPin)-senseOffset;
 #endif
@@ -165,6 +174,7 @@ int MotorDriver::getCurrentRaw() {
   // IMPORTANT:  This function can be called in Interrupt() time within the 56uS timer
   //             The default analogRead takes ~100uS which is catastrphic
   //             so DCCTimer has set the sample time to be much faster.  
+  //             On AVR, ADCSampler provides the value without any conversion wait.
 }
 
 unsigned int MotorDriver::raw2mA( int raw) {
@@ -66,6 +66,7 @@ class MotorDriver {
 	getFastPin(type, pin, 0, result);
     }
     byte powerPin, signalPin, signalPin2, currentPin, faultPin, brakePin;
+    byte currentSlot = 0xFF; // ADCSampler slot of currentPin, ADC_NO_CHANNEL if not sampled
     FASTPIN fastPowerPin,fastSignalPin, fastSignalPin2, fastBrakePin,fastFaultPin;
     bool dualSignal;       // true to use signalPin2
     bool invertBrake;       // brake pin passed as negative means pin is inverted
@@ -15,13 +15,16 @@ void BoardManager::intializeBoard()
   initPins();
   DCC::begin(MOTOR_SHIELD_TYPE); 
   setBoardModeOff();
+  supplySlot = ADCSampler::addChannel(pinRawPwrSupply, false);
+  ADCSampler::begin(); //all channels are added, from now on no more analogRead
 }
 
 void BoardManager::processLoop()
 {
   if (millis() - lastPwrCheck > pwrCheckInterval)
   {
-    verifyPowerSignal(1);
+    lastPwrCheck = millis();
+    verifyPowerSignal(1); //min and max of all samples since the last check
     setLEDDispStatus();
   }
 }
@@ -172,13 +175,18 @@ bool BoardManager::verifyPowerSignal(uint16_t numChecks)
 {
   uint16_t minVal = 0xFFFF;
   uint16_t maxVal = 0x0000;
-  for (uint16_t i = 0; i < numChecks; i++)
+  uint32_t numVals = 0;
+  while ((numVals < numChecks) && (supplySlot != ADC_NO_CHANNEL)) //the ADC interrupt tracks min and max, this only waits until the window has numChecks samples
   {
-    uint16_t currSample = analogRead(pinRawPwrSupply); //10bit ADC
-    if (currSample < minVal)
-      minVal = currSample;
-    if (currSample > maxVal)
-      maxVal = currSample;
+    uint16_t newMin, newMax, newNum;
+    ADCSampler::getMinMax(supplySlot, newMin, newMax, newNum); //10bit ADC
+    if (newNum == 0)
+      continue;
+    if (newMin < minVal)
+      minVal = newMin;
+    if (newMax > maxVal)
+      maxVal = newMax;
+    numVals += newNum;
   }
   powerStatus = (maxVal + minVal) >> 1; //average value
   if ((maxVal - minVal) > diffVoltage)
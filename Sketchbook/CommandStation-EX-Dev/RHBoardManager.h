@@ -7,6 +7,7 @@
 #include "DIAG.h"
 #include "LEDChain.h"
 #include "Sensors.h"
+#include "ADCSampler.h"
 
 #define pinCurrentSensorRailSync A0
 #define pinCurrentSensorIBT2 A1
@@ -63,6 +64,7 @@ class BoardManager
     uint16_t minVal = 0xFFFF; //used for power analysis
     uint16_t maxVal = 0x0000;
     uint32_t lastPwrCheck = millis();
+    byte supplySlot = ADC_NO_CHANNEL; // ADCSampler slot of pinRawPwrSupply
     LEDChain * RHCtrlLEDs = NULL;
     Sensor * RHSensorBlock = NULL;
 
@@ -68,11 +68,16 @@ decide to ignore the <q ID> return and only react to <Q ID> triggers.
 #include "StringFormatter.h"
 #include "Sensors.h"
 #include "EEStore.h"
+#include "ADCSampler.h"
+#include "BinLink.h"
 
 
 void Sensor::begin()
 {
-  
+  bankSlot[0] = ADCSampler::addChannel(PortBank1, false);
+  bankSlot[1] = ADCSampler::addChannel(PortBank2, false);
+  bankSampleCtr[0] = 0;
+  bankSampleCtr[1] = 0;
 }
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -107,6 +112,10 @@ void Sensor::checkAll(Print *stream)
 //  }
   if (!isActive)
     return;
+  if (ADCSampler::isRunning())
+    for (uint8_t i = 0; i < 2; i++)
+      if ((uint8_t)(ADCSampler::getSampleCount(bankSlot[i]) - bankSampleCtr[i]) < 2) //the first conversion after the mux step may have started before
+        return; //no fresh sample of this mux position yet, check again next loop
   uint16_t portMask = PORTB & 0x0F;
   ctr++;
   if ((portMask == 0))// && (ctr >= 1000))
@@ -120,7 +129,8 @@ void Sensor::checkAll(Print *stream)
       if ((compSent & verifyMask) > 0)
       {
         if (stream != NULL) 
-          StringFormatter::send(stream, F("<%c %d>\n"), (verifyStatus & verifyMask) > 0 ? 'Q' : 'q', i);
+          if (!BinLink::addSensor(i, (verifyStatus & verifyMask) > 0))
+            StringFormatter::send(stream, F("<%c %d>\n"), (verifyStatus & verifyMask) > 0 ? 'Q' : 'q', i);
       }
       verifyMask = verifyMask << 1;
     }
@@ -129,7 +139,7 @@ void Sensor::checkAll(Print *stream)
   }
   uint16_t bitMask = 0x0001 << portMask;
   uint16_t* inpArray = (uint16_t*)&inpStatusABCD;
-  if (analogRead(PortBank1) > 200) //Banks A,B
+  if (ADCSampler::getValue(bankSlot[0]) > 200) //Banks A,B
   {
     inpArray[0] |= bitMask;
   }
@@ -138,12 +148,14 @@ void Sensor::checkAll(Print *stream)
     inpArray[0] &= ~bitMask;
   }
 
-  if (analogRead(PortBank2) > 200) //Banks C,D
+  if (ADCSampler::getValue(bankSlot[1]) > 200) //Banks C,D
     inpArray[1] |= bitMask;
   else
     inpArray[1] &= ~bitMask;
   portMask = (portMask + 1) & 0x0F;
   PORTB = (PORTB & 0xF0) | portMask;
+  bankSampleCtr[0] = ADCSampler::getSampleCount(bankSlot[0]);
+  bankSampleCtr[1] = ADCSampler::getSampleCount(bankSlot[1]);
 //  latchdelay = 0;
 } // Sensor::checkAll
 
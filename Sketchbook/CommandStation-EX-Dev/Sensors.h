@@ -43,6 +43,8 @@ class  Sensor
     uint8_t currentSensor = 0;
     byte latchdelay;
     bool isActive = false;
+    byte bankSlot[2]; // ADCSampler slots of PortBank1, PortBank2
+    byte bankSampleCtr[2]; // sample count at the last mux step
 }; // Sensor
 
 
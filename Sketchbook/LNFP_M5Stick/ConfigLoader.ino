@@ -125,25 +125,182 @@ bool writeJSONFile(String fileName, const char * fileStr)
     return false;
 }
 
-DynamicJsonDocument * getDocPtr(String cmdFile, bool duplData)
+//copies the string value of the top level key keyName in srcFileName to fileName and resolves the escape sequences
+//the value is read and written in small chunks, so a config file upload never needs a buffer of the size of the file
+bool writeJSONStringToFile(String srcFileName, const char * keyName, String fileName)
 {
-  uint32_t jsonData = readFileToBuffer(cmdFile, wsTxBuffer, wsBufferSize);
-//  Serial.println(wsTxBuffer);
-  if (jsonData > 0)
+  uint32_t startTime = millis();
+  File srcFile = SPIFFS.open(srcFileName, "r");
+  if (!srcFile)
+    return false;
+  File dataFile = SPIFFS.open(fileName, "w");
+  if (!dataFile)
+  {
+    srcFile.close();
+    return false;
+  }
+  uint8_t outBuffer[256];
+  uint16_t outPtr = 0;
+  uint32_t bytesWritten = 0;
+  uint16_t keyLen = strlen(keyName);
+  uint8_t scanState = 0; //0: search key, 1: key found, wait for ':', 2: wait for value, 3: copy value, 4: done
+  int16_t nestLevel = 0;
+  bool inString = false;
+  bool escChar = false;
+  bool keyMatch = false;
+  uint16_t strPos = 0;
+  while (srcFile.available() && (scanState < 4))
   {
-    uint16_t docSize = 4096 * (trunc((3 * jsonData) / 4096) + 1);  //.length();
-//    Serial.printf("Size: %i Doc Size: %i\n", jsonData, docSize);
-    DynamicJsonDocument * thisDoc = new DynamicJsonDocument(docSize);
-    DeserializationError error;
-    if (duplData)
-      error = deserializeJson(*thisDoc, (const char*) wsTxBuffer); //use const to force deserialize to keep copy of buffer data
+    int thisChar = srcFile.read();
+    if (scanState < 3)
+    {
+      if (inString)
+      {
+        if (escChar)
+        {
+          escChar = false;
+          keyMatch = false; //key names with escape sequences are not supported
+        }
+        else
+          if (thisChar == '\\')
+            escChar = true;
+          else
+            if (thisChar == '"')
+            {
+              inString = false;
+              if (keyMatch && (strPos == keyLen) && (nestLevel == 1))
+                scanState = 1;
+            }
+            else
+            {
+              keyMatch = keyMatch && (strPos < keyLen) && (thisChar == keyName[strPos]);
+              strPos++;
+            }
+        continue;
+      }
+      if (isspace(thisChar))
+        continue;
+      if ((scanState == 1) && (thisChar == ':'))
+      {
+        scanState = 2;
+        continue;
+      }
+      if ((scanState == 2) && (thisChar == '"'))
+      {
+        scanState = 3;
+        continue;
+      }
+      scanState = 0; //"Data" was a value or the value is not a string, continue searching
+      switch (thisChar)
+      {
+        case '"': inString = true; keyMatch = true; strPos = 0; break;
+        case '{':
+        case '[': nestLevel++; break;
+        case '}':
+        case ']': nestLevel--; break;
+      }
+      continue;
+    }
+    //scanState 3, copy value
+    if (escChar)
+    {
+      escChar = false;
+      switch (thisChar)
+      {
+        case 'n': thisChar = '\n'; break;
+        case 'r': thisChar = '\r'; break;
+        case 't': thisChar = '\t'; break;
+        case 'b': thisChar = '\b'; break;
+        case 'f': thisChar = '\f'; break;
+        case 'u':
+          {
+            char hexStr[5] = {0,0,0,0,0};
+            srcFile.read((uint8_t*)hexStr, 4);
+            uint16_t codePoint = strtol(hexStr, NULL, 16);
+            if (codePoint >= 0x80) //write as UTF-8, leave the last byte to the code below
+            {
+              if (outPtr > (sizeof(outBuffer) - 3))
+              {
+                bytesWritten += dataFile.write(outBuffer, outPtr);
+                outPtr = 0;
+              }
+              if (codePoint >= 0x800)
+              {
+                outBuffer[outPtr++] = 0xE0 | (codePoint >> 12);
+                outBuffer[outPtr++] = 0x80 | ((codePoint >> 6) & 0x3F);
+              }
+              else
+                outBuffer[outPtr++] = 0xC0 | (codePoint >> 6);
+              thisChar = 0x80 | (codePoint & 0x3F);
+            }
+            else
+              thisChar = codePoint;
+          }
+          break;
+        default: break; //", \, /
+      }
+    }
     else
-      error = deserializeJson(*thisDoc, wsTxBuffer); //use const to force deserialize to keep copy of buffer data
+      if (thisChar == '\\')
+      {
+        escChar = true;
+        continue;
+      }
+      else
+        if (thisChar == '"')
+        {
+          scanState = 4;
+          continue;
+        }
+    outBuffer[outPtr++] = thisChar;
+    if (outPtr == sizeof(outBuffer))
+    {
+      bytesWritten += dataFile.write(outBuffer, outPtr);
+      outPtr = 0;
+    }
+  }
+  bytesWritten += dataFile.write(outBuffer, outPtr);
+  dataFile.println(); //same as writeJSONFile
+  dataFile.close();
+  srcFile.close();
+  if (scanState == 4)
+    Serial.printf("Writing Config File from message complete %i bytes in %i ms\n", bytesWritten, millis() - startTime);
+  else
+    Serial.printf("Config data %s not found in message\n", keyName);
+  return scanState == 4;
+}
+
+DynamicJsonDocument * getDocPtr(String cmdFile, bool duplData) //duplData is no longer needed, the document always keeps its own copy of the data
+{
+  int fileSize = getFileSize(cmdFile);
+  if (fileSize > 0)
+  {
+    File dataFile = SPIFFS.open(cmdFile, "r");
+    uint32_t docSize = 4096 * (trunc((3 * fileSize) / 4096) + 1); //released by shrinkToFit after parsing
+    DynamicJsonDocument * thisDoc = NULL;
+    DeserializationError error = DeserializationError::NoMemory;
+    for (uint8_t i = 0; (i < 3) && (error == DeserializationError::NoMemory); i++) //try a bigger document if the estimate was too low
+    {
+      if (thisDoc)
+      {
+        delete(thisDoc);
+        docSize *= 2;
+        dataFile.seek(0);
+      }
+      thisDoc = new DynamicJsonDocument(docSize);
+      error = deserializeJson(*thisDoc, dataFile); //parse from the file, no buffer of the file size needed
+    }
+    dataFile.close();
+//    Serial.printf("Size: %i Doc Size: %i\n", fileSize, docSize);
     if (!error)
+    {
+      thisDoc->shrinkToFit();
       return thisDoc;
+    }
     else
     {
-      Serial.println("Deserialization error");
+      Serial.printf("Deserialization error %s in %s\n", error.c_str(), &cmdFile[0]);
+      delete(thisDoc);
       return NULL;
     }
   }
@@ -156,6 +313,7 @@ DynamicJsonDocument * getDocPtr(String cmdFile, bool duplData)
 
 void prepareShutDown()
 {
+  flushLNRecorder();
   digitraxBuffer->saveToFile(bufferFileName);
   delay(1000);
   if (mySwitchList)
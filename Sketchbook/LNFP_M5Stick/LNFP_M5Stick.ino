@@ -1,6 +1,7 @@
 String BBVersion = "1.5.12";
 
 //#define measurePerformance //uncomment this to display the number of loop cycles per second
+//#define useDualCore //uncomment this to run LocoNet, LocoNet over TCP and MQTT Gateway communication in a separate task on core 0
 #define useM5Lite
 //#define useAI
 //Arduino published libraries. Install using the Arduino IDE or download from Github and install manually
@@ -31,6 +32,8 @@ String BBVersion = "1.5.12";
 
 //following libraries can be downloaded from https://github.com/tanner87661?tab=repositories
 #include <IoTT_DigitraxBuffers.h> //as introduced in video # 30
+#include <IoTT_StateSync.h> //DigitraxBuffers state as retained MQTT messages
+#include <IoTT_AccessoryOut.h> //rate limited switch and signal commands
 #include <IoTT_LocoNetHBESP32.h> //this is a hybrid library introduced in video #29
 #include <IoTT_MQTTESP32.h> //as introduced in video # 29
 #include <IoTT_Gateway.h> //LocoNet Gateway as introduced in video # 29
@@ -45,6 +48,9 @@ String BBVersion = "1.5.12";
 //#include <OneDimKalman.h>
 #include <IoTT_lbServer.h>
 #include <IoTT_TrainSensor.h>
+#ifdef useDualCore
+  #include <IoTT_CommQueue.h>
+#endif
 #ifdef useAI
   #include <IoTT_VoiceControl.h>
 #endif
@@ -56,13 +62,9 @@ DNSServer * dnsServer = NULL;
 WiFiClient * wifiClient = NULL;
 AsyncWebSocket * ws = NULL; //("/ws");
 AsyncWebSocketClient * globalClient = NULL;
-uint32_t wsBufferSize = 16384;
+uint32_t wsRxBufferSize = 2048; //commands from the browser. Larger messages like config file uploads are staged in a file, see WebServer tab
 uint32_t wsRxReadPtr = 0;
-uint32_t wsRxWritePtr = 0;
-char * wsRxBuffer; //[32768]; //should this by dynamic?
-uint32_t wsTxReadPtr = 0;
-uint32_t wsTxWritePtr = 0;
-char * wsTxBuffer; //[32768]; //should this by dynamic?
+char * wsRxBuffer;
 bool execLoop = true; //used to stop loop execution if update files are coming in. Must result in restart
 
 //global variables
@@ -97,6 +99,7 @@ LocoNetESPSerial * lnSerial = NULL;
 nodeType subnetMode = standardMode;
 IoTT_SerInjector * usbSerial = NULL;
 IoTT_LBServer * lbServer = NULL;
+IoTT_LBServer * wiServer = NULL; //WiThrottle server for Engine Driver and other handheld throttles
 IoTT_DigitraxBuffers * digitraxBuffer = NULL; //pointer to DigitraxBuffers
 //IoTT_OpenLCB *olcbSerial = NULL;
 //HardwareSerial *wireSerial = NULL;
@@ -104,8 +107,16 @@ ln_mqttGateway * commGateway = NULL;
 IoTT_ledChain * myChain = NULL;
 IoTT_SwitchList * mySwitchList = NULL;
 MQTTESP32 * lnMQTT = NULL;
+IoTT_StateSync * stateSync = NULL;
+IoTT_AccessoryOut * accessoryOut = NULL;
 NmraDcc  * myDcc = NULL;
 IoTT_TrainSensor * trainSensor = NULL;
+#ifdef useDualCore
+  TaskHandle_t ioTaskHandle = NULL; //I/O task for bus and network transports, pinned to core 0
+  IoTT_CommQueue<lnReceiveBuffer, 32> rxQueue; //I/O task to loop()
+  IoTT_CommQueue<lnTransmitMsg, 32> txQueue; //loop() and web server to I/O task
+  portMUX_TYPE txQueueMux = portMUX_INITIALIZER_UNLOCKED; //serializes the writers of txQueue
+#endif
 //some variables used for performance measurement
 #ifdef measurePerformance
 uint16_t loopCtr = 0;
@@ -183,9 +194,40 @@ bool pwrDC = false;
 
 File uploadFile; //used for web server to upload files
 
+void * sendMsgTarget() //the transport sendMsg writes to for the selected interface
+{
+  switch (useInterface.devId)
+  {
+    case 1:; //DCC
+    case 10:; //DCC from MQTT
+    case 2:; //LocoNet
+    case 16: return lnSerial; //LocoNet Loopback
+    case 3: return lnMQTT; //LocoNet over MQTT
+    case 4:; //LocoNet w/ MQTT Gateway
+    case 11:; //LocoNet /w lbServer
+    case 13:; //LocoNet w/ Gateway lbServer and MQTT
+    case 14:; //LocoNet Loopback /w lbServer
+    case 15: return commGateway; //LocoNet Loopback /w lbServer and MQTT
+    case 12:; //LN over TCP Client
+    case 17: return lbServer; //WiThrottle
+  }
+  return NULL;
+}
+
 //this is the outgoing communication function for IoTT_DigitraxBuffers.h, routing the outgoing messages to the correct interface
 uint16_t sendMsg(lnTransmitMsg txData)
 {
+  if (isLNReplayActive()) //replayed traffic is for local processing only
+    return 0;
+#ifdef useDualCore
+  if ((xTaskGetCurrentTaskHandle() != ioTaskHandle) && ioTaskOwns(sendMsgTarget())) //transports are not thread safe, hand over to the task processing it
+  {
+    portENTER_CRITICAL(&txQueueMux);
+    bool txOK = txQueue.push(txData);
+    portEXIT_CRITICAL(&txQueueMux);
+    return txOK ? txData.lnMsgSize : -1;
+  }
+#endif
 //  Serial.printf("Call sendMsg to %i: %i, %2X, %2X, %2X, %2X \n", useInterface.devId, txData.lnMsgSize, txData.lnData[0], txData.lnData[1], txData.lnData[2], txData.lnData[3]);
 //  Serial.printf("Outgoing Callback %i\n", useInterface.devId);
   switch (useInterface.devId)
@@ -237,6 +279,53 @@ uint16_t sendMQTTMsg(char * topic, char * payload) //used for native MQTT only
   }
 }
 
+bool ioTaskOwns(void * commObj) //true if the transport is processed in the I/O task instead of loop()
+{
+#ifdef useDualCore
+  if ((ioTaskHandle == NULL) || (commObj == NULL))
+    return false;
+  if ((commObj == lnSerial) || (commObj == commGateway))
+    return true;
+  if (commObj == lbServer)
+    return useInterface.devId != 17; //WiThrottle client updates DigitraxBuffers, so it stays in loop()
+  if (commObj == lnMQTT)
+    return (useInterface.devId == 3) && (stateSync == NULL); //native MQTT is also used by the LED and button libraries, received state updates DigitraxBuffers
+#endif
+  return false;
+}
+
+#ifdef useDualCore
+void ioTask(void * thisParam) //bus and network transports on core 0, the application in loop() runs on core 1
+{
+  lnTransmitMsg txData;
+  while (1)
+  {
+    while (txQueue.pop(txData)) //outgoing messages from the application
+      sendMsg(txData);
+    if (ioTaskOwns(lnSerial) && (execLoop || (subnetMode != standardMode)))
+      lnSerial->processLoop(); //handling all LocoNet communication
+    if (execLoop)
+    {
+      if (ioTaskOwns(lbServer))
+        lbServer->processLoop(); //drives the LocoNet over TCP interface traffic
+      if ((wifiCfgMode == 1) && (!wifiCancelled) && (WiFi.status() == WL_CONNECTED)) //reconnecting is done in loop()
+      {
+        if (ioTaskOwns(commGateway)) 
+          commGateway->processLoop();
+        else
+          if (ioTaskOwns(lnMQTT)) 
+          {
+            if (lnMQTT->mustResubscribe()) //true after reset of the MQTT connection
+              lnMQTT->subscribeTopics();
+            lnMQTT->processLoop(); //LN over MQTT
+          }
+      }
+    }
+    vTaskDelay(1); //let the idle task on core 0 run
+  }
+}
+#endif
+
 void resetPin(uint8_t pinNr)
 {
   pinMode(pinNr, OUTPUT);
@@ -253,8 +342,7 @@ void setup()
 //  resetPin(33);
 //  resetPin(36);
 
-  wsRxBuffer = (char*) malloc(wsBufferSize); 
-  wsTxBuffer = (char*) malloc(wsBufferSize); 
+  wsRxBuffer = (char*) malloc(wsRxBufferSize); 
   M5.begin();
 //  M5.Axp.EnableCoulombcounter();
   
@@ -271,6 +359,9 @@ void setup()
   digitraxBuffer = new IoTT_DigitraxBuffers(sendMsg); //initialization with standard LocoNet communication function
   //load switch status data from file. If not Cmd Stn mode, slot buffer is cleared, otherwise, load slot buffer from previous session
   digitraxBuffer->loadFromFile(bufferFileName); //load previous dataset
+#ifdef measurePerformance
+  digitraxBuffer->printBufferStats(); //memory used by the status buffers
+#endif
   myWebServer = new AsyncWebServer(80);
   dnsServer = new DNSServer();
   wifiClient = new WiFiClient();
@@ -477,6 +568,20 @@ void setup()
           case 9: lnMQTT->setDCCMode(); break; //no callback as DCC is one way only
           case 10: lnMQTT->setNativeMQTTCallback(callbackDCCMQTTMessage, 3); break; //DCC from MQTT, read only
         }
+        if (lnMQTT->getStateSync()) //restarted nodes get the buffer state from the broker instead of asking LocoNet
+          switch (useInterface.devId)
+          {
+            case 3: //LN over MQTT, receives the state
+              stateSync = new IoTT_StateSync(digitraxBuffer);
+              lnMQTT->setStateCallback(callbackStateMessage);
+              break;
+            case 4:;
+            case 13:;
+            case 15: //LocoNet w/ Gateway, publishes the state
+              stateSync = new IoTT_StateSync(digitraxBuffer);
+              lnMQTT->setStateSource(getStateUpdate);
+              break;
+          }
         wifiAlwaysOn = true;
         delete(jsonDataObj);
       }
@@ -538,6 +643,22 @@ void setup()
     else 
       Serial.println("WiThrottle not activated");
 
+    if (jsonConfigObj->containsKey("useWiServer") && (useInterface.devId != 17)) //WiThrottle server, uses the selected LocoNet interface
+      if ((bool)(*jsonConfigObj)["useWiServer"])
+      {
+        Serial.println("Load WiThrottle Server");  
+        wiServer = new IoTT_LBServer();
+        jsonDataObj = getDocPtr("/configdata/wiserver.cfg", false);
+        if (jsonDataObj != NULL)
+        {
+          wiServer->loadLBServerCfgJSON(*jsonDataObj);
+          delete(jsonDataObj);
+        }
+        wiServer->initWIServer(true);
+        wiServer->setTxCallback(sendMsg);
+        wifiAlwaysOn = true;
+      }
+
     if ((useInterface.devId == 4) || (useInterface.devId == 7) || (useInterface.devId == 13) || (useInterface.devId == 11) || (useInterface.devId == 14) || (useInterface.devId == 15)) // && (modMode == 1))) //LocoNet or Loopback or OpenLCB Gateway/ALM or lbServer
     {
       Serial.println("Load Gateway");  
@@ -558,11 +679,18 @@ void setup()
         digitraxBuffer->enableBushbyWatch(true); //defined in IoTT_DigitraxBuffers.h
       else
         digitraxBuffer->enableBushbyWatch(false);
+    if (jsonConfigObj->containsKey("lnRecorderSize")) //size of the LocoNet recorder file in kBytes
+      initLNRecorder((uint32_t)(*jsonConfigObj)["lnRecorderSize"] * 1024);
     if (jsonConfigObj->containsKey("useLissy"))
       if ((bool)(*jsonConfigObj)["useLissy"])
         digitraxBuffer->enableLissyMod(true); //defined in IoTT_DigitraxBuffers.h
       else
         digitraxBuffer->enableLissyMod(false);
+    accessoryOut = new IoTT_AccessoryOut(digitraxBuffer, sendMsg); //switch and signal commands, drops the redundant ones and paces the rest
+    if (jsonConfigObj->containsKey("accBudget")) //commands per second, 0 for no limit
+      accessoryOut->setBudget((*jsonConfigObj)["accBudget"], jsonConfigObj->containsKey("accBurst") ? (uint8_t)(*jsonConfigObj)["accBurst"] : accDefaultBurst);
+    if (jsonConfigObj->containsKey("accRetrigger")) //ms from the last activity of a switch to the next coil activation
+      accessoryOut->setRetriggerTime((*jsonConfigObj)["accRetrigger"]);
         
     if (useHat.devId == 1) //BlueHat or CTC Hat
     {
@@ -955,11 +1083,16 @@ void setup()
 //    if (useNTP) getInternetTime();
     if (lbServer)
       lbServer->startServer();
+    if (wiServer)
+      wiServer->startServer();
       
     Serial.println(String(ESP.getFreeHeap()));
   }
   randomSeed((uint32_t)ESP.getEfuseMac()); //initialize random generator with MAC
   pinMode(0, INPUT);
+#ifdef useDualCore
+  xTaskCreatePinnedToCore(ioTask, "IOTask", 8192, NULL, 2, &ioTaskHandle, 0);
+#endif
 }
 
 void loop() {
@@ -969,6 +1102,34 @@ void loop() {
   if (millis() > myTimer)
   {
     Serial.printf("Timer Loop: %i Heap: %i\n", loopCtr, ESP.getFreeHeap());
+    if (myChain)
+    {
+      Serial.printf("LED Frame: %i us Max: %i us I2C: %i bytes/s\n", myChain->frameTime, myChain->maxFrameTime, myChain->i2cLEDBytes);
+      myChain->maxFrameTime = 0;
+      myChain->i2cLEDBytes = 0;
+    }
+#ifdef useDualCore
+    Serial.printf("Rx Queue max: %i lost: %i Tx Queue max: %i lost: %i\n", rxQueue.maxFillLevel, rxQueue.overflowCtr, txQueue.maxFillLevel, txQueue.overflowCtr);
+#endif
+    if (lnSerial)
+      Serial.printf("LocoNet Tx: %i merged: %i\n", lnSerial->txMsgCtr, lnSerial->txMergeCtr);
+    if (stateSync)
+      stateSync->printStats();
+    if (accessoryOut)
+      accessoryOut->printStats();
+    if (trainSensor)
+      trainSensor->printStats();
+#ifdef useAI
+    if (voiceWatcher)
+      voiceWatcher->printStats();
+#endif
+    if (wiServer)
+    {
+      Serial.printf("WiThrottle Clients: %i Cmds: %i Speed Req: %i Sent: %i Lines: %i Max Loop: %i us\n", wiServer->getConnectionStatus(), wiServer->wiCmdCtr, wiServer->wiSpeedReqCtr, wiServer->wiSpeedTxCtr, wiServer->wiLineCtr, wiServer->wiMaxLoopTime);
+      wiServer->resetWIStats();
+    }
+    printWebStats();
+    printDisplayStats();
     loopCtr = 0;
     myTimer += 1000;
   }
@@ -980,15 +1141,23 @@ void loop() {
 
   if (execLoop)
   {
+#ifdef useDualCore
+  lnReceiveBuffer rxData;
+  while (rxQueue.pop(rxData)) //messages received in the I/O task
+    callbackLocoNetMessage(&rxData);
+#endif
+  processLNRecorder(); //writes recorded LocoNet messages to SPIFFS or replays them
 //  if (secElHandlerList) secElHandlerList->processLoop(); //calculates speeds in all blocks and sets signals accordingly
 #ifdef useAI
-  if (voiceWatcher) voiceWatcher->processKeywordRecognition(); //listens for STOP and GO keywords
+  if (voiceWatcher) voiceWatcher->processKeywordRecognition(); //STOP and GO keywords recognized by the inference task
 #endif
   if (myDcc) myDcc->process(); //receives and decodes track signals
   if (eventHandler) eventHandler->processButtonHandler(); //drives the outgoing buffer and time delayed commands
+  if (accessoryOut) accessoryOut->processLoop(); //sends switch and signal commands within the bus budget
   if (usbSerial) usbSerial->processLoop(); //drives the USB interface serial traffic
-  if (lbServer) lbServer->processLoop(); //drives the LocoNet over TCP interface traffic
-  if (lnSerial) lnSerial->processLoop(); //handling all LocoNet communication
+  if (lbServer && !ioTaskOwns(lbServer)) lbServer->processLoop(); //drives the LocoNet over TCP interface traffic
+  if (wiServer) wiServer->processLoop(); //sends throttle commands to LocoNet and state changes to the WiThrottle clients
+  if (lnSerial && !ioTaskOwns(lnSerial)) lnSerial->processLoop(); //handling all LocoNet communication
 //  if (olcbSerial) olcbSerial->processLoop(); //handling all OpenLCB communication
   if (trainSensor) trainSensor->processLoop(); //getting the data fromn the speed sensor
 
@@ -1025,9 +1194,12 @@ void loop() {
       if (WiFi.status() == WL_CONNECTED)
       { 
         if (commGateway) 
-          commGateway->processLoop();
+        {
+          if (!ioTaskOwns(commGateway))
+            commGateway->processLoop();
+        }
         else
-          if (lnMQTT) 
+          if (lnMQTT && !ioTaskOwns(lnMQTT)) 
           {
             if (lnMQTT->mustResubscribe()) //true after reset of the MQTT connection
             {
@@ -1053,7 +1225,7 @@ void loop() {
     sendKeepAlive();
   }
   if (subnetMode != standardMode)
-    if (lnSerial) lnSerial->processLoop(); //enable all LocoNet communication
+    if (lnSerial && !ioTaskOwns(lnSerial)) lnSerial->processLoop(); //enable all LocoNet communication
   M5.update();
   processDisplay();
   
@@ -0,0 +1,248 @@
+//LocoNet recorder. Every message coming in through callbackLocoNetMessage is stored in a binary ring file on SPIFFS
+//The file is organized in blocks of lnRecBlockSize bytes. Each block starts with a 4 byte sequence number, followed by records:
+//  uint8_t msgSize, uint8_t errorFlags, uint16_t reqID, uint32_t recTime (millis), msgSize bytes of message data
+//A msgSize of 0 marks the end of the records in a block. Records are collected in RAM and written as one block when it is full
+//or after lnRecFlushInterval, so there is at most one flash write per block. After a restart, recording continues after the block
+//with the highest sequence number. The block after that is the oldest one, which is where the replay starts.
+//Replay feeds the records back through callbackLocoNetMessage, i.e. DigitraxBuffers and the LED, button and switch event handlers,
+//with original timing or faster. Outgoing messages are blocked while replaying.
+
+#define lnRecBlockSize 512
+#define lnRecHeaderSize 8 //record size without message data
+#define lnRecFlushInterval 10000 //write a block at least every 10 secs, even if not full
+#define lnReplayBatchSize 32 //max records per loop() call in fast replay mode
+
+String lnRecFileName = "/lnrecord.dat";
+uint16_t lnRecNumBlocks = 0; //0: recorder not active
+uint16_t lnRecBlockNr = 0; //block to write next, also the oldest block in the file
+uint32_t lnRecSeqNr = 1; //0 is used for blocks not written yet
+uint8_t lnRecBuffer[lnRecBlockSize];
+uint16_t lnRecBufferPtr = 4;
+uint32_t lnRecFlushTimer = millis();
+
+bool lnReplayActive = false;
+volatile bool lnReplayStartReq = false; //set from the web server task, executed in loop()
+volatile bool lnReplayStopReq = false;
+float lnReplaySpeed = 1.0; //0: as fast as possible
+uint8_t lnReplayBuffer[lnRecBlockSize];
+uint16_t lnReplayBlockNr = 0;
+uint16_t lnReplayBlockCtr = 0;
+uint16_t lnReplayPtr = lnRecBlockSize;
+bool lnReplayFirstRec = true;
+uint32_t lnReplayStartTime = 0; //millis() at the first replayed record
+uint32_t lnReplayBaseTime = 0; //millis() when the base record was due
+uint32_t lnReplayBaseRecTime = 0; //recTime of the base record, later records are timed from here
+uint32_t lnReplayPrevRecTime = 0; //recTime of the previous record
+uint32_t lnReplayMsgCtr = 0;
+
+void initLNRecorder(uint32_t fileSize)
+{
+  lnRecNumBlocks = fileSize / lnRecBlockSize;
+  if (lnRecNumBlocks < 2)
+  {
+    lnRecNumBlocks = 0;
+    return;
+  }
+  uint32_t maxSeqNr = 0;
+  lnRecBlockNr = 0;
+  File recFile = SPIFFS.open(lnRecFileName, "r");
+  bool fileOK = recFile && (recFile.size() == (lnRecNumBlocks * lnRecBlockSize));
+  if (fileOK)
+    for (uint16_t i = 0; i < lnRecNumBlocks; i++)
+    {
+      uint32_t blockSeqNr = 0;
+      recFile.seek(i * lnRecBlockSize);
+      recFile.read((uint8_t*)&blockSeqNr, 4);
+      if (blockSeqNr > maxSeqNr)
+      {
+        maxSeqNr = blockSeqNr;
+        lnRecBlockNr = (i + 1) % lnRecNumBlocks;
+      }
+    }
+  if (recFile)
+    recFile.close();
+  if (!fileOK) //new file or size changed, create empty file
+  {
+    Serial.printf("Create LocoNet recorder file with %i blocks\n", lnRecNumBlocks);
+    memset(lnRecBuffer, 0, lnRecBlockSize);
+    recFile = SPIFFS.open(lnRecFileName, "w");
+    if (recFile)
+    {
+      for (uint16_t i = 0; i < lnRecNumBlocks; i++)
+        recFile.write(lnRecBuffer, lnRecBlockSize);
+      recFile.close();
+    }
+    else
+    {
+      Serial.println("LocoNet recorder file could not be created");
+      lnRecNumBlocks = 0;
+      return;
+    }
+  }
+  lnRecSeqNr = maxSeqNr + 1;
+  lnRecBufferPtr = 4;
+  lnRecFlushTimer = millis();
+  Serial.printf("LocoNet recorder active, next block %i\n", lnRecBlockNr);
+}
+
+void recordLNMessage(lnReceiveBuffer * newData)
+{
+  if ((lnRecNumBlocks == 0) || lnReplayActive)
+    return;
+  uint16_t recSize = lnRecHeaderSize + newData->lnMsgSize;
+  if ((lnRecBufferPtr + recSize) > lnRecBlockSize)
+    flushLNRecorder();
+  uint8_t * recPtr = &lnRecBuffer[lnRecBufferPtr];
+  uint32_t recTime = millis();
+  recPtr[0] = newData->lnMsgSize;
+  recPtr[1] = newData->errorFlags;
+  memcpy(&recPtr[2], &newData->reqID, 2);
+  memcpy(&recPtr[4], &recTime, 4);
+  memcpy(&recPtr[lnRecHeaderSize], newData->lnData, newData->lnMsgSize);
+  lnRecBufferPtr += recSize;
+}
+
+void flushLNRecorder()
+{
+  if ((lnRecNumBlocks == 0) || (lnRecBufferPtr <= 4))
+    return;
+  memcpy(&lnRecBuffer[0], &lnRecSeqNr, 4);
+  memset(&lnRecBuffer[lnRecBufferPtr], 0, lnRecBlockSize - lnRecBufferPtr); //end marker
+  File recFile = SPIFFS.open(lnRecFileName, "r+");
+  if (recFile)
+  {
+    recFile.seek(lnRecBlockNr * lnRecBlockSize);
+    recFile.write(lnRecBuffer, lnRecBlockSize);
+    recFile.close();
+  }
+  lnRecSeqNr++;
+  lnRecBlockNr = (lnRecBlockNr + 1) % lnRecNumBlocks;
+  lnRecBufferPtr = 4;
+  lnRecFlushTimer = millis();
+}
+
+void requestLNReplay(float speedFactor) //can be called from any task
+{
+  lnReplaySpeed = speedFactor;
+  lnReplayStartReq = true;
+}
+
+void stopLNReplay() //can be called from any task
+{
+  lnReplayStopReq = true;
+}
+
+bool isLNReplayActive()
+{
+  return lnReplayActive;
+}
+
+bool loadLNReplayBlock(uint16_t blockNr) //returns false if the block was never written
+{
+  uint32_t blockSeqNr = 0;
+  File recFile = SPIFFS.open(lnRecFileName, "r");
+  if (!recFile)
+    return false;
+  recFile.seek(blockNr * lnRecBlockSize);
+  recFile.read(lnReplayBuffer, lnRecBlockSize);
+  recFile.close();
+  memcpy(&blockSeqNr, &lnReplayBuffer[0], 4);
+  lnReplayPtr = 4;
+  return blockSeqNr > 0;
+}
+
+void startLNReplay()
+{
+  if (lnRecNumBlocks == 0)
+  {
+    Serial.println("LocoNet recorder not active");
+    return;
+  }
+  flushLNRecorder(); //make sure the latest data is in the file
+  lnReplayBlockNr = lnRecBlockNr; //oldest block
+  lnReplayBlockCtr = 0;
+  lnReplayPtr = lnRecBlockSize; //load first block in processLNReplay
+  lnReplayFirstRec = true;
+  lnReplayMsgCtr = 0;
+  lnReplayActive = true;
+  Serial.printf("LocoNet replay started, speed %.1f\n", lnReplaySpeed);
+}
+
+void endLNReplay()
+{
+  lnReplayActive = false;
+  Serial.printf("LocoNet replay ended, %i messages in %i ms\n", lnReplayMsgCtr, lnReplayFirstRec ? 0 : millis() - lnReplayStartTime);
+}
+
+void processLNReplay()
+{
+  uint8_t batchCtr = 0;
+  while (lnReplayActive && (batchCtr < lnReplayBatchSize))
+  {
+    if ((lnReplayPtr > (lnRecBlockSize - lnRecHeaderSize)) || (lnReplayBuffer[lnReplayPtr] == 0)) //end of block
+    {
+      if (lnReplayBlockCtr >= lnRecNumBlocks)
+      {
+        endLNReplay();
+        return;
+      }
+      if (!loadLNReplayBlock(lnReplayBlockNr))
+        lnReplayPtr = lnRecBlockSize; //empty block, skip
+      lnReplayBlockNr = (lnReplayBlockNr + 1) % lnRecNumBlocks;
+      lnReplayBlockCtr++;
+      continue;
+    }
+    uint8_t * recPtr = &lnReplayBuffer[lnReplayPtr];
+    uint32_t recTime;
+    memcpy(&recTime, &recPtr[4], 4);
+    if (lnReplayFirstRec)
+    {
+      lnReplayFirstRec = false;
+      lnReplayStartTime = millis();
+      lnReplayBaseTime = lnReplayStartTime;
+      lnReplayBaseRecTime = recTime;
+      lnReplayPrevRecTime = recTime;
+    }
+    if ((int32_t)(recTime - lnReplayPrevRecTime) < 0) //the ring file spans reboots, so millis() of the recording can go backwards
+    {
+      if (lnReplaySpeed > 0) //no gap, continue the replay clock from where the previous record was due
+        lnReplayBaseTime += (uint32_t)((lnReplayPrevRecTime - lnReplayBaseRecTime) / lnReplaySpeed);
+      lnReplayBaseRecTime = recTime;
+      lnReplayPrevRecTime = recTime;
+    }
+    if (lnReplaySpeed > 0)
+      if ((millis() - lnReplayBaseTime) < (uint32_t)((recTime - lnReplayBaseRecTime) / lnReplaySpeed))
+        return; //not due yet
+    lnReplayPrevRecTime = recTime;
+    lnReceiveBuffer rxData;
+    rxData.lnMsgSize = recPtr[0];
+    rxData.errorFlags = recPtr[1];
+    memcpy(&rxData.reqID, &recPtr[2], 2);
+    rxData.reqRecTime = recTime;
+    memcpy(rxData.lnData, &recPtr[lnRecHeaderSize], rxData.lnMsgSize);
+    lnReplayPtr += lnRecHeaderSize + rxData.lnMsgSize;
+    callbackLocoNetMessage(&rxData);
+    lnReplayMsgCtr++;
+    batchCtr++;
+  }
+}
+
+void processLNRecorder() //called from loop()
+{
+  if (lnReplayStopReq)
+  {
+    lnReplayStopReq = false;
+    if (lnReplayActive)
+      endLNReplay();
+  }
+  if (lnReplayStartReq)
+  {
+    lnReplayStartReq = false;
+    startLNReplay();
+  }
+  if (lnReplayActive)
+    processLNReplay();
+  else
+    if ((lnRecBufferPtr > 4) && ((millis() - lnRecFlushTimer) > lnRecFlushInterval))
+      flushLNRecorder();
+}
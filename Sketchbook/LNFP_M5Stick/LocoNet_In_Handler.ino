@@ -6,8 +6,20 @@ void callbackLocoNetMessage(lnReceiveBuffer * newData) //this is the landing poi
                                                        //from LocoNet, MQTT, or Gateway
 {
 //  Serial.println("App Callback");
+#ifdef useDualCore
+  if ((ioTaskHandle) && (xTaskGetCurrentTaskHandle() == ioTaskHandle)) //called by a transport in the I/O task, processed in loop()
+  {
+    rxQueue.push(*newData);
+    return;
+  }
+#endif
+  recordLNMessage(newData);
   if ((newData->errorFlags & (~msgEcho)) == 0)// && (newData->lnMsgSize > 0))//filter out echo flag
+  {
+    if (wiServer) 
+      wiServer->lnWriteMsg(*newData); //turnout, power and slot updates for the WiThrottle clients
     processLNValidMsg(newData);
+  }
   else
     processLNError(newData);
 }
@@ -76,7 +88,6 @@ void handleTranspondingEvent(uint16_t zoneAddr, uint16_t locoAddr, uint8_t event
 //  Serial.printf("Incoming Transponder Command for Zone %i Loco %i Status %i\n", zoneAddr, locoAddr, eventVal);
   if (eventHandler) eventHandler->processBtnEvent(evt_transponder, zoneAddr, locoAddr | (eventVal << 15));
   if (mySwitchList) mySwitchList->processBtnEvent(evt_transponder, zoneAddr, locoAddr | (eventVal << 15));
-  if (myChain) myChain->processBtnEvent(evt_transponder, zoneAddr, locoAddr | (eventVal << 15));
 }
 
 void handleSwiEvent(uint16_t swiAddr, uint8_t swiPos, uint8_t coilStat)
@@ -86,6 +97,7 @@ void handleSwiEvent(uint16_t swiAddr, uint8_t swiPos, uint8_t coilStat)
   if (eventHandler) eventHandler->processBtnEvent(evt_trackswitch, swiAddr, swiPos);
   if (mySwitchList) mySwitchList->processBtnEvent(evt_trackswitch, swiAddr, swiPos);
 //  if (myChain) myChain->processBtnEvent(evt_trackswitch, swiAddr, swiPos);
+//  if (secElHandlerList) secElHandlerList->processBtnEvent(evt_trackswitch, swiAddr, swiPos);
 }
 
 void handleInputEvent(uint16_t inpAddr, uint8_t inpStatus)
@@ -94,6 +106,7 @@ void handleInputEvent(uint16_t inpAddr, uint8_t inpStatus)
 //  Serial.printf("Incoming Input Command for Detector %i Level %i\n", inpAddr, inpStatus);
   if (eventHandler) eventHandler->processBtnEvent(evt_blockdetector, inpAddr, inpStatus);
   if (mySwitchList) mySwitchList->processBtnEvent(evt_blockdetector, inpAddr, inpStatus);
+//  if (secElHandlerList) secElHandlerList->processBtnEvent(evt_blockdetector, inpAddr, inpStatus);
 }
 
 void handleSignalEvent(uint16_t sigAddr, uint8_t sigAspect)
@@ -130,5 +143,5 @@ void handleButtonValue(uint16_t btnAddr, uint8_t inputValue)
 void handleProgrammerEvent(uint8_t *  programmerSlot)
 {
 //  Serial.printf("Prog Stat: %i CV: %i Val: %i\n", programmerSlot[1], (programmerSlot[5]<<7) + (programmerSlot[6] & 0x7F), programmerSlot[7]);
-  if (trainSensor) trainSensor->programmerReturn(programmerSlot);
+  if (trainSensor) trainSensor->programmerReturn(programmerSlot, digitraxBuffer->getProgQueueLevel());
 }
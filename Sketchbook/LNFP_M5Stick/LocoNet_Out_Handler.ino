@@ -42,7 +42,10 @@ void sendSwitchCommand(uint8_t opCode, uint16_t swiNr, uint8_t swiTargetPos, uin
 //  Serial.println(txData.lnData[2],16);
   txData.lnData[3] = ~(txData.lnData[0] ^ txData.lnData[1] ^ txData.lnData[2]);
 //  Serial.printf("LN Out: %i %i %i %i\n", txData.lnData[0],txData.lnData[1],txData.lnData[2],txData.lnData[3]);
-  sendMsg(txData);
+  if (accessoryOut && (opCode != 0xB1)) //switch reports are not paced
+    accessoryOut->addSwitchCmd(txData);
+  else
+    sendMsg(txData);
 }
 
 void sendSignalCommand(uint16_t signalNr, uint8_t signalAspect)
@@ -75,7 +78,10 @@ void sendSignalCommand(uint16_t signalNr, uint8_t signalAspect)
 //    Serial.print(txData.lnData[10],16);
 //    Serial.println(" ");
 
-  sendMsg(txData);
+  if (accessoryOut)
+    accessoryOut->addSignalCmd(signalNr, signalAspect, txData);
+  else
+    sendMsg(txData);
 }
 
 void sendBlockDetectorCommand(uint16_t bdNr, uint8_t bdStatus) 
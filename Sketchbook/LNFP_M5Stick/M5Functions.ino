@@ -48,6 +48,20 @@ uint32_t wifiResetLastClick = 0;
 
 char dispBuffer[oneShotBufferSize][dccStrLen];
 
+//The viewer pages do not draw each message to the display. Messages go to dispBuffer and the text area is rendered into an off-screen
+//sprite, which is sent to the display as one rectangle at most every viewerFrameInterval. If the sprite can't be allocated, the lines
+//are drawn directly as before
+#define viewerFrameInterval 100 //max 10 frames per second
+#define viewerLineStep 15 //line distance and position of the first line in 80 x 160 coordinates
+#define viewerFontHeight 8 //font 1
+
+TFT_eSprite * viewerSprite = NULL;
+bool viewerDirty = false;
+uint32_t viewerFrameTimer = millis();
+uint32_t dispTime = 0; //statistics, time spent in display code in us
+uint32_t dispMaxTime = 0;
+uint32_t dispFrameCtr = 0;
+
 bool isOneTime()
 {
   return dccOneTimeDisp;
@@ -73,6 +87,8 @@ void getRTCTime()
 
 void processDisplay()
 {
+  if (viewerDirty && (useM5Viewer > 0) && ((millis() - viewerFrameTimer) >= viewerFrameInterval))
+    flushViewer();
   axpBusVoltage = M5.Axp.GetVBusVoltage();
   axpInVoltage = M5.Axp.GetVinVoltage();
   hatPresent = axpInVoltage > 0.5;
@@ -774,87 +790,126 @@ String getMQTTString(char * topic, byte * payload)
   return outText;  
 }
 
-void clearDisplay()
+uint16_t getViewerTop()
 {
-  String emptyLine = "                                        ";
-  uint8_t dispY = 0;
-  for (int i = 0; i < oneShotBufferSize; i++)
+  return getYCoord(viewerLineStep + 5);
+}
+
+bool initViewerSprite()
+{
+  if (viewerSprite)
+    return true;
+  viewerSprite = new TFT_eSprite(&M5.Lcd);
+  viewerSprite->setColorDepth(8); //half the RAM of 16 bit, enough for text
+  uint16_t spriteHeight = getYCoord((viewerLineStep * oneShotBufferSize) + 5) - getViewerTop() + viewerFontHeight;
+  if (!viewerSprite->createSprite(M5.Lcd.width() - getXCoord(5), spriteHeight))
+  {
+    Serial.println("No memory for display sprite, drawing directly");
+    delete(viewerSprite);
+    viewerSprite = NULL;
+    return false;
+  }
+  viewerSprite->setTextColor(TFT_BLACK, TFT_LIGHTGREY);
+  return true;
+}
+
+void flushViewer() //renders the text lines, newest on top, and sends them to the display
+{
+  uint32_t startTime = micros();
+  uint16_t viewerTop = getViewerTop();
+  if (initViewerSprite())
   {
-    strncpy(dispBuffer[i], emptyLine.c_str(), dccStrLen);
-    dispY = (15 * (i+1)) + 5;
-    drawText(&emptyLine[0], 5, dispY, 1);
+    viewerSprite->fillSprite(TFT_LIGHTGREY);
+    for (int i = 0; i < oneShotBufferSize; i++)
+      viewerSprite->drawString(&dispBuffer[(m5DispLine+oneShotBufferSize-i-1) % oneShotBufferSize][0], 0, getYCoord((viewerLineStep * (i+1)) + 5) - viewerTop, 1);
+    viewerSprite->pushSprite(getXCoord(5), viewerTop);
   }
+  else
+  {
+    String emptyLine = "                                                                      ";
+    for (int i = 0; i < oneShotBufferSize; i++)
+    {
+      uint8_t dispY = (viewerLineStep * (i+1)) + 5;
+      drawText(&emptyLine[0], 5, dispY, 1);
+      drawText(&dispBuffer[(m5DispLine+oneShotBufferSize-i-1) % oneShotBufferSize][0], 5, dispY, 1);
+    }
+  }
+  viewerDirty = false;
+  viewerFrameTimer = millis();
+  dispFrameCtr++;
+  startTime = micros() - startTime;
+  dispTime += startTime;
+  if (startTime > dispMaxTime)
+    dispMaxTime = startTime;
 }
 
-void processLNtoM5(lnReceiveBuffer * newData)
+void addViewerLine(const char * lineText, const char * addText) //adds a line to dispBuffer, the display is updated in processDisplay
 {
-  String emptyLine = "                                                                      ";
-  String outText = getLNString(newData);
-  strncpy(dispBuffer[m5DispLine], outText.c_str(), dccStrLen);
-  uint8_t dispY = 0;
-  for (int i = 0; i < oneShotBufferSize; i++)
+  uint32_t startTime = micros();
+  strncpy(dispBuffer[m5DispLine], lineText, dccStrLen - 1);
+  dispBuffer[m5DispLine][dccStrLen - 1] = char(0);
+  if (addText)
   {
-    dispY = (15 * (i+1)) + 5;
-    drawText(&emptyLine[0], 5, dispY, 1);
-    drawText(&dispBuffer[(m5DispLine+oneShotBufferSize-i) % oneShotBufferSize][0], 5, dispY, 1);
+    strncat(dispBuffer[m5DispLine], " ", dccStrLen - 1 - strlen(dispBuffer[m5DispLine]));
+    strncat(dispBuffer[m5DispLine], addText, dccStrLen - 1 - strlen(dispBuffer[m5DispLine]));
   }
   m5DispLine = (m5DispLine + 1) % oneShotBufferSize; //line
+  viewerDirty = true;
+  dispTime += micros() - startTime;
+}
+
+void printDisplayStats()
+{
+  Serial.printf("Display: %i us Max Frame: %i us Frames: %i\n", dispTime, dispMaxTime, dispFrameCtr);
+  dispTime = 0;
+  dispMaxTime = 0;
+  dispFrameCtr = 0;
+}
+
+void clearDisplay()
+{
+  for (int i = 0; i < oneShotBufferSize; i++)
+    dispBuffer[i][0] = char(0);
+  viewerDirty = true;
+}
+
+void processLNtoM5(lnReceiveBuffer * newData)
+{
+  String outText = getLNString(newData);
+  addViewerLine(outText.c_str(), NULL);
 }
 
 void processOLCBtoM5(lnReceiveBuffer * newData)
 {
-  String emptyLine = "                                                                      ";
   String outText = getOLCBString(newData);
-  strncpy(dispBuffer[m5DispLine], outText.c_str(), dccStrLen);
-  uint8_t dispY = 0;
-  for (int i = 0; i < oneShotBufferSize; i++)
-  {
-    dispY = (15 * (i+1)) + 5;
-    drawText(&emptyLine[0], 5, dispY, 1);
-    drawText(&dispBuffer[(m5DispLine+oneShotBufferSize-i) % oneShotBufferSize][0], 5, dispY, 1);
-  }
-  m5DispLine = (m5DispLine + 1) % oneShotBufferSize; //line
+  addViewerLine(outText.c_str(), NULL);
 }
 
 void processMQTTtoM5(bool published, char * topic, char * payload)
 {
-  String emptyLine = "                                                                      ";
   if (((published) && isOneTime()) || ((!published) && (!isOneTime())))
-  {
-    strncpy(dispBuffer[m5DispLine], topic, dccStrLen);
-    strncat(dispBuffer[m5DispLine], " ", dccStrLen - strlen(dispBuffer[m5DispLine]));
-    strncat(dispBuffer[m5DispLine], payload, dccStrLen - strlen(dispBuffer[m5DispLine]));
-    uint8_t dispY = 0;
-//    Serial.println(dispBuffer[m5DispLine]);
-    for (int i = 0; i < oneShotBufferSize; i++)
-    {
-      dispY = (15 * (i+1)) + 5;
-      drawText(&emptyLine[0], 5, dispY, 1);
-      drawText(&dispBuffer[(m5DispLine+oneShotBufferSize-i) % oneShotBufferSize][0], 5, dispY, 1);
-    }
-    m5DispLine = (m5DispLine + 1) % oneShotBufferSize; //line
-  }
+    addViewerLine(topic, payload);
 }
 
 void processDCCtoM5(bool oneTime, String dispText)
 {
-  String emptyLine = "                                                                      ";
   if (oneTime)
+    addViewerLine(dispText.c_str(), NULL);
+  else
   {
-    strncpy(dispBuffer[m5DispLine], dispText.c_str(), dccStrLen);
-    uint8_t dispY = 0;
-    for (int i = 0; i < oneShotBufferSize; i++)
+    //circular mode, dispText is the list of commands in the refresh buffer, one per line. Show the first lines in the same order
+    clearDisplay();
+    m5DispLine = 0;
+    int lineStart = 0;
+    for (int i = 0; (i < oneShotBufferSize) && (lineStart < dispText.length()); i++)
     {
-      dispY = (15 * (i+1)) + 5;
-      drawText(&emptyLine[0], 5, dispY, 1);
-      drawText(&dispBuffer[(m5DispLine+oneShotBufferSize-i) % oneShotBufferSize][0], 5, dispY, 1);
+      int lineEnd = dispText.indexOf("\r\n", lineStart);
+      if (lineEnd < 0)
+        lineEnd = dispText.length();
+      strncpy(dispBuffer[oneShotBufferSize - 1 - i], dispText.substring(lineStart, lineEnd).c_str(), dccStrLen - 1); //line i is shown from dispBuffer[oneShotBufferSize - 1 - i]
+      dispBuffer[oneShotBufferSize - 1 - i][dccStrLen - 1] = char(0);
+      lineStart = lineEnd + 2;
     }
-    m5DispLine = (m5DispLine + 1) % oneShotBufferSize; //line
-  }
-  else
-  {
-    dccViewerPage();
-    drawText(&dispText[0], 5, 20, 1);
     Serial.println(dispText);
   }
 }
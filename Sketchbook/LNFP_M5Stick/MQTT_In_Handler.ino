@@ -41,6 +41,19 @@ void callbackMQTTMessage(char* topic, byte *  payload, unsigned int length)
       Serial.printf("deserializeJson() wsProcessing failed: %s\n", error.c_str());
 }
 
+void callbackStateMessage(char* subTopic, byte * payload, unsigned int length) //retained state pages from the LocoNet node
+{
+  if (stateSync)
+    stateSync->processStateMsg(subTopic, payload, length);
+}
+
+int16_t getStateUpdate(char * subTopic, uint8_t * payload, bool prevSent) //next changed state page to publish, called by MQTTESP32
+{
+  if (stateSync)
+    return stateSync->getNextUpdate(subTopic, payload, prevSent);
+  return -1;
+}
+
 void processDataToMQTTBWebClient(String thisCmd,  char* topic, char* payload) //if a web browser is conneted, all LN messages are sent via Websockets
                                                      //this is the hook for a web based OLCB viewer
 {
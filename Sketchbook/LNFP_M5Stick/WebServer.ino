@@ -20,15 +20,145 @@ fileListEntry outFileList[outListLen];
 int fileListRdPtr = 0;
 int fileListWrPtr = 0;
 
+#define wsRxFileName "/wsrx.tmp" //staging file for web socket messages larger than wsRxBuffer
+File wsRxFile;
+bool wsRxToFile = false;
+
 //------------------------------------------------------------------------------------------------------------------------------------------------
 
 void notFound(AsyncWebServerRequest *request) {
   request->send(404, "text/plain", "Not found");
 }
 
+//Web pages prepared by tools/WebAssets/build_www.py. The manifest lists the content hash of every file and if a .gz version exists.
+//The hash is used as ETag, so a reload with an unchanged file is answered with 304 and no content. Requests with ?v=<hash>,
+//i.e. scripts, style sheets and images referenced from the pages, can be cached by the browser without asking again
+//Files not in the manifest are served by serveStatic as before
+#define webAssetManifest "/www/assets.man"
+#define webCacheVersioned "public, max-age=31536000, immutable"
+#define webCacheRevalidate "no-cache"
+
+typedef struct
+{
+  char fileName[strBufLen];
+  char fileHash[9];
+  bool hasGzip;
+} webAssetEntry;
+
+webAssetEntry * webAssetList = NULL;
+uint16_t webAssetCount = 0;
+uint32_t webFileCtr = 0; //statistics, files sent
+uint32_t webNotModCtr = 0; //304 sent
+uint32_t webGzipCtr = 0; //files sent compressed
+
+void loadWebAssetManifest()
+{
+  File manFile = SPIFFS.open(webAssetManifest, "r");
+  if (!manFile)
+  {
+    Serial.println("No web asset manifest, pages are not cached");
+    return;
+  }
+  uint16_t lineCtr = 0;
+  while (manFile.available())
+    if (manFile.read() == '\n')
+      lineCtr++;
+  webAssetList = (webAssetEntry*) calloc(lineCtr, sizeof(webAssetEntry));
+  if (!webAssetList)
+  {
+    manFile.close();
+    return;
+  }
+  manFile.seek(0);
+  while (manFile.available() && (webAssetCount < lineCtr))
+  {
+    String thisLine = manFile.readStringUntil('\n');
+    int hashPos = thisLine.indexOf(' ');
+    int gzipPos = thisLine.lastIndexOf(' ');
+    if ((hashPos <= 0) || (hashPos >= strBufLen) || (gzipPos != hashPos + 9)) //invalid line or name too long, leave it to serveStatic
+      continue;
+    webAssetEntry * thisEntry = &webAssetList[webAssetCount];
+    strcpy(thisEntry->fileName, thisLine.substring(0, hashPos).c_str());
+    strcpy(thisEntry->fileHash, thisLine.substring(hashPos + 1, gzipPos).c_str());
+    thisEntry->hasGzip = thisLine.charAt(gzipPos + 1) == '1';
+    webAssetCount++;
+  }
+  manFile.close();
+  Serial.printf("%i web files in manifest\n", webAssetCount);
+}
+
+int16_t findWebAsset(const String& url) //returns the index in webAssetList or -1
+{
+  String fileName = "/www" + url;
+  if (fileName.endsWith("/"))
+    fileName += "index.htm";
+  for (uint16_t i = 0; i < webAssetCount; i++)
+    if (strcmp(webAssetList[i].fileName, fileName.c_str()) == 0)
+      return i;
+  return -1;
+}
+
+void printWebStats()
+{
+  Serial.printf("Web Files sent: %i gzip: %i not modified: %i\n", webFileCtr, webGzipCtr, webNotModCtr);
+  webFileCtr = 0;
+  webGzipCtr = 0;
+  webNotModCtr = 0;
+}
+
+class WebAssetHandler : public AsyncWebHandler
+{
+  public:
+    bool canHandle(AsyncWebServerRequest *request)
+    {
+      if ((request->method() != HTTP_GET) || (findWebAsset(request->url()) < 0))
+        return false;
+      request->addInterestingHeader("If-None-Match");
+      request->addInterestingHeader("Accept-Encoding");
+      return true;
+    }
+
+    void handleRequest(AsyncWebServerRequest *request)
+    {
+      int16_t assetIndex = findWebAsset(request->url());
+      if (assetIndex < 0)
+        return request->send(404);
+      webAssetEntry * thisEntry = &webAssetList[assetIndex];
+      String eTag = "\"" + String(thisEntry->fileHash) + "\"";
+      bool isVersioned = request->hasParam("v") && request->getParam("v")->value().equals(thisEntry->fileHash);
+      AsyncWebServerResponse * response = NULL;
+      if (request->hasHeader("If-None-Match") && (request->header("If-None-Match") == eTag))
+      {
+        response = request->beginResponse(304);
+        webNotModCtr++;
+      }
+      else
+      {
+        String fileName = thisEntry->fileName;
+        bool useGzip = thisEntry->hasGzip && ((request->header("Accept-Encoding").indexOf("gzip") >= 0) || !SPIFFS.exists(fileName));
+        if (useGzip) //the response sets Content-Type from fileName and Content-Encoding from the .gz file name
+          response = request->beginResponse(SPIFFS.open(fileName + ".gz", "r"), fileName);
+        else
+          response = request->beginResponse(SPIFFS, fileName);
+        webFileCtr++;
+        if (useGzip)
+          webGzipCtr++;
+      }
+      response->addHeader("Cache-Control", isVersioned ? webCacheVersioned : webCacheRevalidate);
+      response->addHeader("ETag", eTag);
+      if (thisEntry->hasGzip) //caches must not give the .gz version to a client that did not ask for it
+        response->addHeader("Vary", "Accept-Encoding");
+      request->send(response);
+    }
+};
+
+WebAssetHandler * webAssetHandler = NULL;
+
 void startWebServer()
 {
   if (!myWebServer) return;
+  if (SPIFFS.exists(wsRxFileName)) //left over from a reset while a message was staged
+    SPIFFS.remove(wsRxFileName);
   myWebServer->on("/delete_led", HTTP_GET, [](AsyncWebServerRequest * request)
   {
     deleteAllFiles("led", configDir, configExt, true); //delete the last one only to save as much as possible
@@ -103,6 +233,12 @@ void startWebServer()
   myWebServer->addHandler(ws);
 
   myWebServer->onNotFound(notFound);
+  if (!webAssetHandler) //startWebServer is called again after a WiFi reconnect
+  {
+    loadWebAssetManifest();
+    webAssetHandler = new WebAssetHandler();
+    myWebServer->addHandler(webAssetHandler);
+  }
   myWebServer->serveStatic("/", SPIFFS, "/www/").setDefaultFile("index.htm");
   myWebServer->begin();
   Serial.println("Web Server initialized");
@@ -249,48 +385,57 @@ bool addFileToTx(String fileName, int fileIndex, String cmdType, uint8_t multiMo
 void sendJSONFile(int thisFileIndex)
 {
 //  Serial.printf("Try to send File %s Type %s as Index %i\n", &outFileList[thisFileIndex].fileName[0], &outFileList[thisFileIndex].cmdType[0], outFileList[thisFileIndex].fileIndex);
-  String fileStr;
-  uint32_t retStr = 0;//"";
-  wsTxWritePtr = 0;
-  wsTxReadPtr = 0;
+  if (globalClient == NULL)
+    return;
+  String msgStr;
+  String fileName = "";
   switch (outFileList[thisFileIndex].multiFileMode)
   {
     case 0: //single file
       if (outFileList[thisFileIndex].fileIndex == 0)
-        strcpy(wsTxBuffer, "{\"Cmd\":\"CfgData\", \"ResetData\":true, ");
+        msgStr = "{\"Cmd\":\"CfgData\", \"ResetData\":true, ";
       else
-        strcpy(wsTxBuffer, "{\"Cmd\":\"CfgData\", \"ResetData\":false, ");
-      retStr = strlen(wsTxBuffer);
-      retStr = createCfgEntryByName(&outFileList[thisFileIndex].fileName[0], &outFileList[thisFileIndex].cmdType[0], &wsTxBuffer[strlen(wsTxBuffer)]);
+        msgStr = "{\"Cmd\":\"CfgData\", \"ResetData\":false, ";
+      msgStr += createCfgEntryByName(&outFileList[thisFileIndex].cmdType[0]);
+      fileName = configDir + "/" + String(outFileList[thisFileIndex].fileName);
       break;
     case 1: //multi file adding
-      strcpy(wsTxBuffer, "{\"Cmd\":\"CfgFiles\", \"FileMode\":1, \"FileNameType\":\"");
-      strcat(wsTxBuffer, outFileList[thisFileIndex].fileNameType);
-      strcat(wsTxBuffer, "\", \"FileName\":\"");
-      strcat(wsTxBuffer, outFileList[thisFileIndex].fileName);
-      strcat(wsTxBuffer, "\",");
-      retStr = strlen(wsTxBuffer);
-      retStr = createCfgEntryByName(&outFileList[thisFileIndex].fileName[0], &outFileList[thisFileIndex].cmdType[0], &wsTxBuffer[strlen(wsTxBuffer)]);
+      msgStr = "{\"Cmd\":\"CfgFiles\", \"FileMode\":1, \"FileNameType\":\"" + String(outFileList[thisFileIndex].fileNameType);
+      msgStr += "\", \"FileName\":\"" + String(outFileList[thisFileIndex].fileName) + "\",";
+      msgStr += createCfgEntryByName(&outFileList[thisFileIndex].cmdType[0]);
+      fileName = configDir + "/" + String(outFileList[thisFileIndex].fileName);
       break;
     case 2: //start new multifile
-      strcpy(wsTxBuffer, "{\"Cmd\":\"CfgFiles\", \"FileMode\":2");
+      msgStr = "{\"Cmd\":\"CfgFiles\", \"FileMode\":2";
       break;
     case 3: //write multifile to disk
-      strcpy(wsTxBuffer, "{\"Cmd\":\"CfgFiles\", \"FileMode\":3");
+      msgStr = "{\"Cmd\":\"CfgFiles\", \"FileMode\":3";
       break;
   }
-  strcat(wsTxBuffer, "}");
-//  Serial.println(wsTxBuffer);
-  if (globalClient != NULL)
-    globalClient->text(wsTxBuffer);
+  //the message buffer is allocated with the size of the file and handed over to the web socket, which frees it when sent
+  int fileSize = fileName.length() > 0 ? getFileSize(fileName) : 0;
+  if (fileSize < 0)
+    fileSize = 0;
+  uint32_t msgLen = msgStr.length() + fileSize + 1;
+  AsyncWebSocketMessageBuffer * msgBuffer = ws->makeBuffer(msgLen);
+  if ((msgBuffer == NULL) || (msgBuffer->get() == NULL))
+  {
+    Serial.printf("No memory to send %s\n", &fileName[0]);
+    return;
+  }
+  msgBuffer->lock(); //not freed by the web socket until queued
+  char * msgPtr = (char*) msgBuffer->get();
+  memcpy(msgPtr, msgStr.c_str(), msgStr.length());
+  uint32_t bytesRead = fileSize > 0 ? readFileToBuffer(fileName, &msgPtr[msgStr.length()], fileSize + 1) : 0;
+  memset(&msgPtr[msgStr.length() + bytesRead], ' ', fileSize - bytesRead); //file got shorter, fill with white space
+  msgPtr[msgLen - 1] = '}';
+  globalClient->text(msgBuffer);
+  msgBuffer->unlock();
 }
 
-uint32_t createCfgEntryByName(String fileName, String cmdType, char * toBuffer)
+String createCfgEntryByName(String cmdType)
 {
-  strcat(toBuffer, "\"Type\":\"");
-  strcat(toBuffer, cmdType.c_str());
-  strcat(toBuffer, "\",\"Data\":");
-  uint32_t retStr = readFileToBuffer(configDir + "/" + fileName, &wsTxBuffer[strlen(wsTxBuffer)], wsBufferSize - strlen(wsTxBuffer));
+  return "\"Type\":\"" + cmdType + "\",\"Data\":";
 }
 
 /*
@@ -339,230 +484,323 @@ void freeObjects() //free up RAM as ESP will restart at end of updating anyway
   }
 }
 
+//messages up to wsRxBufferSize are collected in wsRxBuffer, larger ones are written to wsRxFileName while they come in
+void startWsRxMessage()
+{
+  if (wsRxToFile) //previous message was not completed
+  {
+    wsRxFile.close();
+    SPIFFS.remove(wsRxFileName);
+  }
+  wsRxToFile = false;
+  wsRxReadPtr = 0;
+  wsRxBuffer[0] = char(0);
+}
+
+void addWsRxData(uint8_t * data, size_t len)
+{
+  if (!wsRxToFile && ((wsRxReadPtr + len) >= wsRxBufferSize))
+  {
+    wsRxFile = SPIFFS.open(wsRxFileName, "w");
+    if (!wsRxFile)
+    {
+      Serial.println("Can't open web socket receive file");
+      return;
+    }
+    wsRxFile.write((uint8_t*)wsRxBuffer, wsRxReadPtr);
+    wsRxToFile = true;
+  }
+  if (wsRxToFile)
+    wsRxFile.write(data, len);
+  else
+  {
+    memcpy(&wsRxBuffer[wsRxReadPtr], data, len);
+    wsRxBuffer[wsRxReadPtr + len] = char(0);
+  }
+  wsRxReadPtr += len;
+}
+
+void endWsRxMessage(AsyncWebSocketClient * client)
+{
+  if (wsRxToFile)
+  {
+    wsRxFile.close();
+    wsRxToFile = false;
+    processWsFile(client);
+    SPIFFS.remove(wsRxFileName);
+  }
+  else
+    processWsMessage(wsRxBuffer, wsRxReadPtr, client);
+}
+
+void processWsFile(AsyncWebSocketClient * client) //message staged in wsRxFileName, parse everything except the config data
+{
+  StaticJsonDocument<512> filter;
+  const char * filterKeys[] = {"Cmd", "Type", "FileName", "FileNameType", "Index", "Restart", "LedNr", "ServoNr", "ServoPos", "ModuleNr", "Speed", "Stop", "SubCmd", "Val", "Addr", "TrackLen", "VMax", "Mode", "ProgMode", "CV", "CVVal", "Ops"};
+  for (uint8_t i = 0; i < (sizeof(filterKeys) / sizeof(filterKeys[0])); i++)
+    filter[filterKeys[i]] = true;
+  File msgFile = SPIFFS.open(wsRxFileName, "r");
+  if (!msgFile)
+    return;
+  DynamicJsonDocument doc(4096);
+  DeserializationError error = deserializeJson(doc, msgFile, DeserializationOption::Filter(filter));
+  msgFile.close();
+  if (!error)
+    processWsCommand(doc, client);
+  else
+    Serial.printf("processWsFile deserializeJson() wsProcessing failed: %s\n", error.c_str());
+}
+
 void processWsMessage(char * newMsg, int msgLen, AsyncWebSocketClient * client)
 {
 //  Serial.println(newMsg);
-//  Serial.println(String(ESP.getFreeHeap()));
   int docSize = 4096;
-//  Serial.println(String(ESP.getMaxAllocHeap()));
   DynamicJsonDocument doc(docSize);
-//  Serial.println(String(ESP.getFreeHeap()));
-  char duplMsg[strlen(newMsg) + 1];
-  strcpy(duplMsg, newMsg);
-//  Serial.println(String(ESP.getFreeHeap()));
-  DeserializationError error = deserializeJson(doc, duplMsg);//, msgLen);
-//  Serial.println(String(ESP.getFreeHeap()));
+  DeserializationError error = deserializeJson(doc, newMsg, msgLen); //parse in place, wsRxBuffer is not used until the command is processed
   if (!error)
+    processWsCommand(doc, client);
+  else
+    Serial.printf("processWsMessage deserializeJson() wsProcessing failed: %s\n", error.c_str());
+//  yield();
+}
+
+void processWsCommand(DynamicJsonDocument &doc, AsyncWebSocketClient * client)
+{
+  if (doc.containsKey("Cmd"))
   {
-    if (doc.containsKey("Cmd"))
-    {
-      String thisCmd = doc["Cmd"];
+    String thisCmd = doc["Cmd"];
 //      Serial.println(thisCmd);
-      if (thisCmd == "SetLED") //Request to switch on LED for identification purposes
+    if (thisCmd == "SetLED") //Request to switch on LED for identification purposes
+    {
+      JsonArray ledList = doc["LedNr"];
+      for (int i = 0; i < ledList.size(); i++)
       {
-        JsonArray ledList = doc["LedNr"];
-        for (int i = 0; i < ledList.size(); i++)
-        {
 //          Serial.printf("Setting Test LED %i\n", (uint16_t)ledList[i]);
-          if (myChain) myChain->identifyLED(ledList[i]);
-          if (mySwitchList) mySwitchList->identifyLED(ledList[i]);
-        }
+        if (myChain) myChain->identifyLED(ledList[i]);
+        if (mySwitchList) mySwitchList->identifyLED(ledList[i]);
       }
-      if (thisCmd == "SetServo") //Request to move Servo for position verification purposes
+    }
+    if (thisCmd == "SetServo") //Request to move Servo for position verification purposes
+    {
+      JsonArray servoList = doc["ServoNr"];
+      for (int i = 0; i < servoList.size(); i++)
       {
-        JsonArray servoList = doc["ServoNr"];
-        for (int i = 0; i < servoList.size(); i++)
-        {
 //          Serial.printf("Setting Test LED %i\n", (uint16_t)ledList[i]);
-          if (mySwitchList) mySwitchList->moveServo(servoList[i], doc["ServoPos"]);
-        }
+        if (mySwitchList) mySwitchList->moveServo(servoList[i], doc["ServoPos"]);
       }
-      if (thisCmd == "CfgFiles") //Config Request Format: {"Cmd":"CfgFiles", "Type":"pgxxxxCfg"}
+    }
+    if (thisCmd == "CfgFiles") //Config Request Format: {"Cmd":"CfgFiles", "Type":"pgxxxxCfg"}
+    {
+      keepAlive = millis() + keepAliveInterval;
+      uint16_t fileSelector = 0xFFFF;
+      if (doc.containsKey("Type"))
+        fileSelector = doc["Type"];
+      addFileToTx("", 0, "pgStartFile", 2); //reset file list
+      if (fileSelector & 0x0001)  
+        addFileToTx("node", 0, "pgNodeCfg", 1); //add file
+      if (fileSelector & 0x0002)  
+        addFileToTx("mqtt", 0, "pgMQTTCfg", 1); //add file
+      if (fileSelector & 0x0004)  
+        addFileToTx("usb", 0, "pgUSBCfg", 1);
+      if (fileSelector & 0x0010)  
+        addFileToTx("btn", 0, "pgHWBtnCfg", 1);
+      if (fileSelector & 0x0100)  
+        addFileToTx("btn", 0, "pgThrottleCfg", 1);
+      int fileCtr = 0;
+      if (fileSelector & 0x0200)  
       {
-        keepAlive = millis() + keepAliveInterval;
-        uint16_t fileSelector = 0xFFFF;
-        if (doc.containsKey("Type"))
-          fileSelector = doc["Type"];
-        addFileToTx("", 0, "pgStartFile", 2); //reset file list
-        if (fileSelector & 0x0001)  
-          addFileToTx("node", 0, "pgNodeCfg", 1); //add file
-        if (fileSelector & 0x0002)  
-          addFileToTx("mqtt", 0, "pgMQTTCfg", 1); //add file
-        if (fileSelector & 0x0004)  
-          addFileToTx("usb", 0, "pgUSBCfg", 1);
-        if (fileSelector & 0x0010)  
-          addFileToTx("btn", 0, "pgHWBtnCfg", 1);
-        if (fileSelector & 0x0100)  
-          addFileToTx("btn", 0, "pgThrottleCfg", 1);
-        int fileCtr = 0;
-        if (fileSelector & 0x0200)  
+        if (addFileToTx("greenhat", 0, "pgGreenHatCfg", 1))
         {
-          if (addFileToTx("greenhat", 0, "pgGreenHatCfg", 1))
-          {
-            uint8_t modNr = 0;
-            if (doc.containsKey("ModuleNr"))
-              modNr = doc["ModuleNr"];
-            String fileNameStr = "gh/" + String(modNr);
+          uint8_t modNr = 0;
+          if (doc.containsKey("ModuleNr"))
+            modNr = doc["ModuleNr"];
+          String fileNameStr = "gh/" + String(modNr);
 //            addFileToTx(fileNameStr + "/switches", 0, "pgSwitchCfg", 1);
 //            addFileToTx(fileNameStr + "/btn", 0, "pgHWBtnCfg", 1);
 
-            fileCtr = 0;
-            while (addFileToTx(fileNameStr + "/switches", fileCtr, "pgSwitchCfg", 1))
-              fileCtr++;
-            fileCtr = 0;
-            while (addFileToTx(fileNameStr + "/btn", fileCtr, "pgHWBtnCfg", 1))
-              fileCtr++;
-            fileCtr = 0;
-            while (addFileToTx(fileNameStr + "/btnevt", fileCtr, "pgBtnHdlrCfg", 1))
-              fileCtr++;
+          fileCtr = 0;
+          while (addFileToTx(fileNameStr + "/switches", fileCtr, "pgSwitchCfg", 1))
+            fileCtr++;
+          fileCtr = 0;
+          while (addFileToTx(fileNameStr + "/btn", fileCtr, "pgHWBtnCfg", 1))
+            fileCtr++;
+          fileCtr = 0;
+          while (addFileToTx(fileNameStr + "/btnevt", fileCtr, "pgBtnHdlrCfg", 1))
+            fileCtr++;
 //            addFileToTx(fileNameStr + "/btnevt", 0, "pgBtnHdlrCfg", 1);
 
-            fileCtr = 0;
-            while (addFileToTx(fileNameStr + "/led", fileCtr, "pgLEDCfg", 1))
-              fileCtr++;
+          fileCtr = 0;
+          while (addFileToTx(fileNameStr + "/led", fileCtr, "pgLEDCfg", 1))
+            fileCtr++;
 //            addFileToTx(fileNameStr + "/led", 0, "pgLEDCfg", 1);
-          }
         }
-        if (fileSelector & 0x0400)  
-          addFileToTx("lbserver", 0, "pgLBSCfg", 1);
-        if (fileSelector & 0x0800)  
-          addFileToTx("vwcfg", 0, "pgVoiceWCfg", 1);
-        if (fileSelector & 0x1000)  
-          addFileToTx("rhcfg", 0, "pgRedHatCfg", 1);
-        if (fileSelector & 0x2000)  
-          addFileToTx("rhcfg", 0, "pgPrplHatCfg", 1);
-        if (fileSelector & 0x4000)  
-          addFileToTx("wiclient", 0, "pgWiCfg", 1);
-        fileCtr = 0;
-        if (fileSelector & 0x0020)  
-          while (addFileToTx("led", fileCtr, "pgLEDCfg", 1))
-            fileCtr++;
-        fileCtr = 0;
-        if (fileSelector & 0x0040)  
-          while (addFileToTx("btnevt", fileCtr, "pgBtnHdlrCfg", 1))
-            fileCtr++;
-        fileCtr = 0;
-        if (fileSelector & 0x0080)  
-          while (addFileToTx("secel", fileCtr, "pgSecElCfg", 1))
-            fileCtr++;
-        addFileToTx("", 0, "pgWriteFile", 3); //Write file to disk
       }
+      if (fileSelector & 0x0400)  
+        addFileToTx("lbserver", 0, "pgLBSCfg", 1);
+      if (fileSelector & 0x0800)  
+        addFileToTx("vwcfg", 0, "pgVoiceWCfg", 1);
+      if (fileSelector & 0x1000)  
+        addFileToTx("rhcfg", 0, "pgRedHatCfg", 1);
+      if (fileSelector & 0x2000)  
+        addFileToTx("rhcfg", 0, "pgPrplHatCfg", 1);
+      if (fileSelector & 0x4000)  
+        addFileToTx("wiclient", 0, "pgWiCfg", 1);
+      fileCtr = 0;
+      if (fileSelector & 0x0020)  
+        while (addFileToTx("led", fileCtr, "pgLEDCfg", 1))
+          fileCtr++;
+      fileCtr = 0;
+      if (fileSelector & 0x0040)  
+        while (addFileToTx("btnevt", fileCtr, "pgBtnHdlrCfg", 1))
+          fileCtr++;
+      fileCtr = 0;
+      if (fileSelector & 0x0080)  
+        while (addFileToTx("secel", fileCtr, "pgSecElCfg", 1))
+          fileCtr++;
+      addFileToTx("", 0, "pgWriteFile", 3); //Write file to disk
+    }
 
-      if (thisCmd == "ReqStats") //Request Technical data
-        keepAlive = millis();      
+    if (thisCmd == "LNReplay") //Replay LocoNet recorder Format: {"Cmd":"LNReplay", "Speed":1.0}, Speed 0 is as fast as possible, {"Cmd":"LNReplay", "Stop":true} to end
+    {
+      if (doc.containsKey("Stop"))
+        stopLNReplay();
+      else
+        requestLNReplay(doc.containsKey("Speed") ? (float)doc["Speed"] : 1.0);
+    }
 
-      if (thisCmd == "CfgData") //Config Request Format: {"Cmd":"CfgData", "Type":"pgxxxxCfg", "FileName":"name"}
-      {
-        String cmdType = doc["Type"];
-        if (cmdType == "pgLNViewer")
-          return;
-        if (cmdType == "pgDCCViewer")
-          return;
-        if (cmdType == "pgOLCBViewer")
-          return;
+    if (thisCmd == "ReqStats") //Request Technical data
+      keepAlive = millis();      
 
-        String fileName = doc["FileName"];
-        int fileCtr = 0;
-        while (addFileToTx(fileName, fileCtr, cmdType, 0))
-          fileCtr++;
-      }
-      if (thisCmd == "CfgUpdate") //Config Request Format: {"Cmd":"CfgData", "Type":"pgxxxxCfg", "FileType":"xxxx", "FileName":"nnnnx.cfg", "Data":{}}
+    if (thisCmd == "CfgData") //Config Request Format: {"Cmd":"CfgData", "Type":"pgxxxxCfg", "FileName":"name"}
+    {
+      String cmdType = doc["Type"];
+      if (cmdType == "pgLNViewer")
+        return;
+      if (cmdType == "pgDCCViewer")
+        return;
+      if (cmdType == "pgOLCBViewer")
+        return;
+
+      String fileName = doc["FileName"];
+      int fileCtr = 0;
+      while (addFileToTx(fileName, fileCtr, cmdType, 0))
+        fileCtr++;
+    }
+    if (thisCmd == "CfgUpdate") //Config Request Format: {"Cmd":"CfgData", "Type":"pgxxxxCfg", "FileType":"xxxx", "FileName":"nnnnx.cfg", "Data":{}}
+    {
+      execLoop = false;
+      const char *  cmdType = doc["Type"];
+      const char * fileStr = doc["Data"];
+      const char *  fileName = doc["FileName"];
+      const char *  fileNameType = doc["FileNameType"];
+      int fileIndex = doc["Index"];
+      if (strcmp(cmdType, "pgDelete") == 0)
       {
-        execLoop = false;
-        const char *  cmdType = doc["Type"];
-        const char * fileStr = doc["Data"];
-        const char *  fileName = doc["FileName"];
-        const char *  fileNameType = doc["FileNameType"];
-        int fileIndex = doc["Index"];
-        if (strcmp(cmdType, "pgDelete") == 0)
-        {
-          deleteAllFiles(fileNameType, configDir, configExt, false);
-          freeObjects();
-          sendCTS();
-          return;
-        }
+        deleteAllFiles(fileNameType, configDir, configExt, false);
+        freeObjects();
+        sendCTS();
+        return;
+      }
+      if (fileStr)
         writeJSONFile(configDir + "/" + fileName, fileStr);
-        if (!doc.containsKey("Restart")) //if old format (before multi file), then restart
+      else
+        writeJSONStringToFile(wsRxFileName, "Data", configDir + "/" + fileName); //large upload, copy from the staged message
+      if (!doc.containsKey("Restart")) //if old format (before multi file), then restart
+      {
+        prepareShutDown();
+        delay(500);
+        Serial.println("Restart ESP");
+        sendCTS();
+        delay(100);
+        ESP.restart(); //configuration update requires restart to be sure dynamic allocation of objects is not messed up
+      }
+      else
+        if (doc["Restart"])
         {
           prepareShutDown();
           delay(500);
-          Serial.println("Restart ESP");
+          Serial.println("Reboot ESP");
           sendCTS();
           delay(100);
           ESP.restart(); //configuration update requires restart to be sure dynamic allocation of objects is not messed up
         }
-        else
-          if (doc["Restart"])
-          {
-            prepareShutDown();
-            delay(500);
-            Serial.println("Reboot ESP");
-            sendCTS();
-            delay(100);
-            ESP.restart(); //configuration update requires restart to be sure dynamic allocation of objects is not messed up
-          }
 //          else
 //            Serial.println("No Reboot needed");
-        sendCTS();
-      }
-      if (thisCmd == "SetSensor")  
-      {
+      sendCTS();
+    }
+    if (thisCmd == "SetSensor")  
+    {
 //        Serial.println(thisCmd);
-        if (doc.containsKey("SubCmd"))
-        {
-          String subCmd = doc["SubCmd"];
-          if (subCmd == "ClearDist")
-            if (trainSensor) 
-              trainSensor->resetDistance();
-          if (subCmd == "ClearHeading")
-            if (trainSensor) 
-              trainSensor->resetHeading();
-          if (subCmd == "RepRate")
-            if (trainSensor) 
-            {
-              uint16_t repRate = doc["Val"];
-              trainSensor->setRepRate(globalClient, repRate);
-            }
-          if (subCmd == "SetDCC")
-            if (trainSensor)
-            {
-              int16_t dccAddr = doc["Addr"];
-              Serial.println(dccAddr);
-              trainSensor->reqDCCAddrWatch(globalClient, dccAddr, useInterface.devId == 17);
-            }
-          if (subCmd == "RunTest")
-            if (trainSensor)
-            {
-              float tLen = doc["TrackLen"];
-              float vMax = doc["VMax"];
-              uint8_t pMode = doc["Mode"];
-              trainSensor->startTest(tLen, vMax, pMode);
-            }
-          if (subCmd == "ReadCV")
+      if (doc.containsKey("SubCmd"))
+      {
+        String subCmd = doc["SubCmd"];
+        if (subCmd == "ClearDist")
+          if (trainSensor) 
+            trainSensor->resetDistance();
+        if (subCmd == "ClearHeading")
+          if (trainSensor) 
+            trainSensor->resetHeading();
+        if (subCmd == "RepRate")
+          if (trainSensor) 
+          {
+            uint16_t repRate = doc["Val"];
+            trainSensor->setRepRate(globalClient, repRate);
+          }
+        if (subCmd == "SetDCC")
+          if (trainSensor)
           {
-            uint16_t dccAddr = doc["Addr"]; 
-            uint8_t progMode = doc["ProgMode"];
-            uint8_t cvNr = doc["CV"];
-            digitraxBuffer->readProg(dccAddr, progMode, cvNr);
+            int16_t dccAddr = doc["Addr"];
+            Serial.println(dccAddr);
+            trainSensor->reqDCCAddrWatch(globalClient, dccAddr, useInterface.devId == 17);
           }
-          if (subCmd == "WriteCV")
+        if (subCmd == "RunTest")
+          if (trainSensor)
           {
-            uint16_t dccAddr = doc["Addr"]; 
-            uint8_t progMode = doc["ProgMode"];
-            uint8_t cvNr = doc["CV"];
-            uint8_t cvVal = doc["CVVal"];
-            digitraxBuffer->writeProg(dccAddr, progMode, cvNr, cvVal);
+            float tLen = doc["TrackLen"];
+            float vMax = doc["VMax"];
+            uint8_t pMode = doc["Mode"];
+            trainSensor->startTest(tLen, vMax, pMode);
+          }
+        if (subCmd == "ReadCV")
+        {
+          uint16_t dccAddr = doc["Addr"]; 
+          uint8_t progMode = doc["ProgMode"];
+          uint16_t cvNr = doc["CV"];
+          digitraxBuffer->addProgJob(0, dccAddr, progMode, cvNr);
+        }
+        if (subCmd == "WriteCV")
+        {
+          uint16_t dccAddr = doc["Addr"]; 
+          uint8_t progMode = doc["ProgMode"];
+          uint16_t cvNr = doc["CV"];
+          uint8_t cvVal = doc["CVVal"];
+          digitraxBuffer->addProgJob(1, dccAddr, progMode, cvNr, cvVal);
+        }
+        if (subCmd == "ProgBatch") //Ops: [{"Op":0 read, 1 write, 2 verify, "CV":cvNr, "CVVal":cvVal}], executed in this order
+        {
+          uint16_t dccAddr = doc["Addr"]; 
+          uint8_t progMode = doc["ProgMode"];
+          JsonArray progOps = doc["Ops"];
+          for (JsonObject thisOp : progOps)
+          {
+            uint8_t opType = thisOp["Op"];
+            uint16_t cvNr = thisOp["CV"];
+            uint8_t cvVal = thisOp["CVVal"];
+            if (!digitraxBuffer->addProgJob(opType, dccAddr, progMode, cvNr, cvVal))
+            {
+              Serial.println("Programming queue full");
+              break;
+            }
           }
-          if (subCmd == "StopTest")
-            if (trainSensor)
-              trainSensor->stopTest();
         }
+        if (subCmd == "ProgAbort")
+          digitraxBuffer->clearProgQueue();
+        if (subCmd == "StopTest")
+          if (trainSensor)
+            trainSensor->stopTest();
       }
     }
-  } 
-  else
-    Serial.printf("processWsMessage deserializeJson() wsProcessing failed: %s\n", error.c_str());
-//  yield();
+  }
 }
 
 void onWsEvent(AsyncWebSocket * server, AsyncWebSocketClient * client, AwsEventType type, void * arg, uint8_t *data, size_t len)
@@ -591,16 +829,11 @@ void onWsEvent(AsyncWebSocket * server, AsyncWebSocketClient * client, AwsEventT
         if (info->final && info->index == 0 && info->len == len)
         {
           //the whole message is in a single frame and we got all of it's data
-          wsRxReadPtr = 0;
           if (info->opcode == WS_TEXT)
           {
-            for (size_t i = 0; i < info->len; i++)
-            {
-              wsRxBuffer[wsRxReadPtr] = (char) data[i];
-              wsRxReadPtr++;
-            }
-            wsRxBuffer[wsRxReadPtr] = char(0);
-            processWsMessage(wsRxBuffer, wsRxReadPtr, client);
+            startWsRxMessage();
+            addWsRxData(data, len);
+            endWsRxMessage(client);
           }
           else
           {
@@ -613,9 +846,9 @@ void onWsEvent(AsyncWebSocket * server, AsyncWebSocketClient * client, AwsEventT
         else
         {
           //message is comprised of multiple frames or the frame is split into multiple packets
-          if (info->index == 0)
+          if ((info->index == 0) && (info->num == 0))
           {
-            wsRxReadPtr = 0;
+            startWsRxMessage();
 //            Serial.println("Reset Read Ptr");
             //          if(info->num == 0)
             //            Serial.printf("ws[%s][%u] %s-message start\n", server->url(), client->id(), (info->message_opcode == WS_TEXT)?"text":"binary");
@@ -624,21 +857,15 @@ void onWsEvent(AsyncWebSocket * server, AsyncWebSocketClient * client, AwsEventT
 
 //          Serial.printf("ws[%s][%u] frame[%u] %s[%llu - %llu]: \n", server->url(), client->id(), info->num, (info->message_opcode == WS_TEXT) ? "text" : "binary", info->index, info->index + len);
 
-          if (info->opcode == WS_TEXT)
+          if (info->message_opcode == WS_TEXT)
           {
 //            Serial.println("adding...");
-            for (size_t i = 0; i < len; i++)
-            {
-              wsRxBuffer[wsRxReadPtr] = (char) data[i];
-              wsRxReadPtr++;
-            }
-            wsRxBuffer[wsRxReadPtr] = char(0);
+            addWsRxData(data, len);
           }
           else
           {
             //no processing of non-text data at this time
           }
-          wsRxBuffer[wsRxReadPtr] = char(0);
 //          Serial.println(wsRxReadPtr);
           if ((info->index + len) == info->len)
           {
@@ -648,7 +875,7 @@ void onWsEvent(AsyncWebSocket * server, AsyncWebSocketClient * client, AwsEventT
               {
 //                Serial.println("Processing");
 //                Serial.println(&wsRxBuffer[0]);                
-                processWsMessage(wsRxBuffer, wsRxReadPtr, client);
+                endWsRxMessage(client);
               }
 //              else
 //                Serial.println("Type mismatch");
@@ -453,6 +453,7 @@ function writeDiskFile(newBlob, fileName)
 function startWebsockets()
 {
 	ws = new WebSocket(serverIP);
+	ws.binaryType = "arraybuffer";
 	  
     ws.onopen = function() 
     {
@@ -479,6 +480,12 @@ function startWebsockets()
     {
 //		console.log(evt.data);
 //		console.log(currentPage);
+		if (evt.data instanceof ArrayBuffer) //sample batches from the PurpleHat sensor
+		{
+			if (scriptList.Pages[currentPage].ID == "pgPrplHatCfg")
+				processSensorBatch(evt.data);
+			return;
+		}
   		var myArr = JSON.parse(evt.data);
   		if (myArr.Cmd == "CTS")
 			setCTS();
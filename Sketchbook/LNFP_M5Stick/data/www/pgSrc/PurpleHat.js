@@ -46,6 +46,7 @@ var ScalingFactor = [dispSize[0]/(dispBoundaries[1] - dispBoundaries[0]), dispSi
 
 var	locoAddr = -1;
 var locoAddrValid = false;
+var sensorBatchActive = false; //binary sample frames are coming in, these feed the speed graphs
 
 jsonFileVersion = "1.0.0";
 
@@ -237,6 +238,7 @@ function constructPageContent(contentTab)
 					createTextInput(tempObj, "tile-1_4", "CV Value:", "", "cvval", "setCV(this)");
 					createButton(tempObj, "", "Read CV", "btnReadCV", "readCV(this)");
 					createButton(tempObj, "", "Write CV", "btnWriteCV", "writeCV(this)");
+					createButton(tempObj, "", "Abort", "btnAbortProg", "abortProg(this)");
 				setVisibility(false, tabProgrammer);
 				setVisibility(true, cvTableNative);
 				setVisibility(false, cvTableJMRI);
@@ -624,7 +626,7 @@ function readCV(sender)
 	if (progMode == 0)
 		if (confirm("Place locomotive on programming track and click OK") == false)
 			return;
-	if ((cvId >= 0) && (cvId <= 255))
+	if ((cvId > 0) && (cvId <= 1024))
 	{
 		ws.send("{\"Cmd\":\"SetSensor\", \"SubCmd\":\"ReadCV\", \"Addr\":" + locoAddr.toString() + ",\"ProgMode\":" + progMode.toString() + ",\"CV\":" + cvId.toString() + "}");
 		writeTextField("progstat", "Read CV in progress");
@@ -643,7 +645,7 @@ function writeCV(sender)
 	if (progMode == 0)
 		if (confirm("Place locomotive on programming track and click OK") == false)
 			return;
-	if ((cvId >= 0) && (cvVal >= 0) && (cvId <= 255) && (cvVal <= 255))
+	if ((cvId > 0) && (cvVal >= 0) && (cvId <= 1024) && (cvVal <= 255))
 	{
 		ws.send("{\"Cmd\":\"SetSensor\", \"SubCmd\":\"WriteCV\",\"Addr\":" + locoAddr.toString() + ", \"ProgMode\":" + progMode.toString() + ",\"CV\":" + cvId.toString() + ",\"CVVal\":" + cvVal.toString() + "}");
 		writeTextField("progstat", "Write CV in progress");
@@ -657,6 +659,7 @@ function startMeasuring(sender)
 	if (sender.innerHTML == "Start")
 	{
 		clearAllGraphData();
+		sensorBatchActive = false;
 		ws.send("{\"Cmd\":\"SetSensor\", \"SubCmd\":\"RepRate\",\"Val\":500}");
 		document.getElementById("btnStart").innerHTML = "Stop";
 		document.getElementById("btnStartLow").innerHTML = "Stop";
@@ -957,25 +960,27 @@ function initProg()
 	for (var i = 0; i < 28; i++)
 		addCV(i+67, speedTableProfileGraph.LineGraphs[0].DataElements[i].y);
 	addCV(29, findCVVal(locoDef, 29) | 0x10); //set table use
-	//write first CV 
-	cvId = cvArray[0].x;
-	cvVal = cvArray[0].y;
-	writeCV(null);
-	setTimeout(function(){progCVArray() }, 1000);
+	progCVArray(1);
 }
 
-function progCVArray()
+function progCVArray(opType)
 {
-	//write rest of array 
-	cvArray.splice(0,1); //remove first element
-	if (cvArray.length > 0)
+	//send the whole array as one batch, the programmer queue runs the jobs back to back and reports each result
+	var cmdStr = "{\"Cmd\":\"SetSensor\", \"SubCmd\":\"ProgBatch\",\"Addr\":" + locoAddr.toString() + ", \"ProgMode\":" + progMode.toString() + ",\"Ops\":[";
+	for (var i = 0; i < cvArray.length; i++)
 	{
-		cvId = cvArray[0].x;
-		cvVal = cvArray[0].y;
-		writeCV(null);
-//		console.log("write ", cvId, cvVal);
-		setTimeout(function(){progCVArray() }, 500);
+		if (i > 0)
+			cmdStr += ",";
+		cmdStr += "{\"Op\":" + opType.toString() + ",\"CV\":" + cvArray[i].x.toString() + ",\"CVVal\":" + Math.round(cvArray[i].y).toString() + "}";
 	}
+	cmdStr += "]}";
+	ws.send(cmdStr);
+	writeTextField("progstat", "Write " + cvArray.length.toString() + " CVs in progress");
+}
+
+function abortProg(sender)
+{
+	ws.send("{\"Cmd\":\"SetSensor\", \"SubCmd\":\"ProgAbort\"}");
 }
 
 function calcTable(sender)
@@ -1038,10 +1043,13 @@ function calcTable(sender)
 
 function processProgrammerInput(jsonData)
 {
+	var pendingStr = "";
+	if (jsonData.Pending > 0)
+		pendingStr = " CV " + jsonData.CVNr.toString() + ", " + jsonData.Pending.toString() + " pending";
 	switch (jsonData.Status)
 	{
 		case 0:
-			writeTextField("progstat", "Success");
+			writeTextField("progstat", "Success" + pendingStr);
 			writeInputField("cvid", jsonData.CVNr);
 			writeInputField("cvval", jsonData.CVVal);
 			switch (jsonData.CVNr)
@@ -1065,12 +1073,12 @@ function processProgrammerInput(jsonData)
 			}
 			break;
 		default:
-			var msgStr;
+			var msgStr = "";
 			if (jsonData.Status & 0x01)	msgStr += "Prog track empty. ";
 			if (jsonData.Status & 0x02)	msgStr += "No Ack. ";
 			if (jsonData.Status & 0x04)	msgStr += "Value not found. ";
 			if (jsonData.Status & 0x08)	msgStr += "User aborted.";
-			writeTextField("progstat", msgStr);
+			writeTextField("progstat", msgStr + pendingStr);
 			break;
 	}
 }
@@ -1095,6 +1103,33 @@ function processSpeedTableInput(jsonData)
 //	console.log(speedTableProfileGraph);
 }
 
+//binary frame: format, decimation, number of samples (2), millis() and micros() when sent, then the samples, all little endian
+//sample: micros() time stamp, rel. distance [mm], speed [mm/s], magnet angle [deg]
+function processSensorBatch(batchData)
+{
+	var dataView = new DataView(batchData);
+	if ((dataView.byteLength < 12) || (dataView.getUint8(0) != 1))
+		return;
+	var numSamples = dataView.getUint16(2, true);
+	var sendMillis = dataView.getUint32(4, true);
+	var sendMicros = dataView.getUint32(8, true);
+	var currScale = configData[workCfg].ScaleList[configData[workCfg].ScaleIndex].Scale;
+	for (var i = 0; i < numSamples; i++)
+	{
+		var recPos = 12 + (16 * i);
+		if ((recPos + 16) > dataView.byteLength)
+			break;
+		var sampleTS = sendMillis - (((sendMicros - dataView.getUint32(recPos, true)) >>> 0) / 1000); //same time base as SensorData TS
+		var sampleSpeed = dataView.getFloat32(recPos + 8, true);
+		var scaleSpeed = (sampleSpeed  * 36 * currScale) / 10000; //[km/h]
+		if (configData[workCfg].Units == 1) //imperial
+			scaleSpeed /= 1.6;
+		addEntryToArray(lineGraphTechSpeed, sampleTS, sampleSpeed, speedGraph.MaxXRange * 1000);
+		addEntryToArray(lineGraphScaleSpeed, sampleTS, scaleSpeed, speedGraph.MaxXRange * 1000);
+	}
+	sensorBatchActive = true;
+}
+
 function processSensorInput(jsonData)
 {
 //	console.log(jsonData);
@@ -1131,9 +1166,11 @@ function processSensorInput(jsonData)
 		addEntryToArray(lineGraphElevation, jsonData.TS , ((180 * jsonData.EulerVect[1]) / 3.1415), speedGraph.MaxXRange * 1000);
 		addEntryToArray(lineGraphRadius, jsonData.TS , radiusSig * radiusValGraph, speedGraph.MaxXRange * 1000, radiusValGraph == 0);
 	}
-	addEntryToArray(lineGraphTechSpeed, jsonData.TS , jsonData.Speed, speedGraph.MaxXRange * 1000);
-
-	addEntryToArray(lineGraphScaleSpeed, jsonData.TS , scaleSpeed, speedGraph.MaxXRange * 1000);
+	if (!sensorBatchActive)
+	{
+		addEntryToArray(lineGraphTechSpeed, jsonData.TS , jsonData.Speed, speedGraph.MaxXRange * 1000);
+		addEntryToArray(lineGraphScaleSpeed, jsonData.TS , scaleSpeed, speedGraph.MaxXRange * 1000);
+	}
 	
 	if (jsonData.DCCAddr != undefined)
 	{
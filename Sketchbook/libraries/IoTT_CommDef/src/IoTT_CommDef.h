@@ -69,6 +69,9 @@ typedef uint16_t (*txFct) (lnTransmitMsg);
 typedef void (*cbFct) (lnReceiveBuffer *);
 typedef void (*mqttFct) (char*, byte*, unsigned int);
 typedef void (*mqttTxFct) (byte, char*, char*); //mode (0:send, 1:subscribe), topic, payload
+typedef int16_t (*stateSrcFct) (char*, uint8_t*, bool); //sub topic, payload, previous message sent. Returns payload length of the next retained state message, -1 if none
+
+#define stateMaxPayload 272 //state messages, fits the MQTT buffer of 512 bytes with the topic
 
 void setXORByte(uint8_t * msgData);
 bool getXORCheck(uint8_t * msgData, uint8_t targetLen = 0);
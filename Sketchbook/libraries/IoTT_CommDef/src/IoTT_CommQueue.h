@@ -0,0 +1,60 @@
+#ifndef IoTT_CommQueue_h
+#define IoTT_CommQueue_h
+
+#include <arduino.h>
+#include <inttypes.h>
+
+//Lock free ring buffer to pass messages between two FreeRTOS tasks, e.g. lnReceiveBuffer from an I/O task to the application task
+//One task may write and one task may read at the same time. If more than one task writes, the writers must be serialized by the caller
+//One entry is kept free to distinguish full from empty, so queueSize - 1 entries can be stored
+
+template <typename T, uint16_t queueSize> class IoTT_CommQueue
+{
+	public:
+		bool push(const T &newEntry) //returns false if the queue is full
+		{
+			uint16_t writePtr = __atomic_load_n(&headPtr, __ATOMIC_RELAXED);
+			uint16_t nextPtr = (writePtr + 1) % queueSize;
+			if (nextPtr == __atomic_load_n(&tailPtr, __ATOMIC_ACQUIRE))
+			{
+				overflowCtr++;
+				return false;
+			}
+			queueBuffer[writePtr] = newEntry;
+			__atomic_store_n(&headPtr, nextPtr, __ATOMIC_RELEASE); //entry is visible to the reader after this
+			uint16_t fillLevel = getFillLevel();
+			if (fillLevel > maxFillLevel)
+				maxFillLevel = fillLevel;
+			return true;
+		}
+
+		bool pop(T &getEntry) //returns false if the queue is empty
+		{
+			uint16_t readPtr = __atomic_load_n(&tailPtr, __ATOMIC_RELAXED);
+			if (readPtr == __atomic_load_n(&headPtr, __ATOMIC_ACQUIRE))
+				return false;
+			getEntry = queueBuffer[readPtr];
+			__atomic_store_n(&tailPtr, (uint16_t)((readPtr + 1) % queueSize), __ATOMIC_RELEASE); //slot can be reused after this
+			return true;
+		}
+
+		bool isEmpty()
+		{
+			return __atomic_load_n(&tailPtr, __ATOMIC_ACQUIRE) == __atomic_load_n(&headPtr, __ATOMIC_ACQUIRE);
+		}
+
+		uint16_t getFillLevel()
+		{
+			return (__atomic_load_n(&headPtr, __ATOMIC_ACQUIRE) + queueSize - __atomic_load_n(&tailPtr, __ATOMIC_ACQUIRE)) % queueSize;
+		}
+
+		uint32_t overflowCtr = 0; //statistics, written by the writer only
+		uint16_t maxFillLevel = 0;
+
+	private:
+		T queueBuffer[queueSize];
+		uint16_t headPtr = 0; //next entry to write
+		uint16_t tailPtr = 0; //next entry to read
+};
+
+#endif
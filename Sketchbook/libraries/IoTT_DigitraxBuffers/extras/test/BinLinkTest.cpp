@@ -0,0 +1,268 @@
+//Host test of the binary link between the ESP32 (IoTT_SerInjector, framing in IoTT_BinFrame.h) and the RedHat (BinLink.cpp of
+//CommandStation-EX-Dev). Frames built with the ESP32 framing are fed byte by byte into BinLink, which runs against stand-ins of the DCC
+//calls, and the frames BinLink sends back are checked with the ESP32 framing. Covers COBS with zeros anywhere in the frame, the crc,
+//text between frames, repeated frames (executed once, acknowledged again) and the frame size limit of the replies.
+//
+//g++ -std=gnu++17 -O2 -DARDUINO_AVR_UNO -Istubs/redhat -I../../../../CommandStation-EX-Dev -I../../../IoTT_SerInjector/src BinLinkTest.cpp ../../../../CommandStation-EX-Dev/BinLink.cpp -o BinLinkTest && ./BinLinkTest
+
+#include <IoTT_BinFrame.h>
+#include "BinLink.h"
+#include "DCCEXParser.h"
+#include "DCC.h"
+#include "DCCWaveform.h"
+#include "StringFormatter.h"
+#include <chrono>
+#include <random>
+#include <string>
+#include <vector>
+
+#define numFuzzFrames 100000
+
+uint8_t PORTB = 0;
+unsigned long micros() { return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch()).count(); }
+unsigned long millis() { return micros() / 1000; }
+
+//stand-ins of the firmware, every call is logged as text
+std::vector<std::string> callLog;
+
+void logCall(const char * format, ...)
+{
+	char logLine[80];
+	va_list args;
+	va_start(args, format);
+	vsnprintf(logLine, sizeof(logLine), format, args);
+	va_end(args);
+	callLog.push_back(logLine);
+}
+
+void DCC::setThrottle(uint16_t cab, uint8_t tSpeed, bool tDirection) { logCall("speed %u %u %u", cab, tSpeed, tDirection); }
+void DCC::setFn(int cab, int16_t functionNumber, bool on) { logCall("fn %d %d %d", cab, functionNumber, on); }
+void DCC::setAccessory(int aAdd, byte aNum, bool activate) { logCall("acc %d %d %d", aAdd, aNum, activate); }
+void DCC::setProgTrackSyncMain(bool on) { logCall("sync %d", on); }
+void DCC::setProgTrackBoost(bool on) { logCall("boost %d", on); }
+void DCC::forgetLoco(int cab) { logCall("forget %d", cab); }
+void DCC::forgetAllLocos() { logCall("forget all"); }
+DCCWaveform::DCCWaveform(byte preambleBits, bool isMain) {}
+DCCWaveform DCCWaveform::mainTrack(PREAMBLE_BITS_MAIN, true);
+DCCWaveform DCCWaveform::progTrack(PREAMBLE_BITS_PROG, false);
+void DCCWaveform::setPowerMode(POWERMODE newMode) { logCall("power %s %d", this == &mainTrack ? "main" : "prog", (int)newMode); }
+void DCCWaveform::schedulePacket(const byte buffer[], byte byteCount, byte repeats)
+{
+	std::string logLine = "packet";
+	for (byte i = 0; i < byteCount; i++)
+		logLine += " " + std::to_string(buffer[i]);
+	callLog.push_back(logLine);
+}
+DCCEXParser::DCCEXParser() {}
+void DCCEXParser::parse(Print * stream, byte * command, RingStream * ringStream) { logCall("text <%s>", (char *)command); }
+void StringFormatter::send(Print * stream, const FSH * input...) {}
+
+class TestStream : public Print
+{
+	public:
+		size_t write(uint8_t c) { txData.push_back(c); return 1; }
+		std::vector<uint8_t> txData;
+};
+
+DCCEXParser testParser;
+TestStream testStream;
+uint32_t errorCtr = 0;
+
+void check(bool testResult, const char * testName)
+{
+	if (!testResult)
+	{
+		if (errorCtr < 20)
+			printf("failed: %s\n", testName);
+		errorCtr++;
+	}
+}
+
+//frame as the ESP32 sends it, returns the number of bytes BinLink did not take as frame data
+uint16_t sendFrame(uint8_t seqNr, const std::vector<uint8_t> &records, bool badCrc = false)
+{
+	uint8_t frameBuf[binMaxFrame];
+	uint8_t encBuf[binMaxEnc];
+	frameBuf[0] = seqNr;
+	memcpy(&frameBuf[1], records.data(), records.size());
+	uint8_t frameLen = records.size() + 1;
+	frameBuf[frameLen] = binCrc8(frameBuf, frameLen) ^ (badCrc ? 0x01 : 0x00);
+	uint8_t encLen = binCobsEncode(frameBuf, frameLen + 1, encBuf);
+	uint16_t textCtr = 0;
+	textCtr += BinLink::receive(&testParser, &testStream, 0) ? 0 : 1;
+	for (uint8_t i = 0; i < encLen; i++)
+		textCtr += BinLink::receive(&testParser, &testStream, encBuf[i]) ? 0 : 1;
+	textCtr += BinLink::receive(&testParser, &testStream, 0) ? 0 : 1;
+	return textCtr;
+}
+
+//splits what BinLink has sent into frames and checks them with the ESP32 framing, returns the records of all frames
+std::vector<std::vector<uint8_t>> receiveFrames()
+{
+	BinLink::flush();
+	std::vector<std::vector<uint8_t>> frameList;
+	std::vector<uint8_t> encData;
+	bool inFrame = false;
+	for (uint8_t thisByte : testStream.txData)
+		if (thisByte == 0)
+		{
+			if (inFrame && (encData.size() > 0))
+			{
+				check(encData.size() <= binMaxEnc, "reply frame size");
+				uint8_t frameBuf[256];
+				memcpy(frameBuf, encData.data(), encData.size());
+				uint8_t frameLen = binCobsDecode(frameBuf, encData.size());
+				check(frameLen >= 2, "reply frame decodes");
+				if (frameLen >= 2)
+				{
+					check(binCrc8(frameBuf, frameLen - 1) == frameBuf[frameLen - 1], "reply frame crc");
+					frameList.push_back(std::vector<uint8_t>(&frameBuf[0], &frameBuf[frameLen - 1]));
+				}
+				inFrame = false;
+			}
+			else
+				inFrame = true;
+			encData.clear();
+		}
+		else
+			encData.push_back(thisByte);
+	testStream.txData.clear();
+	return frameList;
+}
+
+//the ack records in the replies
+std::vector<uint8_t> getAcks()
+{
+	std::vector<uint8_t> ackList;
+	for (auto &thisFrame : receiveFrames())
+		for (size_t i = 1; i + 1 < thisFrame.size(); i += 2)
+			if (thisFrame[i] == BLR_ACK)
+				ackList.push_back(thisFrame[i + 1]);
+	return ackList;
+}
+
+void testRecords()
+{
+	callLog.clear();
+	//loco 3 forward speed 10, loco 300 (zero bytes in the record) F0 on, switch 1 thrown, power on
+	check(sendFrame(1, {BLR_SPEED, 0, 3, 0x80 | 10, BLR_FUNCTION, 0x01, 0x2C, 0x80, BLR_ACCESSORY, 0x80, 1, BLR_POWER, 1}) == 0, "frame bytes taken");
+	std::vector<std::string> expLog = {"speed 3 11 1", "fn 300 0 1", "acc 1 0 1", "sync 0", "power main 1", "power prog 1"};
+	check(callLog == expLog, "records executed");
+	std::vector<uint8_t> ackList = getAcks();
+	check((ackList.size() == 1) && (ackList[0] == 1), "frame acknowledged");
+	callLog.clear();
+	sendFrame(2, {BLR_PROG, BLP_WRITEBIT, 0, 29, 0x08 | 5, 0, 0});
+	check((callLog.size() == 1) && (callLog[0] == "text <B 29 5 1 0 0>"), "programming through the text parser");
+	getAcks();
+}
+
+void testRepeat()
+{
+	callLog.clear();
+	sendFrame(10, {BLR_SPEED, 0, 5, 20});
+	sendFrame(10, {BLR_SPEED, 0, 5, 20}); //ack lost, the ESP32 sends it again
+	check(callLog.size() == 1, "repeated frame executed once");
+	std::vector<uint8_t> ackList = getAcks();
+	check((ackList.size() == 2) && (ackList[0] == 10) && (ackList[1] == 10), "repeated frame acknowledged again");
+	callLog.clear();
+	sendFrame(11, {BLR_SPEED, 0, 5, 20}); //same content, new sequence number
+	check(callLog.size() == 1, "next frame executed");
+	getAcks();
+	BinLink::start(&testStream); //ESP32 restarted, its sequence starts again
+	receiveFrames();
+	callLog.clear();
+	sendFrame(11, {BLR_SPEED, 0, 5, 21});
+	check(callLog.size() == 1, "frame after restart executed");
+	getAcks();
+}
+
+void testBadFrames()
+{
+	callLog.clear();
+	sendFrame(20, {BLR_SPEED, 0, 7, 30}, true);
+	check(callLog.empty() && getAcks().empty(), "bad crc ignored");
+	const char * textCmd = "<t 1 7 30 1>";
+	uint16_t textCtr = 0;
+	for (const char * txtPtr = textCmd; *txtPtr; txtPtr++)
+		textCtr += BinLink::receive(&testParser, &testStream, *txtPtr) ? 0 : 1;
+	check(textCtr == strlen(textCmd), "text between frames left to the parser");
+	sendFrame(21, {BLR_SPEED, 0, 7, 30});
+	check(callLog.size() == 1, "frame after text executed");
+	getAcks();
+	callLog.clear();
+	BinLink::receive(&testParser, &testStream, 0);
+	for (uint8_t i = 0; i < 2 * binMaxEnc; i++) //no delimiter
+		BinLink::receive(&testParser, &testStream, 0x55);
+	BinLink::receive(&testParser, &testStream, 0);
+	sendFrame(22, {BLR_SPEED, 0, 7, 31});
+	check(callLog.size() == 1, "frame after overlong data executed");
+	getAcks();
+}
+
+//DCC packets with random bytes, so zeros turn up everywhere in the frame. BinLink must hand every packet over unchanged
+void testFraming()
+{
+	std::mt19937 rng(1);
+	std::uniform_int_distribution<int> byteDist(0, 255);
+	std::uniform_int_distribution<int> lenDist(1, MAX_PACKET_SIZE);
+	std::uniform_int_distribution<int> zeroDist(0, 3);
+	uint8_t seqNr = 100;
+	for (uint32_t j = 0; j < numFuzzFrames; j++)
+	{
+		std::vector<uint8_t> records;
+		std::vector<std::string> expLog;
+		while (true)
+		{
+			uint8_t pktLen = lenDist(rng);
+			if ((records.size() + pktLen + 2 + 2) > binMaxFrame) //seq and crc
+				break;
+			records.push_back(BLR_PACKET);
+			records.push_back(pktLen);
+			std::string logLine = "packet";
+			for (uint8_t i = 0; i < pktLen; i++)
+			{
+				uint8_t pktByte = zeroDist(rng) == 0 ? 0 : byteDist(rng);
+				records.push_back(pktByte);
+				logLine += " " + std::to_string(pktByte);
+			}
+			expLog.push_back(logLine);
+		}
+		callLog.clear();
+		seqNr++;
+		sendFrame(seqNr, records);
+		check(callLog == expLog, "packets unchanged");
+		std::vector<uint8_t> ackList = getAcks();
+		check((ackList.size() == 1) && (ackList[0] == seqNr), "packet frame acknowledged");
+	}
+}
+
+//more replies than fit into one frame go out in several frames
+void testReplies()
+{
+	receiveFrames();
+	for (uint8_t i = 0; i < 40; i++)
+		BinLink::addSensor(i, i & 0x01);
+	std::vector<std::vector<uint8_t>> frameList = receiveFrames();
+	uint8_t sensorNr = 0;
+	for (auto &thisFrame : frameList)
+		for (size_t i = 1; i + 1 < thisFrame.size(); i += 2)
+		{
+			check((thisFrame[i] == BLR_SENSOR) && (thisFrame[i + 1] == (((sensorNr & 0x01) << 7) | sensorNr)), "sensor records in order");
+			sensorNr++;
+		}
+	check((frameList.size() > 1) && (sensorNr == 40), "all sensor records sent");
+}
+
+int main()
+{
+	BinLink::start(&testStream);
+	std::vector<std::vector<uint8_t>> frameList = receiveFrames();
+	check((frameList.size() == 1) && (frameList[0].size() == 3) && (frameList[0][1] == BLR_HELLO), "hello frame");
+	testRecords();
+	testRepeat();
+	testBadFrames();
+	testFraming();
+	testReplies();
+	printf("%u errors\n", errorCtr);
+	return errorCtr > 0 ? 1 : 0;
+}
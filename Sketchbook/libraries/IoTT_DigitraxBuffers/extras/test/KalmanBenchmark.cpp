@@ -0,0 +1,90 @@
+//Host benchmark of the fixed point Kalman kernel in OneDimKalman against the original double version. Analog inputs with noise and a
+//new level now and then, both versions get the same readings. Prints the time per channel update and the deviation of the integer
+//estimates from the rounded double estimates, fails if the deviation exceeds maxAllowedDev at any step, so drift over a long run shows.
+//
+//g++ -std=gnu++17 -O2 -Istubs -I../../../OneDimKalman KalmanBenchmark.cpp ../../../OneDimKalman/OneDimKalman.cpp -o KalmanBenchmark && ./KalmanBenchmark
+
+#include <OneDimKalman.h>
+#include <stdio.h>
+#include <chrono>
+#include <random>
+
+#define numChannels 64
+#define numSteps 20000
+#define maxAllowedDev 2 //ADC counts
+
+typedef struct //the original double version
+{
+	double_t errEst = 10;
+	double_t errMeasure = 8;
+	double_t currEst = 10;
+} refChannel;
+
+double_t refEstimate(refChannel * thisChannel, double_t Measurement)
+{
+	double_t lastEst = thisChannel->currEst;
+	double_t kGain = thisChannel->errEst / (thisChannel->errEst + thisChannel->errMeasure);
+	thisChannel->currEst = thisChannel->currEst + (kGain * (Measurement - thisChannel->currEst));
+	thisChannel->errEst = (1.0 - kGain) * thisChannel->errEst + fabs(lastEst - thisChannel->currEst);
+	thisChannel->errEst = thisChannel->errEst * (1 - kGain);
+	return thisChannel->currEst;
+}
+
+int main()
+{
+	kalmanChannel fixChannels[numChannels];
+	refChannel refChannels[numChannels];
+	uint16_t rawVals[numChannels];
+	uint16_t fixVals[numChannels];
+	uint16_t levels[numChannels];
+	double_t refVals[numChannels];
+	std::mt19937 rng(1); //same readings with every run
+	std::uniform_int_distribution<int32_t> levelDist(0, 4095);
+	std::uniform_int_distribution<int32_t> noiseDist(-20, 20);
+	std::uniform_int_distribution<int32_t> jumpDist(0, 99);
+	kalmanInit(fixChannels, numChannels);
+	for (uint16_t i = 0; i < numChannels; i++)
+		levels[i] = levelDist(rng);
+	std::chrono::nanoseconds refTime(0);
+	std::chrono::nanoseconds fixTime(0);
+	uint32_t maxDev = 0;
+	uint32_t lastMaxDev = 0; //last quarter of the run, grows if the fixed point version drifts away
+	uint64_t sumDev = 0;
+	uint32_t errorCtr = 0;
+	for (uint32_t j = 0; j < numSteps; j++)
+	{
+		for (uint16_t i = 0; i < numChannels; i++)
+		{
+			if (jumpDist(rng) == 0)
+				levels[i] = levelDist(rng);
+			int32_t newVal = levels[i] + noiseDist(rng);
+			rawVals[i] = newVal < 0 ? 0 : newVal > 4095 ? 4095 : newVal;
+		}
+		auto startTime = std::chrono::steady_clock::now();
+		for (uint16_t i = 0; i < numChannels; i++)
+			refVals[i] = refEstimate(&refChannels[i], rawVals[i]);
+		refTime += std::chrono::steady_clock::now() - startTime;
+		startTime = std::chrono::steady_clock::now();
+		kalmanUpdateInt(fixChannels, rawVals, fixVals, numChannels);
+		fixTime += std::chrono::steady_clock::now() - startTime;
+		for (uint16_t i = 0; i < numChannels; i++)
+		{
+			uint32_t thisDev = abs((int32_t)fixVals[i] - (int32_t)round(refVals[i]));
+			sumDev += thisDev;
+			if (thisDev > maxDev)
+				maxDev = thisDev;
+			if ((j >= (3 * numSteps / 4)) && (thisDev > lastMaxDev))
+				lastMaxDev = thisDev;
+			if (thisDev > maxAllowedDev)
+			{
+				if (errorCtr < 10)
+					printf("channel %i step %u: fixed %i double %.3f\n", i, j, fixVals[i], refVals[i]);
+				errorCtr++;
+			}
+		}
+	}
+	uint32_t numUpdates = (uint32_t)numChannels * numSteps;
+	printf("Kalman %i channels %i steps: double %.2f ns/ch fixed %.2f ns/ch\n", numChannels, numSteps, (double)refTime.count() / numUpdates, (double)fixTime.count() / numUpdates);
+	printf("deviation max %u avg %.4f, max in the last quarter %u, %u errors\n", maxDev, (double)sumDev / numUpdates, lastMaxDev, errorCtr);
+	return errorCtr > 0 ? 1 : 0;
+}
@@ -0,0 +1,201 @@
+//Host simulation of the loco reminders of the RedHat firmware (DCC::issueReminders in CommandStation-EX-Dev). DCC.cpp runs against a
+//stand-in of the main track waveform that takes the real transmit time of every packet (16 preamble bits, 58 us half bits for 1 and
+//100 us for 0), on a simulated clock. For each roster size, all locos run with F0 on and every second one of four driven locos gets
+//a new speed, like operators on their throttles. Prints the time between speed packets per loco, for idle locos and for the driven
+//locos in the second after a change, and fails if a loco is not reminded for longer than maxIdleGap.
+//
+//g++ -std=gnu++17 -O2 -w -ffunction-sections -Wl,--gc-sections -DARDUINO_AVR_UNO -Istubs/redhat -I../../../../CommandStation-EX-Dev ReminderSim.cpp ../../../../CommandStation-EX-Dev/DCC.cpp -o ReminderSim && ./ReminderSim
+
+#include "DCC.h"
+#include "DCCWaveform.h"
+#include "CVCache.h"
+#include "StringFormatter.h"
+#include <vector>
+
+#define numDriven 4 //locos that get speed changes
+#define changeInterval 1000000 //us between speed changes
+#define warmupTime 5000000 //us
+#define simTime 60000000 //us
+#define maxIdleGap 500000 //us, 20 locos on an UNO stay below 450 ms
+
+uint8_t PORTB = 0;
+Stream Serial;
+uint64_t simClock = 0; //us
+unsigned long micros() { return simClock; }
+unsigned long millis() { return simClock / 1000; }
+void pinMode(uint8_t pinNr, uint8_t pinMode) {}
+void digitalWrite(uint8_t pinNr, uint8_t pinVal) {}
+void StringFormatter::send(Print & stream, const FSH * input...) {}
+void StringFormatter::send(Print * stream, const FSH * input...) {}
+void StringFormatter::diag(const FSH * input...) {}
+bool Diag::ACK = false;
+void CVCache::begin() {}
+void CVCache::opDone(int16_t result) {}
+
+//main track waveform, the packet is sent when the simulation loop calls sendPacket
+byte simPacket[MAX_PACKET_SIZE + 1];
+byte simLen = 0;
+byte simRepeats = 0;
+
+struct locoStats
+{
+	uint64_t lastSpeedTime = 0;
+	uint64_t lastChangeTime = 0;
+	uint64_t idleSum = 0;
+	uint32_t idleCtr = 0;
+	uint64_t idleMax = 0;
+	uint64_t hotSum = 0;
+	uint32_t hotCtr = 0;
+	uint64_t hotMax = 0;
+};
+
+std::vector<int> locoAddr;
+std::vector<locoStats> locoList;
+bool measuring = false;
+uint32_t packetCtr = 0;
+
+uint32_t packetTime(const byte * packetBuf, byte packetLen) //us, including the checksum
+{
+	byte checkSum = 0;
+	uint32_t numOnes = PREAMBLE_BITS_MAIN + 1; //preamble and end bit
+	uint32_t numZeros = packetLen + 1; //start bits
+	for (byte i = 0; i <= packetLen; i++)
+	{
+		byte thisByte = i < packetLen ? packetBuf[i] : checkSum;
+		checkSum ^= thisByte;
+		for (byte j = 0; j < 8; j++)
+			if (thisByte & (0x80 >> j))
+				numOnes++;
+			else
+				numZeros++;
+	}
+	return numOnes * 116 + numZeros * 200;
+}
+
+void sendPacket()
+{
+	for (byte i = 0; i <= simRepeats; i++)
+		simClock += packetTime(simPacket, simLen);
+	DCCWaveform::mainTrack.packetPending = false;
+	packetCtr++;
+	int cabAddr = simPacket[0];
+	byte cmdPos = 1;
+	if ((simPacket[0] & 0xC0) == 0xC0)
+	{
+		cabAddr = ((simPacket[0] & 0x3F) << 8) | simPacket[1];
+		cmdPos = 2;
+	}
+	if ((simLen <= cmdPos) || (simPacket[cmdPos] != 0x3F)) //128 step speed only
+		return;
+	for (size_t i = 0; i < locoAddr.size(); i++)
+		if (locoAddr[i] == cabAddr)
+		{
+			locoStats &thisLoco = locoList[i];
+			uint64_t thisGap = simClock - thisLoco.lastSpeedTime;
+			if (measuring && (thisLoco.lastSpeedTime > 0))
+			{
+				if ((simClock - thisLoco.lastChangeTime) < changeInterval)
+				{
+					thisLoco.hotSum += thisGap;
+					thisLoco.hotCtr++;
+					if (thisGap > thisLoco.hotMax)
+						thisLoco.hotMax = thisGap;
+				}
+				else
+				{
+					thisLoco.idleSum += thisGap;
+					thisLoco.idleCtr++;
+					if (thisGap > thisLoco.idleMax)
+						thisLoco.idleMax = thisGap;
+				}
+			}
+			thisLoco.lastSpeedTime = simClock;
+		}
+}
+
+DCCWaveform::DCCWaveform(byte preambleBits, bool isMain) {}
+DCCWaveform DCCWaveform::mainTrack(PREAMBLE_BITS_MAIN, true);
+DCCWaveform DCCWaveform::progTrack(PREAMBLE_BITS_PROG, false);
+void DCCWaveform::loop(bool ackManagerActive) {}
+bool DCCWaveform::progTrackSyncMain = false;
+void DCCWaveform::setPowerMode(POWERMODE newMode) {}
+void DCCWaveform::setAckBaseline() {}
+void DCCWaveform::setAckPending() {}
+byte DCCWaveform::getAck() { return 0; }
+void DCCWaveform::schedulePacket(const byte buffer[], byte byteCount, byte repeats)
+{
+	if (this != &mainTrack)
+		return;
+	if (packetPending) //the waveform waits for the running packet
+		sendPacket();
+	memcpy(simPacket, buffer, byteCount);
+	simLen = byteCount;
+	simRepeats = repeats;
+	packetPending = true;
+}
+
+int main()
+{
+	uint32_t errorCtr = 0;
+	printf("locos | idle locos: avg  max ms | driven locos after a change: avg  max ms | packets/s\n");
+	for (byte numLocos = 1; numLocos <= MAX_LOCOS; numLocos++)
+	{
+		DCC::forgetAllLocos();
+		simClock = 0;
+		measuring = false;
+		locoAddr.clear();
+		locoList.assign(numLocos, locoStats());
+		for (byte i = 0; i < numLocos; i++)
+		{
+			locoAddr.push_back(i & 0x01 ? 1000 + i : 3 + i); //short and long addresses
+			DCC::setThrottle(locoAddr[i], 20 + i, true);
+			DCC::setFn(locoAddr[i], 0, true);
+		}
+		uint64_t nextChange = changeInterval;
+		uint8_t changeCtr = 0;
+		uint32_t startPackets = 0;
+		while (simClock < warmupTime + simTime)
+		{
+			if (!measuring && (simClock >= warmupTime))
+			{
+				measuring = true;
+				startPackets = packetCtr;
+			}
+			if (simClock >= nextChange)
+			{
+				byte thisLoco = changeCtr++ % (numLocos < numDriven ? numLocos : numDriven);
+				locoList[thisLoco].lastChangeTime = simClock;
+				DCC::setThrottle(locoAddr[thisLoco], 20 + (changeCtr & 0x0F), true);
+				nextChange += changeInterval;
+			}
+			DCC::loop();
+			if (DCCWaveform::mainTrack.packetPending)
+				sendPacket();
+			else
+				simClock += packetTime(idlePacket, 2);
+		}
+		uint64_t idleSum = 0, idleMax = 0, hotSum = 0, hotMax = 0;
+		uint32_t idleCtr = 0, hotCtr = 0;
+		for (byte i = 0; i < numLocos; i++)
+		{
+			idleSum += locoList[i].idleSum;
+			idleCtr += locoList[i].idleCtr;
+			hotSum += locoList[i].hotSum;
+			hotCtr += locoList[i].hotCtr;
+			if (locoList[i].idleMax > idleMax)
+				idleMax = locoList[i].idleMax;
+			if (locoList[i].hotMax > hotMax)
+				hotMax = locoList[i].hotMax;
+			if ((locoList[i].idleMax > maxIdleGap) || (locoList[i].idleCtr + locoList[i].hotCtr == 0))
+			{
+				printf("loco %i of %i not reminded for %.1f ms\n", locoAddr[i], numLocos, (float)locoList[i].idleMax / 1000);
+				errorCtr++;
+			}
+		}
+		printf("%5i |          %6.1f %6.1f |                        %6.1f %6.1f | %6.0f\n", numLocos,
+			idleCtr ? (float)idleSum / idleCtr / 1000 : 0, (float)idleMax / 1000, hotCtr ? (float)hotSum / hotCtr / 1000 : 0, (float)hotMax / 1000,
+			(float)(packetCtr - startPackets) * 1000000 / simTime);
+	}
+	printf("%u errors\n", errorCtr);
+	return errorCtr > 0 ? 1 : 0;
+}
@@ -0,0 +1,90 @@
+//Host stress test of IoTT_SeqLock. One writer thread updates a slot sized buffer in a write section, several reader threads take
+//snapshots and check that every snapshot is complete and matches the version it was read with. An optional second writer thread
+//stands in for the WiThrottle client that writes from the TCP task.
+//
+//g++ -std=gnu++17 -O2 -pthread -Istubs -I../../src SeqLockStress.cpp -o SeqLockStress && ./SeqLockStress
+
+#include <IoTT_SeqLock.h>
+#include <stdio.h>
+#include <string.h>
+#include <atomic>
+#include <vector>
+
+#define numReaders 4
+#define numWrites 2000000
+#define numClientWrites 20000
+#define bufLen 10
+
+IoTT_SeqLock testLock;
+volatile uint32_t testBuffer[bufLen]; //all entries hold the number of writes so far
+std::atomic<bool> writerDone{false};
+std::atomic<uint32_t> errorCtr{0};
+
+void writeOnce()
+{
+	IoTT_SeqWrite testWrite(&testLock);
+	uint32_t newVal = testBuffer[0] + 1;
+	for (uint8_t i = 0; i < bufLen; i++)
+	{
+		testBuffer[i] = newVal;
+		if (i == bufLen / 2)
+		{
+			IoTT_SeqWrite nestedWrite(&testLock); //nested section must not change the counter
+			uint32_t ownCopy[bufLen];
+			testLock.read([&]() { memcpy(ownCopy, (void*)testBuffer, sizeof(ownCopy)); }); //reads directly inside the own section
+		}
+	}
+}
+
+void runWriter(uint32_t writeCount)
+{
+	for (uint32_t i = 0; i < writeCount; i++)
+		writeOnce();
+}
+
+void runReader(uint32_t * readCount)
+{
+	uint32_t lastVersion = 0;
+	while (!writerDone)
+	{
+		uint32_t localCopy[bufLen];
+		uint32_t thisVersion = testLock.read([&]() { for (uint8_t i = 0; i < bufLen; i++) localCopy[i] = testBuffer[i]; });
+		bool isOK = (thisVersion >= lastVersion) && (localCopy[0] * 2 == thisVersion);
+		for (uint8_t i = 1; i < bufLen; i++)
+			isOK &= (localCopy[i] == localCopy[0]);
+		if (!isOK)
+		{
+			if (errorCtr++ < 10)
+				printf("inconsistent snapshot at version %u: %u..%u, previous version %u\n", thisVersion, localCopy[0], localCopy[bufLen-1], lastVersion);
+		}
+		lastVersion = thisVersion;
+		(*readCount)++;
+	}
+}
+
+int main(int argc, char * argv[])
+{
+	bool withClient = (argc < 2) || (strcmp(argv[1], "--no-client") != 0);
+	uint32_t readCount[numReaders] = {0};
+	std::vector<std::thread> readers;
+	for (uint8_t i = 0; i < numReaders; i++)
+		readers.emplace_back(runReader, &readCount[i]);
+	std::thread writer(runWriter, numWrites);
+	std::thread client(runWriter, withClient ? numClientWrites : 0);
+	writer.join();
+	client.join();
+	writerDone = true;
+	for (auto& thisReader : readers)
+		thisReader.join();
+
+	uint32_t expWrites = numWrites + (withClient ? numClientWrites : 0);
+	if ((testBuffer[0] != expWrites) || (testLock.getVersion() != 2 * expWrites))
+	{
+		printf("lost writes: %u writes, version %u, expected %u\n", testBuffer[0], testLock.getVersion(), expWrites);
+		errorCtr++;
+	}
+	for (uint8_t i = 0; i < numReaders; i++)
+		printf("reader %i: %u snapshots\n", i, readCount[i]);
+	printf("%u writes, %u retries, %u errors\n", testBuffer[0], testLock.getRetryCount(), errorCtr.load());
+	return errorCtr > 0 ? 1 : 0;
+}
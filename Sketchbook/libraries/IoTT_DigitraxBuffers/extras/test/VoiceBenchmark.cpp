@@ -0,0 +1,124 @@
+//Host benchmark of the keyword classifier of IoTT_VoiceControl (EmergencyStop_inferencing). Feeds audio slice by slice to
+//run_classifier_continuous like inference_task does and prints the time per slice against the slice length, which is the budget the
+//inference task has before the record task drops a slice. Detections use the same rule as inference_task: stop and go above 0.5, checked
+//once per model window.
+//Audio is a recording given as raw 16 kHz mono 16 bit little endian PCM, e.g. from sox stop.wav -r 16000 -c 1 -b 16 -e signed -t raw stop.raw
+//Without a file, 20 s of noise are classified, which gives the timing only.
+//
+//EI=../../../EmergencyStop_inferencing/src
+//gcc -O2 -w -I$EI -c $EI/edge-impulse-sdk/tensorflow/lite/c/common.c -o tflite_common.o
+//g++ -std=gnu++14 -O2 -w -ffunction-sections -Wl,--gc-sections -Istubs -I$EI VoiceBenchmark.cpp tflite_common.o $(find $EI -name "*.cc" -o -name "*.cpp" | grep -v "CMSIS\|porting") -o VoiceBenchmark && ./VoiceBenchmark [stop.raw]
+//The SDK sources take a few minutes to compile. The unused CMSIS-DSP calls are removed by --gc-sections, as on the ESP32
+
+#define EI_CLASSIFIER_SLICES_PER_MODEL_WINDOW 3 //before the include, as in the Edge Impulse continuous audio example
+#include <EmergencyStop_inferencing.h>
+#include <stdio.h>
+#include <stdarg.h>
+#include <chrono>
+#include <random>
+#include <vector>
+
+#define synthSeconds 20
+
+//porting layer of the Edge Impulse SDK for the host, replaces porting/arduino
+EI_IMPULSE_ERROR ei_run_impulse_check_canceled() { return EI_IMPULSE_OK; }
+EI_IMPULSE_ERROR ei_sleep(int32_t time_ms) { std::this_thread::sleep_for(std::chrono::milliseconds(time_ms)); return EI_IMPULSE_OK; }
+uint64_t ei_read_timer_us() { return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch()).count(); }
+uint64_t ei_read_timer_ms() { return ei_read_timer_us() / 1000; }
+void ei_printf(const char *format, ...)
+{
+	va_list args;
+	va_start(args, format);
+	vprintf(format, args);
+	va_end(args);
+}
+void ei_printf_float(float f) { printf("%f", f); }
+void * ei_malloc(size_t size) { return malloc(size); }
+void * ei_calloc(size_t nitems, size_t size) { return calloc(nitems, size); }
+void ei_free(void * ptr) { free(ptr); }
+#if defined(__cplusplus) && EI_C_LINKAGE == 1
+extern "C"
+#endif
+void DebugLog(const char * s) { printf("%s", s); }
+
+std::vector<int16_t> audioData;
+size_t sliceStart = 0;
+
+static int audio_signal_get_data(size_t offset, size_t length, float * out_ptr)
+{
+	numpy::int16_to_float(&audioData[sliceStart + offset], out_ptr, length);
+	return 0;
+}
+
+int main(int argc, char * argv[])
+{
+	if (argc > 1)
+	{
+		FILE * audioFile = fopen(argv[1], "rb");
+		if (!audioFile)
+		{
+			printf("can't open %s\n", argv[1]);
+			return 1;
+		}
+		int16_t readBuf[1024];
+		size_t numRead;
+		while ((numRead = fread(readBuf, sizeof(int16_t), 1024, audioFile)) > 0)
+			audioData.insert(audioData.end(), readBuf, readBuf + numRead);
+		fclose(audioFile);
+	}
+	else
+	{
+		std::mt19937 rng(1);
+		std::normal_distribution<float> noiseDist(0, 300);
+		for (uint32_t i = 0; i < synthSeconds * EI_CLASSIFIER_FREQUENCY; i++)
+			audioData.push_back((int16_t)noiseDist(rng));
+	}
+	uint32_t numSlices = audioData.size() / EI_CLASSIFIER_SLICE_SIZE;
+	if (numSlices == 0)
+	{
+		printf("recording shorter than one slice\n");
+		return 1;
+	}
+	run_classifier_init();
+	uint32_t sliceTime = EI_CLASSIFIER_SLICE_SIZE * 1000 / EI_CLASSIFIER_FREQUENCY; //ms
+	uint64_t sumTime = 0;
+	uint64_t maxTime = 0;
+	uint32_t sumDsp = 0;
+	uint32_t sumClassify = 0;
+	uint32_t detectCtr = 0;
+	int printResults = -(EI_CLASSIFIER_SLICES_PER_MODEL_WINDOW);
+	for (uint32_t i = 0; i < numSlices; i++)
+	{
+		sliceStart = i * EI_CLASSIFIER_SLICE_SIZE;
+		signal_t signal;
+		signal.total_length = EI_CLASSIFIER_SLICE_SIZE;
+		signal.get_data = &audio_signal_get_data;
+		ei_impulse_result_t result = {0};
+		uint64_t startTime = ei_read_timer_us();
+		EI_IMPULSE_ERROR r = run_classifier_continuous(&signal, &result, false);
+		uint64_t runTime = ei_read_timer_us() - startTime;
+		if (r != EI_IMPULSE_OK)
+		{
+			printf("classifier failed at slice %u (%d)\n", i, r);
+			return 1;
+		}
+		sumTime += runTime;
+		if (runTime > maxTime)
+			maxTime = runTime;
+		sumDsp += result.timing.dsp;
+		sumClassify += result.timing.classification;
+		if (++printResults >= (EI_CLASSIFIER_SLICES_PER_MODEL_WINDOW))
+		{
+			for (size_t ix = 2; ix < EI_CLASSIFIER_LABEL_COUNT; ix++)
+				if (result.classification[ix].value > 0.5) //only stop and go
+				{
+					printf("%.2f s: %s %.3f\n", (float)(sliceStart + EI_CLASSIFIER_SLICE_SIZE) / EI_CLASSIFIER_FREQUENCY, result.classification[ix].label, result.classification[ix].value);
+					detectCtr++;
+				}
+			printResults = 0;
+		}
+	}
+	printf("%u slices of %u ms: avg %.2f ms (dsp %.2f ms, classification %.2f ms) max %.2f ms, %u detections\n", numSlices, sliceTime,
+		(double)sumTime / numSlices / 1000, (double)sumDsp / numSlices, (double)sumClassify / numSlices, (double)maxTime / 1000, detectCtr);
+	return 0;
+}
@@ -0,0 +1,338 @@
+//Host load test of the WiThrottle server mode of IoTT_LBServer. Local clients act like Engine Driver phones with four throttles each,
+//one of them on a long address and one on the loco of the next phone. They acquire their locos and then move the speed sliders at
+//throttleRate commands per second, with a function key or a direction change now and then. The commands go in through the TCP callbacks
+//of the server like from AsyncTCP, the LocoNet commands of the server go to a stand-in of the command station, which answers OPC_LOCO_ADR
+//with OPC_SL_RD and keeps the slots that the server reads. millis() runs on a simulated clock, processLoop is called every ms, the host
+//time spent in the server is measured with micros(). At the end, every second phone quits with Q and the others drop off the network.
+//For 1 to wiMaxClients clients, prints the commands per second, the OPC_LOCO_SPD sent after coalescing and the LocoNet load they make,
+//the lines sent to the clients and the host time per command and per second of operation. Fails if a loco is not acquired, if the last
+//speed of a throttle does not reach its slot, if speed commands are not coalesced, if a shared loco is not reported to the other phone,
+//if a client does not get the roster of all locos, if a slot is not released at the end or if a queue overflows.
+//
+//L=../../..
+//g++ -std=gnu++17 -O2 -w -ffunction-sections -Wl,--gc-sections -DARDUINOJSON_ENABLE_ARDUINO_STRING=1 -DARDUINOJSON_ENABLE_ARDUINO_STREAM=0 -DARDUINOJSON_ENABLE_ARDUINO_PRINT=0 -Istubs -I$L/ArduinoJson/src -I$L/IoTT_CommDef/src -I../../src -I$L/IoTT_SerInjector/src -I$L/IoTT_RemoteButtons/src -I$L/IoTT_LocoNetButtons/src -I$L/OneDimKalman -I$L/IoTT_lbServer/src WiLoadTest.cpp $L/IoTT_lbServer/src/IoTT_lbServer.cpp $L/IoTT_CommDef/src/IoTT_CommDef.cpp -o WiLoadTest && ./WiLoadTest
+
+#include <IoTT_lbServer.h>
+#include <stdio.h>
+#include <chrono>
+#include <map>
+#include <random>
+#include <string>
+#include <vector>
+
+#define throttlesPerClient 4
+#define throttleRate 20 //commands per second and throttle, Engine Driver while the slider is dragged
+#define lnBitRate 16457 //LocoNet, 10 bits per byte
+#define simTime 30000 //ms
+#define settleTime 1000 //ms after the last command, for the last speed and state updates
+
+IoTT_DigitraxBuffers * digitraxBuffer = NULL;
+HardwareSerial Serial;
+uint32_t simClock = 0; //ms
+unsigned long millis() { return simClock; }
+unsigned long micros() { return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch()).count(); }
+void prepSlotReadMsg(lnTransmitMsg * msgData, uint8_t slotNr) {}
+uint32_t overflowCtr = 0;
+
+//server messages are not printed, queue overflows are counted
+size_t HardwareSerial::write(const uint8_t * buffer, size_t size)
+{
+	if (std::string((const char *)buffer, size).find("overflow") != std::string::npos)
+		overflowCtr++;
+	return size;
+}
+
+//local client, collects the lines the server sends
+class TestClient : public AsyncClient
+{
+	public:
+		size_t space() { return 5744; } //TCP_SND_BUF of the ESP32
+		size_t add(const char * data, size_t size, uint8_t apiflags = 0)
+		{
+			txData.append(data, size);
+			return size;
+		}
+		bool send()
+		{
+			for (char thisChar : txData)
+				if ((thisChar == '\r') || (thisChar == '\n'))
+				{
+					if (rxPartial.size() > 0)
+						rxLines.push_back(rxPartial);
+					rxPartial.clear();
+				}
+				else
+					rxPartial += thisChar;
+			txData.clear();
+			return true;
+		}
+		std::vector<std::string> rxLines; //lines received from the server
+	private:
+		std::string txData;
+		std::string rxPartial;
+};
+
+//command station with the slots that the server reads through DigitraxBuffers
+slotData csSlots[maxSlots];
+uint32_t csSpeedCtr[maxSlots];
+uint32_t csByteCtr = 0; //LocoNet bytes sent by the server
+IoTT_LBServer * wiServer = NULL;
+
+IoTT_DigitraxBuffers::IoTT_DigitraxBuffers(txFct lnOut) {}
+IoTT_DigitraxBuffers::~IoTT_DigitraxBuffers() {}
+uint8_t IoTT_DigitraxBuffers::getPowerStatus() { return 0x83; }
+uint8_t IoTT_DigitraxBuffers::getSwiPosition(uint16_t swiNum) { return 0; }
+slotData * IoTT_DigitraxBuffers::getSlotData(uint8_t slotNum) { return &csSlots[slotNum]; }
+uint8_t IoTT_DigitraxBuffers::getSlotOfAddr(uint8_t locoAddrLo, uint8_t locoAddrHi) { return 0xFF; } //WiThrottle client mode only
+void IoTT_DigitraxBuffers::setPowerStatus(uint8_t newStatus) {}
+uint32_t IoTT_DigitraxBuffers::getSlotSnapshot(uint8_t slotNum, slotData * destSlot)
+{
+	memcpy(destSlot, &csSlots[slotNum], sizeof(slotData));
+	return 0;
+}
+
+uint16_t csReceive(lnTransmitMsg txData)
+{
+	uint8_t slotNr = txData.lnData[1];
+	csByteCtr += txData.lnMsgSize;
+	switch (txData.lnData[0])
+	{
+		case 0xBF: //OPC_LOCO_ADR, slot of the address or a free slot
+		{
+			uint16_t locoAddr = (txData.lnData[1] << 7) + txData.lnData[2];
+			uint8_t freeSlot = 0;
+			for (slotNr = 1; slotNr < maxSlots; slotNr++)
+			{
+				if ((csSlots[slotNr][0] & 0x30) && ((((csSlots[slotNr][6] & 0x7F) << 7) + (csSlots[slotNr][1] & 0x7F)) == locoAddr))
+					break;
+				if ((freeSlot == 0) && ((csSlots[slotNr][0] & 0x30) == 0))
+					freeSlot = slotNr;
+			}
+			if (slotNr >= maxSlots)
+			{
+				slotNr = freeSlot;
+				memset(&csSlots[slotNr], 0, sizeof(slotData));
+				csSlots[slotNr][0] = 0x13; //common, 128 steps
+				csSlots[slotNr][1] = locoAddr & 0x7F;
+				csSlots[slotNr][4] = 0x07; //TRK
+				csSlots[slotNr][6] = locoAddr >> 7;
+			}
+			lnReceiveBuffer slRead; //OPC_SL_RD to the application, which hands it to the server
+			slRead.lnMsgSize = 14;
+			slRead.lnData[0] = 0xE7;
+			slRead.lnData[1] = 0x0E;
+			slRead.lnData[2] = slotNr;
+			memcpy(&slRead.lnData[3], &csSlots[slotNr], sizeof(slotData));
+			setXORByte(&slRead.lnData[0]);
+			wiServer->lnWriteMsg(slRead);
+		}
+		break;
+		case 0xBA: //OPC_MOVE_SLOTS, NULL move sets the slot in use
+			if (txData.lnData[1] == txData.lnData[2])
+				csSlots[slotNr][0] |= 0x30;
+			break;
+		case 0xB5: //OPC_SLOT_STAT1
+			csSlots[slotNr][0] = txData.lnData[2];
+			break;
+		case 0xA0: //OPC_LOCO_SPD
+			csSlots[slotNr][2] = txData.lnData[2];
+			csSpeedCtr[slotNr]++;
+			break;
+		case 0xA1: //OPC_LOCO_DIRF
+			csSlots[slotNr][3] = txData.lnData[2];
+			break;
+		case 0xA2: //OPC_LOCO_SND
+			csSlots[slotNr][7] = txData.lnData[2];
+			break;
+	}
+	return txData.lnMsgSize;
+}
+
+uint32_t errorCtr = 0;
+
+void check(bool testResult, const char * testName, int testNr)
+{
+	if (!testResult)
+	{
+		if (errorCtr < 20)
+			printf("failed: %s %i\n", testName, testNr);
+		errorCtr++;
+	}
+}
+
+struct testThrottle
+{
+	uint8_t clientNr;
+	char throttleID;
+	uint16_t dccAddr;
+	std::string locoKey;
+	uint32_t nextCmd;
+};
+
+struct testLoco
+{
+	int16_t lastSpeed = 0; //last V command of any throttle
+	uint32_t dirCtr = 0; //direction changes, each may send a pending speed right away
+};
+
+int main()
+{
+	std::mt19937 rng(1);
+	std::uniform_int_distribution<int> speedDist(0, 126);
+	std::uniform_int_distribution<int> actionDist(0, 49);
+	digitraxBuffer = new IoTT_DigitraxBuffers();
+	printf("clients | throttles | commands/s | OPC_LOCO_SPD/s | LocoNet load | lines/s | host us/command | host load | max loop us\n");
+	for (uint8_t numClients = 1; numClients <= wiMaxClients; numClients++)
+	{
+		memset(csSlots, 0, sizeof(csSlots));
+		memset(csSpeedCtr, 0, sizeof(csSpeedCtr));
+		csByteCtr = 0;
+		overflowCtr = 0;
+		simClock = 0;
+		wiServer = new IoTT_LBServer();
+		wiServer->initWIServer(true);
+		wiServer->setTxCallback(&csReceive);
+		std::vector<TestClient> clientList(numClients);
+		std::vector<testThrottle> throttleList;
+		std::map<uint16_t, testLoco> locoList;
+		uint32_t serverTime = 0; //us
+		uint32_t cmdCtr = 0;
+		uint32_t lineCtr = 0; //lines from the TCP task since the last processLoop
+		auto runLoop = [&]()
+		{
+			uint32_t startTime = micros();
+			wiServer->processLoop();
+			serverTime += micros() - startTime;
+			simClock++;
+			lineCtr = 0;
+		};
+		auto sendLine = [&](uint8_t clientNr, std::string cmdLine)
+		{
+			if (lineCtr == wiRxQueueSize - 1) //queue is full, the TCP task waits for processLoop
+				runLoop();
+			cmdLine += "\n";
+			uint32_t startTime = micros();
+			wiServer->handleDataFromServer(&clientList[clientNr], &cmdLine[0], cmdLine.size());
+			serverTime += micros() - startTime;
+			cmdCtr++;
+			lineCtr++;
+		};
+		for (uint8_t i = 0; i < numClients; i++) //throttles 0..2 with a loco of their own, 3 with throttle 0 of the next client
+		{
+			wiServer->handleNewClient(&clientList[i]);
+			sendLine(i, "NPhone" + std::to_string(i));
+			sendLine(i, "HU" + std::to_string(1000 + i));
+			for (uint8_t j = 0; j < throttlesPerClient; j++)
+			{
+				testThrottle newThrottle;
+				newThrottle.clientNr = i;
+				newThrottle.throttleID = '0' + j;
+				newThrottle.dccAddr = j == 3 ? 3 + (((i + 1) % numClients) * 2) : j == 2 ? 1000 + i : 3 + (i * 2) + j;
+				newThrottle.locoKey = std::string(newThrottle.dccAddr > 127 ? "L" : "S") + std::to_string(newThrottle.dccAddr);
+				newThrottle.nextCmd = 1000 + (rng() % (1000 / throttleRate));
+				throttleList.push_back(newThrottle);
+				locoList[newThrottle.dccAddr] = testLoco();
+			}
+		}
+		for (testThrottle &thisThrottle : throttleList)
+			sendLine(thisThrottle.clientNr, std::string("M") + thisThrottle.throttleID + "+" + thisThrottle.locoKey + "<;>" + thisThrottle.locoKey);
+		while (simClock < 1000)
+			runLoop();
+		wiServer->resetWIStats();
+		serverTime = 0;
+		cmdCtr = 0;
+		csByteCtr = 0;
+		while (simClock < 1000 + simTime)
+		{
+			for (testThrottle &thisThrottle : throttleList)
+			{
+				if (simClock < thisThrottle.nextCmd)
+					continue;
+				testLoco &thisLoco = locoList[thisThrottle.dccAddr];
+				std::string cmdLine = std::string("M") + thisThrottle.throttleID + "A" + thisThrottle.locoKey + "<;>";
+				switch (actionDist(rng))
+				{
+					case 0: cmdLine += "F11"; break; //F1 pressed
+					case 1:
+						cmdLine += "R" + std::to_string(rng() & 0x01);
+						thisLoco.dirCtr++;
+						break;
+					default:
+						thisLoco.lastSpeed = speedDist(rng);
+						cmdLine += "V" + std::to_string(thisLoco.lastSpeed);
+						break;
+				}
+				sendLine(thisThrottle.clientNr, cmdLine);
+				thisThrottle.nextCmd += 1000 / throttleRate;
+			}
+			runLoop();
+		}
+		uint32_t loadCmds = cmdCtr;
+		uint32_t loadTime = serverTime;
+		uint32_t loadBytes = csByteCtr;
+		uint32_t speedTx = wiServer->wiSpeedTxCtr;
+		uint32_t clientLines = wiServer->wiLineCtr;
+		uint32_t maxLoop = wiServer->wiMaxLoopTime;
+		uint32_t endTime = simClock + settleTime;
+		while (simClock < endTime)
+			runLoop();
+		uint8_t numInUse = 0;
+		for (uint8_t i = 1; i < maxSlots; i++)
+			if ((csSlots[i][0] & 0x30) == 0x30)
+				numInUse++;
+		check(numInUse == locoList.size(), "slots in use", numClients);
+		for (auto &thisEntry : locoList)
+		{
+			uint8_t slotNr = 1;
+			while ((slotNr < maxSlots) && ((((csSlots[slotNr][6] & 0x7F) << 7) + (csSlots[slotNr][1] & 0x7F)) != thisEntry.first))
+				slotNr++;
+			check(slotNr < maxSlots, "slot of the loco", thisEntry.first);
+			if (slotNr >= maxSlots)
+				continue;
+			uint8_t lnSpeed = thisEntry.second.lastSpeed == 0 ? 0 : thisEntry.second.lastSpeed + 1;
+			check(csSlots[slotNr][2] == lnSpeed, "last speed in the slot", thisEntry.first);
+			check(csSpeedCtr[slotNr] <= ((simTime + settleTime) / wiUpdateInterval) + thisEntry.second.dirCtr + 1, "speed commands coalesced", thisEntry.first);
+		}
+		for (testThrottle &thisThrottle : throttleList)
+		{
+			bool locoAdded = false;
+			uint32_t speedUpdates = 0; //speed of the shared locos set by the other client
+			for (std::string &thisLine : clientList[thisThrottle.clientNr].rxLines)
+			{
+				if (thisLine == std::string("M") + thisThrottle.throttleID + "+" + thisThrottle.locoKey + "<;>")
+					locoAdded = true;
+				if (thisLine.compare(0, 7 + thisThrottle.locoKey.size(), std::string("M") + thisThrottle.throttleID + "A" + thisThrottle.locoKey + "<;>V") == 0)
+					speedUpdates++;
+			}
+			check(locoAdded, "loco acquired", thisThrottle.dccAddr);
+			if ((thisThrottle.throttleID == '3') && (numClients > 1))
+				check(speedUpdates > 0, "speed of a shared loco sent to the other client", thisThrottle.dccAddr);
+		}
+		for (uint8_t i = 0; i < numClients; i++) //last roster list has all locos
+		{
+			std::string lastRoster;
+			for (std::string &thisLine : clientList[i].rxLines)
+				if (thisLine.compare(0, 2, "RL") == 0)
+					lastRoster = thisLine;
+			std::string rosterHead = "RL" + std::to_string(numInUse) + "]";
+			check(lastRoster.compare(0, rosterHead.size(), rosterHead) == 0, "roster sent to the client", i);
+		}
+		printf("%7i | %9i | %10.0f | %14.0f | %11.1f%% | %7.0f | %15.2f | %8.3f%% | %11u\n", numClients, (int)throttleList.size(),
+			(float)loadCmds * 1000 / simTime, (float)speedTx * 1000 / simTime, (float)loadBytes * 10 * 100 / lnBitRate / (simTime / 1000),
+			(float)clientLines * 1000 / simTime, (float)loadTime / loadCmds, (float)loadTime / simTime / 10, maxLoop);
+		for (uint8_t i = 0; i < numClients; i += 2) //every second client quits, all at the same time
+			sendLine(i, "Q");
+		runLoop();
+		for (uint8_t i = 0; i < numClients; i++) //the others are gone without Q
+			wiServer->handleDisconnect(&clientList[i]);
+		endTime = simClock + settleTime;
+		while (simClock < endTime)
+			runLoop();
+		for (uint8_t i = 1; i < maxSlots; i++)
+			check((csSlots[i][0] & 0x30) != 0x30, "slot released", i);
+		check(overflowCtr == 0, "no queue overflow", numClients);
+		delete wiServer;
+	}
+	printf("%u errors\n", errorCtr);
+	return errorCtr > 0 ? 1 : 0;
+}
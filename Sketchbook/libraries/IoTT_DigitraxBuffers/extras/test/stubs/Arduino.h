@@ -0,0 +1,160 @@
+#ifndef Arduino_h
+#define Arduino_h
+
+//minimal host replacement of the Arduino and FreeRTOS calls used by the code under test, one task per std::thread
+//millis() and micros() are defined by the tests that need them, so they can run on a simulated clock
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdarg.h>
+#include <string.h>
+#include <math.h>
+#include <algorithm>
+#include <chrono>
+#include <mutex>
+#include <string>
+#include <thread>
+
+typedef uint8_t byte;
+typedef bool boolean;
+
+#define F(x) (x)
+#define PROGMEM
+#define IRAM_ATTR
+#define LOW 0
+#define HIGH 1
+#define INPUT 0
+#define OUTPUT 1
+#define DEC 10
+#define HEX 16
+
+using std::min;
+using std::max;
+
+unsigned long millis();
+unsigned long micros();
+inline long random(long maxVal) { return maxVal > 0 ? rand() % maxVal : 0; }
+inline void yield() { std::this_thread::yield(); }
+inline void delay(unsigned long ms) { std::this_thread::sleep_for(std::chrono::milliseconds(ms)); }
+
+typedef void * TaskHandle_t;
+typedef uint32_t TickType_t;
+typedef std::mutex * SemaphoreHandle_t;
+typedef int BaseType_t;
+
+#define pdTRUE 1
+#define pdFALSE 0
+#define portMAX_DELAY 0xFFFFFFFF
+
+inline TaskHandle_t xTaskGetCurrentTaskHandle()
+{
+	static thread_local uint8_t thisTask;
+	return &thisTask;
+}
+
+inline void vTaskDelay(TickType_t ticks)
+{
+	if (ticks > 0)
+		std::this_thread::yield();
+}
+
+inline SemaphoreHandle_t xSemaphoreCreateMutex() { return new std::mutex; }
+inline BaseType_t xSemaphoreTake(SemaphoreHandle_t thisMutex, TickType_t ticks) { thisMutex->lock(); return pdTRUE; }
+inline BaseType_t xSemaphoreGive(SemaphoreHandle_t thisMutex) { thisMutex->unlock(); return pdTRUE; }
+
+class String
+{
+	public:
+		String() {}
+		String(const char * txtStr) { if (txtStr) strData = txtStr; }
+		String(char txtChar) { strData = txtChar; }
+		String(int numVal) { strData = std::to_string(numVal); }
+		String(unsigned int numVal) { strData = std::to_string(numVal); }
+		String(long numVal) { strData = std::to_string(numVal); }
+		String(unsigned long numVal) { strData = std::to_string(numVal); }
+		String & operator+=(const String &addStr) { strData += addStr.strData; return *this; }
+		String & operator+=(const char * addStr) { strData += addStr; return *this; }
+		String & operator+=(char addChar) { strData += addChar; return *this; }
+		friend String operator+(const String &lhs, const String &rhs) { String newStr(lhs); newStr += rhs; return newStr; }
+		friend String operator+(const String &lhs, const char * rhs) { String newStr(lhs); newStr += rhs; return newStr; }
+		friend String operator+(const char * lhs, const String &rhs) { String newStr(lhs); newStr += rhs; return newStr; }
+		friend String operator+(const String &lhs, char rhs) { String newStr(lhs); newStr += rhs; return newStr; }
+		bool operator==(const String &cmpStr) const { return strData == cmpStr.strData; }
+		bool operator==(const char * cmpStr) const { return strData == cmpStr; }
+		bool operator!=(const String &cmpStr) const { return strData != cmpStr.strData; }
+		bool operator!=(const char * cmpStr) const { return strData != cmpStr; }
+		char operator[](unsigned int charPos) const { return strData[charPos]; }
+		const char * c_str() const { return strData.c_str(); }
+		unsigned int length() const { return strData.size(); }
+		bool reserve(unsigned int strSize) { strData.reserve(strSize); return true; }
+		bool concat(const String &addStr) { strData += addStr.strData; return true; }
+		bool concat(const char * addStr, unsigned int addLen) { strData.append(addStr, addLen); return true; }
+		bool concat(char addChar) { strData += addChar; return true; }
+	private:
+		std::string strData;
+};
+
+class StringSumHelper : public String //ArduinoJson refers to it
+{
+	public:
+		using String::String;
+};
+
+class Printable
+{
+	public:
+		virtual String toString() const = 0;
+};
+
+class Print
+{
+	public:
+		virtual ~Print() {}
+		virtual size_t write(uint8_t c) = 0;
+		virtual size_t write(const uint8_t * buffer, size_t size)
+		{
+			for (size_t i = 0; i < size; i++)
+				write(buffer[i]);
+			return size;
+		}
+		size_t print(const char * txtStr) { return write((const uint8_t *)txtStr, strlen(txtStr)); }
+		size_t print(const String &txtStr) { return print(txtStr.c_str()); }
+		size_t print(const Printable &txtObj) { return print(txtObj.toString()); }
+		size_t print(long numVal, int numBase = DEC) { return printf(numBase == HEX ? "%lX" : "%li", numVal); }
+		size_t print(unsigned long numVal, int numBase = DEC) { return printf(numBase == HEX ? "%lX" : "%lu", numVal); }
+		size_t print(int numVal, int numBase = DEC) { return print((long)numVal, numBase); }
+		size_t print(unsigned int numVal, int numBase = DEC) { return print((unsigned long)numVal, numBase); }
+		template <typename T> size_t println(const T &txtVal) { return print(txtVal) + println(); }
+		template <typename T> size_t println(const T &numVal, int numBase) { return print(numVal, numBase) + println(); }
+		size_t println() { return print("\r\n"); }
+		size_t printf(const char * format, ...)
+		{
+			char txtBuf[256];
+			va_list args;
+			va_start(args, format);
+			int txtLen = vsnprintf(txtBuf, sizeof(txtBuf), format, args);
+			va_end(args);
+			return txtLen > 0 ? write((const uint8_t *)txtBuf, min(txtLen, (int)sizeof(txtBuf) - 1)) : 0;
+		}
+};
+
+class Stream : public Print
+{
+	public:
+		virtual int available() { return 0; }
+		virtual int read() { return -1; }
+};
+
+#include <HardwareSerial.h>
+
+class EspClass
+{
+	public:
+		uint64_t getEfuseMac() { return 0; }
+};
+
+inline EspClass ESP;
+
+#endif
@@ -0,0 +1 @@
+#include <ArduinoJson.h> //IoTT_lbServer includes it with this spelling, the host file system is case sensitive
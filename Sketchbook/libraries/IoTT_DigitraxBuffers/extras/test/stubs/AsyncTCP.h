@@ -0,0 +1,56 @@
+#ifndef AsyncTCP_h
+#define AsyncTCP_h
+
+#include <Arduino.h>
+#include <IPAddress.h>
+
+//AsyncTCP stub without a network. A test derives its clients from AsyncClient and sees what the code under test sends to them,
+//the callbacks of the code under test are called by the test itself
+class AsyncClient;
+
+typedef void (*AcConnectHandler)(void *, AsyncClient *);
+typedef void (*AcDataHandler)(void *, AsyncClient *, void * data, size_t len);
+typedef void (*AcErrorHandler)(void *, AsyncClient *, int8_t error);
+typedef void (*AcTimeoutHandler)(void *, AsyncClient *, uint32_t time);
+
+class AsyncClient
+{
+	public:
+		virtual ~AsyncClient() {}
+		virtual bool connect(IPAddress ip, uint16_t port) { return false; }
+		virtual bool connected() { return false; }
+		virtual void close(bool now = false) {}
+		virtual void stop() { close(false); }
+		virtual bool canSend() { return space() > 0; }
+		virtual size_t space() { return 0; }
+		virtual size_t add(const char * data, size_t size, uint8_t apiflags = 0) { return 0; }
+		virtual bool send() { return false; }
+		size_t write(const char * data) { return write(data, strlen(data)); }
+		size_t write(const char * data, size_t size)
+		{
+			size_t addLen = add(data, size);
+			send();
+			return addLen;
+		}
+		virtual IPAddress remoteIP() { return IPAddress(); }
+		uint32_t getAckTimeout() { return 5000; }
+		uint32_t getRxTimeout() { return 0; }
+		const char * errorToString(int8_t error) { return "error"; }
+		void onConnect(AcConnectHandler cb, void * arg = 0) {}
+		void onDisconnect(AcConnectHandler cb, void * arg = 0) {}
+		void onData(AcDataHandler cb, void * arg = 0) {}
+		void onError(AcErrorHandler cb, void * arg = 0) {}
+		void onTimeout(AcTimeoutHandler cb, void * arg = 0) {}
+		void onPoll(AcConnectHandler cb, void * arg = 0) {}
+};
+
+class AsyncServer
+{
+	public:
+		AsyncServer(IPAddress addr, uint16_t port) {}
+		AsyncServer(uint16_t port) {}
+		void onClient(AcConnectHandler cb, void * arg) {}
+		void begin() {}
+};
+
+#endif
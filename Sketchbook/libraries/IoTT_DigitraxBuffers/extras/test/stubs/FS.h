@@ -0,0 +1,30 @@
+#ifndef FS_h
+#define FS_h
+
+#include <Arduino.h>
+
+namespace fs
+{
+	class File : public Stream
+	{
+		public:
+			size_t write(uint8_t c) { return 0; }
+			size_t write(const uint8_t * buffer, size_t size) { return 0; }
+			size_t read(uint8_t * buffer, size_t size) { return 0; }
+			using Stream::read;
+			void close() {}
+			operator bool() const { return false; }
+	};
+
+	class FS
+	{
+		public:
+			File open(const String &path, const char * mode = "r") { return File(); }
+			bool exists(const String &path) { return false; }
+	};
+}
+
+using fs::File;
+using fs::FS;
+
+#endif
@@ -0,0 +1,18 @@
+#ifndef HardwareSerial_h
+#define HardwareSerial_h
+
+#include <Arduino.h>
+
+//serial port stub, the tests that use Serial define it and its output
+class HardwareSerial : public Stream
+{
+	public:
+		HardwareSerial(int uartNr = 0) {}
+		void begin(unsigned long baudRate, uint32_t serConfig = 0, int8_t rxPin = -1, int8_t txPin = -1, bool invert = false) {}
+		size_t write(uint8_t c) { return write(&c, 1); }
+		size_t write(const uint8_t * buffer, size_t size);
+};
+
+extern HardwareSerial Serial;
+
+#endif
@@ -0,0 +1,31 @@
+#ifndef IPAddress_h
+#define IPAddress_h
+
+#include <Arduino.h>
+
+class IPAddress : public Printable
+{
+	public:
+		IPAddress() {}
+		IPAddress(uint32_t newAddr) : ipAddr(newAddr) {}
+		bool fromString(const String &addrStr) { return fromString(addrStr.c_str()); }
+		bool fromString(const char * addrStr)
+		{
+			uint32_t addrBytes[4];
+			if (sscanf(addrStr, "%u.%u.%u.%u", &addrBytes[0], &addrBytes[1], &addrBytes[2], &addrBytes[3]) != 4)
+				return false;
+			ipAddr = addrBytes[0] | (addrBytes[1] << 8) | (addrBytes[2] << 16) | (addrBytes[3] << 24);
+			return true;
+		}
+		String toString() const
+		{
+			char addrStr[16];
+			sprintf(addrStr, "%u.%u.%u.%u", ipAddr & 0xFF, (ipAddr >> 8) & 0xFF, (ipAddr >> 16) & 0xFF, ipAddr >> 24);
+			return String(addrStr);
+		}
+		operator uint32_t() const { return ipAddr; }
+	private:
+		uint32_t ipAddr = 0;
+};
+
+#endif
@@ -0,0 +1,8 @@
+#ifndef SPIFFS_h
+#define SPIFFS_h
+
+#include <FS.h>
+
+inline fs::FS SPIFFS;
+
+#endif
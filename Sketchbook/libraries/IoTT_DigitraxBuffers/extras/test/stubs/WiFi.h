@@ -0,0 +1,21 @@
+#ifndef WiFi_h
+#define WiFi_h
+
+#include <Arduino.h>
+#include <IPAddress.h>
+
+class Client : public Stream
+{
+	public:
+		size_t write(uint8_t c) { return 1; }
+};
+
+class WiFiClass
+{
+	public:
+		IPAddress localIP() { return IPAddress(0x0100007F); } //127.0.0.1
+};
+
+inline WiFiClass WiFi;
+
+#endif
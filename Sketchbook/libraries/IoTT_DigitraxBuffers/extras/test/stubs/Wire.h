@@ -0,0 +1,12 @@
+#ifndef Wire_h
+#define Wire_h
+
+#include <Arduino.h>
+
+class TwoWire : public Stream
+{
+	public:
+		size_t write(uint8_t c) { return 0; }
+};
+
+#endif
@@ -0,0 +1 @@
+#include <Arduino.h> //IoTT_CommDef includes it in lower case, the host file system is case sensitive
@@ -0,0 +1,61 @@
+#ifndef Arduino_h
+#define Arduino_h
+
+//minimal host replacement of the AVR Arduino core, enough for the headers of the RedHat firmware (CommandStation-EX-Dev) that
+//the tests build. Build with -DARDUINO_AVR_UNO, the firmware only accepts known boards
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <stdarg.h>
+
+typedef uint8_t byte;
+class __FlashStringHelper;
+#define F(strVal) (reinterpret_cast<const __FlashStringHelper *>(strVal))
+#define PROGMEM
+#define pgm_read_byte_near(addr) (*(const uint8_t *)(addr))
+#define highByte(w) ((uint8_t)((w) >> 8))
+#define lowByte(w) ((uint8_t)((w) & 0xFF))
+
+class Print
+{
+	public:
+		virtual size_t write(uint8_t c) = 0;
+		virtual size_t write(const uint8_t * buf, size_t len)
+		{
+			for (size_t i = 0; i < len; i++)
+				write(buf[i]);
+			return len;
+		}
+};
+
+class Stream : public Print
+{
+	public:
+		size_t write(uint8_t c) { return fputc(c, stdout) == EOF ? 0 : 1; }
+		using Print::write;
+		virtual int available() { return 0; }
+		virtual int read() { return -1; }
+};
+
+#define LOW 0
+#define HIGH 1
+#define INPUT 0
+#define OUTPUT 1
+
+extern uint8_t PORTB; //the following are defined by the test
+extern Stream Serial;
+unsigned long micros();
+unsigned long millis();
+void pinMode(uint8_t pinNr, uint8_t pinMode);
+void digitalWrite(uint8_t pinNr, uint8_t pinVal);
+
+inline char * itoa(int numVal, char * numStr, int numBase)
+{
+	sprintf(numStr, numBase == 16 ? "%x" : "%d", numVal);
+	return numStr;
+}
+
+#endif
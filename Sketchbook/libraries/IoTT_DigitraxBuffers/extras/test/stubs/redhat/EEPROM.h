@@ -0,0 +1,18 @@
+#ifndef EEPROM_h
+#define EEPROM_h
+
+#include <stdint.h>
+
+class EEPROMClass
+{
+	public:
+		uint8_t read(int) { return 0xFF; }
+		void write(int, uint8_t) {}
+		void update(int, uint8_t) {}
+		template <typename T> T & get(int, T & t) { return t; }
+		template <typename T> const T & put(int, const T & t) { return t; }
+};
+
+extern EEPROMClass EEPROM;
+
+#endif
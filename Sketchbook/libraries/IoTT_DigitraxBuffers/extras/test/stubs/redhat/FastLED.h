@@ -0,0 +1,13 @@
+#ifndef FastLED_h
+#define FastLED_h
+
+#include <stdint.h>
+
+struct CHSV
+{
+	uint8_t h, s, v;
+	CHSV() {}
+	CHSV(uint8_t ih, uint8_t is, uint8_t iv) : h(ih), s(is), v(iv) {}
+};
+
+#endif
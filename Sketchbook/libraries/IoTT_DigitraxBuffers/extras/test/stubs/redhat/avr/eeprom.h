@@ -0,0 +1 @@
+//not used by the code under test
@@ -0,0 +1,2 @@
+//the firmware reads its settings from config.h, which is made from config.example.h
+#include <config.example.h>
@@ -0,0 +1,203 @@
+#include <IoTT_AccessoryOut.h>
+
+IoTT_AccessoryOut::IoTT_AccessoryOut(IoTT_DigitraxBuffers * srcBuffers, txFct txCallback)
+{
+	stateBuffers = srcBuffers;
+	txFunction = txCallback;
+}
+
+void IoTT_AccessoryOut::setBudget(uint8_t cmdPerSec, uint8_t burstSize)
+{
+	cmdBudget = cmdPerSec;
+	maxCredit = 1000 * max(burstSize, (uint8_t)1);
+	txCredit = maxCredit;
+	creditTime = millis();
+}
+
+void IoTT_AccessoryOut::setRetriggerTime(uint16_t retriggerMs)
+{
+	retriggerTime = retriggerMs;
+}
+
+void IoTT_AccessoryOut::addSwitchCmd(lnTransmitMsg txData)
+{
+	uint16_t swiAddr = ((txData.lnData[1] & 0x7F)) + ((txData.lnData[2] & 0x0F)<<7);
+	addCmd(accSwitch, swiAddr, txData.lnData[2] & 0x30, &txData);
+}
+
+void IoTT_AccessoryOut::addSignalCmd(uint16_t sigNr, uint8_t sigAspect, lnTransmitMsg txData)
+{
+	addCmd(accSignal, sigNr, sigAspect & 0x1F, &txData); //DigitraxBuffers keeps 5 bits
+}
+
+bool IoTT_AccessoryOut::isCurrentState(accCmdType cmdType, uint16_t accAddr, uint8_t targetVal)
+{
+	if (cmdType == accSignal)
+		return stateBuffers->getSignalAspect(accAddr) == targetVal;
+	else //switch in position and coil not active, so neither coil on nor coil off changes anything
+		return (stateBuffers->getSwiCoilStatus(accAddr) == 0) && (stateBuffers->getSwiPosition(accAddr) == (targetVal & 0x20));
+}
+
+bool IoTT_AccessoryOut::isSameAddr(uint8_t entryNr, accCmdType cmdType, uint16_t accAddr)
+{
+	return cmdBuffer[entryNr].tbd && (cmdBuffer[entryNr].cmdType == cmdType) && (cmdBuffer[entryNr].accAddr == accAddr);
+}
+
+//a coil off may only be removed together with its coil on, otherwise the coil stays active
+bool IoTT_AccessoryOut::hasWaitingCoilOn(uint8_t entryNr)
+{
+	accCmdEntry * thisEntry = &cmdBuffer[entryNr];
+	for (uint8_t i = 0; i < accBufferLen; i++)
+		if (isSameAddr(i, thisEntry->cmdType, thisEntry->accAddr) && (cmdBuffer[i].seqNr < thisEntry->seqNr) && (cmdBuffer[i].targetVal == (thisEntry->targetVal | 0x10)))
+			return true;
+	return false;
+}
+
+void IoTT_AccessoryOut::addCmd(accCmdType cmdType, uint16_t accAddr, uint8_t targetVal, lnTransmitMsg * txData)
+{
+	cmdCtr++;
+	int16_t freeEntry = -1;
+	int16_t lastWaiting = -1; //newest waiting command for this address
+	uint64_t mergeMask = 0; //entries undone by this command, removed after the scan so hasWaitingCoilOn still sees them
+	for (uint8_t i = 0; i < accBufferLen; i++)
+	{
+		accCmdEntry * thisEntry = &cmdBuffer[i];
+		if (isSameAddr(i, cmdType, accAddr))
+		{
+			if (cmdType == accSignal) //only the last aspect counts, replace it and keep the place in the sequence
+			{
+				if (thisEntry->targetVal == targetVal)
+					dropCtr++;
+				else
+				{
+					thisEntry->targetVal = targetVal;
+					thisEntry->txData = *txData;
+					mergeCtr++;
+				}
+				return;
+			}
+			if (((thisEntry->targetVal & 0x20) != (targetVal & 0x20)) && (((thisEntry->targetVal & 0x10) > 0) || hasWaitingCoilOn(i))) //other direction, this command undoes it anyway
+				mergeMask |= (1ULL << i);
+			else
+				if ((lastWaiting < 0) || (thisEntry->seqNr > cmdBuffer[lastWaiting].seqNr))
+					lastWaiting = i;
+		}
+		if (!thisEntry->tbd && (freeEntry < 0))
+			freeEntry = i;
+	}
+	for (uint8_t i = 0; i < accBufferLen; i++)
+		if (mergeMask & (1ULL << i))
+		{
+			cmdBuffer[i].tbd = false;
+			mergeCtr++;
+			if (freeEntry < 0)
+				freeEntry = i;
+		}
+	if (lastWaiting >= 0 ? cmdBuffer[lastWaiting].targetVal == targetVal : isCurrentState(cmdType, accAddr, targetVal))
+	{
+		dropCtr++;
+		return;
+	}
+	if (freeEntry < 0) //send what is waiting for this address, then this command, so the order is kept
+	{
+		overflowCtr++;
+		flushAddr(cmdType, accAddr);
+		sendNow(txData);
+		return;
+	}
+	accCmdEntry * newEntry = &cmdBuffer[freeEntry];
+	newEntry->cmdType = cmdType;
+	newEntry->accAddr = accAddr;
+	newEntry->targetVal = targetVal;
+	newEntry->txData = *txData;
+	newEntry->seqNr = nextSeqNr++;
+	newEntry->addTime = millis();
+	newEntry->deferred = false;
+	newEntry->tbd = true;
+	uint8_t fillLevel = 0;
+	for (uint8_t i = 0; i < accBufferLen; i++)
+		if (cmdBuffer[i].tbd)
+			fillLevel++;
+	if (fillLevel > maxFillLevel)
+		maxFillLevel = fillLevel;
+}
+
+void IoTT_AccessoryOut::flushAddr(accCmdType cmdType, uint16_t accAddr)
+{
+	while (true)
+	{
+		int16_t sendThis = -1; //oldest command for this address
+		for (uint8_t i = 0; i < accBufferLen; i++)
+			if (isSameAddr(i, cmdType, accAddr) && ((sendThis < 0) || (cmdBuffer[i].seqNr < cmdBuffer[sendThis].seqNr)))
+				sendThis = i;
+		if (sendThis < 0)
+			return;
+		sendNow(&cmdBuffer[sendThis].txData);
+		cmdBuffer[sendThis].tbd = false;
+	}
+}
+
+//bypasses rate and retrigger time, the credit is used up as far as there is any
+void IoTT_AccessoryOut::sendNow(lnTransmitMsg * txData)
+{
+	txFunction(*txData);
+	txCtr++;
+	txCredit = txCredit >= 1000 ? txCredit - 1000 : 0;
+}
+
+//a command waits for older ones of the same address, and a coil is not switched on again within the retrigger time
+bool IoTT_AccessoryOut::isReady(uint8_t entryNr)
+{
+	accCmdEntry * thisEntry = &cmdBuffer[entryNr];
+	for (uint8_t i = 0; i < accBufferLen; i++)
+		if (cmdBuffer[i].tbd && (cmdBuffer[i].cmdType == thisEntry->cmdType) && (cmdBuffer[i].accAddr == thisEntry->accAddr) && (cmdBuffer[i].seqNr < thisEntry->seqNr))
+			return false;
+	if ((thisEntry->cmdType == accSwitch) && ((thisEntry->targetVal & 0x10) > 0))
+	{
+		uint32_t lastActivity = stateBuffers->getLastSwiActivity(thisEntry->accAddr);
+		if ((lastActivity > 0) && ((millis() - lastActivity) < retriggerTime))
+		{
+			if (!thisEntry->deferred)
+			{
+				thisEntry->deferred = true;
+				retriggerCtr++;
+			}
+			return false;
+		}
+	}
+	return true;
+}
+
+void IoTT_AccessoryOut::processLoop()
+{
+	if (cmdBudget > 0)
+	{
+		uint32_t timeNow = millis();
+		uint32_t newCredit = txCredit + ((timeNow - creditTime) * cmdBudget);
+		txCredit = min(newCredit, maxCredit);
+		creditTime = timeNow;
+	}
+	while ((cmdBudget == 0) || (txCredit >= 1000))
+	{
+		int16_t sendThis = -1; //oldest command that can go
+		for (uint8_t i = 0; i < accBufferLen; i++)
+			if (cmdBuffer[i].tbd && ((sendThis < 0) || (cmdBuffer[i].seqNr < cmdBuffer[sendThis].seqNr)) && isReady(i))
+				sendThis = i;
+		if (sendThis < 0)
+			return;
+		accCmdEntry * thisEntry = &cmdBuffer[sendThis];
+		txFunction(thisEntry->txData);
+		thisEntry->tbd = false;
+		txCtr++;
+		uint32_t thisDelay = millis() - thisEntry->addTime;
+		if (thisDelay > maxDelay)
+			maxDelay = thisDelay;
+		if (cmdBudget > 0)
+			txCredit -= 1000;
+	}
+}
+
+void IoTT_AccessoryOut::printStats()
+{
+	Serial.printf("Accessory Out: %i cmds %i sent %i dropped %i merged %i retrigger wait %i overflow, buffer max %i delay max %i ms\n", cmdCtr, txCtr, dropCtr, mergeCtr, retriggerCtr, overflowCtr, maxFillLevel, maxDelay);
+}
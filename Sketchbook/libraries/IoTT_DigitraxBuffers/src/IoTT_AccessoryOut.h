@@ -0,0 +1,74 @@
+#ifndef IoTT_AccessoryOut_h
+#define IoTT_AccessoryOut_h
+
+#include <Arduino.h>
+#include <IoTT_CommDef.h>
+#include <IoTT_DigitraxBuffers.h>
+
+//Output stage for switch and signal commands (OPC_SW_REQ, OPC_SW_ACK and OPC_IMM_PACKET). A route button or a signal recalculation can
+//create dozens of commands within milliseconds, many of them for the state the switch or signal already has. These are dropped, a
+//waiting command that is undone by a newer one for the same address is removed, and the rest is sent at the configured rate. A coil off
+//is only removed together with its coil on. If the buffer is full, the waiting commands of the address and then the new one are sent at once.
+//The coil of a switch is activated again only after the retrigger time since the last activity in the switch protocol of DigitraxBuffers.
+//Commands for the same address are sent in the order they came in. All calls from the task running processLocoNetMsg
+
+#define accBufferLen 64
+#define accDefaultBudget 20 //commands per second
+#define accDefaultBurst 4 //commands sent right away after a quiet period
+#define accDefaultRetrigger 100 //ms from the last activity of a switch to the next coil activation
+
+enum accCmdType : uint8_t {accSwitch = 0, accSignal = 1};
+
+typedef struct
+{
+	bool tbd = false; //to be done, otherwise the entry is free
+	bool deferred = false; //has been held back for the retrigger time
+	accCmdType cmdType = accSwitch;
+	uint16_t accAddr = 0;
+	uint8_t targetVal = 0; //switch: direction 0x20 and coil 0x10, same as getSwiStatus. signal: aspect
+	uint32_t seqNr = 0; //order of arrival
+	uint32_t addTime = 0;
+	lnTransmitMsg txData;
+} accCmdEntry;
+
+class IoTT_AccessoryOut
+{
+	public:
+		IoTT_AccessoryOut(IoTT_DigitraxBuffers * srcBuffers, txFct txCallback);
+		void setBudget(uint8_t cmdPerSec, uint8_t burstSize = accDefaultBurst); //0: no rate limit
+		void setRetriggerTime(uint16_t retriggerMs);
+		void addSwitchCmd(lnTransmitMsg txData);
+		void addSignalCmd(uint16_t sigNr, uint8_t sigAspect, lnTransmitMsg txData);
+		void processLoop();
+		void printStats();
+
+	private:
+		void addCmd(accCmdType cmdType, uint16_t accAddr, uint8_t targetVal, lnTransmitMsg * txData);
+		bool isCurrentState(accCmdType cmdType, uint16_t accAddr, uint8_t targetVal);
+		bool isSameAddr(uint8_t entryNr, accCmdType cmdType, uint16_t accAddr); //waiting entry for this address
+		bool hasWaitingCoilOn(uint8_t entryNr);
+		void flushAddr(accCmdType cmdType, uint16_t accAddr);
+		void sendNow(lnTransmitMsg * txData);
+		bool isReady(uint8_t entryNr);
+
+		IoTT_DigitraxBuffers * stateBuffers = NULL;
+		txFct txFunction = NULL;
+		accCmdEntry cmdBuffer[accBufferLen];
+		uint32_t nextSeqNr = 0;
+		uint8_t cmdBudget = accDefaultBudget;
+		uint32_t maxCredit = 1000 * accDefaultBurst;
+		uint32_t txCredit = 1000 * accDefaultBurst; //1000 per command
+		uint32_t creditTime = millis();
+		uint16_t retriggerTime = accDefaultRetrigger;
+		//statistics
+		uint32_t cmdCtr = 0;
+		uint32_t txCtr = 0;
+		uint32_t dropCtr = 0; //target state already set or waiting
+		uint32_t mergeCtr = 0; //waiting command removed by a newer one
+		uint32_t retriggerCtr = 0; //commands held back for the retrigger time
+		uint32_t overflowCtr = 0; //buffer full, address flushed without pacing
+		uint8_t maxFillLevel = 0;
+		uint32_t maxDelay = 0; //ms from addCmd to the tx function
+};
+
+#endif
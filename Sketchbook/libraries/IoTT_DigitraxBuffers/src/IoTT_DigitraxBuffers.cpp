@@ -1,11 +1,16 @@
 #include <IoTT_DigitraxBuffers.h>
 
 
-blockDetBuffer blockDetectorBuffer;
-switchBuffer switchPositionBuffer;
-signalBuffer signalAspectBuffer;
-analogValBuffer analogValueBuffer;
-buttonValBuffer buttonValueBuffer;
+//status buffers are paged, memory is only allocated for address ranges in use. See IoTT_PagedBuffer.h
+IoTT_PagedBuffer<uint8_t, numBDs> blockDetectorBuffer; //4096 input bits, 8 per byte, lsb is lowest number
+IoTT_PagedBuffer<uint8_t, numSwis> switchPositionBuffer; //4 switches per byte. First bit indicates coil state, second is position
+IoTT_PagedBuffer<uint8_t, numSigs> signalAspectBuffer;
+IoTT_PagedBuffer<uint16_t, numAnalogVals> analogValueBuffer;
+IoTT_PagedBuffer<uint8_t, numButtons> buttonValueBuffer;
+//location table. Each loco has one zone, the locos in a zone form a list through locoNextBuffer. All entries are stored +1, so 0 is empty
+IoTT_PagedBuffer<uint16_t, numLocoAddrs> locoZoneBuffer; //bits 0-12: zone + 1, bit 14: direction known, bit 15: direction
+IoTT_PagedBuffer<uint16_t, numLocoAddrs> locoNextBuffer; //next loco + 1 in the same zone
+IoTT_PagedBuffer<uint16_t, numZones> zoneHeadBuffer; //first loco + 1 in the zone
 powerStatusBuffer sysPowerStatus = 2; //OPC_IDLE
 slotDataBuffer slotBuffer;
 uint8_t dispatchSlot = 0x00;
@@ -302,8 +307,11 @@ void IoTT_DigitraxBuffers::setLocoNetMode(bool newMode)
 void IoTT_DigitraxBuffers::clearSlotBuffer()
 {
 	if (!isCommandStation)
+	{
+		IoTT_SeqWrite slotWrite(&domainLock[dbDomSlots]);
 		for (int i = 0; i < numSlots; i++)
 			memcpy(&slotBuffer[i], &stdSlot[0], 10);
+	}
 }
 
 void IoTT_DigitraxBuffers::setRedHatMode(txFct lnReply, DynamicJsonDocument doc)
@@ -354,16 +362,11 @@ bool IoTT_DigitraxBuffers::saveToFile(String fileName)
     File dataFile = SPIFFS.open(fileName, "w");
     if (dataFile)
     {
-		dataFile.write(blockDetectorBuffer, numBDs);
-		dataFile.write(switchPositionBuffer, numSwis);
-		dataFile.write(signalAspectBuffer, numSigs);
-		uint8_t buf[2];
-		for (int i = 0; i < numAnalogVals; i++)
-		{
-			memcpy(&buf, &analogValueBuffer[i], 2);
-			dataFile.write(buf, 2);
-		}
-		dataFile.write(buttonValueBuffer, numButtons);
+		blockDetectorBuffer.writeToFile(&dataFile);
+		switchPositionBuffer.writeToFile(&dataFile);
+		signalAspectBuffer.writeToFile(&dataFile);
+		analogValueBuffer.writeToFile(&dataFile); //2 bytes per value, lsb first
+		buttonValueBuffer.writeToFile(&dataFile);
 		dataFile.write(sysPowerStatus);
 		for (int i = 0; i < numSlots; i++)
 			dataFile.write(slotBuffer[i], 10);
@@ -384,29 +387,25 @@ void IoTT_DigitraxBuffers::loadFromFile(String fileName)
     File dataFile = SPIFFS.open(fileName, "r");
     if (dataFile)
     {
+		for (uint8_t i = 0; i < numDomains; i++) //everything changes
+			domainLock[i].writeBegin();
 		uint32_t fileSize = dataFile.size();
 		uint32_t minSize = numBDs;
 		Serial.printf("Load %i bytes from disk\n", fileSize);
 		if (fileSize >= minSize) 
-			dataFile.read(blockDetectorBuffer, numBDs);
+			blockDetectorBuffer.readFromFile(&dataFile);
 		minSize += numSwis;
 		if (fileSize >= minSize) 
-			dataFile.read(switchPositionBuffer, numSwis);
+			switchPositionBuffer.readFromFile(&dataFile);
 		minSize += numSigs;
 		if (fileSize >= minSize) 
-			dataFile.read(signalAspectBuffer, numSigs);
-		uint8_t buf[2];
+			signalAspectBuffer.readFromFile(&dataFile);
 		minSize += (2 * numAnalogVals);
 		if (fileSize >= minSize) 
-			for (int i = 0; i < numAnalogVals; i++)
-			{
-				dataFile.read(buf,2);
-//				analogValueBuffer[i] = (buf[0]<<8) + buf[1];
-				memcpy(&analogValueBuffer[i], &buf, 2);
-			}
+			analogValueBuffer.readFromFile(&dataFile);
 		minSize += numButtons;
 		if (fileSize >= minSize) 
-			dataFile.read(buttonValueBuffer, numButtons);
+			buttonValueBuffer.readFromFile(&dataFile);
 		minSize += 1;
 		if (fileSize >= minSize) 
 			dataFile.read(&sysPowerStatus, 1);
@@ -433,12 +432,43 @@ void IoTT_DigitraxBuffers::loadFromFile(String fileName)
 		dataFile.close();
 		for (int i = 1; i < maxSlots; i++)
 			slotBuffer[i][4] = 0x04 + sysPowerStatus;
+		for (uint8_t i = 0; i < numDomains; i++)
+			domainLock[i].writeEnd();
 		Serial.println("Digitrax Buffer Data File loaded");
 	}
     else
 		Serial.println("Unable to read Digitrax Buffer Data File");
 }
 
+void IoTT_DigitraxBuffers::printBufferStats()
+{
+	uint32_t chkSum = 0;
+	uint32_t startTime = micros();
+	for (uint16_t i = 0; i < numBDs; i++)
+		chkSum += blockDetectorBuffer.getValue(i);
+	for (uint16_t i = 0; i < numSwis; i++)
+		chkSum += switchPositionBuffer.getValue(i);
+	for (uint16_t i = 0; i < numSigs; i++)
+		chkSum += signalAspectBuffer.getValue(i);
+	for (uint16_t i = 0; i < numAnalogVals; i++)
+		chkSum += analogValueBuffer.getValue(i);
+	for (uint16_t i = 0; i < numButtons; i++)
+		chkSum += buttonValueBuffer.getValue(i);
+	uint32_t readTime = micros() - startTime;
+	uint32_t numReads = numBDs + numSwis + numSigs + numAnalogVals + numButtons;
+#ifdef useDenseBuffers
+	Serial.print("Dense buffers: ");
+#else
+	Serial.print("Paged buffers: ");
+#endif
+	Serial.printf("BD %i Swi %i Sig %i Analog %i Btn %i bytes, %i reads in %i us (%i)\n", blockDetectorBuffer.getResidentSize(), switchPositionBuffer.getResidentSize(), signalAspectBuffer.getResidentSize(), analogValueBuffer.getResidentSize(), buttonValueBuffer.getResidentSize(), numReads, readTime, chkSum);
+	Serial.printf("Location table %i bytes\n", locoZoneBuffer.getResidentSize() + locoNextBuffer.getResidentSize() + zoneHeadBuffer.getResidentSize());
+	Serial.print("Snapshot version/read retries:");
+	for (uint8_t i = 0; i < numDomains; i++)
+		Serial.printf(" %i/%i", domainLock[i].getVersion() >> 1, domainLock[i].getRetryCount());
+	Serial.println();
+}
+
 void IoTT_DigitraxBuffers::processLoop()
 {
 	if (dccPort)
@@ -476,14 +506,18 @@ void IoTT_DigitraxBuffers::processLoop()
 			{
 //				Serial.printf("Prog timeout");
 				lnTransmitMsg txBuffer;
+				domainLock[dbDomSlots].writeBegin();
 				memcpy(&slotBuffer[0x7C][0], &progSlot[0], 10);;
 				slotBuffer[0x7C][0] = 0x04;
+				domainLock[dbDomSlots].writeEnd();
 				prepSlotReadMsg(&txBuffer, 0x7C);
 				lnOutFct(txBuffer);
 				progMode = false;
 			}
 
 	}
+
+	processProgQueue();
 	
 	if (millis() - fcRefresh > fcRefreshInterval)
 	{
@@ -508,7 +542,10 @@ void IoTT_DigitraxBuffers::processLoop()
 void IoTT_DigitraxBuffers::processLocoNetMsg(lnReceiveBuffer * newData) 
 {
 	if (isCommandStation)
+	{
+		IoTT_SeqWrite slotWrite(&domainLock[dbDomSlots]); //slots are changed all over the slot manager
 		processSlotManager(newData); //includes DCC generator and updating the buffers if message was processes
+	}
 	else
 		processBufferUpdates(newData); //update the buffers
 }
@@ -517,6 +554,7 @@ void IoTT_DigitraxBuffers::writeProg(uint16_t dccAddr, uint8_t progMode, uint16_
 {
 	lnTransmitMsg txBuffer;
 	slotData * prSlot = getSlotData(0x7C);
+	domainLock[dbDomSlots].writeBegin();
 	switch (progMode)
 	{
 		case 0: (*prSlot)[0] = 0x60; //Prog track, byte mode
@@ -532,6 +570,7 @@ void IoTT_DigitraxBuffers::writeProg(uint16_t dccAddr, uint8_t progMode, uint16_
 	(*prSlot)[5] = (((cvNr-1) & 0x0080) >> 7) + (((cvNr-1) & 0x0300)>>4) + ((cvVal & 0x80)>>6); //CVH + Data 7
 	(*prSlot)[6] = ((cvNr-1) & 0x007F);//CVLO
 	(*prSlot)[7] = cvVal & 0x7F;
+	domainLock[dbDomSlots].writeEnd();
 	prepSlotWriteMsg(&txBuffer, 0x7C);
 	lnOutFct(txBuffer);
 }
@@ -540,6 +579,7 @@ void IoTT_DigitraxBuffers::readProg(uint16_t dccAddr, uint8_t progMode, uint16_t
 {
 	lnTransmitMsg txBuffer;
 	slotData * prSlot = getSlotData(0x7C);
+	domainLock[dbDomSlots].writeBegin();
 	switch (progMode)
 	{
 		case 0: (*prSlot)[0] = 0x20; //Prog track, byte mode
@@ -555,10 +595,287 @@ void IoTT_DigitraxBuffers::readProg(uint16_t dccAddr, uint8_t progMode, uint16_t
 	(*prSlot)[5] = (((cvNr-1) & 0x0080) >> 7) + (((cvNr-1) & 0x0300)>>4); //CVH 
 	(*prSlot)[6] = ((cvNr-1) & 0x007F);//CVLO
 	(*prSlot)[7] = 0;
+	domainLock[dbDomSlots].writeEnd();
 	prepSlotWriteMsg(&txBuffer, 0x7C);
 	lnOutFct(txBuffer);
 }
 
+bool IoTT_DigitraxBuffers::addProgJob(uint8_t opType, uint16_t dccAddr, uint8_t progMode, uint16_t cvNr, uint8_t cvVal)
+{
+	if ((opType > 2) || (progMode > 2))
+		return false;
+	progJob newJob;
+	newJob.opType = opType;
+	newJob.progMode = progMode;
+	newJob.dccAddr = dccAddr;
+	newJob.cvNr = cvNr;
+	newJob.cvVal = cvVal;
+	newJob.retryCtr = 0;
+	return progQueue.push(newJob);
+}
+
+void IoTT_DigitraxBuffers::clearProgQueue()
+{
+	progClearReq = true;
+}
+
+uint16_t IoTT_DigitraxBuffers::getProgQueueLevel()
+{
+	return progQueue.getFillLevel() + (progJobActive ? 1 : 0);
+}
+
+void IoTT_DigitraxBuffers::startProgJob()
+{
+	if (activeJob.opType == 1)
+		writeProg(activeJob.dccAddr, activeJob.progMode, activeJob.cvNr, activeJob.cvVal);
+	else
+		readProg(activeJob.dccAddr, activeJob.progMode, activeJob.cvNr);
+	progJobBlind = (activeJob.progMode == 1);
+	progJobBusy = false;
+	progJobSent = millis();
+	//no feedback in blind mode, otherwise wait 3 times the average reply time before trying again. A bitwise read on the prog track takes
+	//much longer than an ops mode write, so each op type and mode has its own average
+	progJobTimeout = progJobBlind ? progBlindTimeout : min(max(3 * progAvgLatency[activeJob.opType][activeJob.progMode], (uint32_t)progMinTimeout), (uint32_t)progTimeout);
+}
+
+void IoTT_DigitraxBuffers::endProgJob(uint8_t * programmerSlot) //report the result of the active job and start the next one in processProgQueue
+{
+	uint8_t * pStat = &programmerSlot[1];
+	if ((*pStat == 0) && (activeJob.opType == 2)) //verify, compare with expected value
+		if (((programmerSlot[7] & 0x7F) + ((programmerSlot[5] & 0x02) << 6)) != activeJob.cvVal)
+			*pStat |= 0x04;
+	progJobActive = false;
+	progOpCtr++;
+	if (*pStat != 0)
+		progFailCtr++;
+	if (*pStat & 0x01) //no loco on the track, no point in trying the rest
+		flushProgQueue();
+	if (handleProgrammerEvent)
+		handleProgrammerEvent(programmerSlot);
+}
+
+void IoTT_DigitraxBuffers::processProgAck(uint8_t ackCode)
+{
+	if (!progJobActive)
+		return;
+	switch (ackCode)
+	{
+		case 0x00: //programmer busy, try again in a moment
+			progJobBusy = true;
+			progBusyTimer = millis();
+			break;
+		case 0x7F: //mode not supported, no reply will come
+		{
+			slotData failSlot;
+			memcpy(&failSlot[0], &slotBuffer[0x7C][0], 10);
+			failSlot[1] = 0x02;
+			endProgJob(&failSlot[0]);
+			break;
+		}
+		case 0x40: //accepted blind, this is all we get
+			if (progJobBlind)
+			{
+				slotData doneSlot;
+				memcpy(&doneSlot[0], &slotBuffer[0x7C][0], 10);
+				doneSlot[1] = 0;
+				endProgJob(&doneSlot[0]);
+			}
+			break;
+	}
+}
+
+void IoTT_DigitraxBuffers::processProgReply(uint8_t * programmerSlot)
+{
+	if (progJobActive)
+	{
+		uint16_t cvNr = ((programmerSlot[5] & 0x30) << 4) + ((programmerSlot[5] & 0x01) << 7) + (programmerSlot[6] & 0x7F) + 1;
+		bool isWrite = (programmerSlot[0] & 0x40) > 0; //PCMD
+		bool isOpsMode = (programmerSlot[0] & 0x04) > 0;
+		if ((cvNr == activeJob.cvNr) && (isWrite == (activeJob.opType == 1)) && (isOpsMode == (activeJob.progMode != 0))) //a late reply of an earlier job with the same CV is not taken
+		{
+			uint32_t replyTime = millis() - progJobSent;
+			uint32_t * avgLatency = &progAvgLatency[activeJob.opType][activeJob.progMode];
+			*avgLatency = ((7 * *avgLatency) + replyTime) >> 3;
+			endProgJob(programmerSlot);
+			return;
+		}
+	}
+	if (handleProgrammerEvent) //reply to a request from somewhere else
+		handleProgrammerEvent(programmerSlot);
+}
+
+void IoTT_DigitraxBuffers::flushProgQueue()
+{
+	progJob oldJob;
+	while (progQueue.pop(oldJob))
+		progFailCtr++;
+	if (progJobActive)
+	{
+		progJobActive = false;
+		progFailCtr++;
+	}
+}
+
+void IoTT_DigitraxBuffers::processProgQueue()
+{
+	if (progClearReq)
+	{
+		progClearReq = false;
+		flushProgQueue();
+	}
+	if (progJobActive)
+	{
+		if (progJobBusy && ((millis() - progBusyTimer) > progBusyDelay))
+		{
+			uint32_t sentTime = progJobSent; //keep the timeout of the first attempt
+			startProgJob();
+			progJobSent = sentTime;
+		}
+		else
+			if ((millis() - progJobSent) > progJobTimeout)
+			{
+				if (activeJob.retryCtr < progMaxRetry)
+				{
+					activeJob.retryCtr++;
+					progRetryCtr++;
+					startProgJob();
+				}
+				else
+				{
+					slotData failSlot;
+					memcpy(&failSlot[0], &slotBuffer[0x7C][0], 10);
+					failSlot[1] = 0x02; //no ack
+					endProgJob(&failSlot[0]);
+				}
+			}
+		return;
+	}
+	if (progQueue.pop(activeJob))
+	{
+		if (progOpCtr == 0)
+			progBatchStart = millis();
+		progJobActive = true;
+		startProgJob();
+	}
+	else
+		if (progOpCtr > 0) //batch complete
+		{
+			uint32_t batchTime = millis() - progBatchStart;
+			Serial.printf("Programmer: %i CVs in %i ms, %.1f CVs per minute, %i retries, %i failed, avg reply %i ms\n", progOpCtr, batchTime, batchTime > 0 ? (60000.0 * progOpCtr) / batchTime : 0.0, progRetryCtr, progFailCtr, progAvgLatency[activeJob.opType][activeJob.progMode]);
+			progOpCtr = 0;
+			progRetryCtr = 0;
+			progFailCtr = 0;
+		}
+}
+
+//location table functions
+
+void IoTT_DigitraxBuffers::setLocoLocation(uint16_t zoneAddr, uint16_t locoAddr, bool isPresent, uint8_t locoDir)
+{
+	if ((zoneAddr >= numZones) || (locoAddr >= numLocoAddrs))
+		return;
+	uint16_t oldEntry = locoZoneBuffer.getValue(locoAddr);
+	uint16_t oldZone = (oldEntry & 0x1FFF) - 1; //noLocation if not detected
+	if (!isPresent)
+	{
+		if (oldZone != zoneAddr) //already reported in the next zone
+			return;
+		domainLock[dbDomLocation].writeBegin();
+		removeFromZone(zoneAddr, locoAddr);
+		locoZoneBuffer.setValue(locoAddr, 0);
+		domainLock[dbDomLocation].writeEnd();
+		if (handleLocationEvent)
+			handleLocationEvent(zoneAddr, locoAddr, 0);
+		return;
+	}
+	uint16_t newEntry = zoneAddr + 1;
+	if (locoDir <= 1)
+		newEntry |= 0x4000 | (locoDir << 15);
+	else
+		if (oldZone == zoneAddr)
+			newEntry |= (oldEntry & 0xC000); //keep direction from an earlier report
+	if (newEntry == oldEntry)
+		return;
+	domainLock[dbDomLocation].writeBegin(); //events are sent when the table is consistent again
+	if (oldZone != zoneAddr)
+	{
+		if (oldZone != noLocation)
+			removeFromZone(oldZone, locoAddr);
+		locoNextBuffer.setValue(locoAddr, zoneHeadBuffer.getValue(zoneAddr));
+		zoneHeadBuffer.setValue(zoneAddr, locoAddr + 1);
+	}
+	locoZoneBuffer.setValue(locoAddr, newEntry);
+	domainLock[dbDomLocation].writeEnd();
+	if (handleLocationEvent)
+	{
+		if ((oldZone != zoneAddr) && (oldZone != noLocation))
+			handleLocationEvent(oldZone, locoAddr, 0);
+		handleLocationEvent(zoneAddr, locoAddr, 1);
+	}
+}
+
+void IoTT_DigitraxBuffers::removeFromZone(uint16_t zoneAddr, uint16_t locoAddr) //walks the list of the zone, which only holds the few locos in that block
+{
+	uint16_t nextLoco = locoNextBuffer.getValue(locoAddr);
+	uint16_t thisLoco = zoneHeadBuffer.getValue(zoneAddr);
+	if (thisLoco == (locoAddr + 1))
+		zoneHeadBuffer.setValue(zoneAddr, nextLoco);
+	else
+		while (thisLoco > 0)
+		{
+			uint16_t followLoco = locoNextBuffer.getValue(thisLoco - 1);
+			if (followLoco == (locoAddr + 1))
+			{
+				locoNextBuffer.setValue(thisLoco - 1, nextLoco);
+				break;
+			}
+			thisLoco = followLoco;
+		}
+	locoNextBuffer.setValue(locoAddr, 0);
+}
+
+uint16_t IoTT_DigitraxBuffers::getLocoZone(uint16_t locoAddr)
+{
+	return (locoZoneBuffer.getValue(locoAddr) & 0x1FFF) - 1;
+}
+
+uint8_t IoTT_DigitraxBuffers::getLocoDir(uint16_t locoAddr)
+{
+	uint16_t thisEntry = locoZoneBuffer.getValue(locoAddr);
+	if (thisEntry & 0x4000)
+		return thisEntry >> 15;
+	else
+		return 0xFF;
+}
+
+uint16_t IoTT_DigitraxBuffers::getZoneLoco(uint16_t zoneAddr, uint16_t prevLoco)
+{
+	if (prevLoco == noLocation)
+		return zoneHeadBuffer.getValue(zoneAddr) - 1;
+	else
+		return locoNextBuffer.getValue(prevLoco) - 1;
+}
+
+uint8_t IoTT_DigitraxBuffers::getZoneLocoList(uint16_t zoneAddr, uint16_t * locoList, uint8_t maxLocos)
+{
+	uint8_t numLocos = 0;
+	domainLock[dbDomLocation].read([&]()
+	{
+		numLocos = 0;
+		uint16_t thisLoco = zoneHeadBuffer.getValue(zoneAddr);
+		while ((thisLoco > 0) && (numLocos < maxLocos))
+		{
+			locoList[numLocos++] = thisLoco - 1;
+			thisLoco = locoNextBuffer.getValue(thisLoco - 1);
+		}
+	});
+	return numLocos;
+}
+
+bool IoTT_DigitraxBuffers::isLocoInZone(uint16_t zoneAddr, uint16_t locoAddr)
+{
+	return (zoneAddr != noLocation) && (getLocoZone(locoAddr) == zoneAddr);
+}
 
 //status buffer update and access functions 
 
@@ -569,34 +886,35 @@ uint8_t IoTT_DigitraxBuffers::getPowerStatus()
 
 uint8_t IoTT_DigitraxBuffers::getButtonValue(uint16_t buttonNum)
 {
-	return buttonValueBuffer[buttonNum];
+	return buttonValueBuffer.getValue(buttonNum);
 }
 
 uint8_t IoTT_DigitraxBuffers::getBDStatus(uint16_t bdNum)
 {
 	uint16_t byteNr = bdNum>>3;  //	uint16_t byteNr = trunc(bdNum/8);
-	return ((blockDetectorBuffer[byteNr] >> (bdNum % 8)) & 0x01); //0=free, 1=occ
+	return ((blockDetectorBuffer.getValue(byteNr) >> (bdNum % 8)) & 0x01); //0=free, 1=occ
 }
 
 uint8_t IoTT_DigitraxBuffers::getSwiPosition(uint16_t swiNum)
 {
-	return ((switchPositionBuffer[swiNum >> 2] >> (2 * (swiNum % 4))) & 0x02) << 4;
+	return ((switchPositionBuffer.getValue(swiNum >> 2) >> (2 * (swiNum % 4))) & 0x02) << 4;
 }
 
 uint8_t IoTT_DigitraxBuffers::getSwiCoilStatus(uint16_t swiNum)
 {
-	return ((switchPositionBuffer[swiNum >> 2] >> (2 * (swiNum % 4))) & 0x01) << 4;
+	return ((switchPositionBuffer.getValue(swiNum >> 2) >> (2 * (swiNum % 4))) & 0x01) << 4;
 }
 
 uint8_t IoTT_DigitraxBuffers::getSwiStatus(uint16_t swiNum)
 {
-	return ((switchPositionBuffer[swiNum >> 2] >> (2 * (swiNum % 4))) & 0x03) << 4;
+	return ((switchPositionBuffer.getValue(swiNum >> 2) >> (2 * (swiNum % 4))) & 0x03) << 4;
 }
 
 void IoTT_DigitraxBuffers::setSwiStatus(uint16_t swiNum, bool swiPos, bool coilStatus)
 {
 	uint16_t byteNr = trunc(swiNum/4);
 	uint8_t inpPosStat = 0;
+	IoTT_SeqWrite swiWrite(&domainLock[dbDomSwitches]);
 	swWrPtr = (swWrPtr + 1) % switchProtLen;
 	switchProtocol[swWrPtr].devAddr = swiNum;
 	switchProtocol[swWrPtr].lastActivity = millis();
@@ -604,43 +922,53 @@ void IoTT_DigitraxBuffers::setSwiStatus(uint16_t swiNum, bool swiPos, bool coilS
 		inpPosStat |= 0x02;
 	if (coilStatus)
 		inpPosStat |= 0x01;
-    switchPositionBuffer[byteNr] &= ~(0x03<<(2*(swiNum % 4))); //clear bits
-    switchPositionBuffer[byteNr] |= inpPosStat<<(2*(swiNum % 4)); //set status bits
+    uint8_t swiByte = switchPositionBuffer.getValue(byteNr) & ~(0x03<<(2*(swiNum % 4))); //clear bits
+    switchPositionBuffer.setValue(byteNr, swiByte | (inpPosStat<<(2*(swiNum % 4)))); //set status bits
 }
 
 //get the time when switch received last command. Used for retriggering while active
 uint32_t IoTT_DigitraxBuffers::getLastSwiActivity(uint16_t swiNum)
 {
-	uint8_t thisOfs = swWrPtr + switchProtLen;
-	for (uint8_t i = 0; i < switchProtLen; i++)
+	uint32_t lastActivity = 0;
+	domainLock[dbDomSwitches].read([&]()
 	{
-		uint8_t thisEntry = (thisOfs - i) % switchProtLen;
-		if (switchProtocol[thisEntry].devAddr == swiNum)
-			return switchProtocol[thisEntry].lastActivity;
-	}
-	return 0;
+		lastActivity = 0;
+		uint8_t thisOfs = swWrPtr + switchProtLen;
+		for (uint8_t i = 0; i < switchProtLen; i++)
+		{
+			uint8_t thisEntry = (thisOfs - i) % switchProtLen;
+			if (switchProtocol[thisEntry].devAddr == swiNum)
+			{
+				lastActivity = switchProtocol[thisEntry].lastActivity;
+				break;
+			}
+		}
+	});
+	return lastActivity;
 }
 
 uint8_t IoTT_DigitraxBuffers::getSignalAspect(uint16_t sigNum)
 {
-	return signalAspectBuffer[sigNum];
+	return signalAspectBuffer.getValue(sigNum);
 }
 
 void IoTT_DigitraxBuffers::setSignalAspect(uint16_t sigNum, uint8_t sigAspect)
 {
-	signalAspectBuffer[sigNum] = (sigAspect & 0x1F);
+	IoTT_SeqWrite sigWrite(&domainLock[dbDomSignals]);
+	signalAspectBuffer.setValue(sigNum, sigAspect & 0x1F);
 }
 
 uint16_t IoTT_DigitraxBuffers::getAnalogValue(uint16_t analogNum)
 {
 //	Serial.printf("Get analog %i %i\n", analogNum, analogValueBuffer[analogNum]);
-	return analogValueBuffer[analogNum];
+	return analogValueBuffer.getValue(analogNum);
 }
 
 void IoTT_DigitraxBuffers::setAnalogValue(uint16_t analogNum, uint16_t analogValue)
 {
 //	Serial.printf("Set Analog %i %i \n", analogNum, analogValue);
-	analogValueBuffer[analogNum] = analogValue;
+	IoTT_SeqWrite inpWrite(&domainLock[dbDomInputs]);
+	analogValueBuffer.setValue(analogNum, analogValue);
 }
 
 bool IoTT_DigitraxBuffers::getBushbyWatch()
@@ -656,6 +984,7 @@ uint16_t IoTT_DigitraxBuffers::receiveDCCGeneratorFeedback(lnTransmitMsg txData)
 		case 5: //prog Answer
 		{
 			lnTransmitMsg txBuffer;
+			domainLock[dbDomSlots].writeBegin();
 			memcpy(&slotBuffer[0x7C][0], &progSlot[0], 10);;
 			int16_t retVal = (txData.lnData[7] << 8) + txData.lnData[8];
 			if (retVal == -1)
@@ -663,9 +992,10 @@ uint16_t IoTT_DigitraxBuffers::receiveDCCGeneratorFeedback(lnTransmitMsg txData)
 			else
 			{
 				slotBuffer[0x7C][0] = 0x00;
-				slotBuffer[0x7C][5] = (retVal & 0x38) >> 7; //high 3 of 10 bits
-				slotBuffer[0x7C][6] = retVal & 0x7F; //low 7 of 10 bits
+				slotBuffer[0x7C][5] = (slotBuffer[0x7C][5] & ~0x02) | ((retVal & 0x80) >> 6); //Data 7, keep CVH
+				slotBuffer[0x7C][7] = retVal & 0x7F; //Data
 			}
+			domainLock[dbDomSlots].writeEnd();
 			prepSlotReadMsg(&txBuffer, 0x7C);
 			lnOutFct(txBuffer);
 			progMode = false;
@@ -830,6 +1160,7 @@ void IoTT_DigitraxBuffers::processBufferUpdates(lnReceiveBuffer * newData) //pro
 				case 0x6F: //slot write
 					if (!isCommandStation)
 						progBusy =  (newData->lnData[2] == 1);
+					processProgAck(newData->lnData[2]);
 					break;
 			}
 			lastSwiAddr = 0xFFFF;
@@ -878,6 +1209,7 @@ void IoTT_DigitraxBuffers::processBufferUpdates(lnReceiveBuffer * newData) //pro
 						locoAddr = newData->lnData[4] & 0x7F;
 					else
 						locoAddr = (newData->lnData[3] << 7) + (newData->lnData[4] & 0x7F);
+					setLocoLocation(zoneAddr, locoAddr, (newData->lnData[1] & 0x20) > 0);
 					if (handleTranspondingEvent)
 						handleTranspondingEvent(zoneAddr, locoAddr, (newData->lnData[1] & 0x20)>>5);
 					break;
@@ -914,11 +1246,19 @@ void IoTT_DigitraxBuffers::processBufferUpdates(lnReceiveBuffer * newData) //pro
 			break;
 		}
 		case 0xE0: //OPC_MULTI_SENSE_LONG as used by Digikeijs railcom detector
-			if ((translateLissy) & (newData->lnData[1] == 0x09))
+			if (newData->lnData[1] == 0x09)
 			{
-				lnTransmitMsg thisBuffer;
-				prepLissyMsg(newData, &thisBuffer);
-				lnOutFct(thisBuffer);
+				uint16_t zoneAddr = ((newData->lnData[2] & 0x1F) << 7) + (newData->lnData[3] & 0x7F);
+				uint16_t locoAddr = ((newData->lnData[4] & 0x7F) << 7) + (newData->lnData[5] & 0x7F);
+				if (newData->lnData[4] == 0x7E) //short address
+					locoAddr = newData->lnData[5] & 0x7F;
+				setLocoLocation(zoneAddr, locoAddr, (newData->lnData[2] & 0x20) > 0, (newData->lnData[6] & 0x40) >> 6);
+				if (translateLissy)
+				{
+					lnTransmitMsg thisBuffer;
+					prepLissyMsg(newData, &thisBuffer);
+					lnOutFct(thisBuffer);
+				}
 			}
 			break;
         case 0xED: //OPC_IMM_PACKET
@@ -989,15 +1329,16 @@ void IoTT_DigitraxBuffers::processBufferUpdates(lnReceiveBuffer * newData) //pro
 						slotData * newSlot = &slotBuffer[slotNr];
 						newData->reqID = ((*newSlot)[0] ^ newData->lnData[3]) & 0x007F; //identify changes in slot status
 //						Serial.printf("RDWR %i %i %i\n", (*newSlot)[0], newData->lnData[3], newData->reqID);
+						domainLock[dbDomSlots].writeBegin();
 						memcpy(newSlot[0], &newData->lnData[3], 10);
+						domainLock[dbDomSlots].writeEnd();
 						switch (slotNr)
 						{
 							case 0x7B: //Fast Clock
 								break;
 							case 0x7C: //Programmer
 								if (newData->lnData[0] == 0xE7) //final programmer reply
-									if (handleProgrammerEvent)
-										handleProgrammerEvent(newSlot[0]);
+									processProgReply(newSlot[0]);
 								break;
 							case 0x7F: //System Configuration
 //								Serial.printf("Bushby Bit is %i \n", getBushbyStatus());
@@ -1026,6 +1367,7 @@ void IoTT_DigitraxBuffers::processBufferUpdates(lnReceiveBuffer * newData) //pro
 
 void IoTT_DigitraxBuffers::setPowerStatus(uint8_t newStatus)
 {
+	IoTT_SeqWrite powerWrite(&domainLock[dbDomPower]);
 	switch (newStatus)
 	{
 		case 0x82: ////OPC_OFF
@@ -1046,17 +1388,19 @@ void IoTT_DigitraxBuffers::setPowerStatus(uint8_t newStatus)
 
 void IoTT_DigitraxBuffers::setButtonValue(uint16_t buttonNum, uint8_t buttonValue)
 {
-	buttonValueBuffer[buttonNum] = buttonValue;
+	IoTT_SeqWrite inpWrite(&domainLock[dbDomInputs]);
+	buttonValueBuffer.setValue(buttonNum, buttonValue);
 }
 
 void IoTT_DigitraxBuffers::setBDStatus(uint16_t bdNum, bool bdStatus)
 {
+	IoTT_SeqWrite inpWrite(&domainLock[dbDomInputs]);
 	uint16_t byteNr = bdNum>>3;  //	uint16_t byteNr = trunc(bdNum/8);
     uint8_t bitMask = 0x01<<(bdNum % 8);
     if (bdStatus)
-		blockDetectorBuffer[byteNr] |= bitMask;
+		blockDetectorBuffer.setValue(byteNr, blockDetectorBuffer.getValue(byteNr) | bitMask);
 	else
-        blockDetectorBuffer[byteNr] &= ~bitMask;
+        blockDetectorBuffer.setValue(byteNr, blockDetectorBuffer.getValue(byteNr) & ~bitMask);
 }
 
 void IoTT_DigitraxBuffers::setProgStatus(bool progBusy)
@@ -1085,6 +1429,145 @@ uint8_t IoTT_DigitraxBuffers::getBushbyStatus()
 	return (((*ctrlSlot)[3] & 0x04) >> 2);
 }
 
+uint32_t IoTT_DigitraxBuffers::getDomainVersion(uint8_t domainNr)
+{
+	if (domainNr < numDomains)
+		return domainLock[domainNr].getVersion();
+	return 0;
+}
+
+uint32_t IoTT_DigitraxBuffers::getSlotSnapshot(uint8_t slotNum, slotData * destSlot)
+{
+	if (slotNum >= numSlots)
+		slotNum = 0;
+	return domainLock[dbDomSlots].read([&]() { memcpy(destSlot, &slotBuffer[slotNum], sizeof(slotData)); });
+}
+
+uint32_t IoTT_DigitraxBuffers::getSlotTableSnapshot(slotDataBuffer * destBuffer)
+{
+	return domainLock[dbDomSlots].read([&]() { memcpy(destBuffer, &slotBuffer, sizeof(slotDataBuffer)); });
+}
+
+uint8_t IoTT_DigitraxBuffers::getStateDomain(uint8_t bufNr)
+{
+	switch (bufNr)
+	{
+		case sbSwitches: return dbDomSwitches;
+		case sbSignals: return dbDomSignals;
+		case sbLocation: return dbDomLocation;
+		case sbSlots: return dbDomSlots;
+		case sbPower: return dbDomPower;
+		default: return dbDomInputs;
+	}
+}
+
+uint8_t IoTT_DigitraxBuffers::getStatePageCount(uint8_t bufNr)
+{
+	switch (bufNr)
+	{
+		case sbBDs: return blockDetectorBuffer.getNumPages();
+		case sbSwitches: return switchPositionBuffer.getNumPages();
+		case sbSignals: return signalAspectBuffer.getNumPages();
+		case sbAnalog: return analogValueBuffer.getNumPages();
+		case sbButtons: return buttonValueBuffer.getNumPages();
+		case sbLocation: return locoZoneBuffer.getNumPages();
+		case sbSlots: return numSlots / sbSlotsPerPage;
+		case sbPower: return 1;
+	}
+	return 0;
+}
+
+uint16_t IoTT_DigitraxBuffers::getStatePageBytes(uint8_t bufNr, uint8_t pageNr)
+{
+	if (pageNr >= getStatePageCount(bufNr))
+		return 0;
+	switch (bufNr)
+	{
+		case sbBDs: return blockDetectorBuffer.getPageLen(pageNr);
+		case sbSwitches: return switchPositionBuffer.getPageLen(pageNr);
+		case sbSignals: return signalAspectBuffer.getPageLen(pageNr);
+		case sbAnalog: return 2 * analogValueBuffer.getPageLen(pageNr);
+		case sbButtons: return buttonValueBuffer.getPageLen(pageNr);
+		case sbLocation: return 2 * locoZoneBuffer.getPageLen(pageNr);
+		case sbSlots: return sbSlotsPerPage * sizeof(slotData);
+		case sbPower: return 1;
+	}
+	return 0;
+}
+
+uint16_t IoTT_DigitraxBuffers::getStatePage(uint8_t bufNr, uint8_t pageNr, uint8_t * destBuf, uint32_t * domVersion)
+{
+	uint16_t pageBytes = getStatePageBytes(bufNr, pageNr);
+	if (pageBytes == 0)
+		return 0;
+	*domVersion = domainLock[getStateDomain(bufNr)].read([&]()
+	{
+		switch (bufNr)
+		{
+			case sbBDs: blockDetectorBuffer.readPage(pageNr, destBuf); break;
+			case sbSwitches: switchPositionBuffer.readPage(pageNr, destBuf); break;
+			case sbSignals: signalAspectBuffer.readPage(pageNr, destBuf); break;
+			case sbAnalog: analogValueBuffer.readPage(pageNr, (uint16_t*)destBuf); break;
+			case sbButtons: buttonValueBuffer.readPage(pageNr, destBuf); break;
+			case sbLocation: locoZoneBuffer.readPage(pageNr, (uint16_t*)destBuf); break;
+			case sbSlots: memcpy(destBuf, &slotBuffer[pageNr * sbSlotsPerPage], pageBytes); break;
+			case sbPower: destBuf[0] = sysPowerStatus; break;
+		}
+	});
+	return pageBytes;
+}
+
+bool IoTT_DigitraxBuffers::isInitPhase()
+{
+	return initPhase;
+}
+
+bool IoTT_DigitraxBuffers::setStatePage(uint8_t bufNr, uint8_t pageNr, uint8_t * srcBuf, uint16_t bufLen)
+{
+	if ((bufLen == 0) || (bufLen != getStatePageBytes(bufNr, pageNr)))
+		return false;
+	if ((bufNr == sbSlots) && isCommandStation) //we own the slots
+		return false;
+	bool hasData = false; //an empty page is no state, e.g. from a publisher that has just started
+	for (uint16_t i = 0; i < bufLen; i++)
+		hasData |= (srcBuf[i] != 0);
+	if (hasData)
+		initPhase = false; //state comes from another node, no need to ask the bus for all inputs
+	if (bufNr == sbLocation) //zone lists are updated and location events sent for every loco that changed
+	{
+		uint16_t * newEntry = (uint16_t*)srcBuf;
+		for (uint8_t i = 0; i < (bufLen >> 1); i++)
+		{
+			uint16_t locoAddr = (pageNr << pbPageBits) + i;
+			uint16_t oldEntry = locoZoneBuffer.getValue(locoAddr);
+			if (newEntry[i] == oldEntry)
+				continue;
+			if (newEntry[i] == 0)
+				setLocoLocation((oldEntry & 0x1FFF) - 1, locoAddr, false);
+			else
+				setLocoLocation((newEntry[i] & 0x1FFF) - 1, locoAddr, true, (newEntry[i] & 0x4000) ? (newEntry[i] >> 15) : 0xFF);
+		}
+		return true;
+	}
+	uint8_t oldPower = sysPowerStatus;
+	domainLock[getStateDomain(bufNr)].writeBegin();
+	switch (bufNr)
+	{
+		case sbBDs: blockDetectorBuffer.writePage(pageNr, srcBuf); break;
+		case sbSwitches: switchPositionBuffer.writePage(pageNr, srcBuf); break;
+		case sbSignals: signalAspectBuffer.writePage(pageNr, srcBuf); break;
+		case sbAnalog: analogValueBuffer.writePage(pageNr, (uint16_t*)srcBuf); break;
+		case sbButtons: buttonValueBuffer.writePage(pageNr, srcBuf); break;
+		case sbSlots: memcpy(&slotBuffer[pageNr * sbSlotsPerPage], srcBuf, bufLen); break;
+		case sbPower: sysPowerStatus = srcBuf[0]; break;
+	}
+	domainLock[getStateDomain(bufNr)].writeEnd();
+	if ((bufNr == sbPower) && (sysPowerStatus != oldPower))
+		if (handlePowerStatus)
+			handlePowerStatus(); //callback function to application
+	return true;
+}
+
 slotData * IoTT_DigitraxBuffers::getSlotData(uint8_t slotNum)
 {
 	return &slotBuffer[slotNum];
@@ -1100,6 +1583,7 @@ uint8_t IoTT_DigitraxBuffers::getSlotStatus(uint8_t slotNr)
 
 void IoTT_DigitraxBuffers::updateSlotStatus(uint8_t slotNr, uint8_t newStatus)
 {
+	IoTT_SeqWrite slotWrite(&domainLock[dbDomSlots]);
 	slotBuffer[slotNr][0] = newStatus;
 }
 
@@ -1116,6 +1600,7 @@ uint8_t IoTT_DigitraxBuffers::getSlotOfAddr(uint8_t locoAddrLo, uint8_t locoAddr
 	}
 	if (firstFree != 0xFF)
 	{
+		IoTT_SeqWrite slotWrite(&domainLock[dbDomSlots]);
 		slotBuffer[firstFree][1] = locoAddrLo;
 		slotBuffer[firstFree][6] = locoAddrHi;
 		return firstFree;
@@ -1149,6 +1634,7 @@ uint8_t IoTT_DigitraxBuffers::getFirstSlave(uint8_t masterSlot)
 
 void IoTT_DigitraxBuffers::updateTrackByte(bool setOp, uint8_t trackBits)
 {
+	IoTT_SeqWrite slotWrite(&domainLock[dbDomSlots]);
 	for (uint8_t i = 1; i < maxSlots; i++)
 	{
 		if (setOp)
@@ -1511,6 +1997,7 @@ void IoTT_DigitraxBuffers::setSlotDirfSpeed(lnReceiveBuffer * newData, bool send
 	slotData * thisSlot = getSlotData(newData->lnData[1]);
 	if (thisSlot) 
 	{
+		IoTT_SeqWrite slotWrite(&domainLock[dbDomSlots]); //includes the linked slots changed by iterateMULinks
 		if (focusNextAddr) //for Train side Sensor to select current slot
 		{
 			if (thisSlot)
@@ -1609,6 +2096,7 @@ void IoTT_DigitraxBuffers::generateFunctionCmd(lnReceiveBuffer * newData)
 void IoTT_DigitraxBuffers::purgeUnusedSlots()
 {
 	lnTransmitMsg txBuffer;
+	IoTT_SeqWrite slotWrite(&domainLock[dbDomSlots]);
 	for (uint8_t i = 1; i < maxSlots; i++)
 	{
 		if ((slotBuffer[i][0] & 0x80) > 0) //bit not cleared, so free slot
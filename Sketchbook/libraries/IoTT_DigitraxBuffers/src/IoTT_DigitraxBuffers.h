@@ -6,6 +6,9 @@
 #include <IoTT_CommDef.h>
 #include <IoTT_SerInjector.h>
 #include <IoTT_RemoteButtons.h>
+#include <IoTT_PagedBuffer.h>
+#include <IoTT_SeqLock.h>
+#include <IoTT_CommQueue.h>
 #include <SPIFFS.h>
 
 #define numSigs 2048
@@ -14,15 +17,45 @@
 #define numAnalogVals 4096
 #define numButtons 4096
 #define numSlots 128 //total system slots
+#define numLocoAddrs 10240 //location table, long addresses up to 10239
+#define numZones 4096 //transponding zones, 12 bit address
+#define noLocation 0xFFFF //return value for unknown zone or loco
 #define maxSlots 120 //locomotive slots
 
 #define bufferUpdateInterval 1000
 #define slotRequestInterval 1900
 #define switchProtLen 20
 #define progTimeout 10000
+#define progQueueSize 128 //programming jobs, 127 can be queued
+#define progMinTimeout 1000 //per job timeout is 3x the average reply time of its op type and mode, but at least this
+#define progBlindTimeout 500 //ops mode without feedback, job is done after LACK. Without one, it is retried up to progMaxRetry times, then fails
+#define progBusyDelay 100 //resend after programmer busy LACK
+#define progMaxRetry 2
 #define fcRefreshInterval 1000
 #define purgeInterval 65000
 
+//state domains, each has its own sequence lock and version for the snapshot functions
+#define dbDomSlots 0
+#define dbDomSwitches 1
+#define dbDomInputs 2 //block detectors, buttons and analog values
+#define dbDomSignals 3
+#define dbDomPower 4
+#define dbDomLocation 5
+#define numDomains 6
+
+//buffers that can be copied page by page to other nodes, see IoTT_StateSync.h
+#define sbBDs 0
+#define sbSwitches 1
+#define sbSignals 2
+#define sbAnalog 3
+#define sbButtons 4
+#define sbLocation 5 //locoZoneBuffer only, the zone lists are rebuilt from it
+#define sbSlots 6 //8 slots per page
+#define sbPower 7
+#define numStateBufs 8
+#define sbMaxPageBytes 128 //64 entries of 2 bytes
+#define sbSlotsPerPage 8
+
 typedef void (*dccFct) (uint8_t, uint8_t *); //slot nr, fct depending value array
 
 typedef uint8_t blockDetBuffer[numBDs]; //4096 input bits, 8 per byte, lsb is lowest number
@@ -34,6 +67,16 @@ typedef uint8_t powerStatusBuffer;
 typedef uint8_t slotData[10]; //slot data 0 is slot number, this is given by position in array, so we only need 10 bytes
 typedef slotData slotDataBuffer[numSlots];
 
+typedef struct
+{
+	uint8_t opType; //0: read 1: write 2: verify (read and compare with cvVal)
+	uint8_t progMode; //0: prog track 1: ops mode, no feedback 2: ops mode with feedback
+	uint16_t dccAddr;
+	uint16_t cvNr;
+	uint8_t cvVal;
+	uint8_t retryCtr;
+}progJob;
+
 extern DynamicJsonDocument * getDocPtr(String cmdFile, bool duplData);
 
 typedef struct
@@ -72,6 +115,10 @@ class IoTT_DigitraxBuffers
 		void processLocoNetMsg(lnReceiveBuffer * newData); //process incoming Loconet messages
 		void writeProg(uint16_t dccAddr, uint8_t progMode, uint16_t cvNr, uint8_t cvVal);
 		void readProg(uint16_t dccAddr, uint8_t progMode, uint16_t cvNr);
+		//programming queue. Jobs are executed one after the other, each result is reported through handleProgrammerEvent
+		bool addProgJob(uint8_t opType, uint16_t dccAddr, uint8_t progMode, uint16_t cvNr, uint8_t cvVal = 0); //returns false if queue is full or opType/progMode is invalid. Call from one task only
+		void clearProgQueue(); //can be called from any task, executed in processLoop
+		uint16_t getProgQueueLevel(); //jobs not yet completed, including the active one
 		void setPowerStatus(uint8_t newStatus);
 
 		//read and write buffer values
@@ -93,6 +140,7 @@ class IoTT_DigitraxBuffers
 		uint8_t getUpdateReqStatus();
 		void clearUpdateReqFlag(uint8_t clrFlagMask);
 		uint16_t receiveDCCGeneratorFeedback(lnTransmitMsg txData);
+		void printBufferStats(); //resident memory and read time of the status buffers
 		//LocoNet Management functions mainly for Command Station mode
 		//from incoming DCC command
 		//sensor slot finding functions
@@ -101,6 +149,34 @@ class IoTT_DigitraxBuffers
 		slotData * getSlotData(uint8_t slotNum);
 		int8_t getFocusSlotNr();
 		uint8_t getSlotOfAddr(uint8_t locoAddrLo, uint8_t locoAddrHi);
+		//location table from transponding and RailCom detector messages
+		void setLocoLocation(uint16_t zoneAddr, uint16_t locoAddr, bool isPresent, uint8_t locoDir = 0xFF); //locoDir 0xFF: unknown
+		uint16_t getLocoZone(uint16_t locoAddr); //noLocation if loco was not detected
+		uint8_t getLocoDir(uint16_t locoAddr); //0xFF if not known
+		uint16_t getZoneLoco(uint16_t zoneAddr, uint16_t prevLoco = noLocation); //first loco in zone, or the one after prevLoco. noLocation if none
+		bool isLocoInZone(uint16_t zoneAddr, uint16_t locoAddr);
+		//consistent copies for readers on other tasks. The buffers are updated by the task calling processLocoNetMsg, which never waits
+		//for a reader. The return value is the version of the domain, it changes with every update
+		uint32_t getDomainVersion(uint8_t domainNr);
+		uint32_t getSlotSnapshot(uint8_t slotNum, slotData * destSlot);
+		uint32_t getSlotTableSnapshot(slotDataBuffer * destBuffer);
+		uint8_t getZoneLocoList(uint16_t zoneAddr, uint16_t * locoList, uint8_t maxLocos); //returns the number of locos in the zone, up to maxLocos
+		template <typename F> uint32_t readDomain(uint8_t domainNr, F readFct) //for anything else, readFct is repeated if the domain changed while it was running
+		{
+			return domainLock[domainNr].read(readFct);
+		}
+		template <typename F> void writeDomain(uint8_t domainNr, F writeFct) //for buffer writes from outside, e.g. the WiThrottle client of IoTT_LBServer
+		{
+			IoTT_SeqWrite domainWrite(&domainLock[domainNr]);
+			writeFct();
+		}
+		//raw pages of the state buffers for IoTT_StateSync
+		uint8_t getStateDomain(uint8_t bufNr);
+		uint8_t getStatePageCount(uint8_t bufNr);
+		uint16_t getStatePageBytes(uint8_t bufNr, uint8_t pageNr);
+		uint16_t getStatePage(uint8_t bufNr, uint8_t pageNr, uint8_t * destBuf, uint32_t * domVersion); //any task, returns the number of bytes
+		bool setStatePage(uint8_t bufNr, uint8_t pageNr, uint8_t * srcBuf, uint16_t bufLen); //task running processLocoNetMsg only, srcBuf 2 byte aligned
+		bool isInitPhase(); //buffers are still filled from the bus after startup, nothing to publish yet
 
 	private: //functions
 		//write buffer values
@@ -108,6 +184,13 @@ class IoTT_DigitraxBuffers
 		void setButtonValue(uint16_t buttonNum, uint8_t buttonValue);
 		void setBDStatus(uint16_t bdNum, bool bdStatus);
 		void setProgStatus(bool progBusy);
+		void removeFromZone(uint16_t zoneAddr, uint16_t locoAddr);
+		void processProgQueue();
+		void flushProgQueue();
+		void startProgJob();
+		void endProgJob(uint8_t * programmerSlot);
+		void processProgAck(uint8_t ackCode);
+		void processProgReply(uint8_t * programmerSlot);
 
 		//LocoNet functions for Cmd Stn Client mode
 		void requestNextSlotUpdate();
@@ -133,6 +216,7 @@ class IoTT_DigitraxBuffers
 		void purgeUnusedSlots();
 
 	private: //variables
+		IoTT_SeqLock domainLock[numDomains];
 		sensorEntry sensorTable[32];
 		IoTT_Mux64Buttons * rhButtons = NULL;
 		bool isCommandStation = false;
@@ -159,6 +243,20 @@ class IoTT_DigitraxBuffers
 		uint8_t txPin = 26; 
 		bool progBusy = false;
 		uint8_t progCV = 0;
+		IoTT_CommQueue<progJob, progQueueSize> progQueue;
+		progJob activeJob;
+		bool progJobActive = false;
+		bool progJobBlind = false; //ops mode without feedback, done with LACK
+		bool progJobBusy = false; //programmer busy, resend after progBusyDelay
+		uint32_t progBusyTimer = 0;
+		volatile bool progClearReq = false;
+		uint32_t progJobSent = 0;
+		uint32_t progJobTimeout = progTimeout;
+		uint32_t progAvgLatency[3][3] = {{progTimeout / 3, progTimeout / 3, progTimeout / 3}, {progTimeout / 3, progTimeout / 3, progTimeout / 3}, {progTimeout / 3, progTimeout / 3, progTimeout / 3}}; //per opType and progMode, average time from sending the job to the reply
+		uint32_t progBatchStart = 0; //statistics for the current batch
+		uint16_t progOpCtr = 0;
+		uint16_t progRetryCtr = 0;
+		uint16_t progFailCtr = 0;
 		//RedHat                  
 		uint8_t ledLevel = 15; //0-100%
 };
@@ -175,4 +273,5 @@ extern void handleSignalEvent(uint16_t sigAddr, uint8_t sigAspect) __attribute__
 extern void handleAnalogValue(uint16_t analogAddr, uint16_t inputValue) __attribute__ ((weak));
 extern void handleButtonValue(uint16_t btnAddr, uint8_t inputValue) __attribute__ ((weak));
 extern void handleTranspondingEvent(uint16_t zoneAddr, uint16_t locoAddr, uint8_t eventVal) __attribute__ ((weak));
+extern void handleLocationEvent(uint16_t zoneAddr, uint16_t locoAddr, uint8_t eventVal) __attribute__ ((weak)); //location table change, eventVal 1: entered 0: left
 extern void handleProgrammerEvent(uint8_t * programmerSlot) __attribute__ ((weak));
@@ -0,0 +1,157 @@
+#ifndef IoTT_PagedBuffer_h
+#define IoTT_PagedBuffer_h
+
+#include <Arduino.h>
+#include <inttypes.h>
+#include <FS.h>
+
+//Status buffer for numEntries values of type T. Values are stored in pages of pbPageSize entries that are allocated on the first write
+//of a value other than 0, so a node using a few dozen addresses only keeps a few pages in RAM. Entries of pages not allocated read as 0
+//Define useDenseBuffers to use plain arrays instead, e.g. to compare memory and lookup time with printBufferStats() in IoTT_DigitraxBuffers
+
+//#define useDenseBuffers
+
+#define pbPageBits 6
+#define pbPageSize (1 << pbPageBits) //64 entries per page
+
+template <typename T, uint16_t numEntries> class IoTT_PagedBuffer
+{
+	public:
+		T getValue(uint16_t index)
+		{
+			if (index >= numEntries)
+				return 0;
+#ifdef useDenseBuffers
+			return denseBuffer[index];
+#else
+			uint8_t pageNr = index >> pbPageBits;
+			if ((pagePresent[pageNr >> 3] & (1 << (pageNr & 0x07))) == 0)
+				return 0;
+			return pageTable[pageNr][index & (pbPageSize - 1)];
+#endif
+		}
+
+		void setValue(uint16_t index, T newValue)
+		{
+			if (index >= numEntries)
+				return;
+#ifdef useDenseBuffers
+			denseBuffer[index] = newValue;
+#else
+			uint8_t pageNr = index >> pbPageBits;
+			if ((pagePresent[pageNr >> 3] & (1 << (pageNr & 0x07))) == 0)
+			{
+				if (newValue == 0) //page not needed
+					return;
+				if (!allocPage(pageNr))
+					return;
+			}
+			pageTable[pageNr][index & (pbPageSize - 1)] = newValue;
+#endif
+		}
+
+		uint32_t getResidentSize() //bytes used for the values and the page table
+		{
+#ifdef useDenseBuffers
+			return sizeof(denseBuffer);
+#else
+			uint32_t pageCtr = 0;
+			for (uint8_t i = 0; i < sizeof(pagePresent); i++)
+				pageCtr += __builtin_popcount(pagePresent[i]);
+			return (pageCtr * pbPageSize * sizeof(T)) + sizeof(pageTable) + sizeof(pagePresent);
+#endif
+		}
+
+		void writeToFile(File * dataFile) //same format as the plain array
+		{
+#ifdef useDenseBuffers
+			dataFile->write((uint8_t*)&denseBuffer[0], sizeof(denseBuffer));
+#else
+			T emptyPage[pbPageSize];
+			memset(emptyPage, 0, sizeof(emptyPage));
+			for (uint8_t i = 0; i < numPages; i++)
+				dataFile->write((uint8_t*)(pageTable[i] ? pageTable[i] : &emptyPage[0]), getPageLen(i) * sizeof(T));
+#endif
+		}
+
+		void readFromFile(File * dataFile)
+		{
+#ifdef useDenseBuffers
+			dataFile->read((uint8_t*)&denseBuffer[0], sizeof(denseBuffer));
+#else
+			T readPage[pbPageSize];
+			for (uint8_t i = 0; i < numPages; i++)
+			{
+				memset(readPage, 0, sizeof(readPage));
+				dataFile->read((uint8_t*)&readPage[0], getPageLen(i) * sizeof(T));
+				writePage(i, readPage);
+			}
+#endif
+		}
+
+		//page access for copying the buffer to other nodes. A page holds getPageLen() entries, the last one may be shorter
+		uint8_t getNumPages()
+		{
+			return numPages;
+		}
+
+		uint16_t getPageLen(uint8_t pageNr)
+		{
+			return min(pbPageSize, numEntries - (pageNr << pbPageBits));
+		}
+
+		void readPage(uint8_t pageNr, T * destPage) //entries of pages not allocated are 0
+		{
+#ifdef useDenseBuffers
+			memcpy(destPage, &denseBuffer[pageNr << pbPageBits], getPageLen(pageNr) * sizeof(T));
+#else
+			if (pageTable[pageNr] && (pagePresent[pageNr >> 3] & (1 << (pageNr & 0x07))))
+				memcpy(destPage, pageTable[pageNr], getPageLen(pageNr) * sizeof(T));
+			else
+				memset(destPage, 0, getPageLen(pageNr) * sizeof(T));
+#endif
+		}
+
+		void writePage(uint8_t pageNr, const T * srcPage) //allocates the page only if there is a value other than 0
+		{
+			uint16_t pageLen = getPageLen(pageNr);
+#ifdef useDenseBuffers
+			memcpy(&denseBuffer[pageNr << pbPageBits], srcPage, pageLen * sizeof(T));
+#else
+			bool hasData = false;
+			for (uint16_t j = 0; j < pageLen; j++)
+				hasData |= (srcPage[j] != 0);
+			if (hasData && allocPage(pageNr))
+				memcpy(pageTable[pageNr], srcPage, pageLen * sizeof(T));
+			else
+				if (pageTable[pageNr])
+					memset(pageTable[pageNr], 0, pbPageSize * sizeof(T));
+#endif
+		}
+
+	private:
+		static const uint8_t numPages = (numEntries + pbPageSize - 1) >> pbPageBits;
+#ifdef useDenseBuffers
+		T denseBuffer[numEntries] = {};
+#else
+		T * pageTable[numPages] = {};
+		uint8_t pagePresent[(numPages + 7) >> 3] = {}; //presence bitmap, 1 bit per page
+
+		bool allocPage(uint8_t pageNr)
+		{
+			if (pageTable[pageNr] == NULL)
+			{
+				pageTable[pageNr] = (T*) calloc(pbPageSize, sizeof(T));
+				if (pageTable[pageNr] == NULL)
+				{
+					Serial.println("Buffer page allocation failed");
+					return false;
+				}
+			}
+			pagePresent[pageNr >> 3] |= (1 << (pageNr & 0x07));
+			return true;
+		}
+#endif
+};
+
+#endif
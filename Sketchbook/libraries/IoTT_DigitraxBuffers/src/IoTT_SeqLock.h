@@ -0,0 +1,99 @@
+#ifndef IoTT_SeqLock_h
+#define IoTT_SeqLock_h
+
+#include <Arduino.h>
+#include <atomic>
+
+//Sequence lock for buffers that are written by one task and read by others. The writer never waits. The counter is odd while a write
+//is in progress, a reader copies the data and repeats if the counter was odd or has changed in the meantime. The even counter value
+//is the version of the data, it changes with every write.
+//Write sections can be nested. A read from inside a write section of the same task (e.g. an event handler called while the buffer is
+//updated) reads directly. Writes normally come from the task running processLocoNetMsg. A write from another task (WiThrottle client
+//on the TCP task) waits until the current write section has ended, so only there the writer may wait
+
+#define slRetryYield 16 //after this many retries, give a lower priority writer on the same core the chance to finish
+
+class IoTT_SeqLock
+{
+	public:
+		void writeBegin()
+		{
+			TaskHandle_t thisTask = xTaskGetCurrentTaskHandle();
+			if (writerTask.load(std::memory_order_relaxed) != thisTask)
+			{
+				uint16_t tryCtr = 0;
+				TaskHandle_t noTask = NULL;
+				while (!writerTask.compare_exchange_weak(noTask, thisTask, std::memory_order_acquire, std::memory_order_relaxed))
+				{
+					noTask = NULL;
+					if ((++tryCtr % slRetryYield) == 0)
+						vTaskDelay(1);
+				}
+			}
+			if (writeDepth++ > 0)
+				return;
+			seqCtr.store(seqCtr.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+			std::atomic_thread_fence(std::memory_order_release); //counter is odd before any data is written
+		}
+
+		void writeEnd()
+		{
+			if (--writeDepth > 0)
+				return;
+			seqCtr.store(seqCtr.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+			writerTask.store(NULL, std::memory_order_release);
+		}
+
+		//calls readFct until it ran without a write in between, returns the version of the data it has seen
+		template <typename F> uint32_t read(F readFct)
+		{
+			uint16_t tryCtr = 0;
+			while (true)
+			{
+				if (writerTask.load(std::memory_order_relaxed) == xTaskGetCurrentTaskHandle()) //inside our own write section
+				{
+					readFct();
+					return seqCtr.load(std::memory_order_relaxed) & ~0x01;
+				}
+				uint32_t startSeq = seqCtr.load(std::memory_order_acquire);
+				if ((startSeq & 0x01) == 0)
+				{
+					readFct();
+					std::atomic_thread_fence(std::memory_order_acquire);
+					if (seqCtr.load(std::memory_order_relaxed) == startSeq)
+						return startSeq;
+				}
+				retryCtr++;
+				if ((++tryCtr % slRetryYield) == 0)
+					vTaskDelay(1);
+			}
+		}
+
+		uint32_t getVersion()
+		{
+			return seqCtr.load(std::memory_order_acquire) & ~0x01;
+		}
+
+		uint32_t getRetryCount()
+		{
+			return retryCtr;
+		}
+
+	private:
+		std::atomic<uint32_t> seqCtr{0};
+		std::atomic<TaskHandle_t> writerTask{NULL}; //owner of the write section
+		uint8_t writeDepth = 0; //only used by the owner
+		volatile uint32_t retryCtr = 0; //statistics only, not exact with several readers
+};
+
+//write section for the lifetime of the object
+class IoTT_SeqWrite
+{
+	public:
+		IoTT_SeqWrite(IoTT_SeqLock * thisLock) : lockPtr(thisLock) { lockPtr->writeBegin(); }
+		~IoTT_SeqWrite() { lockPtr->writeEnd(); }
+	private:
+		IoTT_SeqLock * lockPtr;
+};
+
+#endif
@@ -0,0 +1,211 @@
+#include <IoTT_StateSync.h>
+
+const char * stateBufName[numStateBufs] = {"bd", "swi", "sig", "ana", "btn", "loc", "slot", "pwr"}; //sbBDs..sbPower
+
+IoTT_StateSync::IoTT_StateSync(IoTT_DigitraxBuffers * srcBuffers)
+{
+	stateBuffers = srcBuffers;
+	uint16_t numPages = 0;
+	for (uint8_t i = 0; i < numStateBufs; i++)
+	{
+		pageBase[i] = numPages;
+		numPages += stateBuffers->getStatePageCount(i);
+		bufVersion[i] = ssNoVersion;
+	}
+}
+
+IoTT_StateSync::~IoTT_StateSync()
+{
+	if (pageCrc)
+		free(pageCrc);
+	if (pageKnown)
+		free(pageKnown);
+	if (pageSent)
+		free(pageSent);
+}
+
+void IoTT_StateSync::nextScanBuf()
+{
+	scanBuf = (scanBuf + 1) % numStateBufs;
+	scanPage = 0;
+}
+
+//returns the next page that is different from what was published last time. Only buffers with a new domain version are checked, so
+//every write to a published buffer must go through the domain lock of DigitraxBuffers, otherwise the change is never sent
+int16_t IoTT_StateSync::getNextUpdate(char * subTopic, uint8_t * payload, bool prevSent)
+{
+	if (stateBuffers->isInitPhase()) //our buffers are not complete yet
+		return -1;
+	if (!pageCrc)
+	{
+		uint16_t numPages = pageBase[numStateBufs - 1] + stateBuffers->getStatePageCount(numStateBufs - 1);
+		pageCrc = (uint16_t*) calloc(numPages, sizeof(uint16_t));
+		pageKnown = (uint8_t*) calloc((numPages + 7) >> 3, 1);
+		pageSent = (uint8_t*) calloc((numPages + 7) >> 3, 1);
+		if (!pageCrc || !pageKnown || !pageSent)
+		{
+			Serial.println("State sync buffer allocation failed");
+			return -1;
+		}
+	}
+	if (!prevSent) //send it again with the next scan of this buffer
+	{
+		pageKnown[lastPageIdx >> 3] &= ~(1 << (lastPageIdx & 0x07));
+		bufVersion[lastBuf] = ssNoVersion;
+		txFailCtr++;
+	}
+	for (uint8_t i = 0; i < ssScanPages; i++)
+	{
+		if (scanPage == 0)
+		{
+			uint32_t thisVersion = stateBuffers->getDomainVersion(stateBuffers->getStateDomain(scanBuf));
+			if (thisVersion == bufVersion[scanBuf])
+			{
+				nextScanBuf();
+				continue;
+			}
+			scanVersion = thisVersion; //a change during the scan is found with the next one
+		}
+		uint8_t thisBuf = scanBuf;
+		uint8_t thisPage = scanPage;
+		uint32_t domVersion;
+		uint16_t pageBytes = stateBuffers->getStatePage(thisBuf, thisPage, (uint8_t*)&pageBuf[0], &domVersion);
+		if (++scanPage >= stateBuffers->getStatePageCount(thisBuf))
+		{
+			bufVersion[thisBuf] = scanVersion;
+			nextScanBuf();
+		}
+		uint16_t pageIdx = pageBase[thisBuf] + thisPage;
+		uint16_t thisCrc = crc16((uint8_t*)&pageBuf[0], pageBytes);
+		bool isKnown = (pageKnown[pageIdx >> 3] & (1 << (pageIdx & 0x07))) != 0;
+		if (isKnown && (pageCrc[pageIdx] == thisCrc))
+			continue;
+		bool hasData = false;
+		for (uint16_t j = 0; j < pageBytes; j++)
+			hasData |= (((uint8_t*)&pageBuf[0])[j] != 0);
+		bool wasSent = (pageSent[pageIdx >> 3] & (1 << (pageIdx & 0x07))) != 0;
+		pageCrc[pageIdx] = thisCrc;
+		pageKnown[pageIdx >> 3] |= (1 << (pageIdx & 0x07));
+		if (!hasData && !wasSent) //nothing we know of, the retained message stays
+			continue;
+		pageSent[pageIdx >> 3] |= (1 << (pageIdx & 0x07));
+		lastBuf = thisBuf;
+		lastPageIdx = pageIdx;
+		sprintf(subTopic, "%s/%i", stateBufName[thisBuf], thisPage);
+		txMsgCtr++;
+		txRawCtr += pageBytes;
+		if (!hasData)
+			return 0;
+		payload[0] = ssFormat;
+		for (uint8_t j = 0; j < 4; j++)
+			payload[j + 1] = (domVersion >> (8 * j)) & 0xFF;
+		uint16_t msgLen = ssHeaderLen + encodePage((uint8_t*)&pageBuf[0], pageBytes, &payload[ssHeaderLen]);
+		txByteCtr += msgLen;
+		return msgLen;
+	}
+	return -1;
+}
+
+void IoTT_StateSync::processStateMsg(char * subTopic, uint8_t * payload, uint16_t msgLen)
+{
+	char * pageStr = strchr(subTopic, '/');
+	if (!pageStr)
+		return;
+	uint8_t bufNr = 0;
+	while ((bufNr < numStateBufs) && ((strlen(stateBufName[bufNr]) != (pageStr - subTopic)) || (strncmp(subTopic, stateBufName[bufNr], pageStr - subTopic) != 0)))
+		bufNr++;
+	uint8_t pageNr = atoi(&pageStr[1]);
+	uint16_t pageBytes = bufNr < numStateBufs ? stateBuffers->getStatePageBytes(bufNr, pageNr) : 0;
+	if (pageBytes == 0)
+	{
+		rxBadCtr++;
+		return;
+	}
+	if (msgLen == 0) //all entries 0
+		memset(&pageBuf[0], 0, pageBytes);
+	else
+	{
+		if ((msgLen <= ssHeaderLen) || (payload[0] != ssFormat) || !decodePage(&payload[ssHeaderLen], msgLen - ssHeaderLen, (uint8_t*)&pageBuf[0], pageBytes))
+		{
+			rxBadCtr++;
+			return;
+		}
+		uint32_t domVersion = 0;
+		for (uint8_t j = 0; j < 4; j++)
+			domVersion |= (uint32_t)payload[j + 1] << (8 * j);
+		rxVersion[stateBuffers->getStateDomain(bufNr)] = domVersion;
+	}
+	if (stateBuffers->setStatePage(bufNr, pageNr, (uint8_t*)&pageBuf[0], pageBytes))
+		rxMsgCtr++;
+}
+
+void IoTT_StateSync::printStats()
+{
+	if (txMsgCtr)
+		Serial.printf("State sync Tx: %i pages %i bytes (%i uncompressed) %i failed\n", txMsgCtr, txByteCtr, txRawCtr, txFailCtr);
+	if (rxMsgCtr || rxBadCtr)
+	{
+		Serial.printf("State sync Rx: %i pages %i bad, versions", rxMsgCtr, rxBadCtr);
+		for (uint8_t i = 0; i < numDomains; i++)
+			Serial.printf(" %i", rxVersion[i] >> 1);
+		Serial.println();
+	}
+}
+
+uint16_t IoTT_StateSync::encodePage(uint8_t * srcBuf, uint16_t srcLen, uint8_t * destBuf)
+{
+	uint16_t inPos = 0;
+	uint16_t outPos = 0;
+	while (inPos < srcLen)
+		if (srcBuf[inPos] == 0)
+		{
+			uint8_t runLen = 0;
+			while ((inPos < srcLen) && (srcBuf[inPos] == 0) && (runLen < 255))
+			{
+				runLen++;
+				inPos++;
+			}
+			destBuf[outPos++] = 0;
+			destBuf[outPos++] = runLen;
+		}
+		else
+			destBuf[outPos++] = srcBuf[inPos++];
+	return outPos;
+}
+
+bool IoTT_StateSync::decodePage(uint8_t * srcBuf, uint16_t srcLen, uint8_t * destBuf, uint16_t destLen)
+{
+	uint16_t inPos = 0;
+	uint16_t outPos = 0;
+	while (inPos < srcLen)
+		if (srcBuf[inPos] == 0)
+		{
+			if ((inPos + 1) >= srcLen)
+				return false;
+			uint8_t runLen = srcBuf[inPos + 1];
+			if ((runLen == 0) || ((outPos + runLen) > destLen))
+				return false;
+			memset(&destBuf[outPos], 0, runLen);
+			outPos += runLen;
+			inPos += 2;
+		}
+		else
+		{
+			if (outPos >= destLen)
+				return false;
+			destBuf[outPos++] = srcBuf[inPos++];
+		}
+	return outPos == destLen;
+}
+
+uint16_t IoTT_StateSync::crc16(uint8_t * srcBuf, uint16_t srcLen) //CCITT
+{
+	uint16_t crc = 0xFFFF;
+	for (uint16_t i = 0; i < srcLen; i++)
+	{
+		crc ^= (uint16_t)srcBuf[i] << 8;
+		for (uint8_t j = 0; j < 8; j++)
+			crc = (crc & 0x8000) ? (crc << 1) ^ 0x1021 : crc << 1;
+	}
+	return crc;
+}
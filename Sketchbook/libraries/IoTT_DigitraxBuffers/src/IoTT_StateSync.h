@@ -0,0 +1,58 @@
+#ifndef IoTT_StateSync_h
+#define IoTT_StateSync_h
+
+#include <Arduino.h>
+#include <IoTT_DigitraxBuffers.h>
+
+//Copies the state buffers of IoTT_DigitraxBuffers to other nodes as retained MQTT messages, one message per buffer page with the
+//topic <StateTopic>/<buffer>/<page>, e.g. lnState/bd/3. The node connected to LocoNet publishes every page that has changed, so the broker
+//always holds the complete state. A node starting up subscribes to the state topic and gets all pages right away, then the changes.
+//Payload is the format byte, the domain version (4 bytes, lsb first) and the page data with runs of 0 coded as 0x00, run length.
+//A page with all entries 0 is sent with an empty payload, which deletes the retained message on the broker. Nothing is published before the
+//initial buffer refresh of the node is done, and pages that were never published are not sent while empty, so a restarted publisher
+//does not delete the state the broker still holds
+
+#define ssFormat 1
+#define ssHeaderLen 5
+#define ssScanPages 24 //pages checked per call of getNextUpdate
+#define ssNoVersion 0xFFFFFFFF //domain versions are even, so this forces a scan
+
+class IoTT_StateSync
+{
+	public:
+		IoTT_StateSync(IoTT_DigitraxBuffers * srcBuffers);
+		~IoTT_StateSync();
+		int16_t getNextUpdate(char * subTopic, uint8_t * payload, bool prevSent); //publisher, see stateSrcFct. Any task
+		void processStateMsg(char * subTopic, uint8_t * payload, uint16_t msgLen); //subscriber, task running processLocoNetMsg only
+		void printStats();
+
+	private:
+		uint16_t encodePage(uint8_t * srcBuf, uint16_t srcLen, uint8_t * destBuf);
+		bool decodePage(uint8_t * srcBuf, uint16_t srcLen, uint8_t * destBuf, uint16_t destLen);
+		uint16_t crc16(uint8_t * srcBuf, uint16_t srcLen);
+		void nextScanBuf();
+
+		IoTT_DigitraxBuffers * stateBuffers = NULL;
+		//publisher
+		uint16_t * pageCrc = NULL; //crc of the page content last published, allocated with the first call of getNextUpdate
+		uint8_t * pageKnown = NULL; //bitmap, page has been published
+		uint8_t * pageSent = NULL; //bitmap, page has been sent at least once since startup, empty pages are published only after that
+		uint16_t pageBase[numStateBufs]; //index of the first page of each buffer in pageCrc
+		uint32_t bufVersion[numStateBufs]; //domain version when all pages of the buffer were last checked
+		uint32_t scanVersion = 0;
+		uint8_t scanBuf = 0;
+		uint8_t scanPage = 0;
+		uint8_t lastBuf = 0;
+		uint16_t lastPageIdx = 0;
+		uint16_t pageBuf[sbMaxPageBytes >> 1]; //2 byte aligned for the 16 bit buffers
+		//statistics
+		uint32_t txMsgCtr = 0;
+		uint32_t txByteCtr = 0;
+		uint32_t txRawCtr = 0; //page bytes before compression
+		uint32_t txFailCtr = 0;
+		uint32_t rxMsgCtr = 0;
+		uint32_t rxBadCtr = 0;
+		uint32_t rxVersion[numDomains] = {}; //version of the sending node, last received
+};
+
+#endif
@@ -27,6 +27,11 @@ colorMode getColorModeByName(String colModeName)
   return constlevel; 
 }
 
+bool sameHSV(CHSV thisCol, CHSV otherCol)
+{
+	return (thisCol.h == otherCol.h) && (thisCol.s == otherCol.s) && (thisCol.v == otherCol.v);
+}
+
 displayType getDisplayTypeByName(String displayTypeName)
 {
   if (displayTypeName == "discrete") return discrete;
@@ -218,6 +223,7 @@ bool IoTT_LEDHandler::identifyLED(uint16_t ledNr)
 			{
 				idResult = true;
 				currentColor[i] = CHSV(0,0,255);
+				activeEffect[multiColor ? i : 0].fxMode = constlevel; //the pixel write stops it, send it again afterwards
 				parentObj->setCurrColHSV(ledAddrList[i], CHSV(0,0,255));
 			}
 		}
@@ -225,13 +231,91 @@ bool IoTT_LEDHandler::identifyLED(uint16_t ledNr)
 	return idResult;
 }
 
+uint16_t IoTT_LEDHandler::getEffectSlots() //number of coprocessor slots needed to animate this handler, 0 if there is nothing to animate
+{
+	if (displType == linear) //colors are interpolated on the ESP32
+		return 0;
+	for (uint16_t i = 0; i < cmdListLen; i++)
+		for (uint8_t j = 0; j < ledAddrListLen; j++)
+			if (cmdList[i]->dispMode[j] != constlevel)
+				return ledAddrListLen;
+	return 0;
+}
+
+bool IoTT_LEDHandler::usesGlobalModes() //global blink and ramp modes follow a common clock
+{
+	for (uint16_t i = 0; i < cmdListLen; i++)
+		for (uint8_t j = 0; j < ledAddrListLen; j++)
+			switch (cmdList[i]->dispMode[j])
+			{
+				case globalblinkpos:
+				case globalblinkneg:
+				case globalrampup:
+				case globalrampdown:
+					return true;
+				default:
+					break;
+			}
+	return false;
+}
+
+//sends the effect descriptor for blinking and ramp modes, so the coprocessor animates the LEDs. Returns false for static colors,
+//these are sent as pixel writes, which also stop a running effect. effectEnded tells the caller to write the pixel in any case
+bool IoTT_LEDHandler::updateEffect(uint8_t colorNr, IoTT_LEDCmdList * cmdDef, bool &effectEnded)
+{
+	ledEffectDef newEffect;
+	newEffect.fxMode = cmdDef->dispMode[colorNr];
+	if (newEffect.fxMode == constlevel)
+	{
+		effectEnded = (activeEffect[colorNr].fxMode != constlevel);
+		activeEffect[colorNr].fxMode = constlevel;
+		return false;
+	}
+	newEffect.baseCol = (cmdDef->colOn[colorNr] != NULL) ? cmdDef->colOn[colorNr]->HSVVal : CHSV(0,0,0);
+	switch (newEffect.fxMode)
+	{
+		case localblinkpos:
+		case localblinkneg:
+			newEffect.altCol = (cmdDef->colOff[colorNr] != NULL) ? cmdDef->colOff[colorNr]->HSVVal : CHSV(0,0,0);
+			break;
+		case globalblinkpos:
+		case globalblinkneg:
+			newEffect.altCol = (cmdDef->colOff[0] != NULL) ? cmdDef->colOff[0]->HSVVal : CHSV(0,0,0); //same as the streamed version
+			break;
+		default: //ramps fade the base color
+			newEffect.altCol = CHSV(newEffect.baseCol.h, newEffect.baseCol.s, 0);
+			break;
+	}
+	newEffect.baseCol.v = scale8(newEffect.baseCol.v, parentObj->brightness8);
+	newEffect.altCol.v = scale8(newEffect.altCol.v, parentObj->brightness8);
+	if ((newEffect.fxMode == localblinkpos) || (newEffect.fxMode == localblinkneg) || (newEffect.fxMode == localrampup) || (newEffect.fxMode == localrampdown))
+		newEffect.period = min(cmdDef->blinkRate[colorNr], (uint16_t)i2cMaxEffectPeriod);
+	else
+		newEffect.period = min(parentObj->blinkInterval, (uint16_t)i2cMaxEffectPeriod);
+	ledEffectDef * lastEffect = &activeEffect[colorNr];
+	if ((newEffect.fxMode != lastEffect->fxMode) || !sameHSV(newEffect.baseCol, lastEffect->baseCol) || !sameHSV(newEffect.altCol, lastEffect->altCol) || (newEffect.period != lastEffect->period) || (parentObj->refreshAnyway > 0))
+	{
+		if (multiColor)
+			parentObj->setEffect(&ledAddrList[colorNr], 1, &newEffect);
+		else
+			parentObj->setEffect(ledAddrList, ledAddrListLen, &newEffect);
+		*lastEffect = newEffect;
+		currentColor[colorNr] = newEffect.baseCol;
+	}
+	return true;
+}
 
 void IoTT_LEDHandler::updateChainDataForColor(uint8_t colorNr, IoTT_LEDCmdList * cmdDef, IoTT_LEDCmdList * cmdDefLin, uint8_t distance)
 {
 	CHSV targetCol, targetColLin;
 	bool flipBlink = false;
 	bool useGlobal = true;
+	bool effectEnded = false;
 	uint16_t timeElapsed;
+	uint8_t faderVal;
+	if (useEffects && (cmdDefLin == NULL))
+		if (updateEffect(colorNr, cmdDef, effectEnded))
+			return;
 //	Serial.printf("Disp Mode %i \n", cmdDef->dispMode[colorNr]);
 //	cmdDef->dispMode[colorNr] = 0;
 	switch (cmdDef->dispMode[colorNr])
@@ -244,19 +328,13 @@ void IoTT_LEDHandler::updateChainDataForColor(uint8_t colorNr, IoTT_LEDCmdList *
 		case globalrampdown: 
 			flipBlink = true;
 		case globalrampup: 
+			faderVal = flipBlink ? 255 - parentObj->globFader8 : parentObj->globFader8;
 			targetCol = cmdDef->colOn[colorNr]->HSVVal; 
-			if (flipBlink)
-				targetCol.v = round(targetCol.v * (1 - parentObj->globFaderValue));
-			else
-				targetCol.v = round(targetCol.v * parentObj->globFaderValue);
-			
+			targetCol.v = scale8(targetCol.v, faderVal);
 			if (cmdDefLin != NULL)
 			{
 				targetColLin = cmdDefLin->colOn[colorNr]->HSVVal; 
-				if (flipBlink)
-					targetColLin.v = round(targetColLin.v * (1 - parentObj->globFaderValue));
-				else
-					targetColLin.v = round(targetColLin.v * parentObj->globFaderValue);
+				targetColLin.v = scale8(targetColLin.v, faderVal);
 			}
 			break;
 		case globalblinkneg: 
@@ -288,21 +366,19 @@ void IoTT_LEDHandler::updateChainDataForColor(uint8_t colorNr, IoTT_LEDCmdList *
 				while (millis() > blinkTimer) //exception correction in case something is not initialized.
 					blinkTimer = millis() + cmdDef->blinkRate[colorNr];
 			}
-			locFaderValue = 1 - ((float_t)timeElapsed/(float_t)cmdDef->blinkRate[colorNr]);  //positive slope ramp from 0 to 1
-			targetCol = cmdDef->colOn[colorNr]->HSVVal; 
-			if (flipBlink)
-				targetCol.v = round(targetCol.v * (1 - locFaderValue));
+			if ((cmdDef->blinkRate[colorNr] > 0) && (timeElapsed < cmdDef->blinkRate[colorNr]))
+				locFader8 = 255 - (((uint32_t)timeElapsed * 255) / cmdDef->blinkRate[colorNr]);  //positive slope ramp from 0 to 255
 			else
-				targetCol.v = round(targetCol.v * locFaderValue);
+				locFader8 = 255;
+			faderVal = flipBlink ? 255 - locFader8 : locFader8;
+			targetCol = cmdDef->colOn[colorNr]->HSVVal; 
+			targetCol.v = scale8(targetCol.v, faderVal);
 			if (cmdDefLin != NULL)
 			{
 				targetColLin = cmdDefLin->colOn[colorNr]->HSVVal; 
-				if (flipBlink)
-					targetColLin.v = round(targetColLin.v * (1 - locFaderValue));
-				else
-					targetColLin.v = round(targetColLin.v * locFaderValue);
+				targetColLin.v = scale8(targetColLin.v, faderVal);
 			}
-//			Serial.printf("h: %i s: %i v: %i %i %i %g\n", targetCol.h, targetCol.s, targetCol.v, timeElapsed, cmdDef->blinkRate[colorNr], locFaderValue);
+//			Serial.printf("h: %i s: %i v: %i %i %i %i\n", targetCol.h, targetCol.s, targetCol.v, timeElapsed, cmdDef->blinkRate[colorNr], locFader8);
 			break;
 
 		case localblinkneg: 
@@ -342,24 +418,24 @@ void IoTT_LEDHandler::updateChainDataForColor(uint8_t colorNr, IoTT_LEDCmdList *
 			hueSpan = 255 - abs(hueSpan);
 			hueSign *= -1;
 		}
-		float_t distFact = (float_t)distance / 100;
-		int hueDist = hueSign * round((float_t)abs(hueSpan) * distFact);
+		//distance is in percent, integer rounding to nearest
+		int hueDist = hueSign * ((abs(hueSpan) * distance + 50) / 100);
 		targetCol.h = targetColLin.h + hueDist; 
 
 		int16_t sSpan = targetCol.s - targetColLin.s;
-		int sDist = round((float_t) sSpan * distFact);
+		int sDist = (sSpan * distance + (sSpan >= 0 ? 50 : -50)) / 100;
 		targetCol.s = targetColLin.s  + sDist;
 		
 		int16_t vSpan = targetCol.v - targetColLin.v;
-		int vDist = round((float_t) vSpan * distFact);
+		int vDist = (vSpan * distance + (vSpan >= 0 ? 50 : -50)) / 100;
 		targetCol.v = targetColLin.v  + vDist;
 
-//		Serial.printf("t: %i t1: %i d: %f r: %i %i %i %i %i %i\n", targetColLin.h, hueSpan, distFact, hueDist, sDist, vDist, targetCol.h, targetCol.s, targetCol.v);
+//		Serial.printf("t: %i t1: %i d: %i r: %i %i %i %i %i %i\n", targetColLin.h, hueSpan, distance, hueDist, sDist, vDist, targetCol.h, targetCol.s, targetCol.v);
 	}
 	
-	targetCol.v = round(targetCol.v * parentObj->getBrightness()); //this is the final target color, now we calculate the next step on the way there, if needed
+	targetCol.v = scale8(targetCol.v, parentObj->brightness8); //this is the final target color, now we calculate the next step on the way there, if needed
 
-	if ((targetCol.h != currentColor[colorNr].h) || (targetCol.s != currentColor[colorNr].s) || (targetCol.v != currentColor[colorNr].v) || (parentObj->refreshAnyway > 0))
+	if ((targetCol.h != currentColor[colorNr].h) || (targetCol.s != currentColor[colorNr].s) || (targetCol.v != currentColor[colorNr].v) || (parentObj->refreshAnyway > 0) || effectEnded)
 	{
 		uint16_t blinkPeriod;
 		if (useGlobal)
@@ -367,16 +443,17 @@ void IoTT_LEDHandler::updateChainDataForColor(uint8_t colorNr, IoTT_LEDCmdList *
 		else
 			blinkPeriod = cmdDef->blinkRate[colorNr];
 		uint16_t rateH;
-		if (blinkPeriod > 0)
-			rateH = round((255/(float)blinkPeriod)*(1000/(float)parentObj->ledUpdateInterval)); //val_units per LED refresh interval at given blink period
+		uint32_t rateDiv = (uint32_t)blinkPeriod * parentObj->ledUpdateInterval;
+		if (rateDiv > 0)
+			rateH = (255000 + (rateDiv >> 1)) / rateDiv; //val_units per LED refresh interval at given blink period
 		else
 			rateH = 255; //immediate change, period 0
 //		Serial.printf("Period: %i Rate %i\n", blinkPeriod, rateH);
 		int16_t hueChange = targetCol.h - currentColor[colorNr].h;
 		int16_t satChange = targetCol.s - currentColor[colorNr].s;
-		float satRatio = satChange / hueChange;
+		int16_t satRatio = hueChange != 0 ? satChange / hueChange : 0;
 		int16_t valChange = targetCol.v - currentColor[colorNr].v;
-		float valRatio = valChange / hueChange;
+		int16_t valRatio = hueChange != 0 ? valChange / hueChange : 0;
 
 		int newTarget_h = targetCol.h;
 		int newTarget_v = targetCol.v;
@@ -450,16 +527,15 @@ void IoTT_LEDHandler::updateChainDataForColor(uint8_t colorNr, IoTT_LEDCmdList *
 				}
 				else
 				{
-					currentColor[colorNr].s = currentColor[colorNr].s + round(myDeltaH * satRatio);
-					currentColor[colorNr].v = currentColor[colorNr].v + round(myDeltaH * valRatio);
+					currentColor[colorNr].s = currentColor[colorNr].s + (myDeltaH * satRatio);
+					currentColor[colorNr].v = currentColor[colorNr].v + (myDeltaH * valRatio);
 				}
 				break;
 		}
 		if (multiColor)
 			parentObj->setCurrColHSV(ledAddrList[colorNr], currentColor[colorNr]);
 		else
-			for (int i = 0; i < ledAddrListLen; i++)
-				parentObj->setCurrColHSV(ledAddrList[i], currentColor[colorNr]);
+			parentObj->setCurrColHSV(ledAddrList, ledAddrListLen, currentColor[colorNr]); //convert once for all LEDs of this handler
 	}
 }
 
@@ -694,14 +770,27 @@ void IoTT_LEDHandler::updateAnalogValue()
 void IoTT_LEDHandler::updateTransponder()
 {
 	IoTT_LEDCmdList * cmdDef = NULL;
-	//get target color based on status
-
-	if (lastValue != lastExtStatus)
+	//get target color based on status. 0: one of the locos in condAddrList, or any loco if the list is empty, is in the zone, 1: not
+	uint16_t zoneAddr = ctrlAddrList[0];
+	uint8_t zoneStatus = 1;
+	if (condAddrListLen > 0)
+	{
+		for (uint16_t i = 0; i < condAddrListLen; i++)
+			if (digitraxBuffer->isLocoInZone(zoneAddr, condAddrList[i]))
+			{
+				zoneStatus = 0;
+				break;
+			}
+	}
+	else
+		if (digitraxBuffer->getZoneLoco(zoneAddr) != noLocation)
+			zoneStatus = 0;
+	if (lastValue != zoneStatus)
 	{
-		lastValue = lastExtStatus;
+		lastValue = zoneStatus;
 		blinkTimer = millis();
 	}
-	cmdDef = cmdList[lastExtStatus];
+	cmdDef = cmdList[zoneStatus];
 	//update chain LED's
 	if (cmdDef != NULL)
 		updateChainData(cmdDef);
@@ -760,21 +849,6 @@ void IoTT_LEDHandler::updateLEDs()
     }
 }
 
-void IoTT_LEDHandler::processTranspEvent(uint16_t btnAddr, uint16_t eventValue)
-{
-//	Serial.printf("Transponder event Zone %i Move %i Addr %i\n", btnAddr, (eventValue & 0x8000) >> 15, eventValue & 0x7FFF);
-	if (ctrlAddrListLen > 0)
-		if (ctrlAddrList[0] == btnAddr)
-			if (condAddrListLen > 0)
-				for (uint16_t i = 0; i < condAddrListLen; i++)
-					if (condAddrList[i] == (eventValue & 0x7FFF))
-					{
-//						Serial.printf("Execute Transponder event Zone %i Move %i Addr %i\n", btnAddr, (eventValue & 0x8000) >> 15, eventValue & 0x7FFF);
-						lastExtStatus = ((eventValue & 0x8000)>>15) ^ 0x01;
-						break;
-					}
-}
-
 void IoTT_LEDHandler::loadLEDHandlerJSON(JsonObject thisObj)
 {
 	freeObjects();
@@ -785,10 +859,12 @@ void IoTT_LEDHandler::loadLEDHandlerJSON(JsonObject thisObj)
 		ledAddrListLen = LEDNums.size();
 		ledAddrList = (uint16_t*) realloc (ledAddrList, ledAddrListLen * sizeof(uint16_t));
 		currentColor = (CHSV*) realloc (currentColor, ledAddrListLen * sizeof(CHSV));
+		activeEffect = (ledEffectDef*) realloc (activeEffect, ledAddrListLen * sizeof(ledEffectDef));
 		for (int i=0; i<ledAddrListLen;i++)
 		{
 			ledAddrList[i] = LEDNums[i];
 			currentColor[i] = CHSV(0,0,0);
+			activeEffect[i].fxMode = constlevel;
 		}
 	}
 	if (thisObj.containsKey("MultiColor"))
@@ -918,6 +994,7 @@ void IoTT_ledChain::loadLEDChainJSONObj(JsonObject doc, bool resetList)
         currentBrightness = doc["ChainParams"]["Brightness"]["InitLevel"];
         if (currentBrightness > 1 || (currentBrightness < 0))
 			currentBrightness = 0.8;
+		setBrightness(currentBrightness);
         Serial.printf("JSON Brightness: %f\n", currentBrightness);
         if (doc.containsKey("MQTT"))
         {
@@ -999,6 +1076,8 @@ void IoTT_ledChain::loadLEDChainJSONObj(JsonObject doc, bool resetList)
 		}
 		LEDHandlerListLen += newListLen;
         Serial.printf("%i LED Defs loaded\n", LEDHandlerListLen);
+		if (i2cVerified)
+			assignEffectSlots();
 	}
 	else
 		Serial.println("No LED Chain defined");
@@ -1034,6 +1113,7 @@ float_t IoTT_ledChain::getBrightness()
 void IoTT_ledChain::setBrightness(float_t newVal)
 {
 	currentBrightness = newVal;
+	brightness8 = round(constrain(newVal, 0, 1) * 255);
  //   Serial.printf("Set new Brightness: %f\n", currentBrightness);
  }
 
@@ -1059,6 +1139,7 @@ CRGB * IoTT_ledChain::initChain(word numLEDs)
 	blinkTimer = millis() + blinkInterval;
 	ledUpdateTimer = millis() + ledUpdateInterval + 5; //5ms ofset to Buttons
 	globFaderValue = 0;
+	globFader8 = 0;
 	return ledChain;
 }
 
@@ -1107,6 +1188,48 @@ void IoTT_ledChain::setCurrColHSV(uint16_t ledNr, CHSV newCol)
 	}
 }
 
+void IoTT_ledChain::setCurrColHSV(uint16_t * ledList, uint8_t listLen, CHSV newCol)
+{
+	CRGB newRGB = newCol; //HSV to RGB conversion done once for the entire group
+#ifdef useRTOS
+	xSemaphoreTake(ledBaton, portMAX_DELAY);
+#endif
+	for (uint8_t i = 0; i < listLen; i++)
+	{
+		uint16_t ledNr = ledList[i];
+		if (ledNr < chainLength)
+			switch (chainMode)
+			{
+				case hatDirect:
+					ledChain[ledNr] = newRGB;
+					break;
+				case hatI2C:
+					setI2CLED(ledNr, newCol);
+					break;
+			}
+	}
+	needUpdate = true;
+#ifdef useRTOS
+	xSemaphoreGive(ledBaton);
+#endif
+}
+
+void IoTT_ledChain::setEffect(uint16_t * ledList, uint8_t listLen, ledEffectDef * newEffect)
+{
+	if (chainMode != hatI2C)
+		return;
+#ifdef useRTOS
+	xSemaphoreTake(ledBaton, portMAX_DELAY);
+#endif
+	for (uint8_t i = 0; i < listLen; i++)
+		if (ledList[i] < chainLength)
+			setI2CEffect(ledList[i], newEffect);
+	needUpdate = true;
+#ifdef useRTOS
+	xSemaphoreGive(ledBaton);
+#endif
+}
+
 void IoTT_ledChain::setBlinkRate(uint16_t blinkVal)
 {
 	blinkInterval = blinkVal;
@@ -1197,6 +1320,7 @@ void IoTT_ledChain::showI2CLED()
 	thisWire->beginTransmission(I2CAddr);
 	thisWire->write(0xFF);
 	thisWire->endTransmission();
+	i2cLEDBytes++;
 }
 
 void IoTT_ledChain::setI2CLED(uint16_t ledNr, CHSV newCol)
@@ -1211,9 +1335,66 @@ void IoTT_ledChain::setI2CLED(uint16_t ledNr, CHSV newCol)
 		thisWire->write(newCol.s);
 		thisWire->write(newCol.v);
 		lastCol = newCol;
+		i2cLEDBytes += 3;
 	}
 	thisWire->endTransmission(false);
 	ledChain[ledNr] = newCol;
+	i2cLEDBytes += 2;
+}
+
+//effect descriptor, the coprocessor animates the LED until the next pixel or effect command for it:
+//LED# high, LED# low, mode (colorMode), base color h, s, v, alternate color h, s, v, period high, period low, phase (1/256 of a cycle)
+void IoTT_ledChain::setI2CEffect(uint16_t ledNr, ledEffectDef * newEffect)
+{
+	thisWire->beginTransmission(I2CAddr);
+	thisWire->write((ledNr & 0xFF00)>>8);
+	thisWire->write(ledNr & 0x00FF);
+	thisWire->write(newEffect->fxMode);
+	thisWire->write(newEffect->baseCol.h);
+	thisWire->write(newEffect->baseCol.s);
+	thisWire->write(newEffect->baseCol.v);
+	thisWire->write(newEffect->altCol.h);
+	thisWire->write(newEffect->altCol.s);
+	thisWire->write(newEffect->altCol.v);
+	thisWire->write((newEffect->period & 0xFF00)>>8);
+	thisWire->write(newEffect->period & 0x00FF);
+	thisWire->write(0); //phase, all LEDs of a handler start together
+	thisWire->endTransmission(false);
+	ledChain[ledNr] = newEffect->baseCol;
+	i2cLEDBytes += i2cEffectCmdLen;
+}
+
+//handlers with blinking or ramp modes get their LEDs animated by the coprocessor, as long as it has free slots. The others are streamed.
+//Global modes run from the clock of the coprocessor when offloaded and from blinkInterval here when streamed. The two clocks are not in
+//step, so handlers with global modes are offloaded only if all of them fit, otherwise they are all streamed
+void IoTT_ledChain::assignEffectSlots()
+{
+	uint16_t slotsLeft = i2cEffectSlots;
+	uint16_t globalSlots = 0;
+	bool globalFits = true;
+	for (uint16_t i = 0; i < LEDHandlerListLen; i++)
+		if (LEDHandlerList[i]->usesGlobalModes())
+		{
+			uint16_t slotsNeeded = LEDHandlerList[i]->getEffectSlots();
+			globalFits &= (slotsNeeded > 0); //linear handlers are always streamed
+			globalSlots += slotsNeeded;
+		}
+	globalFits &= (globalSlots <= slotsLeft);
+	if (globalFits)
+		slotsLeft -= globalSlots;
+	for (uint16_t i = 0; i < LEDHandlerListLen; i++)
+	{
+		if (LEDHandlerList[i]->usesGlobalModes())
+		{
+			LEDHandlerList[i]->useEffects = globalFits;
+			continue;
+		}
+		uint16_t slotsNeeded = LEDHandlerList[i]->getEffectSlots();
+		LEDHandlerList[i]->useEffects = (slotsNeeded > 0) && (slotsNeeded <= slotsLeft);
+		if (LEDHandlerList[i]->useEffects)
+			slotsLeft -= slotsNeeded;
+	}
+	Serial.printf("LED effects: %i of %i coprocessor slots used%s\n", i2cEffectSlots - slotsLeft, i2cEffectSlots, ((globalSlots > 0) && !globalFits) ? ", global modes streamed" : "");
 }
 
 void IoTT_ledChain::resetI2CWDT()
@@ -1237,6 +1418,7 @@ int8_t IoTT_ledChain::pingI2CDevice(uint8_t numBytes)
 	while (thisWire->available())
 		char c = thisWire->read();
 	uint8_t devData[numBytes];
+	memset(devData, 0xFF, numBytes); //firmware without effects sends 5 bytes only
 //	Serial.printf("Ping device %2X for %i bytes \n", I2CAddr, numBytes);
 	
 	uint8_t byteCount = 0;
@@ -1256,7 +1438,7 @@ int8_t IoTT_ledChain::pingI2CDevice(uint8_t numBytes)
 	else
 	{
 		resetI2CWDT();
-		for (byteCount = 0; byteCount < 5; byteCount++ )
+		for (byteCount = 0; byteCount < numBytes; byteCount++ )
 		{
 			thisWire->requestFrom(I2CAddr, 1);
 			if (thisWire->available())
@@ -1269,13 +1451,14 @@ int8_t IoTT_ledChain::pingI2CDevice(uint8_t numBytes)
 	}
 //	Serial.println();
 //	Serial.println(byteCount);
-	if (byteCount >= numBytes)
+	if (byteCount >= 5)
 	{
 		if (devData[0] > 0)
 		{
 			i2cDevID = devData[0]; //0x55 YellowHat 0x56 GreenHat
 			i2cChainLength = (devData[1]<<8) + devData[2];
 			i2cChainType = (devData[3]<<8) + devData[4];
+			i2cEffectSlots = ((byteCount > 5) && (devData[5] != 0xFF)) ? devData[5] : 0;
 //			Serial.printf("I2C LED Chain Dev %i Type %i Length %i\n", i2cDevID, i2cChainType, i2cChainLength);
 		}
 		return devData[0];
@@ -1326,30 +1509,6 @@ void IoTT_ledChain::setI2CLEDType(uint16_t ledType)
 //	refreshAnyway = true;
 }
 
-void IoTT_ledChain::processBtnEvent(sourceType inputEvent, uint16_t btnAddr, uint16_t eventValue)
-{
-	switch (inputEvent)
-	{
-		case evt_transponder:
-//			Serial.println("Step 1");
-			if (LEDHandlerListLen > 0)
-			{
-//				Serial.println("Step 2");
-				for (uint16_t i = 0; i < LEDHandlerListLen; i++)
-				{
-//					Serial.printf("Step 3 Handler %i Evt %i\n", i, LEDHandlerList[i]->ctrlSource);
-					if (LEDHandlerList[i]->ctrlSource == inputEvent)
-					{
-//						Serial.println("Step 4");
-						LEDHandlerList[i]->processTranspEvent(btnAddr, eventValue);
-					}
-				}
-				
-			}
-			break;
-	}
-}
-
 void IoTT_ledChain::processChain()
 {
 	if (txMQTT) return;
@@ -1370,6 +1529,10 @@ void IoTT_ledChain::processChain()
 	    }
 	}
     globFaderValue = 1 - ((float_t)timeElapsed/(float_t)blinkInterval);  //positive slope ramp from 0 to 1
+	if ((blinkInterval > 0) && (timeElapsed < blinkInterval))
+		globFader8 = 255 - (((uint32_t)timeElapsed * 255) / blinkInterval); //integer version used by the LED handlers
+	else
+		globFader8 = 255;
 //    Serial.printf("%f\n", globFaderValue);
 	if ((millis() > ledUpdateTimer) || rollOver)
 	{
@@ -1384,7 +1547,7 @@ void IoTT_ledChain::processChain()
 			if (pingCtr > 20)
 			{
 				pingCtr = 0;
-				i2cDevID = pingI2CDevice(5);
+				i2cDevID = pingI2CDevice(6);
 				if (i2cChainType != colTypeNum)
 					setI2CLEDType(colTypeNum);
 				else
@@ -1394,6 +1557,8 @@ void IoTT_ledChain::processChain()
 					{
 						resetI2CDevice(false);
 						i2cVerified = true;
+						assignEffectSlots();
+						refreshAnyway = 2; //the coprocessor restarted, send all colors and effects again
 					}
 			}
 		}	
@@ -1401,7 +1566,11 @@ void IoTT_ledChain::processChain()
 		{
 			if ((millis() > endIdentify) || rollOver)
 			{
+				uint32_t frameStart = micros();
 				updateLEDs();
+				frameTime = micros() - frameStart;
+				if (frameTime > maxFrameTime)
+					maxFrameTime = frameTime;
 				if (tempLEDCtr > 0)
 					while (tempLEDCtr > 0)
 					{
@@ -13,6 +13,8 @@
 //#define useRTOS
 
 #define i2cMaxChainLength 525
+#define i2cEffectCmdLen 12 //LED effect descriptor, see setI2CEffect
+#define i2cMaxEffectPeriod 32767
 
 enum chainModeType : byte {hatDirect=0, hatI2C = 1}; //, hatSerComm = 2};
 enum transitionType : byte {soft=0, direct=1, merge=2};
@@ -22,6 +24,14 @@ enum displayType : byte {discrete=0, linear=1};
 class IoTT_ledChain;
 class IoTT_LEDHandler;
 
+typedef struct //animation of an LED, running on the I2C LED coprocessor
+{
+	uint8_t fxMode = constlevel; //colorMode, constlevel if no effect is running
+	CHSV baseCol; //on color, ramp color
+	CHSV altCol; //off color of blinking modes
+	uint16_t period = 0; //blink half cycle or ramp cycle in ms
+} ledEffectDef;
+
 class IoTT_ColorDefinitions
 {
 	public:
@@ -65,7 +75,8 @@ class IoTT_LEDHandler
 		void updateLEDs();
 		void updateLocalBlinkValues();
 		bool identifyLED(uint16_t ledNr);
-		void processTranspEvent(uint16_t btnAddr, uint16_t eventValue);
+		uint16_t getEffectSlots();
+		bool usesGlobalModes();
 	private:
 		void freeObjects();
 		void updateBlockDet();
@@ -79,6 +90,7 @@ class IoTT_LEDHandler
 		void updateConstantLED();
 		void updateChainData(IoTT_LEDCmdList * cmdDef, IoTT_LEDCmdList * cmdDefLin = NULL, uint8_t distance = 0);
 		void updateChainDataForColor(uint8_t colorNr, IoTT_LEDCmdList * cmdDef, IoTT_LEDCmdList * cmdDefLin = NULL, uint8_t distance = 0);
+		bool updateEffect(uint8_t colorNr, IoTT_LEDCmdList * cmdDef, bool &effectEnded);
 	public:
 		IoTT_ledChain* parentObj = NULL;
 	public:
@@ -95,14 +107,15 @@ class IoTT_LEDHandler
 		uint8_t displType = 0;
 
 		CHSV * currentColor = NULL; //CHSV(0,0,0);
+		ledEffectDef * activeEffect = NULL; //effect sent to the coprocessor, per color
+		bool useEffects = false; //blinking and ramps are animated by the coprocessor, set by IoTT_ledChain::assignEffectSlots
 		uint16_t blinkInterval = 500;
 		uint32_t blinkTimer = millis();
 		bool     blinkStatus = false;
-		float_t  locFaderValue = 0;
+		uint8_t  locFader8 = 0; //local ramp 0..255
 		uint16_t lastValue = 0xFFFF;
 		uint16_t lastStatValue = 0xFFFF;
 		uint32_t lastActivity = 0xFFFFFFFF;
-		uint8_t  lastExtStatus = 1; //used for transponder events whioch are not in (yet) in Digitrax Buffer)
 };
 
 class IoTT_ledChain
@@ -114,7 +127,6 @@ class IoTT_ledChain
 		void loadLEDChainJSONObj(JsonObject doc, bool resetList = true);
 		void setMQTTMode(mqttTxFct txFct);
 		void subscribeTopics();
-		void processBtnEvent(sourceType inputEvent, uint16_t btnAddr, uint16_t eventValue);
 	
 		uint16_t getChainLength();
 		CRGB * getChain();
@@ -160,12 +172,15 @@ class IoTT_ledChain
 		void setI2CLED(uint16_t ledNr, CHSV newCol);
 		void setI2CLEDType(uint16_t ledType);
 		void setI2CChainLen(uint16_t chainLen);
+		void setI2CEffect(uint16_t ledNr, ledEffectDef * newEffect);
+		void assignEffectSlots();
 		void resetI2CDevice(bool forceReset);
 		int8_t pingI2CDevice(uint8_t numBytes = 3);
 		uint16_t i2cChainLength;
 		uint16_t i2cChainType = 0;
 		int16_t i2cDevID = -1;
 		bool i2cVerified = false;
+		uint8_t i2cEffectSlots = 0; //number of LEDs the coprocessor can animate, 0 for firmware without effects
 
 
 	public:
@@ -177,6 +192,11 @@ class IoTT_ledChain
 		bool     blinkStatus;
 		uint8_t  pingCtr = 0;
 		float_t  globFaderValue;
+		uint8_t  globFader8 = 0; //globFaderValue as 0..255, calculated once per cycle for all handlers
+		uint8_t  brightness8 = 204; //currentBrightness as 0..255
+		uint32_t frameTime = 0; //micros() used by the last LED handler pass
+		uint32_t maxFrameTime = 0; //since the last performance printout
+		uint32_t i2cLEDBytes = 0; //bytes sent to the I2C LED coprocessor
 		uint16_t colTypeNum = 0;
 		bool needUpdate;
 		SemaphoreHandle_t ledBaton;
@@ -188,6 +208,8 @@ class IoTT_ledChain
 		bool processMQTTCmd(char * topic, DynamicJsonDocument doc);
 		void sendLEDStatusMQTT(uint16_t ledNr);
 		void setCurrColHSV(uint16_t ledNr, CHSV newCol);
+		void setCurrColHSV(uint16_t * ledList, uint8_t listLen, CHSV newCol); //same color for a group of LEDs
+		void setEffect(uint16_t * ledList, uint8_t listLen, ledEffectDef * newEffect); //I2C mode only
 		void setBlinkRate(uint16_t blinkVal);
 		void identifyLED(uint16_t LEDNr);
 		void setRefreshInterval(uint16_t newInterval); //1/frame rate in millis()
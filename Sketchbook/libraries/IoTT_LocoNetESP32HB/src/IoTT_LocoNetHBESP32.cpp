@@ -88,11 +88,71 @@ void LocoNetESPSerial::loadLNCfgJSON(DynamicJsonDocument doc)
 		m_invertRx = doc["invLogicRx"];
 	if (doc.containsKey("invLogic"))
 		m_invertTx = doc["invLogicTx"];
+	if (doc.containsKey("CoalesceWindow"))
+		coalesceWindow = (uint32_t)doc["CoalesceWindow"] * 1000;
 	begin(m_rxPin, m_txPin,m_invertRx, m_invertTx);
 }
 
+//returns the slot number a queued message refers to, 0xFF if none, 0xFE if not known
+uint8_t getMsgSlot(uint8_t * msgData)
+{
+	switch (msgData[0])
+	{
+		case 0xA0:; //OPC_LOCO_SPD
+		case 0xA1:; //OPC_LOCO_DIRF
+		case 0xA2:; //OPC_LOCO_SND
+		case 0xA3:; //OPC_LOCO_F9F12
+		case 0xB5:; //OPC_SLOT_STAT1
+		case 0xBB: //OPC_RQ_SL_DATA
+			return msgData[1];
+		case 0xB8:; //OPC_UNLINK_SLOTS
+		case 0xB9:; //OPC_LINK_SLOTS
+		case 0xBA: //OPC_MOVE_SLOTS
+			return 0xFE; //two slots
+		case 0xE7:; //OPC_SL_RD
+		case 0xEF: //OPC_WR_SL
+			return msgData[1] == 0x0E ? msgData[2] : 0xFE;
+		default:
+			return (msgData[0] >= 0xD0) ? 0xFE : 0xFF; //long messages may refer to slots
+	}
+}
+
+//Throttles over TCP, WiThrottle or MQTT may send many speed updates per loco. If an OPC_LOCO_SPD or OPC_LOCO_DIRF of the same slot 
+//is still waiting in the queue, it is replaced by the new message. Searching stops at any other message for the same slot, so the 
+//order of messages for a slot does not change. The message at the head of the queue may be in transmission and is never changed
+bool LocoNetESPSerial::coalesceMsg(uint8_t * msgData, uint8_t msgSize, uint16_t reqID)
+{
+	if ((coalesceWindow == 0) || ((msgData[0] != 0xA0) && (msgData[0] != 0xA1)))
+		return false;
+	uint8_t headPtr = (que_rdPos + 1) % queBufferSize;
+	uint8_t quePtr = que_wrPos;
+	uint32_t now = micros();
+	while ((quePtr != que_rdPos) && (quePtr != headPtr))
+	{
+		lnTransmitMsg * queMsg = &transmitQueue[quePtr];
+		if ((now - queMsg->reqRecTime) > coalesceWindow) //this and all earlier messages are too old
+			return false;
+		uint8_t msgSlot = getMsgSlot(&queMsg->lnData[0]);
+		if (msgSlot == 0xFE)
+			return false;
+		if (msgSlot == msgData[1])
+		{
+			if ((queMsg->lnData[0] != msgData[0]) || (queMsg->reqID != reqID))
+				return false;
+			memcpy(queMsg->lnData, msgData, msgSize);
+			txMergeCtr++;
+			return true;
+		}
+		quePtr = (quePtr + queBufferSize - 1) % queBufferSize;
+	}
+	return false;
+}
+
 uint16_t LocoNetESPSerial::lnWriteMsg(lnTransmitMsg txData)
 {
+	txMsgCtr++;
+	if (coalesceMsg(&txData.lnData[0], txData.lnMsgSize, txData.reqID))
+		return txData.lnMsgSize;
     uint8_t hlpQuePtr = (que_wrPos + 1) % queBufferSize;
 //	Serial.printf("Serial lnWriteMsg tx %i Rd %i Wr %i Hlp %i\n", txData.lnMsgSize, que_rdPos, que_wrPos, hlpQuePtr);
     if (hlpQuePtr != que_rdPos) //override protection
@@ -120,6 +180,9 @@ uint16_t LocoNetESPSerial::lnWriteMsg(lnTransmitMsg txData)
 uint16_t LocoNetESPSerial::lnWriteMsg(lnReceiveBuffer txData)
 {
 //	Serial.printf("Serial lnWriteMsg rx %i Rd %i Wr %i Hlp %i\n", txData.lnMsgSize, que_rdPos, que_wrPos, hlpQuePtr);
+	txMsgCtr++;
+	if (coalesceMsg(&txData.lnData[0], txData.lnMsgSize, txData.reqID))
+		return txData.lnMsgSize;
     uint8_t hlpQuePtr = (que_wrPos + 1) % queBufferSize;
     if (hlpQuePtr != que_rdPos) //override protection
     {
@@ -47,6 +47,7 @@ Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
 #define verBufferSize 48
 
 #define queBufferSize 50 //messages that can be written in one burst before buffer overflow
+#define coalesceWindowDefault 100 //ms, OPC_LOCO_SPD and OPC_LOCO_DIRF waiting in the queue for less than this are replaced by newer ones
 //#define queReplyBufferSize 5 //messages to that queue get sent high priority
 
 class LocoNetESPSerial : public HardwareSerial
@@ -67,6 +68,8 @@ public:
 	bool carrierOK();
 	bool hasMsgSpace();
 	void loadLNCfgJSON(DynamicJsonDocument doc);
+	uint32_t txMsgCtr = 0; //statistics, messages written to the queue
+	uint32_t txMergeCtr = 0; //messages merged into a queued message of the same slot
    
 private:
    
@@ -76,6 +79,7 @@ private:
    void processLNReceive();
    void processLNTransmit();
    void processLoopBack();
+   bool coalesceMsg(uint8_t * msgData, uint8_t msgSize, uint16_t reqID);
 
 //   void sendBreakSequence();
    uint8_t getXORCheck(uint8_t * msgData, uint8_t * msgLen);
@@ -85,6 +89,7 @@ private:
    lnTransmitMsg transmitQueue[queBufferSize];
 //   lnTransmitMsg replyQueue[queReplyBufferSize];
    uint8_t que_rdPos = 0, que_wrPos = 0;
+   uint32_t coalesceWindow = coalesceWindowDefault * 1000; //micros, 0: no coalescing
 //   uint8_t que_replyRdPos = 0, que_replyWrPos = 0;
    lnReceiveBuffer lnInBuffer, lnEchoBuffer;
    int m_rxPin, m_txPin;
@@ -37,11 +37,13 @@ Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
 char lnPingTopic[100] = "lnPing";  //ping topic, do not change. This is helpful to find Gateway IP Address if not known. 
 char lnBCTopic[100] = "lnIn";  //default topic, can be specified in mqtt.cfg. Useful when sending messages from 2 different LocoNet networks
 char lnEchoTopic[100] = "lnEcho"; //default topic, can be specified in mqtt.cfg
+char lnStateTopic[100] = "lnState"; //default topic, can be specified in mqtt.cfg
 
 char thisNodeName[60] = ""; //default topic, can be specified in mqtt.cfg
 
 cbFct mqttCallback = NULL;
 mqttFct nativeCallback = NULL;
+mqttFct stateCallback = NULL;
 //cbFct mqttappCallback = NULL;
 
 uint8_t workMode = 0; //0: LN; 1: DCC; 2: NativeMQTT; 3: DCC from MQTT
@@ -65,6 +67,15 @@ MQTTESP32::MQTTESP32(Client& client):PubSubClient(client)
 void MQTTESP32::psc_callback(char* topic, byte* payload, unsigned int length)
 {
 	payload[length] = 0;
+	if (stateCallback) //binary state messages, not JSON
+	{
+		uint8_t topicLen = strlen(lnStateTopic);
+		if ((strncmp(topic, lnStateTopic, topicLen) == 0) && (topic[topicLen] == '/'))
+		{
+			stateCallback(&topic[topicLen + 1], payload, length);
+			return;
+		}
+	}
 	if (nativeCallback)
 	{
 		nativeCallback(topic, payload, length);
@@ -171,12 +182,17 @@ void MQTTESP32::loadMQTTCfgJSON(DynamicJsonDocument doc)
         strcpy(appEchoTopic, doc["EchoTopic"]);
     if (doc.containsKey("PingTopic"))
         strcpy(appPingTopic, doc["PingTopic"]);
+    if (doc.containsKey("StateTopic"))
+        strcpy(appStateTopic, doc["StateTopic"]);
+    if (doc.containsKey("StateSync"))
+        useStateSync = doc["StateSync"];
 
     setServer(mqtt_server, mqtt_port);
     setNodeName(nodeName, includeMAC);
     setBCTopicName(appBCTopic);
     setEchoTopicName(appEchoTopic);
     setPingTopicName(appPingTopic);
+    setStateTopicName(appStateTopic);
 }
 
 void MQTTESP32::setMQTTCallback(cbFct newCB, uint8_t newMode)
@@ -236,6 +252,28 @@ void MQTTESP32::setPingTopicName(char * newName)
 	strcpy(&lnPingTopic[0], newName);
 }
 
+void MQTTESP32::setStateTopicName(char * newName)
+{
+	strcpy(&lnStateTopic[0], newName);
+}
+
+bool MQTTESP32::getStateSync()
+{
+	return useStateSync;
+}
+
+void MQTTESP32::setStateSource(stateSrcFct newSrc)
+{
+	stateSource = newSrc;
+	stateSent = true;
+}
+
+void MQTTESP32::setStateCallback(mqttFct newCB)
+{
+	stateCallback = newCB;
+	subscriptionsOK = false;
+}
+
 bool MQTTESP32::connectToBroker()
 {
 	uint32_t startTime = millis();
@@ -264,6 +302,12 @@ void MQTTESP32::subscribeTopics()
 		subscribe(lnPingTopic);
 		subscribe(lnEchoTopic);
 	}
+	if (stateCallback) //retained state of all pages comes in right after subscribing
+	{
+		char stateTopic[110];
+		sprintf(stateTopic, "%s/#", lnStateTopic);
+		subscribe(stateTopic);
+	}
 	subscriptionsOK = true;
 }
 
@@ -460,6 +504,21 @@ void MQTTESP32::processLoop()
 				if (sendMQTTMessage(transmitQueue[hlpQuePtr]))
 					que_rdPos = hlpQuePtr; //if not successful, we keep trying
 			}
+		if (stateSource)
+		{
+			char subTopic[20];
+			char stateTopic[125];
+			for (uint8_t i = 0; i < stateBurst; i++)
+			{
+				int16_t msgLen = stateSource(subTopic, statePayload, stateSent);
+				if (msgLen < 0)
+					break;
+				sprintf(stateTopic, "%s/%s", lnStateTopic, subTopic);
+				stateSent = publish(stateTopic, statePayload, msgLen, true); //an empty payload deletes the retained message
+				if (!stateSent)
+					break;
+			}
+		}
 		if (pingDelay > 0)
 			if (millis() > nextPingPoint)
 			{
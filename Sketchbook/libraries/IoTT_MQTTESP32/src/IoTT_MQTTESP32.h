@@ -33,6 +33,7 @@ Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
 
 #define reconnectStartVal 10000
 #define queBufferSize 50 //messages that can be written in one burst before buffer overflow
+#define stateBurst 8 //state messages published per processLoop
 
 class MQTTESP32 : public PubSubClient
 {
@@ -48,6 +49,10 @@ public:
 	void setEchoTopicName(char * newName);
 	void setPingTopicName(char * newName);
 	void setPingFrequency(uint16_t pingSecs);
+	void setStateTopicName(char * newName);
+	bool getStateSync();
+	void setStateSource(stateSrcFct newSrc); //node publishing its state as retained messages
+	void setStateCallback(mqttFct newCB); //node receiving the state of other nodes, called with the topic below the state topic
 	bool connectToBroker();
 	void subscribeTopics();
 	bool mustResubscribe();
@@ -84,7 +89,11 @@ private:
 	uint32_t respTime;
 	uint8_t  respOpCode;
 	uint16_t respID;
-   
+
+	bool useStateSync = false;
+	stateSrcFct stateSource = NULL;
+	bool stateSent = true;
+	uint8_t statePayload[stateMaxPayload];
 	
 	char mqtt_server[50] = "broker.hivemq.com"; // = Mosquitto Server IP "192.168.xx.xx" as loaded from mqtt.cfg
 	uint16_t mqtt_port = 1883; // = Mosquitto port number, standard is 1883, 8883 for SSL connection;
@@ -94,6 +103,7 @@ private:
 	char appBCTopic[100] = "lnIn";  //default topic, can be specified in mqtt.cfg. Useful when sending messages from 2 different LocoNet networks
 	char appEchoTopic[100] = "lnEcho"; //default topic, can be specified in mqtt.cfg
 	char appDCCTopic[100] = "dccBC";  //default topic, can be specified in mqtt.cfg. Useful when sending messages from 2 different LocoNet networks
+	char appStateTopic[100] = "lnState"; //retained state of the DigitraxBuffers, one message per page below this topic
 	bool includeMAC = true;
 
 };
@@ -27,6 +27,11 @@ buttonType getButtonTypeByName(String typeName)
   return digitalAct; //default
 }
 
+void IRAM_ATTR mcpISR(void * btnObj)
+{
+	((IoTT_Mux64Buttons*)btnObj)->onMCPInterrupt();
+}
+
 IoTT_Mux64Buttons::IoTT_Mux64Buttons()
 {
 //	commType = btnI2C;
@@ -38,6 +43,17 @@ IoTT_Mux64Buttons::~IoTT_Mux64Buttons()
 //    xSemaphoreTake(buttonBaton, portMAX_DELAY);
 //    xSemaphoreGive(buttonBaton);
 //    vSemaphoreDelete(buttonBaton);
+	free(analogFilter);
+	free(analogRaw);
+	free(analogAvg);
+}
+
+void IoTT_Mux64Buttons::allocAnalogFilter() //after touchArray is resized
+{
+	analogFilter = (kalmanChannel*) realloc (analogFilter, numTouchButtons * sizeof(kalmanChannel));
+	analogRaw = (uint16_t*) realloc (analogRaw, numTouchButtons * sizeof(uint16_t));
+	analogAvg = (uint16_t*) realloc (analogAvg, numTouchButtons * sizeof(uint16_t));
+	kalmanInit(analogFilter, numTouchButtons); //initialize with default values
 }
 
 void IoTT_Mux64Buttons::initButtonsDirect(bool pollBtns) //default false
@@ -76,6 +92,7 @@ void IoTT_Mux64Buttons::initButtonsI2C(TwoWire * newWire, uint8_t Addr, uint8_t
 	}
 	
 	touchArray = (IoTT_ButtonConfig*) realloc (touchArray, numTouchButtons * sizeof(IoTT_ButtonConfig));
+	allocAnalogFilter();
 	for (int i = 0; i < numTouchButtons; i++)
 	{
 		IoTT_ButtonConfig * myTouch = &touchArray[i];
@@ -83,7 +100,6 @@ void IoTT_Mux64Buttons::initButtonsI2C(TwoWire * newWire, uint8_t Addr, uint8_t
 		myTouch->btnAddr = boardBaseAddress + i; //LocoNet Button Address
 		myTouch->btnEventMask = 0x1F; //all events activated
 
-		myTouch->analogAvg.setInitValues(); //initialize with default values
 		myTouch->lastPublishedData = 0;
 		myTouch->btnStatus = false; //true if pressed
 		myTouch->lastStateChgTime[4] = 0; //used to calculate dbl click
@@ -94,6 +110,41 @@ void IoTT_Mux64Buttons::initButtonsI2C(TwoWire * newWire, uint8_t Addr, uint8_t
 	}
 }
 
+void IoTT_Mux64Buttons::enableMCPInterrupt(uint8_t intPin, uint16_t pollInterval) //GreenHat only
+{
+	if (sourceMode != 1)
+		return;
+	mcpIntPin = intPin;
+	mcpPollInterval = pollInterval;
+	for (uint8_t i = 0; i < 2; i++)
+	{
+		uint8_t devAddr = MCP23017_ADDRESS + wireAddr + i;
+		uint8_t regData[3] = {MCP23017_IOCONA, MCP23017_IOCON_MIRROR | MCP23017_IOCON_ODR, 0}; //one open drain line for both ports and expanders
+		writeI2CData(devAddr, &regData[0], 2);
+		regData[0] = MCP23017_INTCONA; //interrupt on any change, not compared to DEFVAL
+		regData[1] = 0; //INTCONA, still holds the IOCON value
+		regData[2] = 0; //INTCONB
+		writeI2CData(devAddr, &regData[0], 3);
+		regData[0] = MCP23017_GPINTENA;
+		regData[1] = 0xFF;
+		regData[2] = 0xFF;
+		writeI2CData(devAddr, &regData[0], 3);
+	}
+	pinMode(mcpIntPin, INPUT_PULLUP);
+	attachInterruptArg(digitalPinToInterrupt(mcpIntPin), mcpISR, this, FALLING);
+	readMCPInterrupt(true); //clear anything pending and get the current status
+	Serial.printf("Buttons Addr %i using interrupt on pin %i\n", wireAddr, mcpIntPin);
+}
+
+void IRAM_ATTR IoTT_Mux64Buttons::onMCPInterrupt()
+{
+	if (!mcpIntPending) //keep the time of the first edge until the registers are read
+	{
+		mcpIntTime = millis();
+		mcpIntPending = true;
+	}
+}
+
 void IoTT_Mux64Buttons::loadButtonCfgDirectJSON(DynamicJsonDocument doc) //used for BlackHat
 {
     if (doc.containsKey("RefreshInterval"))
@@ -105,6 +156,7 @@ void IoTT_Mux64Buttons::loadButtonCfgDirectJSON(DynamicJsonDocument doc) //used
         JsonArray Buttons = doc["Buttons"];
 		numTouchButtons = Buttons.size();
 		touchArray = (IoTT_ButtonConfig*) realloc (touchArray, numTouchButtons * sizeof(IoTT_ButtonConfig));
+		allocAnalogFilter();
 
 		for (int i = 0; i < numTouchButtons; i++)
 		{
@@ -113,7 +165,6 @@ void IoTT_Mux64Buttons::loadButtonCfgDirectJSON(DynamicJsonDocument doc) //used
 			myTouch->btnAddr = boardBaseAddress + i; //LocoNet Button Address
 			myTouch->btnEventMask = 0x1F; //all events activated
 
-			myTouch->analogAvg.setInitValues(); //nitialize with default values
 			myTouch->lastPublishedData = 0;
 			myTouch->btnStatus = false; //true if pressed
 			myTouch->lastStateChgTime[4] = 0; //used to calculate dbl click
@@ -175,6 +226,8 @@ void IoTT_Mux64Buttons::loadButtonCfgI2CJSONObj(JsonObject doc) //used GreenHat
         newAnalogThreshold = doc["Sensitivity"];
     if (doc.containsKey("BoardBaseAddr"))
         setBoardBaseAddr((int)doc["BoardBaseAddr"]);
+    if (doc.containsKey("IntPin"))
+        enableMCPInterrupt((uint8_t)doc["IntPin"], doc.containsKey("PollInterval") ? (uint16_t)doc["PollInterval"] : 1000);
     if (doc.containsKey("MQTT"))
     {
 		JsonObject myMQTT = doc["MQTT"];
@@ -367,7 +420,7 @@ void IoTT_Mux64Buttons::processDigitalInputBuffer(uint8_t btnNr, bool btnPressed
 		pollBuffer &= (~inpMask);
 }
 
-void IoTT_Mux64Buttons::processDigitalButton(uint8_t btnNr, bool btnPressed)
+void IoTT_Mux64Buttons::processDigitalButton(uint8_t btnNr, bool btnPressed, uint32_t evtTime) //evtTime 0 means now
 {
 //  if (btnNr == 2) Serial.println(btnPressed);
   IoTT_ButtonConfig * thisTouchData = &touchArray[btnNr];
@@ -375,12 +428,14 @@ void IoTT_Mux64Buttons::processDigitalButton(uint8_t btnNr, bool btnPressed)
 	Serial.printf("No button # %i found\n", btnNr);
   if (btnPressed != thisTouchData->btnStatus)
   {
+	if (evtTime == 0)
+		evtTime = millis();
 	thisTouchData->lastEvtPtr++;
 	thisTouchData->lastEvtPtr &= 0x03;
-	thisTouchData->lastStateChgTime[thisTouchData->lastEvtPtr] = millis();
+	thisTouchData->lastStateChgTime[thisTouchData->lastEvtPtr] = evtTime;
 	thisTouchData->btnStatus = btnPressed;
 //	Serial.printf("Button status change %i\n", thisTouchData->btnTypeDetected);
-	thisTouchData->nextHoldUpdateTime = millis() + holdThreshold;
+	thisTouchData->nextHoldUpdateTime = evtTime + holdThreshold;
 	if (btnPressed)
 	{
 //		Serial.println("Button down");
@@ -436,11 +491,90 @@ uint32_t IoTT_Mux64Buttons::readI2CData(uint8_t devAddr, uint8_t startReg, uint8
 	return readRes;
 }
 
+void IoTT_Mux64Buttons::readI2CBlock(uint8_t devAddr, uint8_t startReg, uint8_t * dataBuf, uint8_t numBytes)
+{
+	writeI2CData(devAddr, &startReg, 1);
+	thisWire->requestFrom(devAddr, numBytes);
+	for (uint8_t i = 0; i < numBytes; i++)
+		dataBuf[i] = thisWire->read();
+}
+
 uint16_t IoTT_Mux64Buttons::readEXTPort(uint8_t extAddr)
 {
 	return readI2CData(extAddr, MCP23017_GPIOA, 2);
 }
 
+uint32_t IoTT_Mux64Buttons::getMCPButtonState(uint8_t * bitData) //0,2: Btn; 1,3: Pos, returns bit per pressed button
+{
+	uint32_t btnState = 0;
+	for (uint8_t btnCtr = 0; btnCtr < numTouchButtons; btnCtr++)
+	{
+		uint8_t byteNr = ((btnCtr & 0x10)>>3) + (btnCtr & 1);
+		uint8_t bitNr = ((btnCtr>>1) & 0x07);
+		if (!(bitData[byteNr] & (0x01 << bitNr)))
+			btnState |= (0x00000001 << btnCtr);
+	}
+	return btnState;
+}
+
+void IoTT_Mux64Buttons::processMCPChanges(uint32_t newState, uint32_t evtTime)
+{
+	uint32_t chgMask = newState ^ mcpBtnState;
+	mcpBtnState = newState;
+	for (uint8_t btnCtr = 0; (btnCtr < numTouchButtons) && chgMask; btnCtr++)
+	{
+		if (chgMask & 0x01)
+			processDigitalButton(btnCtr, (newState >> btnCtr) & 0x01, evtTime);
+		chgMask >>= 1;
+	}
+}
+
+/*
+ * In interrupt mode, the expanders are only read after INTA/INTB went low. INTCAP holds the port status at the time of
+ * the interrupt, so that edge is processed with the time stamp taken in the ISR, then anything that changed until now
+ * (e.g. the release of a short click) with the current time. Reading INTCAP/GPIO clears the interrupt. Both expanders share the INT
+ * line, so if it is still low after the read, the next call reads again instead of waiting for the sanity poll.
+ */
+void IoTT_Mux64Buttons::readMCPInterrupt(bool forceRead)
+{
+	bool intPending = mcpIntPending;
+	uint32_t intTime = mcpIntTime;
+	if (!(intPending || forceRead))
+		return;
+	mcpIntPending = false; //an edge after this point triggers another read
+	uint8_t capData[4] = {0,0,0,0}; //0,2: Btn; 1,3: Pos 
+	uint8_t bitData[4] = {0,0,0,0};
+	bool hasCapture = false;
+	for (uint8_t i = 0; i < 2; i++)
+	{
+		uint8_t regData[6]; //INTFA, INTFB, INTCAPA, INTCAPB, GPIOA, GPIOB
+		uint8_t byteOfs = i == 0 ? 2 : 0; //first expander has channels 9-16
+		readI2CBlock(MCP23017_ADDRESS + wireAddr + i, MCP23017_INTFA, &regData[0], 6);
+		bitData[byteOfs] = regData[4];
+		bitData[byteOfs + 1] = mirrorByte(regData[5]);
+		if (regData[0] | regData[1])
+		{
+			capData[byteOfs] = regData[2];
+			capData[byteOfs + 1] = mirrorByte(regData[3]);
+			hasCapture = true;
+		}
+		else
+		{
+			capData[byteOfs] = bitData[byteOfs];
+			capData[byteOfs + 1] = bitData[byteOfs + 1];
+		}
+	}
+	if (intPending && hasCapture)
+		processMCPChanges(getMCPButtonState(&capData[0]), intTime);
+	processMCPChanges(getMCPButtonState(&bitData[0]), millis());
+	mcpPollTimer = millis();
+	if ((mcpIntPin >= 0) && (digitalRead(mcpIntPin) == LOW) && !mcpIntPending) //one expander changed while the other was read, the shared line did not go high, so there is no new edge
+	{
+		mcpIntTime = millis();
+		mcpIntPending = true; //read again with the next call
+	}
+}
+
 uint16_t IoTT_Mux64Buttons::readMUXButton(uint8_t inpLineNr, uint8_t muxNr)
 {
 	uint8_t newData = ((inpLineNr & 0x0F) | (((muxNr ^ 0xFF) & 0x03) << 4));
@@ -465,8 +599,9 @@ void IoTT_Mux64Buttons::processButtons()
 	IoTT_ButtonConfig * thisTouchData;
 	uint16_t hlpAnalog;
 	uint16_t thisAnalogAvg;
-	double_t randVal = random(-50, 50) / 1000;
 
+	if ((sourceMode == 1) && (mcpIntPin >= 0))
+		readMCPInterrupt(false); //edges are processed right away, not only every btnUpdateInterval
 
 	if (millisElapsed(btnUpdateTimer) > btnUpdateInterval)
 	{
@@ -496,7 +631,13 @@ void IoTT_Mux64Buttons::processButtons()
 							hlpAnalog = 4095 * digitalRead(thisTouchData->gpioPin);
 //					if (btnCtr == 0)
 //						Serial.printf("Ctr %i Line %i Value %i\n", btnCtr, thisTouchData->gpioPin, hlpAnalog);
-					thisAnalogAvg = round(thisTouchData->analogAvg.getEstimate((double_t) hlpAnalog + randVal)); //artifial flickering to avoid filter lockup
+					analogRaw[btnCtr] = hlpAnalog;
+				}
+				kalmanUpdateInt(analogFilter, analogRaw, analogAvg, numTouchButtons); //fixed point, the filter does not lock up on a steady input
+				for (uint8_t btnCtr = 0; btnCtr < numTouchButtons; btnCtr++)
+				{
+					thisTouchData = &touchArray[btnCtr];
+					thisAnalogAvg = analogAvg[btnCtr];
 
 					if (thisTouchData->btnTypeDetected != btnoff)
 					{
@@ -520,22 +661,24 @@ void IoTT_Mux64Buttons::processButtons()
 			break;
 			case 1: //MCP23017
 			{
-				uint16_t portData = 0;
-				uint8_t bitData[4] = {0,0,0,0}; //0,2: Btn; 1,3: Pos 
-				portData = readEXTPort(MCP23017_ADDRESS + wireAddr); //channels 9-16
-				bitData[2] = (portData & 0xFF00) >> 8;
-				bitData[3] = mirrorByte(portData & 0x00FF);
-				portData = readEXTPort(MCP23017_ADDRESS + wireAddr + 1); //channels 1-8
-				bitData[0] = (portData & 0xFF00) >> 8;
-				bitData[1] = mirrorByte(portData & 0x00FF);
-//				Serial.printf("A Btn: %2X A Pos: %2X B Btn: %2X B Pos: %2X \n", bitData[0], bitData[1], bitData[2], bitData[3]);
-				for (uint8_t btnCtr = 0; btnCtr < numTouchButtons; btnCtr++)
+				if (mcpIntPin < 0)
 				{
-					uint8_t byteNr = ((btnCtr & 0x10)>>3) + (btnCtr & 1);
-					uint8_t bitNr = ((btnCtr>>1) & 0x07);
-//					Serial.printf("Btn: %i Byte: %i Bit: %i Result: %i\n", btnCtr, byteNr, bitNr, !(bitData[byteNr] & (0x01 << bitNr)));
-					processDigitalButton(btnCtr, !(bitData[byteNr] & (0x01 << bitNr)));
+					uint16_t portData = 0;
+					uint8_t bitData[4] = {0,0,0,0}; //0,2: Btn; 1,3: Pos 
+					portData = readEXTPort(MCP23017_ADDRESS + wireAddr); //channels 9-16
+					bitData[2] = (portData & 0xFF00) >> 8;
+					bitData[3] = mirrorByte(portData & 0x00FF);
+					portData = readEXTPort(MCP23017_ADDRESS + wireAddr + 1); //channels 1-8
+					bitData[0] = (portData & 0xFF00) >> 8;
+					bitData[1] = mirrorByte(portData & 0x00FF);
+//					Serial.printf("A Btn: %2X A Pos: %2X B Btn: %2X B Pos: %2X \n", bitData[0], bitData[1], bitData[2], bitData[3]);
+					mcpBtnState = getMCPButtonState(&bitData[0]);
 				}
+				else
+					if (millisElapsed(mcpPollTimer) > mcpPollInterval)
+						readMCPInterrupt(true); //sanity poll, also releases an INT line that is stuck low
+				for (uint8_t btnCtr = 0; btnCtr < numTouchButtons; btnCtr++) //no bus traffic in interrupt mode, this runs hold and sensor timers
+					processDigitalButton(btnCtr, (mcpBtnState >> btnCtr) & 0x01);
 			}
 			break;
 			case 2: //external
@@ -36,6 +36,9 @@
 #define MCP23017_GPIOB 0x13    //!< General purpose I/O port register B
 #define MCP23017_OLATB 0x15    //!< Output latch register 0 B
 
+#define MCP23017_IOCON_MIRROR 0x40 //!< INTA and INTB internally connected
+#define MCP23017_IOCON_ODR 0x04    //!< INT pins open drain, so several expanders can share one input
+
 
 #define avgBase 5  //numer of values to be considered for rolling average
 
@@ -70,7 +73,6 @@ typedef struct
   uint8_t  btnEventMask = 0x1F; //all events activated. Bits 0: down 1: up 2: click 3: dblclick 4: hold
   uint8_t  gpioPin = 0;
 //internal usage
-  OneDimKalman    analogAvg; //Kalman filtered analog reading
   uint16_t lastPublishedData = 0;
   buttonEvent lastPublishedEvent = onbtnup;
   bool     btnStatus = false; //true if pressed
@@ -89,6 +91,9 @@ class IoTT_Mux64Buttons
 
 	private:
 		IoTT_ButtonConfig * touchArray = NULL;
+		kalmanChannel * analogFilter = NULL; //Kalman filter of each input, all updated in one pass
+		uint16_t * analogRaw = NULL; //readings of the current cycle
+		uint16_t * analogAvg = NULL; //filtered readings
 		TwoWire * thisWire = NULL;
 		uint8_t sourceMode = 0; //by default, MUX or GPIO is used. 0: MUX or GPIO (if no Wire); 1: MCP23017 port commands; 2: Bit buffer lookup
 		uint8_t wireAddr = 0;
@@ -104,6 +109,12 @@ class IoTT_Mux64Buttons
 		float newAnalogThreshold = 1;  //new analog value gets sent out if deviation is more than x%
 		int currentChannel = -1;
 		uint32_t pollBuffer = 0; //used by event driven approach (e.g. RedHat, to set status lines)
+		int8_t mcpIntPin = -1; //GPIO connected to INTA/INTB of the MCP23017s, -1 if polling
+		uint16_t mcpPollInterval = 1000; //ms, sanity poll in interrupt mode
+		uint32_t mcpPollTimer = millis();
+		uint32_t mcpBtnState = 0; //last known pressed status of the 32 buttons, bit per button
+		volatile bool mcpIntPending = false;
+		volatile uint32_t mcpIntTime = 0; //millis() of the first edge since the last read
 		bool mqttMode = false;
 		topicStruct subTopicList[1] = {{"BTNASK", false}};
 		topicStruct pubTopicList[2] = {{"BTNREPORT", false}, {"BTNREPLY", false}};
@@ -113,6 +124,9 @@ class IoTT_Mux64Buttons
 		void loadButtonCfgI2CJSON(DynamicJsonDocument doc);
 		void loadButtonCfgI2CJSONObj(JsonObject doc);
 
+		void enableMCPInterrupt(uint8_t intPin, uint16_t pollInterval = 1000);
+		void onMCPInterrupt();
+
 		void initButtonsDirect(bool pollBtns = false);
 		void loadButtonCfgDirectJSON(DynamicJsonDocument doc);
 
@@ -134,7 +148,8 @@ class IoTT_Mux64Buttons
 		void sendBtnStatusMQTT(uint8_t topicNr, uint16_t btnNr);
 		void processDigitalInputBuffer(uint8_t btnNr, bool btnPressed);
 	private:
-		void processDigitalButton(uint8_t btnNr, bool btnPressed);
+		void allocAnalogFilter();
+		void processDigitalButton(uint8_t btnNr, bool btnPressed, uint32_t evtTime = 0);
 		void processDigitalHold(uint8_t btnNr);
 		void processSensorHold(uint8_t btnNr);
 		void sendButtonEvent(uint16_t btnAddr, buttonEvent btnEvent);
@@ -143,6 +158,10 @@ class IoTT_Mux64Buttons
 		uint32_t readI2CData(uint8_t devAddr, uint8_t startReg, uint8_t numBytes); //max 4 bytes
 		uint16_t readMUXButton(uint8_t inpLineNr, uint8_t muxNr);
 		uint16_t readEXTPort(uint8_t extAddr);
+		void readI2CBlock(uint8_t devAddr, uint8_t startReg, uint8_t * dataBuf, uint8_t numBytes);
+		uint32_t getMCPButtonState(uint8_t * bitData);
+		void processMCPChanges(uint32_t newState, uint32_t evtTime);
+		void readMCPInterrupt(bool forceRead);
 };
 
 extern void onButtonEvent(uint16_t btnAddr, buttonEvent btnEvent) __attribute__ ((weak));
@@ -290,42 +290,63 @@ void IoTT_SecElLeg::setDynSpeed(uint16_t newSpeedLevel)
 
 uint8_t IoTT_SecElLeg::getNextSignalDynCtr()
 {
-//	Serial.printf("Trying SE %i leg %i: ", parentSE->secelID, legPos);
-	IoTT_SecElLeg * openLeg = getOpenLeg();
-	if (openLeg == this) //leading to nowhere
-		return 0;
+	IoTT_SecElLeg * thisLeg = this;
+	uint8_t maxHops = parentSE->parentSEModel->lookahead;
+	for (uint8_t hopCtr = 0; hopCtr < maxHops; hopCtr++) //elements without entry signal are passed, limited to lookahead in case of loops
+	{
+//		Serial.printf("Trying SE %i leg %i: ", thisLeg->parentSE->secelID, thisLeg->legPos);
+		IoTT_SecElLeg * openLeg = thisLeg->getOpenLeg();
+		if (openLeg == thisLeg) //leading to nowhere
+			return 0;
 		
-	IoTT_SecElLeg * pairedLeg = getConnectedLeg();
+		IoTT_SecElLeg * pairedLeg = thisLeg->getConnectedLeg();
+		if (!pairedLeg) //terminal leg
+			return thisLeg->parentSE->isTerminal ? 0 : thisLeg->parentSE->parentSEModel->dynamicSpeedModel->numSpeedLines - 1; //not possible to enter next leg, ctr = 0 or max in case it is leg to open track
+		if (!pairedLeg->destSE)
+			return 0; //not possible to enter next leg, ctr = 0
+		if (pairedLeg->destSE->entryAspectGenerator) //it has an entry signal pointing towards us
+			return pairedLeg->destSE->dynUptickCtr;
+		thisLeg = pairedLeg->destSE; //no signal, continue through the next element
+	}
+	return parentSE->parentSEModel->dynamicSpeedModel->numSpeedLines - 1; //no signal within lookahead
+}
 
-//	if (pairedLeg)
-//		Serial.printf("SE %i leg %i paired with SE %i leg %i\n", parentSE->secelID, legPos, pairedLeg->parentSE->secelID, pairedLeg->legPos);
-//	else
-//		Serial.printf("SE %i leg %i not paired\n", parentSE->secelID, legPos);
+uint8_t IoTT_SecElLeg::getABSSpeed()
+{
+	if (digitraxBuffer->getBDStatus(parentSE->blockdetAddr))
+		return 0; //set dynamic In speed to zero and set all signals respective aspect
+	//get the speed of the in-leg of the next SE
+	uint8_t nextLegDynSpeed = getNextSignalDynCtr();
+	//if not highest level, set dynamic in speed to next higher level
+	if (nextLegDynSpeed < parentSE->parentSEModel->dynamicSpeedModel->numSpeedLines)
+		nextLegDynSpeed++;
+	return nextLegDynSpeed;
+}
 
-	if (!pairedLeg) //terminal leg
-	{
-		Serial.printf("terminal %i\n", parentSE->isTerminal);
-		return parentSE->isTerminal ? 0 : parentSE->parentSEModel->dynamicSpeedModel->numSpeedLines - 1; //not possible to enter next leg, ctr = 0 or max in case it is leg to open track
-	}
-	else
+bool IoTT_SecElLeg::isStretchEntry() //true if this leg leads from a switch element or track end into a stretch of single track
+{
+	if (parentSE->numLegs > 2)
+		return legPos > 0; //from B or C through the switch towards A
+	return (!destSE) || (destSE->parentSE->numLegs > 2);
+}
+
+bool IoTT_SecElLeg::isStretchOccupied() //any block occupied between this leg and the next switch element
+{
+	IoTT_SecElLeg * thisLeg = this;
+	uint8_t maxHops = parentSE->parentSEModel->lookahead;
+	for (uint8_t hopCtr = 0; hopCtr < maxHops; hopCtr++)
 	{
-		if (!pairedLeg->destSE)
-		{
-			Serial.println("not paired ret 0 ");
-			return 0; //not possible to enter next leg, ctr = 0
-		}
-		else
-			if (pairedLeg->destSE->entryAspectGenerator) //it has an entry signal pointing towards us
-			{
-//				Serial.println("read destSE Ctr");
-				return pairedLeg->destSE->dynUptickCtr;
-			}
-			else
-			{
-				Serial.println("recursive call destSE");
-				return pairedLeg->destSE->getNextSignalDynCtr();
-			}
+		IoTT_SecElLeg * pairedLeg = thisLeg->getConnectedLeg();
+		if ((!pairedLeg) || (!pairedLeg->destSE))
+			return false;
+		IoTT_SecurityElement * nextSE = pairedLeg->destSE->parentSE;
+		if ((nextSE->numLegs > 2) || (nextSE->ctrlMode != APB)) //end of the APB stretch
+			return false;
+		if (digitraxBuffer->getBDStatus(nextSE->blockdetAddr))
+			return true;
+		thisLeg = pairedLeg->destSE;
 	}
+	return false;
 }
 
 IoTT_SecElLeg * IoTT_SecElLeg::getConnectedLeg()
@@ -523,8 +544,17 @@ void IoTT_SecurityElement::processLocoNetMsg(lnReceiveBuffer * newData)
 }
 */
 
-void IoTT_SecurityElement::processElement()
+bool IoTT_SecurityElement::hasNewEvents()
 {
+	return (digitraxBuffer->getBDStatus(blockdetAddr) != lastBDStatus) || (digitraxBuffer->getSwiPosition(switchAddr) != lastSwiPos);
+}
+
+bool IoTT_SecurityElement::processElement()
+{
+	uint8_t oldSpeed[3] = {0,0,0};
+	for (uint8_t i = 0; (i < numLegs) && (i < 3); i++)
+		if (connLeg[i])
+			oldSpeed[i] = connLeg[i]->getCurrentDynSpeed();
 	uint8_t eventMask = 0;
 	uint8_t hlpStat = digitraxBuffer->getBDStatus(blockdetAddr);
 	if (hlpStat != lastBDStatus)
@@ -546,6 +576,11 @@ void IoTT_SecurityElement::processElement()
 		case CTC: processCTC(eventMask); break;
 		default: processManualSE(eventMask); break;
 	}
+	for (uint8_t i = 0; (i < numLegs) && (i < 3); i++)
+		if (connLeg[i])
+			if (connLeg[i]->getCurrentDynSpeed() != oldSpeed[i])
+				return true;
+	return false;
 }
 
 void IoTT_SecurityElement::processABSS(uint8_t newEvents)
@@ -554,18 +589,7 @@ void IoTT_SecurityElement::processABSS(uint8_t newEvents)
 		for (uint16_t i = 0; i < numLegs; i++)
 			if (connLeg[i])
 			{
-				if (digitraxBuffer->getBDStatus(blockdetAddr))
-					connLeg[i]->setDynSpeed(0); //set dynamic In speed to zero and set all signals respective aspect
-				else
-				{
-					//get the speed of the in-leg of the next SE
-					uint8_t nextLegDynSpeed = connLeg[i]->getNextSignalDynCtr();
-					
-					//if not highest level, set dynamic in speed to next higher level
-					if (nextLegDynSpeed < parentSEModel->dynamicSpeedModel->numSpeedLines)
-						nextLegDynSpeed++;
-					connLeg[i]->setDynSpeed(nextLegDynSpeed);
-				}
+				connLeg[i]->setDynSpeed(connLeg[i]->getABSSpeed());
 
 //				if (((secelID == 5) && (i==0)) || ((secelID == 8) && (i!=0)) || ((secelID == 6) && (i==0)) || ((secelID == 7) && (i==0)) || ((secelID == 4) && (i==0)) || ((secelID == 9) && (i==0)) || ((secelID == 10) && (i==0)) || ((secelID == 11) && (i==0)) || ((secelID == 12) && (i==0))  )
 //					Serial.printf("SE %i Leg %i Speed Value %i\n", secelID, i, connLeg[i]->getCurrentDynSpeed());
@@ -578,16 +602,27 @@ void IoTT_SecurityElement::processABSS(uint8_t newEvents)
 			}
 }
 
-void IoTT_SecurityElement::processABSD(uint8_t newEvents)
+void IoTT_SecurityElement::processABSD(uint8_t newEvents) //double track, signals for the current of traffic from A to B/C only
 {
 //	Serial.print("D");
-	
+	if (numLegs > 0)
+		for (uint16_t i = 0; i < numLegs; i++)
+			if (connLeg[i])
+				connLeg[i]->setDynSpeed(i == 0 ? connLeg[i]->getABSSpeed() : 0);
 }
 
-void IoTT_SecurityElement::processAPB(uint8_t newEvents)
+void IoTT_SecurityElement::processAPB(uint8_t newEvents) //single track, absolute stop into an occupied stretch between switches, permissive ABS within the stretch
 {
 //		Serial.print("P");
-
+	if (numLegs > 0)
+		for (uint16_t i = 0; i < numLegs; i++)
+			if (connLeg[i])
+			{
+				if (connLeg[i]->isStretchEntry() && connLeg[i]->isStretchOccupied())
+					connLeg[i]->setDynSpeed(0);
+				else
+					connLeg[i]->setDynSpeed(connLeg[i]->getABSSpeed());
+			}
 }
 
 void IoTT_SecurityElement::processCTC(uint8_t newEvents)
@@ -693,6 +728,8 @@ void IoTT_SecurityElementModel::loadSecElCfgJSON(JsonObject thisObj)
 		dynamicSpeedModel = parentSEL->getDynamicSpeedByName(thisObj["DynSpeedModel"]);
 	if (thisObj.containsKey("StaticSpeedModel"))
 		staticSpeedModel = parentSEL->getStaticSpeedByName(thisObj["StaticSpeedModel"]);
+	if (thisObj.containsKey("Lookahead"))
+		lookahead = thisObj["Lookahead"];
 	if (thisObj.containsKey("SecurityElements"))
     {
         JsonArray secElementList = thisObj["SecurityElements"];
@@ -734,6 +771,19 @@ IoTT_SecElLeg * IoTT_SecurityElementModel::getLegPtr(uint16_t destSENr, uint8_t
 	return NULL;
 }
 
+uint16_t IoTT_SecurityElementModel::getNumSecEl()
+{
+	return numSecEl;
+}
+
+IoTT_SecurityElement * IoTT_SecurityElementModel::getSecEl(uint16_t elNr)
+{
+	if (elNr < numSecEl)
+		return secElList[elNr];
+	else
+		return NULL;
+}
+
 void IoTT_SecurityElementModel::resolveLegConnectors()
 {
 	for (uint16_t i = 0; i < numSecEl; i++)
@@ -857,14 +907,20 @@ void IoTT_SecurityElementList::processLocoNetMsg(lnReceiveBuffer * newData)
 }
 */
 
-IoTT_SecElLeg * IoTT_SecurityElementList::getLegPtr(uint16_t destSENr, uint8_t destSELeg)
+IoTT_SecElLeg * IoTT_SecurityElementList::getLegPtr(uint16_t destSENr, uint8_t destSELeg) //binary search in the compiled element table
 {
-	for (uint16_t i = 0; i < numSecModel; i++)
+	uint16_t lowIdx = 0;
+	uint16_t highIdx = numSE;
+	while (lowIdx < highIdx)
 	{
-		IoTT_SecElLeg * retPtr = secModelList[i]->getLegPtr(destSENr, destSELeg);
-		if (retPtr)
-			return retPtr;
+		uint16_t midIdx = (lowIdx + highIdx) >> 1;
+		if (seTable[midIdx]->secelID < destSENr)
+			lowIdx = midIdx + 1;
+		else
+			highIdx = midIdx;
 	}
+	if ((lowIdx < numSE) && (seTable[lowIdx]->secelID == destSENr))
+		return seTable[lowIdx]->getLegPtr(destSELeg);
 	return NULL;
 }
 
@@ -907,15 +963,189 @@ IoTT_SpeedTable* IoTT_SecurityElementList::getDynamicSpeedByName(String speedNam
 
 void IoTT_SecurityElementList::resolveLinks()
 {
-	for (int i = 0; i < numSecModel; i++)
+	compileTopology();
+}
+
+int compareSecElID(const void * elA, const void * elB)
+{
+	uint16_t idA = (*(IoTT_SecurityElement**)elA)->secelID;
+	uint16_t idB = (*(IoTT_SecurityElement**)elB)->secelID;
+	return (idA > idB) - (idA < idB);
+}
+
+int compareTopoAddr(const void * entryA, const void * entryB)
+{
+	uint16_t addrA = ((IoTT_TopoAddrEntry*)entryA)->addr;
+	uint16_t addrB = ((IoTT_TopoAddrEntry*)entryB)->addr;
+	return (addrA > addrB) - (addrA < addrB);
+}
+
+/*
+ * All elements of all models are collected in one table sorted by ID and their legs are numbered consecutively, so the 
+ * connections become a flat adjacency list (element, leg, connected leg). Block detector and switch addresses are mapped
+ * to elements, so an incoming event only queues the elements using that address. processLoop then re-evaluates the
+ * queued elements and follows changes to the neighbors, up to the lookahead depth of the model.
+ */
+void IoTT_SecurityElementList::compileTopology()
+{
+	freeTopology();
+	for (uint16_t i = 0; i < numSecModel; i++)
+		numSE += secModelList[i]->getNumSecEl();
+	if (numSE == 0)
+		return;
+	seTable = (IoTT_SecurityElement**) malloc(numSE * sizeof(IoTT_SecurityElement*));
+	uint16_t seCtr = 0;
+	for (uint16_t i = 0; i < numSecModel; i++)
+		for (uint16_t j = 0; j < secModelList[i]->getNumSecEl(); j++)
+			seTable[seCtr++] = secModelList[i]->getSecEl(j);
+	qsort(seTable, numSE, sizeof(IoTT_SecurityElement*), compareSecElID);
+	for (uint16_t i = 0; i < numSE; i++)
+	{
+		seTable[i]->seIndex = i;
+		seTable[i]->firstLeg = numTopoLegs;
+		numTopoLegs += seTable[i]->numLegs;
+	}
+	for (uint16_t i = 0; i < numSE; i++)
+		seTable[i]->resolveLegConnectors(); //uses getLegPtr on the sorted table
+
+	topoLegs = (IoTT_TopoLeg*) malloc(numTopoLegs * sizeof(IoTT_TopoLeg));
+	for (uint16_t i = 0; i < numSE; i++)
+		for (uint8_t j = 0; j < seTable[i]->numLegs; j++)
+		{
+			uint16_t legIndex = seTable[i]->firstLeg + j;
+			topoLegs[legIndex].seIndex = i;
+			topoLegs[legIndex].legPos = j;
+			topoLegs[legIndex].destLeg = -1;
+			if (seTable[i]->connLeg[j])
+				seTable[i]->connLeg[j]->legIndex = legIndex;
+		}
+	for (uint16_t i = 0; i < numSE; i++)
+		for (uint8_t j = 0; j < seTable[i]->numLegs; j++)
+		{
+			IoTT_SecElLeg * thisLeg = seTable[i]->connLeg[j];
+			if (thisLeg && thisLeg->destSE)
+				topoLegs[seTable[i]->firstLeg + j].destLeg = thisLeg->destSE->legIndex;
+		}
+	bdMap = compileAddrMap(false, &bdMapLen);
+	swiMap = compileAddrMap(true, &swiMapLen);
+
+	workList = (uint16_t*) malloc(numSE * sizeof(uint16_t));
+	workDepth = (uint8_t*) malloc(numSE * sizeof(uint8_t));
+	memset(workDepth, 0xFF, numSE);
+	for (uint16_t i = 0; i < numSE; i++)
+		queueElement(i, 0); //initial evaluation of all elements
+	Serial.printf("Security Elements: %i elements with %i legs compiled\n", numSE, numTopoLegs);
+}
+
+IoTT_TopoAddrEntry * IoTT_SecurityElementList::compileAddrMap(bool useSwiAddr, uint16_t * mapLen)
+{
+	IoTT_TopoAddrEntry * addrMap = (IoTT_TopoAddrEntry*) malloc(numSE * sizeof(IoTT_TopoAddrEntry));
+	*mapLen = 0;
+	for (uint16_t i = 0; i < numSE; i++)
 	{
-		IoTT_SecurityElementModel * thisModel = secModelList[i];
-		thisModel->resolveLegConnectors();
+		uint16_t thisAddr = useSwiAddr ? seTable[i]->switchAddr : seTable[i]->blockdetAddr;
+		if (thisAddr != 0xFFFF)
+		{
+			addrMap[*mapLen].addr = thisAddr;
+			addrMap[*mapLen].seIndex = i;
+			(*mapLen)++;
+		}
 	}
+	qsort(addrMap, *mapLen, sizeof(IoTT_TopoAddrEntry), compareTopoAddr);
+	return addrMap;
+}
+
+void IoTT_SecurityElementList::queueByAddr(IoTT_TopoAddrEntry * addrMap, uint16_t mapLen, uint16_t addr)
+{
+	uint16_t lowIdx = 0;
+	uint16_t highIdx = mapLen;
+	while (lowIdx < highIdx)
+	{
+		uint16_t midIdx = (lowIdx + highIdx) >> 1;
+		if (addrMap[midIdx].addr < addr)
+			lowIdx = midIdx + 1;
+		else
+			highIdx = midIdx;
+	}
+	while ((lowIdx < mapLen) && (addrMap[lowIdx].addr == addr)) //several elements may use the same address
+		queueElement(addrMap[lowIdx++].seIndex, 0);
+}
+
+void IoTT_SecurityElementList::queueElement(uint16_t seIndex, uint8_t depth)
+{
+	if (seIndex >= numSE)
+		return;
+	if (workDepth[seIndex] != 0xFF) //already in the list, keep the shorter distance
+	{
+		if (depth < workDepth[seIndex])
+			workDepth[seIndex] = depth;
+		return;
+	}
+	workDepth[seIndex] = depth;
+	workList[(workHead + workCount) % numSE] = seIndex;
+	workCount++;
+}
+
+void IoTT_SecurityElementList::processWorkList()
+{
+	while (workCount > 0)
+	{
+		uint16_t seIndex = workList[workHead];
+		workHead = (workHead + 1) % numSE;
+		workCount--;
+		uint8_t thisDepth = workDepth[seIndex];
+		workDepth[seIndex] = 0xFF;
+		IoTT_SecurityElement * thisElement = seTable[seIndex];
+		bool propagate = thisElement->processElement() || (thisElement->ctrlMode == APB); //APB stretch entries may be several elements away
+		for (uint8_t i = 0; (i < thisElement->numLegs) && !propagate; i++)
+			if (thisElement->connLeg[i])
+				propagate = !thisElement->connLeg[i]->hasEntrySignal(); //signals before this element look through it
+		if (propagate && (thisDepth < thisElement->parentSEModel->lookahead))
+			for (uint8_t i = 0; i < thisElement->numLegs; i++)
+			{
+				int16_t destLeg = topoLegs[thisElement->firstLeg + i].destLeg;
+				if (destLeg >= 0)
+					queueElement(topoLegs[destLeg].seIndex, thisDepth + 1);
+			}
+	}
+}
+
+void IoTT_SecurityElementList::processBtnEvent(sourceType inputEvent, uint16_t btnAddr, uint16_t eventValue) //queues the affected elements, evaluated in processLoop
+{
+	switch (inputEvent)
+	{
+		case evt_blockdetector: queueByAddr(bdMap, bdMapLen, btnAddr); break;
+		case evt_trackswitch: queueByAddr(swiMap, swiMapLen, btnAddr); break;
+		default: break;
+	}
+}
+
+void IoTT_SecurityElementList::freeTopology()
+{
+	free(seTable);
+	seTable = NULL;
+	numSE = 0;
+	free(topoLegs);
+	topoLegs = NULL;
+	numTopoLegs = 0;
+	free(bdMap);
+	bdMap = NULL;
+	bdMapLen = 0;
+	free(swiMap);
+	swiMap = NULL;
+	swiMapLen = 0;
+	free(workList);
+	workList = NULL;
+	free(workDepth);
+	workDepth = NULL;
+	workHead = 0;
+	workCount = 0;
+	scanPtr = 0;
 }
 
 void IoTT_SecurityElementList::freeObjects()
 {
+	freeTopology();
 	free(staticSpeedList);
 	staticSpeedList = NULL;
 	numStaticSpeedSets = 0;
@@ -938,11 +1168,13 @@ void IoTT_SecurityElementList::freeObjects()
 void IoTT_SecurityElementList::processLoop()
 {
 //	return;
-	for (int i = 0; i < numSecModel; i++)
+	for (uint8_t i = 0; (i < scanPerLoop) && (numSE > 0); i++) //background scan in case an event was not reported
 	{
-		IoTT_SecurityElementModel * thisModel = secModelList[i];
-		thisModel->processLoop();
+		if (seTable[scanPtr]->hasNewEvents())
+			queueElement(scanPtr, 0);
+		scanPtr = (scanPtr + 1) % numSE;
 	}
+	processWorkList();
 }
 
 /*----------------------------------------------------------------------------------------------------------------------*/
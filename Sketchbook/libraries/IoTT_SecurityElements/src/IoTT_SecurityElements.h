@@ -4,6 +4,7 @@
 #include <Arduino.h>
 #include <ArduinoJson.h>
 #include <IoTT_DigitraxBuffers.h>
+#include <IoTT_ButtonTypeDef.h>
 
 enum sigAddrType : uint8_t  {swiDyn=0, swiStat=1, sigNMRA=3};
 enum ctrlType: int8_t {manual=-1, ABSS=0, ABSD=1, APB=2, CTC=3};
@@ -62,6 +63,17 @@ class IoTT_SecurityElement; //forward declaration
 class IoTT_SecurityElementModel; //forward declaration
 class IoTT_SecurityElementList; //forward declaration
 
+typedef struct{
+	uint16_t seIndex; //element the leg belongs to, index into the sorted element table
+	uint8_t legPos; //0=A, 1=B, 2=C
+	int16_t destLeg; //index of the connected leg of the neighbor element, -1 if not connected
+} IoTT_TopoLeg;
+
+typedef struct{
+	uint16_t addr; //block detector or switch address
+	uint16_t seIndex;
+} IoTT_TopoAddrEntry;
+
 class IoTT_SecElLeg
 {
 	public:
@@ -79,6 +91,9 @@ class IoTT_SecElLeg
 		void sendAspectCommand(uint8_t aspectVal);
 		int calculateAspect();
 		uint8_t updateDynSpeedFromSignal();
+		uint8_t getABSSpeed();
+		bool isStretchEntry();
+		bool isStretchOccupied();
 //		void processLocoNetMsg(lnReceiveBuffer * newData);
 	private:
 		void freeObjects();
@@ -94,6 +109,7 @@ class IoTT_SecElLeg
 		uint16_t destSENr; //to be resolved at startup
 		uint8_t destSELeg; //to be resolved at startup
 		IoTT_SecElLeg * destSE; //pointer tp leg
+		uint16_t legIndex = 0xFFFF; //position in the compiled topology
 		
 		IoTT_AspectGenerator * entryAspectGenerator;
 		uint16_t entrySignalAddr[4] = {0xFFFF,0xFFFF,0xFFFF,0xFFFF};
@@ -115,7 +131,8 @@ class IoTT_SecurityElement
 		IoTT_SecElLeg * getLegPtr(uint8_t destSELeg);
 		void clearDirectionFlags();
 		void setDirection(bool inBound);
-		void processElement(); //the core processing routine
+		bool processElement(); //the core processing routine, returns true if any leg speed changed
+		bool hasNewEvents();
 		void processABSS(uint8_t newEvents);
 		void processABSD(uint8_t newEvents);
 		void processAPB(uint8_t newEvents);
@@ -149,6 +166,8 @@ class IoTT_SecurityElement
 		IoTT_SecurityElementList * parentSEL = NULL;
 		uint8_t numLegs = 0;
 		uint8_t selectedLeg = 1; //defaults to B, in case of no switch
+		uint16_t seIndex = 0xFFFF; //position in the compiled topology
+		uint16_t firstLeg = 0xFFFF; //legs A, B, C are stored consecutively in the topology
 		
 		bool autoProtect = false;
 		fallbackMode fbMode = nofallback;
@@ -171,6 +190,8 @@ class IoTT_SecurityElementModel
 		void processLoop();
 		void clearDirectionFlags();
 		void setDirection(bool inBound);
+		uint16_t getNumSecEl();
+		IoTT_SecurityElement * getSecEl(uint16_t elNr);
 //		void processLocoNetMsg(lnReceiveBuffer * newData);
 	private:
 		void freeObjects();
@@ -179,6 +200,7 @@ class IoTT_SecurityElementModel
 	public:
 		char modelName[50] = "";
 		bool isActive = false;
+		uint8_t lookahead = 8; //max number of elements a change is propagated, also limits signal search over elements without signal
 		IoTT_SecurityElementList * parentSEL = NULL;
 		IoTT_SpeedTable* dynamicSpeedModel = NULL;
 		IoTT_SpeedTable* staticSpeedModel = NULL;
@@ -192,6 +214,7 @@ class IoTT_SecurityElementList
 		void loadSecElCfgJSON(DynamicJsonDocument doc, bool resetList = true);
 		IoTT_SecElLeg * getLegPtr(uint16_t destSENr, uint8_t destSELeg);
 		void processLoop();
+		void processBtnEvent(sourceType inputEvent, uint16_t btnAddr, uint16_t eventValue);
 		IoTT_SpeedTable* getStaticSpeedByName(String speedName);
 		IoTT_SpeedTable* getDynamicSpeedByName(String speedName);
 		IoTT_AspectGenerator* getAspectGeneratorByName(String aspName);
@@ -200,7 +223,29 @@ class IoTT_SecurityElementList
 		void freeObjects();
 		IoTT_SecurityElementModel** secModelList = NULL;
 		void resolveLinks();
+		void freeTopology();
+		void compileTopology();
+		IoTT_TopoAddrEntry * compileAddrMap(bool useSwiAddr, uint16_t * mapLen);
+		void queueByAddr(IoTT_TopoAddrEntry * addrMap, uint16_t mapLen, uint16_t addr);
+		void queueElement(uint16_t seIndex, uint8_t depth);
+		void processWorkList();
 		uint16_t numSecModel = 0;
+
+		//compiled topology, rebuilt whenever models are loaded
+		IoTT_SecurityElement** seTable = NULL; //all elements of all models, sorted by secelID
+		uint16_t numSE = 0;
+		IoTT_TopoLeg * topoLegs = NULL;
+		uint16_t numTopoLegs = 0;
+		IoTT_TopoAddrEntry * bdMap = NULL; //sorted by address
+		uint16_t bdMapLen = 0;
+		IoTT_TopoAddrEntry * swiMap = NULL;
+		uint16_t swiMapLen = 0;
+		uint16_t * workList = NULL; //ring buffer of element indices, each element is queued at most once
+		uint8_t * workDepth = NULL; //per element, 0xFF if not queued
+		uint16_t workHead = 0;
+		uint16_t workCount = 0;
+		uint16_t scanPtr = 0; //background scan for changes not reported by processBtnEvent
+		uint8_t scanPerLoop = 4;
 	public:
 		IoTT_AspectGenerator** aspGenList = NULL;
 		IoTT_SpeedTable** staticSpeedList = NULL;
@@ -0,0 +1,62 @@
+#ifndef IoTT_BinFrame_h
+#define IoTT_BinFrame_h
+
+#include <inttypes.h>
+
+//framing of the binary link to the RedHat, see BinLink.h of the RedHat firmware. Frame: 0x00, COBS([seq][records][crc8]), 0x00
+//Kept apart from IoTT_SerInjector, so the host test in IoTT_DigitraxBuffers/extras/test checks it against the RedHat side
+
+#define binMaxFrame 32 //decoded frame incl. seq and crc, same limit as on the RedHat
+#define binMaxEnc (binMaxFrame + 1)
+
+//frames are shorter than 254 bytes, so there is never a 0xFF block
+inline uint8_t binCobsEncode(const uint8_t* srcBuf, uint8_t srcLen, uint8_t* dstBuf)
+{
+	uint8_t codePos = 0;
+	uint8_t outPos = 1;
+	for (uint8_t i = 0; i < srcLen; i++)
+	{
+		if (srcBuf[i] == 0)
+		{
+			dstBuf[codePos] = outPos - codePos;
+			codePos = outPos++;
+		}
+		else
+			dstBuf[outPos++] = srcBuf[i];
+	}
+	dstBuf[codePos] = outPos - codePos;
+	return outPos;
+}
+
+//in place, returns the decoded length or 0 for an invalid frame
+inline uint8_t binCobsDecode(uint8_t* dataBuf, uint8_t dataLen)
+{
+	uint8_t inPos = 0;
+	uint8_t outPos = 0;
+	while (inPos < dataLen)
+	{
+		uint8_t code = dataBuf[inPos++];
+		if ((code == 0) || ((inPos + code - 1) > dataLen))
+			return 0;
+		for (uint8_t i = 1; i < code; i++)
+			dataBuf[outPos++] = dataBuf[inPos++];
+		if ((code < 0xFF) && (inPos < dataLen))
+			dataBuf[outPos++] = 0;
+	}
+	return outPos;
+}
+
+//CRC-8, polynomial 0x07
+inline uint8_t binCrc8(const uint8_t* dataBuf, uint8_t dataLen)
+{
+	uint8_t crc = 0;
+	for (uint8_t i = 0; i < dataLen; i++)
+	{
+		crc ^= dataBuf[i];
+		for (uint8_t j = 0; j < 8; j++)
+			crc = (crc & 0x80) ? (crc << 1) ^ 0x07 : crc << 1;
+	}
+	return crc;
+}
+
+#endif
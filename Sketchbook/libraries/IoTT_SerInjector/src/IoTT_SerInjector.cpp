@@ -70,6 +70,8 @@ void IoTT_SerInjector::loadLNCfgJSON(DynamicJsonDocument doc)
 		baudRate = doc["BaudRate"];
 	if (doc.containsKey("Invert"))
 		m_invert = doc["Invert"];
+	if (doc.containsKey("BinLink"))
+		binLinkCfg = doc["BinLink"];
 	begin();
 }
 
@@ -425,6 +427,12 @@ void IoTT_SerInjector::processDCCExReceive()
 	while (available()) //read GridConnect protocol and package by message
 	{
 		char inData = read();
+		linkStats.rxBytes++;
+		if ((inData == 0) || binInFrame) //binary frame from the RedHat
+		{
+			handleBinIn(inData);
+			continue;
+		}
 		Serial.print(inData);
 		switch (inData)
 		{
@@ -469,8 +477,205 @@ void IoTT_SerInjector::processDCCExReceive()
 	}
 }
 
+
+uint8_t IoTT_SerInjector::buildDCCExText(lnTransmitMsg* thisEntry, char* txMsg)
+{
+	txMsg[0] = '\0';
+	switch (thisEntry->lnData[0])
+	{
+		case 0: //Power management
+			switch (thisEntry->lnData[1])
+			{
+				case 0: strcpy(txMsg, "<0>"); break; //off
+				case 1: strcpy(txMsg, "<1>"); break; //on
+				case 2: strcpy(txMsg, "<!>"); break; //idle
+			}
+			break;
+		case 1: //cab control
+		{
+			uint16_t cabAddr = (thisEntry->lnData[2] << 7) + (thisEntry->lnData[3] & 0x7F);
+			switch (thisEntry->lnData[1])
+			{
+				case 0: //remove from refresh buffer
+					sprintf(txMsg, "<- %i>", cabAddr);
+					break;
+				case 1: //add to refresh buffer
+					sprintf(txMsg, "<t 1 %i %i %i>", cabAddr, thisEntry->lnData[4], ((thisEntry->lnData[5] & 0x20)>>5) ^ 0x01); //[4]: SPD, [5]:DIRF Dir bit change from LocoNet to DCC++
+					break;
+			}
+			break;
+		}
+		case 2: //function control
+		{
+			uint16_t cabAddr = (thisEntry->lnData[1] << 7) + (thisEntry->lnData[2] &0x7F);
+			sprintf(txMsg, "<F %i %i %i>", cabAddr, thisEntry->lnData[3], thisEntry->lnData[4]);
+			break;
+		}
+		case 3: //switch control
+		{
+			uint16_t swiAddr = (thisEntry->lnData[1] << 7) + (thisEntry->lnData[2] &0x7F) +1; //DCC Offset
+			sprintf(txMsg, "<a %i %i>", swiAddr, thisEntry->lnData[3]);
+			break;
+		}
+		case 4: //immediate command
+		{
+			char subStr[5];
+			sprintf(txMsg, "<M 0");
+			for (uint8_t i = 1; i < thisEntry->lnMsgSize; i++)
+			{
+				sprintf(subStr, " %2X", thisEntry->lnData[i]);
+				strcat(txMsg, subStr);
+			}
+			strcat(txMsg, ">");
+			break;
+		}
+		case 5: //service mode programming
+		{
+			uint16_t cabAddr = (thisEntry->lnData[2] << 7) + (thisEntry->lnData[3] &0x7F);
+			uint8_t progMode = thisEntry->lnData[1];
+			uint16_t cvNr = (thisEntry->lnData[4] << 7) + (thisEntry->lnData[5] &0x7F);
+			uint8_t cvVal = thisEntry->lnData[6];
+			switch ((progMode & 0x04) >> 2)
+			{
+				case 0: // Service Mode
+					progTrackActive = true;
+					if ((progMode & 0x40) > 0) //write Op
+					{
+						if ((progMode & 0x20) > 0) //byte write Op
+							sprintf(txMsg, "<W %i %i %i %i>", cvNr, cvVal, 0, 0);
+						else //bit write Op, value as in LocoNet direct bit mode: 0000DBBB
+							sprintf(txMsg, "<B %i %i %i %i %i>", cvNr, cvVal & 0x07, (cvVal & 0x08) >> 3, 0, 0);
+					}
+					else //read op
+						sprintf(txMsg, "<R %i %i %i>", cvNr, 0, 0);
+					break;
+				case 1: //Ops Mode
+					sprintf(txMsg, "<w%i %i %i>", cabAddr, cvNr, cvVal);
+					break;
+			}
+			break;
+		}
+		case 99: //System configuration
+		{
+			uint16_t cfgId = (thisEntry->lnData[1] << 7) + (thisEntry->lnData[2] &0x7F);
+			uint16_t cfgVal = (thisEntry->lnData[3] << 7) + (thisEntry->lnData[4] &0x7F);
+			sprintf(txMsg, "<Z %i %i>", cfgId, cfgVal);
+			break;
+		}
+	}
+	return strlen(txMsg);
+}
+
+//same command as buildDCCExText as binary record, returns the record length or 0 if it can only be sent as text
+uint8_t IoTT_SerInjector::buildDCCExRecord(lnTransmitMsg* thisEntry, uint8_t* recBuf)
+{
+	switch (thisEntry->lnData[0])
+	{
+		case 0: //Power management
+			if (thisEntry->lnData[1] > 2)
+				return 0;
+			recBuf[0] = blrPower;
+			recBuf[1] = thisEntry->lnData[1];
+			return 2;
+		case 1: //cab control
+		{
+			uint16_t cabAddr = (thisEntry->lnData[2] << 7) + (thisEntry->lnData[3] & 0x7F);
+			recBuf[1] = cabAddr >> 8;
+			recBuf[2] = cabAddr & 0xFF;
+			switch (thisEntry->lnData[1])
+			{
+				case 0: //remove from refresh buffer
+					recBuf[0] = blrForget;
+					return 3;
+				case 1: //add to refresh buffer
+					recBuf[0] = blrSpeed;
+					recBuf[3] = (((thisEntry->lnData[5] & 0x20) ^ 0x20) << 2) | (thisEntry->lnData[4] & 0x7F);
+					return 4;
+			}
+			return 0;
+		}
+		case 2: //function control
+		{
+			uint16_t cabAddr = (thisEntry->lnData[1] << 7) + (thisEntry->lnData[2] &0x7F);
+			recBuf[0] = blrFunction;
+			recBuf[1] = cabAddr >> 8;
+			recBuf[2] = cabAddr & 0xFF;
+			recBuf[3] = (thisEntry->lnData[4] == 1 ? 0x80 : 0x00) | (thisEntry->lnData[3] & 0x7F);
+			return 4;
+		}
+		case 3: //switch control
+		{
+			uint16_t swiAddr = (thisEntry->lnData[1] << 7) + (thisEntry->lnData[2] &0x7F) +1; //DCC Offset
+			recBuf[0] = blrAccessory;
+			recBuf[1] = ((thisEntry->lnData[3] & 0x01) << 7) | (swiAddr >> 8);
+			recBuf[2] = swiAddr & 0xFF;
+			return 3;
+		}
+		case 4: //immediate command
+		{
+			uint8_t pktLen = thisEntry->lnMsgSize - 1;
+			if ((thisEntry->lnMsgSize < 2) || (pktLen > 5))
+				return 0;
+			recBuf[0] = blrPacket;
+			recBuf[1] = pktLen;
+			memcpy(&recBuf[2], &thisEntry->lnData[1], pktLen);
+			return pktLen + 2;
+		}
+		case 5: //service mode programming
+		{
+			uint16_t cabAddr = (thisEntry->lnData[2] << 7) + (thisEntry->lnData[3] &0x7F);
+			uint8_t progMode = thisEntry->lnData[1];
+			uint16_t cvNr = (thisEntry->lnData[4] << 7) + (thisEntry->lnData[5] &0x7F);
+			recBuf[0] = blrProg;
+			if ((progMode & 0x04) > 0) //Ops Mode
+				recBuf[1] = blpWriteMain;
+			else
+			{
+				progTrackActive = true;
+				if ((progMode & 0x40) > 0) //write Op
+					recBuf[1] = (progMode & 0x20) > 0 ? blpWrite : blpWriteBit;
+				else
+					recBuf[1] = blpRead;
+			}
+			recBuf[2] = cvNr >> 8;
+			recBuf[3] = cvNr & 0xFF;
+			recBuf[4] = thisEntry->lnData[6];
+			recBuf[5] = cabAddr >> 8;
+			recBuf[6] = cabAddr & 0xFF;
+			return 7;
+		}
+		case 99: //System configuration
+		{
+			uint16_t cfgId = (thisEntry->lnData[1] << 7) + (thisEntry->lnData[2] &0x7F);
+			uint16_t cfgVal = (thisEntry->lnData[3] << 7) + (thisEntry->lnData[4] &0x7F);
+			recBuf[0] = blrConfig;
+			recBuf[1] = cfgId >> 8;
+			recBuf[2] = cfgId & 0xFF;
+			recBuf[3] = cfgVal >> 8;
+			recBuf[4] = cfgVal & 0xFF;
+			return 5;
+		}
+	}
+	return 0;
+}
+
 void IoTT_SerInjector::processDCCExTransmit()
 {
+	if ((millis() - linkStatTime) > binStatInterval)
+		printLinkStats();
+	if (binLinkStatus == 1)
+	{
+		processBinTransmit();
+		return;
+	}
+	if (binLinkCfg && (binProbeCtr < binMaxProbe) && ((millis() - binProbeTime) > binProbeInterval))
+	{
+		//ask the RedHat for the binary link, it answers with a Hello frame. Old firmware ignores this
+		write("<D BINLINK ON>");
+		linkStats.txBytes += 14;
+		binProbeTime = millis();
+		binProbeCtr++;
+	}
 	//take new message from transmit queue and send to USB/PC
     if (que_wrPos != que_rdPos) //override protection
     {
@@ -479,127 +684,220 @@ void IoTT_SerInjector::processDCCExTransmit()
 		//send to USB port
 //		Serial.printf("DCC++Ex Transmit %i %i %i\n", hlpQuePtr, transmitQueue[hlpQuePtr].lnData[0], transmitQueue[hlpQuePtr].lnData[1]);
 		char txMsg[50];
-		switch (transmitQueue[hlpQuePtr].lnData[0])
+		uint8_t txLen = buildDCCExText(&transmitQueue[hlpQuePtr], txMsg);
+		write(txMsg);
+		linkStats.txBytes += txLen;
+		linkStats.cmdCtr++;
+		uint32_t cmdLatency = micros() - transmitQueue[hlpQuePtr].reqRecTime;
+		linkStats.latSum += cmdLatency;
+		if (cmdLatency > linkStats.latMax)
+			linkStats.latMax = cmdLatency;
+		Serial.print("Out: ");
+		Serial.println(txMsg);
+		que_rdPos = hlpQuePtr;
+	}
+}
+
+void IoTT_SerInjector::processBinTransmit()
+{
+	if (binAwaitAck)
+	{
+		if ((micros() - binFrameTime) > binAckTimeout)
 		{
-			case 0: //Power management
-				switch (transmitQueue[hlpQuePtr].lnData[1])
-				{
-					case 0: //off
-//						Serial.print("<0>");
-						write("<0>");
-						break;
-					case 1: //on
-//						Serial.print("<1>");
-						write("<1>");
-						break;
-					case 2: //idle
-//						Serial.print("<!>");
-						write("<!>");
-						break;
-				}
-				break;
-			case 1: //cab control
+			if (binRetryCtr < binMaxRetry)
 			{
-				uint16_t cabAddr = (transmitQueue[hlpQuePtr].lnData[2] << 7) + (transmitQueue[hlpQuePtr].lnData[3] & 0x7F);
-				switch (transmitQueue[hlpQuePtr].lnData[1])
+				write(binTxFrame, binTxLen);
+				linkStats.txBytes += binTxLen;
+				linkStats.retryCtr++;
+				binRetryCtr++;
+				binFrameTime = micros();
+			}
+			else
+			{
+				//RedHat does not answer, maybe it restarted. The commands are still in the queue and go out as text
+				//The frame may have been executed with only the ack lost. Speed, function, power and accessory commands set a
+				//state and can be sent again, programming and raw DCC packets are dropped, as running them twice is not the same
+				Serial.println("BinLink no ack, back to DCC-EX text");
+				uint8_t recBuf[binMaxFrame];
+				uint8_t keepPtr = binFrameEnd;
+				uint8_t quePtr = binFrameEnd;
+				while (quePtr != que_rdPos) //from the end of the frame backwards, the kept commands are moved up in order
 				{
-					case 0: //remove from refresh buffer
-					{
-						sprintf(txMsg, "<- %i>", cabAddr, transmitQueue[hlpQuePtr].lnData[3], transmitQueue[hlpQuePtr].lnData[4]);
-						write(txMsg);
-//						Serial.println(txMsg);
-					}
-					break;
-					case 1: //add to refresh buffer
+					buildDCCExRecord(&transmitQueue[quePtr], recBuf);
+					if ((recBuf[0] == blrProg) || (recBuf[0] == blrPacket))
+						linkStats.fallbackDropCtr++;
+					else
 					{
-						sprintf(txMsg, "<t 1 %i %i %i>", cabAddr, transmitQueue[hlpQuePtr].lnData[4], ((transmitQueue[hlpQuePtr].lnData[5] & 0x20)>>5) ^ 0x01); //[4]: SPD, [5]:DIRF Dir bit change from LocoNet to DCC++
-						write(txMsg);
-//						Serial.println(txMsg);
+						if (keepPtr != quePtr)
+							transmitQueue[keepPtr] = transmitQueue[quePtr];
+						keepPtr = (keepPtr + queBufferSize - 1) % queBufferSize;
 					}
-					break;
+					quePtr = (quePtr + queBufferSize - 1) % queBufferSize;
 				}
-				break;
+				que_rdPos = keepPtr;
+				binAwaitAck = false;
+				binLinkStatus = 0;
+				binProbeCtr = 0;
+				binProbeTime = millis();
+				linkStats.fallbackCtr++;
 			}
-			case 2: //function control
-			{
-				uint16_t cabAddr = (transmitQueue[hlpQuePtr].lnData[1] << 7) + (transmitQueue[hlpQuePtr].lnData[2] &0x7F);
-				sprintf(txMsg, "<F %i %i %i>", cabAddr, transmitQueue[hlpQuePtr].lnData[3], transmitQueue[hlpQuePtr].lnData[4]);
-				write(txMsg);
-//				Serial.println(txMsg);
-				break;
-			}
-			case 3: //switch control
-			{
-				uint16_t swiAddr = (transmitQueue[hlpQuePtr].lnData[1] << 7) + (transmitQueue[hlpQuePtr].lnData[2] &0x7F) +1; //DCC Offset
-				sprintf(txMsg, "<a %i %i>", swiAddr, transmitQueue[hlpQuePtr].lnData[3]);
-				write(txMsg);
-//				Serial.println(txMsg);
-				break;
-			}
-			case 4: //immediate command
-			{
-				char subStr[5];
-				sprintf(txMsg, "<M 0");
-//				sprintf(txMsg, "<M 0", transmitQueue[hlpQuePtr].lnData[3]);
-				for (uint8_t i = 1; i <   transmitQueue[hlpQuePtr].lnMsgSize; i++)
+		}
+		return;
+	}
+	if (que_wrPos == que_rdPos)
+		return;
+	//put as many queued commands as fit into one frame. While waiting for the ack, new commands collect in the queue for the next one
+	uint8_t frameBuf[binMaxFrame];
+	uint8_t frameLen = 0;
+	frameBuf[frameLen++] = binTxSeq;
+	uint8_t quePtr = que_rdPos;
+	uint8_t cmdCtr = 0;
+	char txMsg[50];
+	while (quePtr != que_wrPos)
+	{
+		uint8_t nextPtr = (quePtr + 1) % queBufferSize;
+		uint8_t recLen = buildDCCExRecord(&transmitQueue[nextPtr], &frameBuf[frameLen]);
+		if ((recLen == 0) || ((frameLen + recLen + 1) > binMaxFrame)) //+1 for the crc
+			break;
+		frameLen += recLen;
+		linkStats.textBytes += buildDCCExText(&transmitQueue[nextPtr], txMsg);
+		quePtr = nextPtr;
+		cmdCtr++;
+	}
+	if (cmdCtr == 0) //no binary record for this one, send it as text
+	{
+		uint8_t nextPtr = (que_rdPos + 1) % queBufferSize;
+		uint8_t txLen = buildDCCExText(&transmitQueue[nextPtr], txMsg);
+		write(txMsg);
+		linkStats.txBytes += txLen;
+		que_rdPos = nextPtr;
+		return;
+	}
+	frameBuf[frameLen] = binCrc8(frameBuf, frameLen);
+	frameLen++;
+	binTxLen = 0;
+	binTxFrame[binTxLen++] = 0;
+	binTxLen += binCobsEncode(frameBuf, frameLen, &binTxFrame[binTxLen]);
+	binTxFrame[binTxLen++] = 0;
+	write(binTxFrame, binTxLen);
+	linkStats.txBytes += binTxLen;
+	linkStats.frameCtr++;
+	linkStats.cmdCtr += cmdCtr;
+	binFrameEnd = quePtr; //commands stay in the queue until acknowledged
+	binAwaitAck = true;
+	binRetryCtr = 0;
+	binFrameTime = micros();
+}
+
+void IoTT_SerInjector::handleBinIn(uint8_t inData)
+{
+	if (inData == 0)
+	{
+		if (binInFrame && (binRxLen > 0)) //end of frame
+		{
+			processBinFrame();
+			binInFrame = false;
+		}
+		else
+			binInFrame = true; //start of frame or resync
+		binRxLen = 0;
+		return;
+	}
+	if (binRxLen < binMaxEnc)
+		binRxBuf[binRxLen++] = inData;
+	else
+	{
+		linkStats.badFrameCtr++;
+		binInFrame = false;
+	}
+}
+
+void IoTT_SerInjector::processBinFrame()
+{
+	uint8_t frameLen = binCobsDecode(binRxBuf, binRxLen);
+	if ((frameLen < 2) || (binCrc8(binRxBuf, frameLen - 1) != binRxBuf[frameLen - 1]))
+	{
+		linkStats.badFrameCtr++;
+		return;
+	}
+	frameLen--;
+	linkStats.rxFrameCtr++;
+	if (binRxSeq >= 0)
+		linkStats.rxLostCtr += (uint8_t)(binRxBuf[0] - binRxSeq - 1);
+	binRxSeq = binRxBuf[0];
+	uint8_t recPos = 1;
+	while (recPos < frameLen)
+	{
+		uint8_t* thisRec = &binRxBuf[recPos];
+		uint8_t recLen = thisRec[0] == blrProgReply ? 5 : 2;
+		if ((recPos + recLen) > frameLen)
+		{
+			linkStats.badFrameCtr++;
+			return;
+		}
+		lnTransmitMsg txOutBuffer;
+		txOutBuffer.reqID = 0;
+		switch (thisRec[0])
+		{
+			case blrHello:
+				if (binLinkStatus == 0)
 				{
-					sprintf(subStr, " %2X", transmitQueue[hlpQuePtr].lnData[i]);
-					strcat(txMsg, subStr);
+					Serial.printf("BinLink version %i active\n", thisRec[1]);
+					binLinkStatus = 1;
+					binAwaitAck = false;
 				}
-				strcat(txMsg, ">");
-				write(txMsg);
-//				Serial.println(txMsg);
 				break;
-			}
-			case 5: //service mode programming
-			{
-				uint16_t cabAddr = (transmitQueue[hlpQuePtr].lnData[2] << 7) + (transmitQueue[hlpQuePtr].lnData[3] &0x7F);
-				uint8_t progMode = transmitQueue[hlpQuePtr].lnData[1];
-				uint16_t cvNr = (transmitQueue[hlpQuePtr].lnData[4] << 7) + (transmitQueue[hlpQuePtr].lnData[5] &0x7F);
-				uint8_t cvVal = transmitQueue[hlpQuePtr].lnData[6];
-				switch ((progMode & 0x04) >> 2)
+			case blrAck:
+				if (binAwaitAck && (thisRec[1] == binTxSeq))
 				{
-					case 0: // Service Mode
-						progTrackActive = true;
-						if ((progMode & 0x40) > 0) //write Op
-						{
-							if ((progMode & 0x20) > 0) //byte write Op
-							{
-								sprintf(txMsg, "<W %i %i %i %i>", cvNr, cvVal, 0, 0);
-							}
-							else //bit write Op
-							{
-								uint8_t bitNr;
-								uint8_t bitVal;
-								sprintf(txMsg, "<B %i %i %i %i %i>", cvNr, bitNr, bitVal, 0, 0);
-							}
-						}
-						else //read op
-						{
-							sprintf(txMsg, "<R %i %i %i>", cvNr, 0, 0);
-						}
-						break;
-					case 1: //Ops Mode
-						sprintf(txMsg, "<w%i %i %i>", cabAddr, cvNr, cvVal);
-						break;
+					uint32_t ackTime = micros();
+					uint32_t rttTime = ackTime - binFrameTime;
+					linkStats.rttSum += rttTime;
+					if (rttTime > linkStats.rttMax)
+						linkStats.rttMax = rttTime;
+					while (que_rdPos != binFrameEnd)
+					{
+						que_rdPos = (que_rdPos + 1) % queBufferSize;
+						uint32_t cmdLatency = ackTime - transmitQueue[que_rdPos].reqRecTime;
+						linkStats.latSum += cmdLatency;
+						if (cmdLatency > linkStats.latMax)
+							linkStats.latMax = cmdLatency;
+					}
+					binAwaitAck = false;
+					binTxSeq++;
 				}
-				write(txMsg);
-//				Serial.print("Out: ");
-//				Serial.println(txMsg);
 				break;
-			}
-			case 99: //System configuration
-			{
-				uint16_t cfgId = (transmitQueue[hlpQuePtr].lnData[1] << 7) + (transmitQueue[hlpQuePtr].lnData[2] &0x7F);
-				uint16_t cfgVal = (transmitQueue[hlpQuePtr].lnData[3] << 7) + (transmitQueue[hlpQuePtr].lnData[4] &0x7F);
-				sprintf(txMsg, "<Z %i %i>", cfgId, cfgVal);
-				write(txMsg);
+			case blrSensor: //same as <Q n> / <q n>
+				txOutBuffer.lnData[0] = 11;
+				txOutBuffer.lnData[1] = thisRec[1] & 0x7F;
+				txOutBuffer.lnData[2] = (thisRec[1] & 0x80) > 0 ? 0 : 1;
+				txOutBuffer.lnMsgSize = 3;
+				processLNMsg(&txOutBuffer);
 				break;
-			}
+			case blrProgReply: //same as <r0|0|cv value>
+				txOutBuffer.lnData[0] = 5;
+				memset(&txOutBuffer.lnData[1], 0, 4);
+				memcpy(&txOutBuffer.lnData[5], &thisRec[1], 4);
+				txOutBuffer.lnMsgSize = 9;
+				processLNMsg(&txOutBuffer);
+				break;
+			default: //unknown record, length of the rest is unknown
+				linkStats.badFrameCtr++;
+				return;
 		}
-		Serial.print("Out: ");
-		Serial.println(txMsg);
-		que_rdPos = hlpQuePtr;
+		recPos += recLen;
 	}
 }
-	
+
+void IoTT_SerInjector::printLinkStats()
+{
+	uint32_t timeSpan = millis() - linkStatTime;
+	linkStatTime += timeSpan;
+	if ((linkStats.cmdCtr == 0) && (linkStats.rxFrameCtr == 0))
+		return;
+	float linkCap = (float)baudRate * timeSpan / 1000 / 10; //bytes per interval, 8N1
+	Serial.printf("DCC-EX link %s: %i cmds, latency avg %i max %i us, tx %i bytes %.1f%%, rx %i bytes %.1f%%\n", binLinkStatus == 1 ? "binary" : "text", linkStats.cmdCtr, linkStats.cmdCtr > 0 ? linkStats.latSum / linkStats.cmdCtr : 0, linkStats.latMax, linkStats.txBytes, 100 * linkStats.txBytes / linkCap, linkStats.rxBytes, 100 * linkStats.rxBytes / linkCap);
+	if (linkStats.frameCtr > 0)
+		Serial.printf("BinLink: %i frames, %.1f cmds per frame, %i bytes as text, ack rtt avg %i max %i us, %i retries, %i fallbacks, %i cmds dropped, %i frames in, %i lost, %i bad\n", linkStats.frameCtr, (float)linkStats.cmdCtr / linkStats.frameCtr, linkStats.textBytes, linkStats.rttSum / linkStats.frameCtr, linkStats.rttMax, linkStats.retryCtr, linkStats.fallbackCtr, linkStats.fallbackDropCtr, linkStats.rxFrameCtr, linkStats.rxLostCtr, linkStats.badFrameCtr);
+	linkStats = binLinkStats();
+}
@@ -31,6 +31,7 @@ Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
 #include <HardwareSerial.h>
 #include <ArduinoJson.h>
 #include <IoTT_DigitraxBuffers.h>
+#include <IoTT_BinFrame.h>
 
 
 // This class is compatible with the corresponding AVR one,
@@ -47,6 +48,50 @@ Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
 
 #define queBufferSize 50 //messages that can be written in one burst before buffer overflow
 
+//binary link to the RedHat, framing in IoTT_BinFrame.h
+#define binAckTimeout 50000 //micros until a frame is sent again
+#define binMaxRetry 2 //then back to DCC-EX text
+#define binProbeInterval 2000 //millis between <D BINLINK ON> requests
+#define binMaxProbe 5 //no answer, the RedHat firmware has no binary link
+#define binStatInterval 10000 //millis between link statistics
+
+#define blrPower 0x01
+#define blrSpeed 0x02
+#define blrForget 0x03
+#define blrFunction 0x04
+#define blrAccessory 0x05
+#define blrConfig 0x06
+#define blrProg 0x07
+#define blrPacket 0x08
+#define blrAck 0x80
+#define blrSensor 0x81
+#define blrProgReply 0x82
+#define blrHello 0x83
+
+#define blpRead 0
+#define blpWrite 1
+#define blpWriteBit 2
+#define blpWriteMain 3
+
+typedef struct
+{
+	uint32_t txBytes = 0; //everything written to the RedHat
+	uint32_t rxBytes = 0;
+	uint32_t textBytes = 0; //what the commands sent in binary frames would have taken as text
+	uint32_t cmdCtr = 0;
+	uint32_t frameCtr = 0;
+	uint32_t retryCtr = 0;
+	uint32_t fallbackCtr = 0;
+	uint32_t fallbackDropCtr = 0; //unacknowledged programming and packet commands not sent again as text
+	uint32_t rxFrameCtr = 0;
+	uint32_t rxLostCtr = 0;
+	uint32_t badFrameCtr = 0;
+	uint32_t latSum = 0; //command queued to ack received, or to written for text
+	uint32_t latMax = 0;
+	uint32_t rttSum = 0; //frame written to ack received
+	uint32_t rttMax = 0;
+} binLinkStats;
+
 class IoTT_DigitraxBuffers;
 
 class IoTT_SerInjector : public HardwareSerial
@@ -77,6 +122,12 @@ private:
 	void processDCCExTransmit();
 	int parseDCCExNumVal(char** startAt, uint8_t* cntVal);
 	bool parseDCCEx(lnTransmitMsg* thisEntry, lnTransmitMsg* txBuffer);
+	uint8_t buildDCCExText(lnTransmitMsg* thisEntry, char* txMsg);
+	uint8_t buildDCCExRecord(lnTransmitMsg* thisEntry, uint8_t* recBuf);
+	void processBinTransmit();
+	void handleBinIn(uint8_t inData);
+	void processBinFrame();
+	void printLinkStats();
 	
    // Member variables
    lnTransmitMsg transmitQueue[queBufferSize];
@@ -96,6 +147,24 @@ private:
    uint8_t numWrite, numRead;
 
    bool progTrackActive = false;
+
+   bool binLinkCfg = false; //BinLink in the config file
+   uint8_t binLinkStatus = 0; //0: text 1: binary
+   uint8_t binProbeCtr = 0;
+   uint32_t binProbeTime = 0;
+   uint8_t binTxSeq = 0;
+   uint8_t binTxFrame[binMaxEnc + 2]; //encoded with delimiters, kept until acknowledged
+   uint8_t binTxLen = 0;
+   bool binAwaitAck = false;
+   uint8_t binFrameEnd = 0; //queue position of the last command in the frame
+   uint8_t binRetryCtr = 0;
+   uint32_t binFrameTime = 0;
+   uint8_t binRxBuf[binMaxEnc];
+   uint8_t binRxLen = 0;
+   bool binInFrame = false;
+   int16_t binRxSeq = -1;
+   binLinkStats linkStats;
+   uint32_t linkStatTime = 0;
    
    uint8_t    bitRecStatus = 0;    	//LocoNet 0: waiting for OpCode; 1: waiting for package data
 									//OLCB:	0: await start char 1: await frame type 2: await ID 3: await end char
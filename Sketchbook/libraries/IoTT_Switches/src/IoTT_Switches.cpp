@@ -319,233 +319,255 @@ void IoTT_SwitchBase::processSwitch(bool extPwrOK)
 */
 }
 
-void IoTT_SwitchBase::processServoComplex()
+//converts incr/s to fixed point incr per refresh tick
+static int32_t speedPerTick(uint16_t incrPerSec)
 {
-	if (currMoveMode == 0) //linear movement mode
+	return ((int64_t)incrPerSec * refreshInterval << profileFracBits) / 1000000;
+}
+
+//converts incr/s2 to fixed point incr per tick2. 0 means no ramp, so return the given instant value
+static int32_t accelPerTick(uint16_t incrPerSec2, int32_t instantVal)
+{
+	if (incrPerSec2 == 0)
+		return instantVal;
+	int32_t retVal = ((int64_t)incrPerSec2 * refreshInterval * refreshInterval << profileFracBits) / 1000000000000LL;
+	return retVal > 0 ? retVal : 1;
+}
+
+/*
+ * Motion profiles are compiled once when a new target is set. A move consists of up to two legs (start to hesitation 
+ * point, then to the target), each leg of an accel/cruise segment followed by a decel segment. Per tick, the speed 
+ * is ramped towards the segment limit and added to the position, all in fixed point. The overshoot/bounce phase
+ * is a damped sine computed with a second order recurrence, so no float math is done while the servo moves.
+ */
+void IoTT_SwitchBase::processServoProfile()
+{
+	if (!targetMove)
+		return;
+	if ((targetMove != profTarget) || (targetMove->aspectPos != profEndPos) || ((currMoveMode == 0) && (targetMove->aspectPos != currentPos)))
 	{
-		uint16_t currPos = currentPos;
-		if (targetMove)
+		compileMove();
+		lastMoveTime = micros();
+		if (currMoveMode != 0)
+			return;
+	}
+	if (currMoveMode == 0)
+	{
+		if ((endMovePwrOff) && (endMoveTimeout < millis()) && (endMoveTimeout > 0))
 		{
-//			Serial.println("Target");
-			if (targetMove->aspectPos != currPos)
-			{
-				if (microsElapsed(lastMoveTime) > nextMoveWait)
-				{
-					lastMoveTime = micros();
-					//analyze the current status for further decision making
-					bool moveUp = targetMove->aspectPos > currPos;
-					uint8_t adjMode = targetMove->moveCfg & 0x0F;
-//					uint8_t adjMode = moveUp ? (targetMove->moveCfg & 0x0F) : ((targetMove->moveCfg & 0xF0) >> 4);
-					float_t linSpeed = moveUp ? (float_t) upSpeed : (float_t)(-1) * downSpeed; //set linSpeed to incr/s
-					bool correctDir = (sgn(currSpeed) == sgn(linSpeed)) || (currSpeed == 0.0);
-					bool softStop = ((adjMode & 0x03) == 1); //soft stop
-					bool softStart = (adjMode & 0x04); //overshoot or soft stop
-					bool beforeHesitate = hesPoint > 0 ? (moveUp ? currPos < hesPoint : currPos > hesPoint) : false; 
-					uint16_t moveEndPoint = beforeHesitate ? hesPoint : targetMove->aspectPos; //end point or hesitate
-					float moveEndSpeed = (beforeHesitate ? (sgn(linSpeed) * hesSpeed) : (adjMode & 0x02 ? (linSpeed) : (adjMode == 0 ? (linSpeed) : (0)))); //speed when arriving at end point, incr/s
-					int32_t breakDistance = round(sq(linSpeed - moveEndSpeed) / (2 * (int32_t)decelRate)); //s = v2 /2a
-					uint16_t breakPoint = moveEndPoint - (sgn(linSpeed) * breakDistance);
-					bool beforeBreakPoint = ((int)(breakPoint - currPos) * (int)sgn(linSpeed)) > 0;
-
-					//calculate dynamic data for step duration and width 
-					uint32_t stepDelay = currSpeed == 0 ? refreshInterval : round(1000000 / abs(currSpeed)); //calculating the duration of 1 step in micros/incr
-					float stepFactor = currSpeed == 0 ? 1 : 1 + (refreshInterval / stepDelay);  //calculate how many steps to take assuming X ms cycle time
-
-//					Serial.printf("Correct Dir: %i Lin Speed %f Curr Sp %f before break: %i going to %i \n", correctDir, linSpeed, currSpeed, beforeBreakPoint, moveEndPoint);
-					if (correctDir)
-					{
-						if (linSpeed != 0)
-						{
-							if (beforeBreakPoint)
-							{
-								if (abs(currSpeed) < abs(linSpeed))
-								{
-									if (softStart)
-									//accelerate
-										currSpeed += round((sgn(linSpeed) * stepFactor * (stepDelay * (int32_t)accelRate) / 1000000)); //v = v0 + at
-									else
-										currSpeed = linSpeed;
-									if (abs(currSpeed) > abs(linSpeed))
-										currSpeed = linSpeed;
-								}
-								//keep moving
-								currentPos += round(stepFactor * sgn(linSpeed)); //set the position
-								nextMoveWait = round(stepFactor * stepDelay); //set the delay time
-							}
-							else
-							{
-								if (currPos == targetMove->aspectPos) //final position
-								{
-									currentPos = targetMove->aspectPos;
-									nextMoveWait = refreshInterval; //1ms wait                
-								}
-								else
-								{
-									//accel-/decel to moveEndSpeed
-									bool endAccel = false;
-									if (abs(moveEndSpeed) > abs(currSpeed))
-									//accelerate
-									{
-										//add comparison to target speed at position, adjust acceleration if needed
-										currSpeed += round((sgn(linSpeed) * stepFactor * (stepDelay * (int32_t)accelRate) / 1000000)); //v = v0 + at
-										if (abs(moveEndSpeed) <= abs(currSpeed))
-											currSpeed = moveEndSpeed;
-										endAccel = currSpeed == moveEndSpeed;
-									}
-									else
-									//decelerate
-									{
-										//add comparison to target speed at position, adjust deceleration if needed
-										int sgnSpeed = sgn(currSpeed);
-										currSpeed -= round((sgn(linSpeed) * stepFactor * (stepDelay * (int32_t)decelRate) / 1000000)); //v = v0 - at
-										if (sgn(currSpeed) != sgnSpeed)
-											currSpeed = 0;
-										endAccel = currSpeed == 0;
-									}
-									//advance to moveEndPoint
-									if (endAccel)
-									{
-										currentPos = moveEndPoint;
-										nextMoveWait = refreshInterval; //1ms wait                
-									}
-									else
-									{
-										currentPos += round(stepFactor * sgn(linSpeed)); //set the position
-										nextMoveWait = round(stepFactor * stepDelay); //set the delay time
-									}
-								}
-							}
-							//when there, execute move end
-							bool currMoveUp = targetMove->aspectPos > currentPos;
-							if ((currentPos == targetMove->aspectPos) || (moveUp != currMoveUp)) //overshooting when speed > 1 incr per cycle
-								if ((adjMode & 0x03) > 1) //bounce back or overshooting
-								{
-									currentPos = targetMove->aspectPos;
-									currMoveMode = 1; //enter oscillation phase
-									timeNull = micros();
-								}
-								else
-									currSpeed = 0;
-						}
-						else
-						{
-							currentPos = targetMove->aspectPos;
-							nextMoveWait = 0;
-						}
-					}
-					else
-					{
-						if (softStop)
-						{
-							//decelerate and change direction. Speed is incr/s, accel/decel is incr/s2, time intervl is 1ms
-							int sgnSpeed = sgn(currSpeed);
-							currSpeed += round((sgn(linSpeed) * stepFactor * (stepDelay * (int32_t)decelRate) / 1000000)); //v = v0 - at
-							if (sgn(currSpeed) != sgnSpeed)
-								currSpeed = 0;
-						}
-						else
-							currSpeed = 0;
-						if (currSpeed != 0)
-						{
-							currentPos += round(stepFactor * sgn(currSpeed)); //set the position
-//							Serial.printf("New Pos %i Speed curr %f lin %f StepFactor %f\n", currentPos, currSpeed, linSpeed, stepFactor);
-							nextMoveWait = round(stepFactor * stepDelay); //set the delay time
-						}
-						else
-							nextMoveWait = refreshInterval; //standard 1ms wait
-					}
-					parentObj->setPWMValue(modIndex, round(currentPos));
-				}
-			}
-			else
-			{
-				if ((endMovePwrOff) && (endMoveTimeout < millis()) && (endMoveTimeout > 0))
-				{
-					endMoveTimeout = 0;
-					parentObj->setPWMValue(modIndex, 0);
-				}
-			}
+			endMoveTimeout = 0;
+			parentObj->setPWMValue(modIndex, 0);
 		}
+		return;
 	}
-	else //oscillator mode
+	uint32_t timePassed = microsElapsed(lastMoveTime);
+	if (timePassed < refreshInterval)
+		return;
+	uint8_t numTicks = 0;
+	while ((timePassed >= refreshInterval) && (numTicks < maxCatchUpTicks))
+	{
+		timePassed -= refreshInterval;
+		numTicks++;
+	}
+	if (timePassed >= refreshInterval) //too far behind, resync
+		lastMoveTime = micros();
+	else
+		lastMoveTime += numTicks * refreshInterval;
+	for (uint8_t i = 0; (i < numTicks) && (currMoveMode != 0); i++)
+		stepMove();
+}
+
+void IoTT_SwitchBase::compileMove()
+{
+	motionProfile * thisProfile = &moveProfile;
+	profTarget = targetMove;
+	profEndPos = targetMove->aspectPos;
+	if ((currMoveMode == 0) || (currMoveMode == 3)) //start from rest, a new target cancels the oscillation
 	{
-//Serial.println("end move");
-		bool moveUp = currentPos == targetMove->aspectPos;
-		uint8_t adjMode = targetMove->moveCfg & 0x0F;
-		float thisLambda = lambda; //(float)((moveUp ? (lambda & 0x0F) : ((lambda & 0xF0) >> 4)) + 1) / 2;
-		float thisFreq = frequency; //(float)((moveUp ? (frequency & 0x0F) : ((frequency & 0xF0) >> 4)) + 1) / 2;
-		float timePassed2 = (float)(micros() - timeNull) / 1000;
-		float timePassed = timePassed2 / 1000;
-		//calculate y(t)
-		float origAmpl = currSpeed / (TWO_PI * thisFreq);
-		float currAmpl = origAmpl  * exp(thisLambda * timePassed * -1);
-		float currVal = round(currAmpl * sin(TWO_PI * thisFreq * timePassed));
-		uint16_t pwmVal = currentPos; //moveUp ? (uint16_t)SERVOMAX : (uint16_t)SERVOMIN;
-
-		if ((currAmpl / origAmpl) > 0.1) //stop oscillator if amplitude < 10% of original value
+		thisProfile->currPos = (int32_t)currentPos << profileFracBits;
+		thisProfile->currSpeed = 0;
+	}
+	int32_t endPos = (int32_t)targetMove->aspectPos << profileFracBits;
+	bool simpleMove = (targetMove->moveCfg == 0);
+	uint8_t adjMode = simpleMove ? 0 : targetMove->moveCfg & 0x0F;
+	int8_t newDir = endPos > thisProfile->currPos ? 1 : -1;
+	int32_t maxSpeed = speedPerTick(newDir > 0 ? upSpeed : downSpeed);
+
+	if (endPos == thisProfile->currPos)
+	{
+		currMoveMode = 0;
+		return;
+	}
+	if ((thisProfile->currSpeed > 0) && (newDir != thisProfile->moveDir)) //direction change while moving
+	{
+		if ((adjMode & 0x03) == 1) //soft stop, brake first and compile again when standing
 		{
-			//PWM to targetPos
-			if ((adjMode & 0x03) == 3) //bounce back
-				//PWM to targetPos + newAmpl
-				pwmVal = moveUp ? pwmVal - currVal : pwmVal + currVal;
-			else //2, overshoot
-				//PWM to targetPos - abs(newAmpl)
-				pwmVal = moveUp ? pwmVal + currVal : pwmVal - currVal;
-			parentObj->setPWMValue(modIndex, pwmVal);
-//			endMoveTimeout = millis() + endMoveDelay;
-		} 
-		else //done, back to linear mode
+			thisProfile->brakeRate = accelPerTick(decelRate, thisProfile->currSpeed);
+			currMoveMode = 2;
+			return;
+		}
+		thisProfile->currSpeed = 0;
+	}
+	thisProfile->moveDir = newDir;
+	thisProfile->numSegments = 0;
+	thisProfile->currSegment = 0;
+	if (maxSpeed == 0) //no speed settings, go directly to the target
+	{
+		thisProfile->currPos = endPos;
+		thisProfile->currSpeed = 0;
+		currentPos = targetMove->aspectPos;
+		parentObj->setPWMValue(modIndex, currentPos);
+		currMoveMode = 0;
+		return;
+	}
+
+	bool softStart = (adjMode & 0x04);
+	int32_t accel = softStart ? accelPerTick(accelRate, maxSpeed) : maxSpeed; //without soft start, full speed is set in one tick
+	int32_t decel = accelPerTick(decelRate, maxSpeed);
+	int32_t endSpeed = ((adjMode & 0x02) || (adjMode == 0)) ? maxSpeed : 0; //speed when arriving at the target
+	int32_t legStart = thisProfile->currPos;
+	int32_t startSpeed = thisProfile->currSpeed;
+	int32_t hesPos = (int32_t)hesPoint << profileFracBits;
+	bool beforeHesitate = (!simpleMove) && (hesPoint > 0) && (((hesPos - legStart) * newDir) > 0) && (((endPos - hesPos) * newDir) > 0);
+
+	for (uint8_t legNr = 0; legNr < 2; legNr++)
+	{
+		int32_t legEnd = endPos;
+		int32_t legEndSpeed = endSpeed;
+		if (legNr == 0)
 		{
-			if (endMovePwrOff)
-				parentObj->setPWMValue(modIndex, 0);
+			if (beforeHesitate)
+			{
+				legEnd = hesPos;
+				legEndSpeed = min(speedPerTick(hesSpeed), maxSpeed);
+			}
+		}
+		else
+			if (!beforeHesitate)
+				break;
 			else
-				parentObj->setPWMValue(modIndex, currentPos);
-			currMoveMode = 0; 
-			currSpeed = 0; 
-//			endMoveTimeout = millis() + endMoveDelay;
+			{
+				legStart = hesPos;
+				startSpeed = min(speedPerTick(hesSpeed), maxSpeed);
+			}
+		//distances are fixed point as well: s = (v^2 - v0^2) / 2a
+		float legDist = abs(legEnd - legStart);
+		float peakSpeed = maxSpeed;
+		float accDist = startSpeed < maxSpeed ? (sq((float)maxSpeed) - sq((float)startSpeed)) / (2 * (float)accel) : 0;
+		float decDist = maxSpeed > legEndSpeed ? (sq((float)maxSpeed) - sq((float)legEndSpeed)) / (2 * (float)decel) : 0;
+		if (accDist + decDist > legDist) //triangle profile, max speed is not reached
+		{
+			peakSpeed = sqrt(((2 * (float)accel * decel * legDist) + (decel * sq((float)startSpeed)) + (accel * sq((float)legEndSpeed))) / (accel + decel));
+			if (peakSpeed < legEndSpeed)
+				legEndSpeed = peakSpeed;
+			decDist = (sq(peakSpeed) - sq((float)legEndSpeed)) / (2 * (float)decel);
 		}
-		nextMoveWait = refreshInterval; //standard 1ms wait
+		profileSegment * thisSeg = &thisProfile->segments[thisProfile->numSegments++];
+		thisSeg->endPos = legEnd - (newDir * (int32_t)round(decDist));
+		thisSeg->rate = startSpeed <= peakSpeed ? accel : decel;
+		thisSeg->limitSpeed = round(peakSpeed);
+		thisSeg = &thisProfile->segments[thisProfile->numSegments++];
+		thisSeg->endPos = legEnd;
+		thisSeg->rate = decel;
+		thisSeg->limitSpeed = max(legEndSpeed, (int32_t)(1 << (profileFracBits - 2))); //keep crawling so we always get there
 	}
+	currMoveMode = 1;
 }
 
-void IoTT_SwitchBase::processServoSimple()
+void IoTT_SwitchBase::stepMove()
 {
-	if (targetMove)
-		if (targetMove->aspectPos != currentPos)
+	motionProfile * thisProfile = &moveProfile;
+	switch (currMoveMode)
+	{
+		case 1: //run profile
 		{
-			if (microsElapsed(lastMoveTime) > nextMoveWait)
+			profileSegment * thisSeg = &thisProfile->segments[thisProfile->currSegment];
+			if (thisProfile->currSpeed < thisSeg->limitSpeed)
+				thisProfile->currSpeed = min(thisProfile->currSpeed + thisSeg->rate, thisSeg->limitSpeed);
+			else
+				thisProfile->currSpeed = max(thisProfile->currSpeed - thisSeg->rate, thisSeg->limitSpeed);
+			thisProfile->currPos += thisProfile->moveDir * thisProfile->currSpeed;
+			while (((thisSeg->endPos - thisProfile->currPos) * thisProfile->moveDir) <= 0)
 			{
-//		Serial.printf("s %i\n", targetMove->moveCfg);
-				lastMoveTime = micros();
-				bool moveUp = targetMove->aspectPos > currentPos;
-				uint16_t stepSpeed = moveUp ? upSpeed : downSpeed; //incr/s 
-				if (stepSpeed > 0) //valid speed settings
+				if (++thisProfile->currSegment < thisProfile->numSegments)
+					thisSeg = &thisProfile->segments[thisProfile->currSegment];
+				else
 				{
-					uint32_t stepDelay = round(1000000 / stepSpeed); //calculating the duration of 1 step
-					float stepFactor = 1 + (refreshInterval / stepDelay);  //calculate how many steps to take assuming 5ms cycle time
-					currentPos += round(stepFactor * (moveUp ? 1 : (-1))); //set the position
-					nextMoveWait = round(stepFactor * stepDelay); //set the delay time
-					bool nextDir = targetMove->aspectPos > currentPos;
-					if (moveUp != nextDir) //reached targetPos, so break the movement
-					{
-						currentPos = targetMove->aspectPos; //make sure to stop in case of overshoot nextMoveWait = refreshInterval;
-					}
+					thisProfile->currPos = (int32_t)profEndPos << profileFracBits;
+					break;
 				}
-				else //no settings, go with maximum speed to the target
+			}
+			currentPos = (thisProfile->currPos + (1 << (profileFracBits - 1))) >> profileFracBits;
+			parentObj->setPWMValue(modIndex, currentPos);
+			if (thisProfile->currSegment >= thisProfile->numSegments) //arrived at target
+			{
+				uint8_t adjMode = targetMove->moveCfg & 0x0F;
+				if (((adjMode & 0x03) > 1) && (frequency > 0)) //bounce back or overshooting
+					startOscillation();
+				else
 				{
-					currentPos = targetMove->aspectPos; //make sure to stop in case of overshooting
-					nextMoveWait = refreshInterval;
+					thisProfile->currSpeed = 0;
+					currMoveMode = 0;
 				}
-				parentObj->setPWMValue(modIndex, currentPos);
-//				endMoveTimeout = millis() + endMoveDelay;
 			}
+			break;
 		}
-		else
-			if ((endMovePwrOff) && (endMoveTimeout < millis()) && (endMoveTimeout > 0))
+		case 2: //braking before reversal
+		{
+			thisProfile->currSpeed = max(thisProfile->currSpeed - thisProfile->brakeRate, (int32_t)0);
+			thisProfile->currPos += thisProfile->moveDir * thisProfile->currSpeed;
+			currentPos = (thisProfile->currPos + (1 << (profileFracBits - 1))) >> profileFracBits;
+			parentObj->setPWMValue(modIndex, currentPos);
+			if (thisProfile->currSpeed == 0)
 			{
-				endMoveTimeout = 0;
-				parentObj->setPWMValue(modIndex, 0);
+				currMoveMode = 1; //keep the position from the profile
+				compileMove();
+			}
+			break;
+		}
+		case 3: //overshoot or bounce back
+		{
+			int32_t nextVal = ((int64_t)thisProfile->oscCoeff1 * thisProfile->oscVal - (int64_t)thisProfile->oscCoeff2 * thisProfile->oscPrevVal) >> oscFracBits;
+			thisProfile->oscPrevVal = thisProfile->oscVal;
+			thisProfile->oscVal = nextVal;
+			if (thisProfile->oscTicks > 0)
+			{
+				thisProfile->oscTicks--;
+				int32_t oscOffset = (thisProfile->oscSign * thisProfile->oscPrevVal) >> oscValBits;
+				parentObj->setPWMValue(modIndex, currentPos + oscOffset);
+			}
+			else //done, back to linear mode
+			{
+				if (endMovePwrOff)
+					parentObj->setPWMValue(modIndex, 0);
+				else
+					parentObj->setPWMValue(modIndex, currentPos);
+				thisProfile->currSpeed = 0;
+				currMoveMode = 0;
 			}
+			break;
+		}
+	}
+}
+
+void IoTT_SwitchBase::startOscillation()
+{
+	//y(t) = A * exp(-lambda * t) * sin(2 PI f t), A = v / (2 PI f), run until amplitude is down to 10%
+	motionProfile * thisProfile = &moveProfile;
+	float tickTime = (float)refreshInterval / 1000000;
+	float arrivalSpeed = ((float)thisProfile->currSpeed / (1 << profileFracBits)) / tickTime; //incr/s
+	float decayFactor = exp(-1 * (float)lambda * tickTime);
+	float angleStep = TWO_PI * frequency * tickTime;
+	float oscAmpl = arrivalSpeed / (TWO_PI * frequency);
+	thisProfile->oscCoeff1 = round(2 * decayFactor * cos(angleStep) * (1 << oscFracBits));
+	thisProfile->oscCoeff2 = round(sq(decayFactor) * (1 << oscFracBits));
+	thisProfile->oscPrevVal = 0;
+	thisProfile->oscVal = round(oscAmpl * decayFactor * sin(angleStep) * (1 << oscValBits));
+	float oscTime = lambda > 0 ? log(10) / (lambda * tickTime) : maxOscTicks; //in ticks
+	thisProfile->oscTicks = oscTime < maxOscTicks ? (uint16_t)ceil(oscTime) : maxOscTicks;
+	thisProfile->oscSign = ((targetMove->moveCfg & 0x03) == 3) ? -thisProfile->moveDir : thisProfile->moveDir; //bounce back or overshoot
+	thisProfile->currSpeed = 0;
+	currMoveMode = 3;
 }
 
 //------------2----------------------------------------------------------------------------------------------------
@@ -580,10 +602,7 @@ void IoTT_ServoDrive::processExtEvent(sourceType inputEvent, uint16_t btnAddr, u
 	}
 	if (targetMove)
 	{
-		if (targetMove->moveCfg == 0)
-			processServoSimple();
-		else
-			processServoComplex();
+		processServoProfile();
 	}
 }
 
@@ -751,10 +770,7 @@ void IoTT_ServoDrive::processSwitch(bool extPwrOK)
 	if (extPwrOK)
 		if (targetMove)
 		{
-			if (targetMove->moveCfg == 0)
-				processServoSimple();
-			else
-				processServoComplex();
+			processServoProfile();
 		}
 		else
 		{
@@ -907,10 +923,42 @@ void IoTT_GreenHat::setPWMValue(uint8_t lineNr, uint16_t pwmVal)
 {
 //	if (lineNr == 0)
 //		Serial.printf("%i pos %i\n", lineNr, pwmVal);
-	ghPWM->setPWM(lineNr, 0, pwrOK ? pwmVal : 0); //if external DC power missing, we shut down servo electrically
-	IoTT_SwitchBase * thisSwiMod = switchModList[lineNr];
-	if (pwmVal > 0)
+	uint16_t newVal = pwrOK ? pwmVal : 0; //if external DC power missing, we shut down servo electrically
+	if (pwmShadow[lineNr] != newVal)
+	{
+		pwmShadow[lineNr] = newVal;
+		pwmDirty |= (1 << lineNr);
+	}
+	if ((pwmVal > 0) && (lineNr < switchModListLen))
+	{
+		IoTT_SwitchBase * thisSwiMod = switchModList[lineNr];
 		thisSwiMod->endMoveTimeout = millis() + endMoveDelay;
+	}
+}
+
+void IoTT_GreenHat::flushPWM()
+{
+	//write all changed channels in one auto increment transaction, unchanged channels in between are rewritten from the shadow
+	if (pwmDirty == 0)
+		return;
+	uint8_t firstLine = 0;
+	uint8_t lastLine = 15;
+	while ((pwmDirty & (1 << firstLine)) == 0)
+		firstLine++;
+	while ((pwmDirty & (1 << lastLine)) == 0)
+		lastLine--;
+	TwoWire * thisWire = parentObj->swiWire;
+	thisWire->beginTransmission(pwmDriverAddr - hatIndex);
+	thisWire->write(PCA9685_LED0_ON_L + (4 * firstLine));
+	for (uint8_t i = firstLine; i <= lastLine; i++)
+	{
+		thisWire->write(0); //on time
+		thisWire->write(0);
+		thisWire->write(pwmShadow[i] & 0xFF); //off time
+		thisWire->write(pwmShadow[i] >> 8);
+	}
+	thisWire->endTransmission();
+	pwmDirty = 0;
 }
 
 void IoTT_GreenHat::processBtnEvent(sourceType inputEvent, uint16_t btnAddr, uint16_t eventValue)
@@ -923,10 +971,8 @@ void IoTT_GreenHat::processBtnEvent(sourceType inputEvent, uint16_t btnAddr, uin
 		for (int i=0; i < switchModListLen; i++)
 		{
 			IoTT_SwitchBase * thisSwiMod = switchModList[i];
-			thisSwiMod->processExtEvent(inputEvent, btnAddr, eventValue); //transponder info is not buffered, so we process the event
+			thisSwiMod->processExtEvent(inputEvent, btnAddr, eventValue); //servos move on the transponder event itself
 		}
-		if (myChain)
-			myChain->processBtnEvent(inputEvent, btnAddr, eventValue);
 	}
 }
 
@@ -956,6 +1002,7 @@ void IoTT_GreenHat::processSwitch(bool extPwrOK)
 			thisSwiMod->processSwitch(extPwrOK);
 		}
 	}
+	flushPWM();
 	if (startUpCtr == 0)
 	{
 		if (buttonHandler) 
@@ -1010,6 +1057,7 @@ void IoTT_GreenHat::moveServo(uint8_t servoNr, uint16_t servoPos)
 {
 //	Serial.printf("Servo Nr %i to Pos %i\n", servoNr, servoPos);
 	setPWMValue(servoNr, servoPos);
+	flushPWM();
 }
 
 //----------------------------------------------------------------------------------------------------------------
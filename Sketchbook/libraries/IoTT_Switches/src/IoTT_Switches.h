@@ -47,6 +47,13 @@ const uint16_t endMoveDelay = 2500; //ms until servo shutoff after target is rea
 #define minPos 210
 #define initPos 215
 
+const uint8_t profileFracBits = 16; //fixed point fraction bits for servo position and speed
+const uint8_t oscFracBits = 14; //fixed point fraction bits for the oscillator coefficients
+const uint8_t oscValBits = 8; //fixed point fraction bits for the oscillator amplitude
+const uint8_t maxProfileSegments = 4; //accel/cruise and decel for up to 2 legs (hesitation)
+const uint8_t maxCatchUpTicks = 4; //max number of profile ticks executed in one call if the loop was late
+const uint16_t maxOscTicks = 250; //upper limit for the overshoot/bounce phase, 2 sec
+
 #define servoFileName "/servos"
 #define servoFileExt ".dat"
 
@@ -59,6 +66,30 @@ typedef struct
 	uint8_t moveCfg;
 } aspectEntry;
 
+typedef struct
+{
+	int32_t endPos; //fixed point position where the segment ends
+	int32_t rate; //fixed point speed change per tick to get to limitSpeed
+	int32_t limitSpeed; //fixed point speed per tick that is kept once reached
+} profileSegment;
+
+typedef struct
+{
+	int8_t  moveDir = 0;
+	uint8_t numSegments = 0;
+	uint8_t currSegment = 0;
+	int32_t currPos = 0; //fixed point, profileFracBits
+	int32_t currSpeed = 0; //fixed point incr per tick, always >= 0, see moveDir
+	int32_t brakeRate = 0; //used when braking before a direction change
+	profileSegment segments[maxProfileSegments];
+	int32_t oscCoeff1 = 0; //2 r cos(w), oscFracBits
+	int32_t oscCoeff2 = 0; //r^2, oscFracBits
+	int32_t oscVal = 0; //damped sine, oscValBits
+	int32_t oscPrevVal = 0;
+	uint16_t oscTicks = 0;
+	int8_t oscSign = 0;
+} motionProfile;
+
 class IoTT_SwitchList;
 class IoTT_GreenHat;
 
@@ -72,8 +103,10 @@ public:
 	virtual void processExtEvent(sourceType inputEvent, uint16_t btnAddr, uint16_t eventValue);
 	virtual void processSwitch(bool extPwrOK);
 	void processServo(uint8_t servoNr);
-	void processServoSimple();
-	void processServoComplex();
+	void processServoProfile();
+	void compileMove();
+	void stepMove();
+	void startOscillation();
 	virtual void loadSwitchCfgJSON(JsonObject thisObj);
 	void saveRunTimeData(File * dataFile = NULL);
 	void loadRunTimeData(File * dataFile = NULL);
@@ -108,15 +141,15 @@ public:
 	aspectEntry * aspectList = NULL;
 	
 //runtime variables
-	uint8_t  currMoveMode; //runtime data 0: at target; 1: accelerating; 2: linear movememnt; 3: hesitating; 4: stopping
+	uint8_t  currMoveMode = 0; //runtime data 0: at target; 1: running profile; 2: braking before reversal; 3: oscillating
 	uint16_t  extSwiPos = 0xFFFF;
 //	uint16_t targetPos = minPos;
 	aspectEntry * targetMove = NULL;
+	aspectEntry * profTarget = NULL; //target the current profile was compiled for
+	int16_t profEndPos = -1;
 	uint16_t currentPos = 0;
-	uint32_t nextMoveWait = refreshInterval;
 	uint32_t lastMoveTime = micros();
-	float_t currSpeed = 0;
-	uint32_t timeNull; //runtime data
+	motionProfile moveProfile;
 public:
 	IoTT_GreenHat * parentObj = NULL;
 };
@@ -156,6 +189,7 @@ public:
 	void processSwitch(bool extPwrOK);
 	void processBtnEvent(sourceType inputEvent, uint16_t btnAddr, uint16_t eventValue);
 	void setPWMValue(uint8_t lineNr, uint16_t pwmVal);
+	void flushPWM();
 	bool isVerified();
 	void moveServo(uint8_t servoNr, uint16_t servoPos);
 	void saveRunTimeData(File * dataFile);
@@ -163,6 +197,8 @@ public:
 	void identifyLED(uint16_t LEDNr);
 private:
 	Adafruit_PWMServoDriver * ghPWM = NULL;
+	uint16_t pwmShadow[16] = {0}; //last value per channel, written in one auto increment transaction by flushPWM
+	uint16_t pwmDirty = 0;
 	IoTT_SwitchBase ** switchModList = NULL;
 	uint16_t switchModListLen = 0;
 	IoTT_Mux64Buttons * myButtons = NULL;
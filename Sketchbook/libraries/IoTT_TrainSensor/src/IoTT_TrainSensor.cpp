@@ -94,7 +94,9 @@ volatile void IoTT_TrainSensor::sensorTask(void * thisParam)
 
 		bool dirFwd = relMove >= 0;
 
-		workData.avgMove = (0.995 * workData.avgMove) + (0.005 * relMove); //used to detect standstill
+		int32_t filterInput = kfToFix(relMove);
+		emaUpdate(&avgMoveFilter, &filterInput, 1, sensorEmaAlpha); //used to detect standstill
+		workData.avgMove = kfToFloat(avgMoveFilter);
 
 		bool isMoving = (abs(workData.avgMove) > 0.25);
 //		Serial.printf("%.2f %.2f %.2f \n", rotAngle/100, relMove, workData.avgMove);
@@ -112,9 +114,13 @@ volatile void IoTT_TrainSensor::sensorTask(void * thisParam)
 		linDistance = (float)relMove * wheelDia * PI / 360;
 		avgDistance = workData.avgMove * wheelDia * PI / 360;
 		if (isMoving)
-			workData.currSpeedTech = 0.995 * workData.currSpeedTech + 0.005 * avgDistance * 1000000 / speedDiff;
+		{
+			filterInput = kfToFix(avgDistance * 1000000 / speedDiff);
+			emaUpdate(&speedFilter, &filterInput, 1, sensorEmaAlpha);
+		}
 		else
-			workData.currSpeedTech = 0;
+			speedFilter = 0;
+		workData.currSpeedTech = kfToFloat(speedFilter);
 				
 		lastSpeedTime = currTime;
 		if (isMoving)
@@ -198,6 +204,8 @@ volatile void IoTT_TrainSensor::sensorTask(void * thisParam)
 			dispData = workData;
 			xSemaphoreGive(sensorSemaphore);
 		}
+		sensorSample newSample = {currTime, workData.relIntegrator, workData.currSpeedTech, workData.axisAngle};
+		sampleRing.push(newSample); //if processLoop falls behind, the new samples are lost and counted in the ring
 	}
 }
 
@@ -331,6 +339,8 @@ void IoTT_TrainSensor::loadLNCfgJSON(DynamicJsonDocument doc)
 		workData.dispDim = (uint8_t)doc["Units"]; //0: metric; 1: imperial
 	if (doc.containsKey("MagThreshold"))
 		magThreshold = doc["MagThreshold"]; //0: metric; 1: imperial
+	if (doc.containsKey("SampleDecimation"))
+		streamDecimation = max((uint8_t)doc["SampleDecimation"], (uint8_t)1); //every n-th sample goes to the web page
 	begin();
 }
 
@@ -467,7 +477,9 @@ void IoTT_TrainSensor::toggleDirCommand()
 	int8_t currSlot = digitraxBuffer->getFocusSlotNr();
 	if ((currSlot > 0) || (digitraxBuffer->getLocoNetMode() == false))
 	{
-		slotData * focusSlot = digitraxBuffer->getSlotData(currSlot);
+		slotData focusData; //copy, the slot may change while we work with it
+		digitraxBuffer->getSlotSnapshot(currSlot, &focusData);
+		slotData * focusSlot = &focusData;
 		lnTransmitMsg txBuffer;
 		txBuffer.lnData[0] = 0xA1; //OPC_LOCO_DIRF 
 		txBuffer.lnData[1] = currSlot;
@@ -526,6 +538,7 @@ bool IoTT_TrainSensor::processTestStep(sensorData * sensStatus)
 			speedSample.adminData.testStartLinIntegrator = sensStatus->relIntegrator;
 			speedSample.adminData.lastLinIntegrator = speedSample.adminData.testStartLinIntegrator;
 			speedSample.adminData.measureStartTime = micros();
+			clrSpeedFit(speedSample.adminData.measureStartTime, speedSample.adminData.testStartLinIntegrator);
 			speedSample.adminData.validSample = true;
 		}
 	}
@@ -538,7 +551,9 @@ bool IoTT_TrainSensor::processSpeedTest() //returns false if complete
 	int8_t currSlot = digitraxBuffer->getFocusSlotNr();
 	if ((currSlot > 0) || (digitraxBuffer->getLocoNetMode() == false))
 	{
-		slotData * focusSlot = digitraxBuffer->getSlotData(currSlot);
+		slotData focusData; //copy, the slot may change while we work with it
+		digitraxBuffer->getSlotSnapshot(currSlot, &focusData);
+		slotData * focusSlot = &focusData;
 		bool forwardDir = ((*focusSlot)[3] & 0x20) == 0; //forward = bit cleared
 		sensorData cpyData = getSensorData();
 		uint8_t upDirIndex = speedSample.adminData.upDir ? 1 : 0;
@@ -593,7 +608,11 @@ bool IoTT_TrainSensor::processSpeedTest() //returns false if complete
 //								Serial.printf("UpDirPos: %i\n", speedSample.adminData.upDirPos);
 							}
 							float_t * dataEntry = forwardDir ? &speedSample.fw[speedSample.adminData.currSpeedStep] : &speedSample.bw[speedSample.adminData.currSpeedStep];
-							(*dataEntry) = abs(1000000 * distSince / timeSince);
+							float_t fitSpeed;
+							if (getFitSpeed(&fitSpeed)) //slope of all samples since measureStartTime
+								(*dataEntry) = abs(fitSpeed);
+							else
+								(*dataEntry) = abs(1000000 * distSince / timeSince);
 							
 //							Serial.printf("spd: %.2f %.2f %i %i\n", (*dataEntry), speedSample.adminData.crawlSpeedMax, speedSample.adminData.testState[upDirIndex].crawlSpeedStep, speedSample.adminData.currSpeedStep);
 							if (((*dataEntry) < speedSample.adminData.crawlSpeedMax) && (speedSample.adminData.testState[upDirIndex].crawlSpeedStep < speedSample.adminData.currSpeedStep))
@@ -661,7 +680,7 @@ bool IoTT_TrainSensor::processSpeedTest() //returns false if complete
 	return true;
 }
 
-void IoTT_TrainSensor::programmerReturn(uint8_t * programmerSlot)
+void IoTT_TrainSensor::programmerReturn(uint8_t * programmerSlot, uint16_t jobsPending)
 {
 	uint16_t opsAddr = (programmerSlot[2]<<7) + (programmerSlot[3] & 0x7F);
 	uint16_t cvNr = ((programmerSlot[5] & 0x30)<<4) + ((programmerSlot[5] & 0x01)<<7) + (programmerSlot[6] & 0x7F) + 1;
@@ -677,6 +696,7 @@ void IoTT_TrainSensor::programmerReturn(uint8_t * programmerSlot)
 		Data["OpsAddr"] = opsAddr;
 		Data["CVNr"] = cvNr;
 		Data["CVVal"]= cvVal;
+		Data["Pending"] = jobsPending;
 		serializeJson(doc, myMqttMsg);
 //		Serial.println(myMqttMsg);
 		globalClient->text(myMqttMsg);
@@ -740,8 +760,9 @@ void IoTT_TrainSensor::sendSensorDataToWeb()
 		int8_t currSlotNr = digitraxBuffer->getFocusSlotNr();
 		if (currSlotNr >= 0)
 		{
-			slotData * currSlot = digitraxBuffer->getSlotData(currSlotNr);
-			if (currSlot)
+			slotData slotCopy;
+			digitraxBuffer->getSlotSnapshot(currSlotNr, &slotCopy);
+			slotData * currSlot = &slotCopy;
 			{
 				uint16_t thisAddr = (((*currSlot)[6] & 0x7F) << 7) + ((*currSlot)[1] & 0x7F); //from IoTT_DigitraxBuffers.h
 //				Serial.println(thisAddr);
@@ -760,8 +781,99 @@ void IoTT_TrainSensor::sendSensorDataToWeb()
 	}
 }
 
+void IoTT_TrainSensor::clrSpeedFit(uint32_t startTime, float_t startPos)
+{
+	speedFit.startTime = startTime;
+	speedFit.startPos = startPos;
+	speedFit.numSamples = 0;
+	speedFit.sumT = 0;
+	speedFit.sumX = 0;
+	speedFit.sumTT = 0;
+	speedFit.sumTX = 0;
+}
+
+//speed [mm/s] as slope of the regression line of position over time, false if there are too few samples
+bool IoTT_TrainSensor::getFitSpeed(float_t * fitSpeed)
+{
+	double divisor = (speedFit.numSamples * speedFit.sumTT) - (speedFit.sumT * speedFit.sumT);
+	if ((speedFit.numSamples < minFitSamples) || (divisor <= 0))
+	{
+		fitFallbackCtr++;
+		return false;
+	}
+	*fitSpeed = ((speedFit.numSamples * speedFit.sumTX) - (speedFit.sumT * speedFit.sumX)) / divisor;
+	fitCtr++;
+	return true;
+}
+
+void IoTT_TrainSensor::sendSampleBatch()
+{
+	if (globalClient && !globalClient->queueIsFull())
+	{
+		uint32_t sendMillis = millis(); //lets the page convert the micros() time stamps to the millis() time of the SensorData messages
+		uint32_t sendMicros = micros();
+		sampleBatch[0] = sampleBatchFormat;
+		sampleBatch[1] = streamDecimation;
+		sampleBatch[2] = batchCount;
+		sampleBatch[3] = 0;
+		memcpy(&sampleBatch[4], &sendMillis, 4);
+		memcpy(&sampleBatch[8], &sendMicros, 4);
+		globalClient->binary(&sampleBatch[0], sampleBatchHeaderLen + (batchCount * sizeof(sensorSample)));
+		batchCtr++;
+	}
+	else
+		batchDropCtr++;
+	batchCount = 0;
+}
+
+//empties the sample ring. Every sample goes to the speed fit while a step is measured, every streamDecimation-th sample to the web page
+void IoTT_TrainSensor::processSamples()
+{
+	sensorSample thisSample;
+	while (sampleRing.pop(thisSample))
+	{
+		sampleCtr++;
+		if (speedSample.adminData.validSample && ((int32_t)(thisSample.timeStamp - speedFit.startTime) >= 0))
+		{
+			double sampleT = (thisSample.timeStamp - speedFit.startTime) / 1000000.0; //[s]
+			double sampleX = thisSample.relIntegrator - speedFit.startPos; //[mm]
+			speedFit.numSamples++;
+			speedFit.sumT += sampleT;
+			speedFit.sumX += sampleX;
+			speedFit.sumTT += sampleT * sampleT;
+			speedFit.sumTX += sampleT * sampleX;
+		}
+		if ((refreshRate > 0) && globalClient)
+		{
+			if (++decimationCtr >= streamDecimation)
+			{
+				decimationCtr = 0;
+				if (batchCount == 0)
+					batchStartTime = millis();
+				memcpy(&sampleBatch[sampleBatchHeaderLen + (batchCount * sizeof(sensorSample))], &thisSample, sizeof(sensorSample));
+				if (++batchCount >= sampleBatchSize)
+					sendSampleBatch();
+			}
+		}
+		else
+			batchCount = 0;
+	}
+	if ((batchCount > 0) && ((millis() - batchStartTime) > sampleBatchTimeout))
+		sendSampleBatch();
+}
+
+void IoTT_TrainSensor::printStats()
+{
+	Serial.printf("Train sensor: %i samples, ring max %i of %i, %i lost\n", sampleCtr, sampleRing.maxFillLevel, sampleRingSize - 1, sampleRing.overflowCtr);
+	if (batchCtr || batchDropCtr)
+		Serial.printf("Train sensor web: %i batches, %i dropped, every %i. sample\n", batchCtr, batchDropCtr, streamDecimation);
+	if (fitCtr || fitFallbackCtr)
+		Serial.printf("Speed steps: %i fitted, %i from start and end position\n", fitCtr, fitFallbackCtr);
+}
+
 void IoTT_TrainSensor::processLoop()
 {
+	processSamples(); //before the speed test, so the fit has all samples up to now
 	if (refreshRate > 0)
 	{
 		if ((millis() - refreshRate) > lastWebRefresh)
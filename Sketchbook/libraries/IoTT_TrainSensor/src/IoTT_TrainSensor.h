@@ -31,6 +31,7 @@ Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
 #include <AsyncTCP.h>
 #include <ESPAsyncWebServer.h>
 #include <IoTT_CommDef.h>
+#include <IoTT_CommQueue.h>
 #include <ArduinoJson.h>
 #include <IoTT_DigitraxBuffers.h>
 #include <Wire.h>
@@ -38,7 +39,7 @@ Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
 #include <Adafruit_BNO055.h>
 #include <TMAG5273.h>
 #include <utility/imumaths.h>
-//#include <OneDimKalman.h>
+#include <OneDimKalman.h>
 
 
 // This class is compatible with the corresponding AVR one,
@@ -64,6 +65,15 @@ Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
 #define magOverflow 360.0
 #define speedChangeTimeout 500 //ms
 
+#define sampleRingSize 128 //raw samples from sensorTask to processLoop, 640ms at measuringInterval
+#define sampleBatchSize 32 //samples per binary frame to the web page
+#define sampleBatchTimeout 100 //ms, send a partial batch after this time
+#define sampleBatchFormat 1
+#define sampleBatchHeaderLen 12 //format, decimation, sample count (2), millis() and micros() when sent
+#define sampleDecimation 4 //default: every 4th sample to the web page, 50 per second
+#define minFitSamples 10 //less samples and the speed is calculated from start and end position
+#define sensorEmaAlpha 328 //0.005 in Q16, weight of a new sample in avgMove and currSpeedTech
+
 typedef struct 
 {
 	float_t x;
@@ -92,6 +102,25 @@ typedef struct
 	float_t avgDir = 0;
 }sensorData;
 
+typedef struct //raw sample of every sensorTask cycle, also the record format of the binary web frame
+{
+	uint32_t timeStamp; //micros()
+	float_t relIntegrator; //[mm]
+	float_t currSpeedTech; //[mm/s]
+	float_t axisAngle; //[deg] magnet angle as read
+}sensorSample;
+
+typedef struct //least squares line through position over time of a speed step
+{
+	uint32_t startTime; //micros() of the first sample
+	float_t startPos; //[mm]
+	uint16_t numSamples;
+	double sumT;
+	double sumX;
+	double sumTT;
+	double sumTX;
+}speedFitData;
+
 typedef struct
 {
 	uint8_t testPhase = 0; //0: not started 1: increasing speeds 2: decreasing speeds 3: end test
@@ -141,6 +170,7 @@ public:
 	~IoTT_TrainSensor();
 	void begin();
 	void processLoop();
+	void printStats();
 	sensorData getSensorData();
 	void resetDistance();
 	void resetHeading();
@@ -153,12 +183,16 @@ public:
 	void stopTest();
 	void sendSpeedCommand(uint8_t newSpeed);
 	void toggleDirCommand();
-	void programmerReturn(uint8_t * programmerSlot);
+	void programmerReturn(uint8_t * programmerSlot, uint16_t jobsPending = 0); //jobsPending: programming jobs still in the queue
    
 private:
 	void sendSpeedTableDataToWeb();
 //	void sendPosDataToWeb();
 	void sendSensorDataToWeb();
+	void processSamples();
+	void sendSampleBatch();
+	void clrSpeedFit(uint32_t startTime, float_t startPos);
+	bool getFitSpeed(float_t * fitSpeed);
 	void clrSpeedTable();
 	bool processTestStep(sensorData * sensStatus);
 	bool processSpeedTest(); //returns false if complete
@@ -191,6 +225,8 @@ private:
 	sensorData dispData;
 //	OneDimKalman * speedEstimate = NULL;
 	OneDimKalman * relMoveEstimate = NULL;
+	int32_t avgMoveFilter = 0; //Q16.16 state of workData.avgMove
+	int32_t speedFilter = 0; //Q16.16 state of workData.currSpeedTech
 //	AsyncWebSocketClient * globalClient = NULL;
 	uint16_t refreshRate = 0;
 	uint32_t lastWebRefresh = millis();
@@ -198,6 +234,19 @@ private:
 	bool reloadOffset = false; //flag the task to reset the IMU offsets
 	uint8_t mountStyle = 0; //flat mount
 	speedTable speedSample;
+	IoTT_CommQueue<sensorSample, sampleRingSize> sampleRing; //sensorTask to processLoop
+	uint8_t streamDecimation = sampleDecimation;
+	uint8_t decimationCtr = 0;
+	uint8_t sampleBatch[sampleBatchHeaderLen + (sampleBatchSize * sizeof(sensorSample))];
+	uint8_t batchCount = 0;
+	uint32_t batchStartTime = millis();
+	speedFitData speedFit;
+	//statistics
+	uint32_t sampleCtr = 0;
+	uint32_t batchCtr = 0;
+	uint32_t batchDropCtr = 0; //web socket queue full
+	uint32_t fitCtr = 0;
+	uint32_t fitFallbackCtr = 0; //not enough samples for a fit
 	
    // Member functions
 };
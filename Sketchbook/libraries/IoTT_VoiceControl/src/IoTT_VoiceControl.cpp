@@ -57,6 +57,14 @@ static bool debug_nn = false; // Set this to true to see e.g. features generated
 static int print_results = -(EI_CLASSIFIER_SLICES_PER_MODEL_WINDOW);
 
 TaskHandle_t taskRecognize = NULL;
+TaskHandle_t taskInference = NULL;
+static IoTT_CommQueue<vcResult, vcResultQueueSize> resultQueue; //inference task to processKeywordRecognition
+//statistics, written by the record and inference tasks
+static uint32_t sliceCtr = 0;
+static uint32_t overrunCtr = 0;
+static uint32_t inferenceCtr = 0;
+static uint32_t inferenceTime = 0;
+static uint32_t maxInferenceTime = 0;
 
 void i2sInit()
 {
@@ -96,9 +104,16 @@ void mic_record_task (void* arg)
             if (inference.buf_count >= inference.n_samples) 
             {
 //                Serial.printf("send it %i %i\n", inference.buf_count,inference.n_samples);
-                inference.buf_select ^= 1;
+                sliceCtr++;
                 inference.buf_count = 0;
-                inference.buf_ready = 1;
+                if (inference.buf_ready) //inference still works on the other buffer, drop this slice
+                    overrunCtr++;
+                else
+                {
+                    inference.buf_select ^= 1;
+                    inference.buf_ready = 1;
+                    xTaskNotifyGive(taskInference);
+                }
             }
         }
     }
@@ -114,6 +129,47 @@ static int microphone_audio_signal_get_data(size_t offset, size_t length, float
     return 0;
 }
 
+//classifies the slice that is not being recorded and queues the results for processKeywordRecognition
+void inference_task(void* arg)
+{
+	while (1)
+	{
+		ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+		if (inference.buf_ready == 0)
+			continue;
+		uint32_t startTime = micros();
+		signal_t signal;
+		signal.total_length = EI_CLASSIFIER_SLICE_SIZE;
+		signal.get_data = &microphone_audio_signal_get_data;
+		ei_impulse_result_t result = {0};
+
+		EI_IMPULSE_ERROR r = run_classifier_continuous(&signal, &result, debug_nn);
+		inference.buf_ready = 0; //buffer can be used by the record task again
+		uint32_t runTime = micros() - startTime;
+		inferenceTime += runTime;
+		inferenceCtr++;
+		if (runTime > maxInferenceTime)
+			maxInferenceTime = runTime;
+		if (r != EI_IMPULSE_OK) 
+		{
+			Serial.printf("ERR: Failed to run classifier (%d)\n", r);
+			continue;
+		}
+		if (++print_results >= (EI_CLASSIFIER_SLICES_PER_MODEL_WINDOW)) 
+		{	
+			for (size_t ix = 2; ix < EI_CLASSIFIER_LABEL_COUNT; ix++) 
+				if (result.classification[ix].value > 0.5) //only stop and go
+				{
+					vcResult thisResult = {(uint8_t)ix, result.classification[ix].label, result.classification[ix].value};
+					resultQueue.push(thisResult);
+				}
+			if (result.anomaly > 0.5)
+				Serial.printf("    anomaly score: %.3f\n", result.anomaly);
+			print_results = 0;
+		}
+	}
+}
+
 IoTT_VoiceControl::IoTT_VoiceControl()
 {
 }
@@ -122,6 +178,8 @@ IoTT_VoiceControl::~IoTT_VoiceControl()
 {
 	vTaskDelete(taskRecognize);
 	taskRecognize = NULL;
+	vTaskDelete(taskInference);
+	taskInference = NULL;
 	
     free(inference.buffers[0]);
     free(inference.buffers[1]);
@@ -167,69 +225,53 @@ void IoTT_VoiceControl::beginKeywordRecognition()
     i2sInit();
     run_classifier_init();
 
-    xTaskCreate(mic_record_task, "mic_record_task", 2048, NULL, 1, &taskRecognize);
+    xTaskCreatePinnedToCore(inference_task, "inference_task", vcInferenceStack, NULL, vcInferencePriority, &taskInference, vcInferenceCore);
+    xTaskCreate(mic_record_task, "mic_record_task", 2048, NULL, vcRecordPriority, &taskRecognize);
     record_ready = true;
 }
 
-void IoTT_VoiceControl::processKeywordRecognition()
+void IoTT_VoiceControl::processKeywordRecognition() //results of the inference task
 {
-	if (inference.buf_ready == 1)
-//    if (microphone_inference_record())
-    {
-//		uint32_t startTime = micros();
-		inference.buf_ready = 0;
-		signal_t signal;
-		signal.total_length = EI_CLASSIFIER_SLICE_SIZE;
-		signal.get_data = &microphone_audio_signal_get_data;
-		ei_impulse_result_t result = {0};
-
-		EI_IMPULSE_ERROR r = run_classifier_continuous(&signal, &result, debug_nn);
-		if (r != EI_IMPULSE_OK) 
-		{
-			Serial.printf("ERR: Failed to run classifier (%d)\n", r);
-			return;
-		}
-//		Serial.printf("Inference: %i\n", micros() - startTime);
-		if (++print_results >= (EI_CLASSIFIER_SLICES_PER_MODEL_WINDOW)) 
-		{	
-			for (size_t ix = 2; ix < EI_CLASSIFIER_LABEL_COUNT; ix++) 
+	uint32_t startTime = micros();
+	vcResult thisResult;
+	while (resultQueue.pop(thisResult))
+	{
+		Serial.printf("  %i  %s: %.5f\n", thisResult.labelNr, thisResult.label, thisResult.value);
+		lnTransmitMsg recData;
+		if (vcCallback) 
+			switch (thisResult.labelNr)
 			{
-				if (result.classification[ix].value > 0.5) //only stop and go
-				{
-					Serial.printf("  %i  %s: %.5f\n", ix, result.classification[ix].label, result.classification[ix].value);
-					lnTransmitMsg recData;
-					if (vcCallback) 
-						switch (ix)
-						{
-							case 2:	//GO
-								Serial.println("Heard GO");
-								if (sendGoCmd)
-								{
-									recData.lnData[0] = 0x83;
-									recData.lnData[1] = ~recData.lnData[0];
-									recData.lnMsgSize = 2;
-									vcCallback(recData);
-								}
-								break;
-							case 3:	//STOP
-								Serial.println("Heard STOP");
-								if (sendStopCmd)
-								{
-									recData.lnData[0] = 0x85;
-									recData.lnData[1] = ~recData.lnData[0];
-									recData.lnMsgSize = 2;
-									vcCallback(recData);
-								}
-								break;
-						}
-				}
+				case 2:	//GO
+					Serial.println("Heard GO");
+					if (sendGoCmd)
+					{
+						recData.lnData[0] = 0x83;
+						recData.lnData[1] = ~recData.lnData[0];
+						recData.lnMsgSize = 2;
+						vcCallback(recData);
+					}
+					break;
+				case 3:	//STOP
+					Serial.println("Heard STOP");
+					if (sendStopCmd)
+					{
+						recData.lnData[0] = 0x85;
+						recData.lnData[1] = ~recData.lnData[0];
+						recData.lnMsgSize = 2;
+						vcCallback(recData);
+					}
+					break;
 			}
-			if (result.anomaly > 0.5)
-				Serial.printf("    anomaly score: %.3f\n", result.anomaly);
-			print_results = 0;
-		}
+	}
+	uint32_t procTime = micros() - startTime;
+	if (procTime > maxLoopTime)
+		maxLoopTime = procTime;
+}
 
-    }
+void IoTT_VoiceControl::printStats()
+{
+	Serial.printf("Voice slices: %i overruns: %i inference avg: %i us max: %i us, loop max: %i us, results lost: %i\n", sliceCtr, overrunCtr, inferenceCtr ? inferenceTime / inferenceCtr : 0, maxInferenceTime, maxLoopTime, resultQueue.overflowCtr);
+	maxLoopTime = 0;
 }
 
 void IoTT_VoiceControl::loadKeywordCfgJSON(DynamicJsonDocument doc)
@@ -27,17 +27,30 @@ Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
 #include <Math.h>
 #include <inttypes.h>
 #include <IoTT_CommDef.h>
+#include <IoTT_CommQueue.h>
 #include <ArduinoJSON.h>
 
+#define vcResultQueueSize 8
+#define vcInferenceCore 0 //same core as the I/O task, which has the higher priority
+#define vcInferencePriority 1
+#define vcInferenceStack 8192
+#define vcRecordPriority 2 //above inference, the I2S DMA only buffers 16 ms
+
 /** Audio buffers, pointers and selectors */
 typedef struct {
     signed short *buffers[2];
     unsigned char buf_select;
-    unsigned char buf_ready;
+    volatile unsigned char buf_ready; //set by the record task, cleared by the inference task when done with the buffer
     unsigned int buf_count;
     unsigned int n_samples;
 } inference_t;
 
+typedef struct {
+    uint8_t labelNr;
+    const char * label;
+    float value;
+} vcResult;
+
 class IoTT_VoiceControl
 {
 public:
@@ -47,10 +60,12 @@ public:
 	void beginKeywordRecognition();
 	void processKeywordRecognition();
 	void loadKeywordCfgJSON(DynamicJsonDocument doc);
+	void printStats(); //inference time, slice overruns and time spent in processKeywordRecognition
 private:
    // Member functions
 	bool sendStopCmd = true;
 	bool sendGoCmd = false;
+	uint32_t maxLoopTime = 0;
 };
 
 //this is the callback function. Provide a function of this name and parameter in your application and it will be called when a new message is received
@@ -117,6 +117,7 @@ void IoTT_LBServer::initLBServer(bool serverMode)
 	{
 		lntcpServer = new AsyncServer(WiFi.localIP(), lbs_Port);
 		lntcpServer->onClient(&handleTopNewClient, this);
+		clientsLock = xSemaphoreCreateMutex();
 	}
 	else //client mode
 	{
@@ -132,10 +133,14 @@ void IoTT_LBServer::initWIServer(bool serverMode)
 //	Serial.println("WI");
 	isServer = serverMode;
 	isWiThrottle = true;
-	if (isServer) //add code here to support server mode
+	if (isServer) //WiThrottle server for Engine Driver and other WiThrottle apps
 	{
+		if (lbs_Port == 1234) //not configured, use the standard WiThrottle port
+			lbs_Port = 12090;
+		wiClients = new wiClientDef[wiMaxClients];
+		wiKnownSwi = (uint8_t*) calloc(wiNumSwi >> 3, 1);
 		lntcpServer = new AsyncServer(WiFi.localIP(), lbs_Port);
-		lntcpServer->onClient(&handleTopNewClient, lntcpServer);
+		lntcpServer->onClient(&handleTopNewClient, this);
 	}
 	else //client mode
 	{
@@ -157,9 +162,31 @@ void IoTT_LBServer::handleNewClient(AsyncClient* client)
 {
 	Serial.printf("A new client has been connected to server, ip: %s with timeout %i %i\n", client->remoteIP().toString().c_str(), client->getAckTimeout(), client->getRxTimeout());
 	
+	if (wiClients) //WiThrottle server mode
+	{
+		wiClientDef * newClient = getWIClient(NULL);
+		if (!newClient)
+		{
+			Serial.println("Too many WiThrottle clients");
+			client->close(true);
+			return;
+		}
+		*newClient = wiClientDef();
+		newClient->sessionNr = ++wiSessionCtr;
+		newClient->evtReadPtr = wiEvtWritePtr;
+		newClient->lastRx = millis();
+		newClient->thisClient = client; //entry is used from here on
+		client->onData(&handleTopDataFromServer, this);
+		client->onError(&handleTopError, this);
+		client->onDisconnect(&handleTopDisconnect, this);
+		client->onTimeout(&handleTopTimeOut, this);
+		return;
+	}
+
 	tcpDef newClientData;
 	// add to list
 	newClientData.thisClient = client;
+	xSemaphoreTake(clientsLock, portMAX_DELAY);
 	clients.push_back(newClientData);
 	Serial.printf("New total is %i client(s)\n", clients.size());
   
@@ -167,6 +194,7 @@ void IoTT_LBServer::handleNewClient(AsyncClient* client)
 	{
 		Serial.println(clients[i].thisClient->remoteIP());
 	}
+	xSemaphoreGive(clientsLock);
 	// register events
 	client->onData(&handleTopDataFromServer, this);
 	client->onError(&handleTopError, this);
@@ -182,6 +210,13 @@ void IoTT_LBServer::handleError(AsyncClient* client, int8_t error)
 
 void IoTT_LBServer::handleDisconnect(AsyncClient* client) 
 {
+	wiClientDef * thisClient = getWIClient(client);
+	if (thisClient) //WiThrottle server mode, processLoop may be using the entry, so it is released there
+	{
+		thisClient->disconnected = true;
+		return;
+	}
+	xSemaphoreTake(clientsLock, portMAX_DELAY);
 	for (int i = 0; i < clients.size(); i++)
 	{
 		if (clients[i].thisClient == client)
@@ -195,6 +230,7 @@ void IoTT_LBServer::handleDisconnect(AsyncClient* client)
 		}
 	}
 	Serial.printf("Client disconnected. %i clients remaining \n", clients.size());
+	xSemaphoreGive(clientsLock);
 	yield();
 }
 
@@ -208,6 +244,11 @@ void IoTT_LBServer::setLNCallback(cbFct newCB)
 	lbsCallback = newCB;
 }
 
+void IoTT_LBServer::setTxCallback(txFct newCB)
+{
+	wiTxCallback = newCB;
+}
+
 void IoTT_LBServer::loadLBServerCfgJSON(DynamicJsonDocument doc)
 {
 	if (doc.containsKey("PortNr"))
@@ -221,6 +262,14 @@ void IoTT_LBServer::loadLBServerCfgJSON(DynamicJsonDocument doc)
 
 uint8_t IoTT_LBServer::getConnectionStatus()
 {
+	if (wiClients)
+	{
+		uint8_t numClients = 0;
+		for (uint8_t i = 0; i < wiMaxClients; i++)
+			if (wiClients[i].thisClient)
+				numClients++;
+		return numClients;
+	}
 	if (isServer)
 		return clients.size();
 	else
@@ -283,8 +332,16 @@ uint16_t IoTT_LBServer::lnWriteMsg(lnReceiveBuffer txData)
 
 void IoTT_LBServer::handleDataFromServer(AsyncClient* client, void *data, size_t len) 
 {
+	wiClientDef * wiClient = getWIClient(client);
+	if (wiClient) //WiThrottle server mode, commands may be split over several packets
+	{
+		if (!wiClient->disconnected)
+			handleWIServerData(wiClient, (char*) data, len);
+		return;
+	}
 	//identify client
-	tcpDef * currClient = NULL;
+	bool isClient = false;
+	xSemaphoreTake(clientsLock, portMAX_DELAY);
 	for (int i = 0; i < clients.size(); i++)
 	{
 		if (clients[i].thisClient == client)
@@ -293,16 +350,17 @@ void IoTT_LBServer::handleDataFromServer(AsyncClient* client, void *data, size_t
 //			Serial.println(clients[i].thisClient->remoteIP());
 //			Serial.write((uint8_t *)data, len);
 //			Serial.println();
-			currClient = &clients[i];
+			isClient = true;
 			break;
 		}
 	}
-	if (currClient)
+	xSemaphoreGive(clientsLock); //not kept while the message is processed, the callback may send to the clients
+	if (isClient)
 	{
 		if ((((char*)data)[len-1] == '\n') || (((char*)data)[len-1] == '\r'))
 		{
 			//if command is complete, call handle data
-			handleData(currClient->thisClient, (char*) data, len);
+			handleData(client, (char*) data, len);
 		}
 	}
 }
@@ -403,55 +461,7 @@ bool IoTT_LBServer::processWIMessage(AsyncClient* client, char * c)
 	uint16_t len = strlen(c);
 	if (len == 0) return false;
 
-	if (isServer) //Server Mode, handle incoming commands from client
-		return processWIServerMessage(client, c);
-	else //client mode, handle incoming commands from server
-		return processWIClientMessage(client, c);
-}
-
-//this is called when data is received in server mode
-bool IoTT_LBServer::processWIServerMessage(AsyncClient* client, char * c)
-{
-	uint16_t len = strlen(c);
-	tcpDef * currClient = NULL;
-	for (int i = 0; i < clients.size(); i++)
-	{
-		if (clients[i].thisClient == client)
-		{
-			currClient = &clients[i];
-			break;
-		}
-	}
-	if (currClient)
-	{
-		if (len > 1 && c[0]=='*') //heartbeat interval
-		{
-			if (c[1] == '+')
-				currClient->nextPing = 0; //do not request pings
-			else
-				currClient->nextPing = millis() + pingInterval;
-			return true;
-		}
-		if (len > 2 && c[0]=='H' && c[1]=='U') 
-		{
-			c[len-1] = '\0';
-			currClient->wiHWIdentifier = (char*) realloc(currClient->wiHWIdentifier, len - 2);
-			strcpy(&currClient->wiHWIdentifier[0], &c[2]);
-			Serial.println("Hardware Identifier");
-			return true;
-		}
-		else if (len > 1 && c[0]=='N') 
-		{
-			c[len-1] = '\0';
-			currClient->wiDeviceName = (char*) realloc(currClient->wiDeviceName, len - 2);
-			strcpy(&currClient->wiDeviceName[0], &c[2]);
-			Serial.println("Device Name");
-			//send wiReply *HeartBeatInterval
-			return true;
-		}
-	}
-	else
-		return false;
+	return processWIClientMessage(client, c); //client mode, handle incoming commands from server. Server mode is handled in handleWIServerData
 }
 
 //this is called when data is received in client mode
@@ -601,14 +611,14 @@ bool IoTT_LBServer::processWIClientMessage(AsyncClient* client, char * c)
 			{
 				currentWIDCC = dccAddr;
 				if (thisSlot)
-					(*thisSlot)[0] = 0x33; //set slot status to in use, refreshed
+					digitraxBuffer->writeDomain(dbDomSlots, [&]() { (*thisSlot)[0] = 0x33; }); //set slot status to in use, refreshed
 //			Serial.printf("Process Add %i \n", dccAddr);
 			}
 			else
 			{
 				currentWIDCC = -1;
 				if (thisSlot)
-					(*thisSlot)[0] = 0x03; //set slot status to not in use, not refreshed
+					digitraxBuffer->writeDomain(dbDomSlots, [&]() { (*thisSlot)[0] = 0x03; }); //set slot status to not in use, not refreshed
 //			Serial.printf("Process Remove %i \n", dccAddr);
 			}
 			if (thisSlot)
@@ -650,10 +660,10 @@ bool IoTT_LBServer::processWIClientMessage(AsyncClient* client, char * c)
 				switch (cmdCode)
 				{
 					case 'V':
-						(*thisSlot)[2] = cmdVal;
+						digitraxBuffer->writeDomain(dbDomSlots, [&]() { (*thisSlot)[2] = cmdVal; });
 						break;
 					case 'R':
-						(*thisSlot)[3] = cmdVal == 0 ? ((*thisSlot)[3] & 0xDF) : ((*thisSlot)[3] | 0x20);
+						digitraxBuffer->writeDomain(dbDomSlots, [&]() { (*thisSlot)[3] = cmdVal == 0 ? ((*thisSlot)[3] & 0xDF) : ((*thisSlot)[3] | 0x20); });
 						break;
 					default: return true;
 				}
@@ -894,49 +904,7 @@ void IoTT_LBServer::processLoop()
 void IoTT_LBServer::processLoopWI() //process function for WiThrottle
 {
 	if (isServer)
-	{
-		if (clients.size() > 0)
-		{
-			if (que_wrPos != que_rdPos)
-			{
-//				Serial.println("Withrottle Server send data to one or more client(s)");
-				int hlpQuePtr = (que_rdPos + 1) % queBufferSize;
-
-/*
-				if (thisClient->canSend())
-				{
-					if (clientTxConfirmation)
-					{
-						if (sendLNClientMessage(clients[clientTxIndex].thisClient, "SENT OK", transmitQueue[hlpQuePtr]))
-						{
-							clientTxConfirmation = false;
-							clientTxIndex++;
-						}
-					}
-					else
-						if (sendLNClientMessage(clients[clientTxIndex].thisClient, "RECEIVE", transmitQueue[hlpQuePtr]))
-						{
-							if ((lastTxClient == clients[clientTxIndex].thisClient) && ((lastTxData.reqID & 0x3FFF) == (transmitQueue[hlpQuePtr].reqID & 0x3FFF)) && ((transmitQueue[hlpQuePtr].errorFlags & msgEcho) > 0))
-								clientTxConfirmation = true;
-							else
-								clientTxIndex++;
-						}
-					if (clientTxIndex == clients.size()) //message sent to all clients
-					{
-						que_rdPos = hlpQuePtr; //if not successful, we keep trying
-						clientTxIndex = 0;
-						clientTxConfirmation = false;
-					}
-*/	
-				que_rdPos = hlpQuePtr; //if not successful, we keep trying
-/*
-				}
-*/
-			}
-		}
-		else
-			que_rdPos = que_wrPos; //no client, so reset out queue to prevent overflow
-	}
+		processLoopWIServer();
 	else
 	{
 		if (!lntcpClient.thisClient->connected())
@@ -990,6 +958,14 @@ void IoTT_LBServer::processLoopLN() //process function for LN over TCP
 {
 	if (isServer)
 	{
+		xSemaphoreTake(clientsLock, portMAX_DELAY);
+		if (clientTxIndex >= clients.size()) //clients disconnected while a message was sent, it went to all remaining ones
+		{
+			if (clientTxIndex > 0)
+				que_rdPos = (que_rdPos + 1) % queBufferSize;
+			clientTxIndex = 0;
+			clientTxConfirmation = false;
+		}
 		if (clients.size() > 0)
 		{
 			if (que_wrPos != que_rdPos)
@@ -1025,6 +1001,7 @@ void IoTT_LBServer::processLoopLN() //process function for LN over TCP
 		}
 		else
 			que_rdPos = que_wrPos; //no client, so reset out queue to prevent overflow
+		xSemaphoreGive(clientsLock);
 	}
 	else
 	{
@@ -1100,3 +1077,713 @@ void IoTT_LBServer::sendLNPing()
 	pingSent = true;
 }
 
+//WiThrottle server mode. The TCP task only collects the command lines of the clients in wiRxQueue, they are parsed in processLoop, so the
+//client table and the loco states are only changed there. Resulting LocoNet commands go through wiTxQueue, turnout commands through
+//sendSwitchCommand of the application. Speed commands are collected per slot in wiSpeedBuffer and only the latest value is sent every
+//wiUpdateInterval. LocoNet traffic from the application is
+//received through lnWriteMsg and creates power, turnout and roster events. processLoop sends these events and changes of the slots in use
+//to the clients, all with a limited number of entries per pass, so a new or slow client does not block the others.
+
+void prepWIMsg(lnTransmitMsg * txData, uint8_t opCode, uint8_t data1, uint8_t data2)
+{
+	txData->lnMsgSize = ((opCode & 0x60) >> 4) + 2; //2 or 4 bytes
+	txData->lnData[0] = opCode;
+	txData->lnData[1] = data1;
+	txData->lnData[2] = data2;
+	txData->reqID = 0;
+	setXORByte(&txData->lnData[0]);
+}
+
+void IoTT_LBServer::resetWIStats()
+{
+	wiCmdCtr = 0;
+	wiSpeedReqCtr = 0;
+	wiSpeedTxCtr = 0;
+	wiLineCtr = 0;
+	wiMaxLoopTime = 0;
+}
+
+wiClientDef * IoTT_LBServer::getWIClient(AsyncClient* client) //NULL returns a free entry
+{
+	if (wiClients)
+		for (uint8_t i = 0; i < wiMaxClients; i++)
+			if (wiClients[i].thisClient == client)
+				return &wiClients[i];
+	return NULL;
+}
+
+void IoTT_LBServer::handleWIServerData(wiClientDef * thisClient, char *data, size_t len)
+{
+	for (size_t i = 0; i < len; i++)
+		if ((data[i] == '\n') || (data[i] == '\r'))
+		{
+			if (thisClient->rxPtr > 0)
+			{
+				wiRxLineDef rxLine;
+				rxLine.clientNr = thisClient - wiClients;
+				rxLine.sessionNr = thisClient->sessionNr;
+				memcpy(&rxLine.rxLine[0], &thisClient->rxBuffer[0], thisClient->rxPtr);
+				rxLine.rxLine[thisClient->rxPtr] = '\0';
+				if (!wiRxQueue.push(rxLine))
+					Serial.println("WiThrottle Rx Queue overflow");
+				thisClient->rxPtr = 0;
+			}
+		}
+		else
+			if (thisClient->rxPtr < (wiRxBufferSize - 1)) //longer lines are cut
+				thisClient->rxBuffer[thisClient->rxPtr++] = data[i];
+}
+
+void IoTT_LBServer::queueWIMsg(uint8_t opCode, uint8_t data1, uint8_t data2)
+{
+	lnTransmitMsg txData;
+	prepWIMsg(&txData, opCode, data1, data2);
+	if (!wiTxQueue.push(txData))
+		Serial.println("WiThrottle Tx Queue overflow");
+}
+
+void IoTT_LBServer::queueWIFctPacket(wiLocoDef * thisLoco, uint8_t fctNr) //function group of fctNr in OPC_IMM_PACKET
+{
+	uint8_t dccPacket[5];
+	uint8_t pktLen = 0;
+	if (thisLoco->longAddr)
+	{
+		dccPacket[pktLen++] = 0xC0 | ((thisLoco->dccAddr >> 8) & 0x3F);
+		dccPacket[pktLen++] = thisLoco->dccAddr & 0xFF;
+	}
+	else
+		dccPacket[pktLen++] = thisLoco->dccAddr & 0x7F;
+	if (fctNr <= 12)
+		dccPacket[pktLen++] = 0xA0 | (thisLoco->hiFct & 0x0F); //F9..F12
+	else
+	{
+		dccPacket[pktLen++] = fctNr <= 20 ? 0xDE : 0xDF; //F13..F20, F21..F28
+		dccPacket[pktLen++] = (thisLoco->hiFct >> (fctNr <= 20 ? 4 : 12)) & 0xFF;
+	}
+	lnTransmitMsg txData;
+	txData.lnMsgSize = 11;
+	txData.lnData[0] = 0xED; //OPC_IMM_PACKET
+	txData.lnData[1] = 0x0B;
+	txData.lnData[2] = 0x7F;
+	txData.lnData[3] = (pktLen << 4) | 0x01; //IM bytes, repetitions
+	txData.lnData[4] = 0x20; //DHI, bit 7 of the IM bytes
+	for (uint8_t i = 0; i < 5; i++)
+	{
+		uint8_t imByte = i < pktLen ? dccPacket[i] : 0;
+		txData.lnData[5 + i] = imByte & 0x7F;
+		txData.lnData[4] |= (imByte & 0x80) >> (7 - i);
+	}
+	txData.reqID = 0;
+	setXORByte(&txData.lnData[0]);
+	if (!wiTxQueue.push(txData))
+		Serial.println("WiThrottle Tx Queue overflow");
+}
+
+void IoTT_LBServer::queueWIEvent(uint8_t evtType, uint16_t evtAddr, uint8_t evtValue)
+{
+	wiEventDef * thisEvent = &wiEvents[wiEvtWritePtr % wiEventQueueSize];
+	thisEvent->evtType = evtType;
+	thisEvent->evtAddr = evtAddr;
+	thisEvent->evtValue = evtValue;
+	wiEvtWritePtr++;
+}
+
+uint8_t IoTT_LBServer::getWIPowerState()
+{
+	switch (digitraxBuffer->getPowerStatus())
+	{
+		case 0x82: return 0; //OPC_OFF
+		case 0x83: return 1; //OPC_ON
+		default: return 2; //unknown
+	}
+}
+
+uint8_t IoTT_LBServer::getWISwiState(uint16_t swiNum)
+{
+	return digitraxBuffer->getSwiPosition(swiNum) > 0 ? 2 : 4; //closed : thrown
+}
+
+void IoTT_LBServer::releaseWILoco(wiClientDef * thisClient, wiLocoDef * thisLoco)
+{
+	if (thisLoco->slotNr >= maxSlots)
+		return;
+	for (uint8_t i = 0; i < wiMaxClients; i++) //slot stays in use if another throttle is still using it
+		if (wiClients[i].thisClient)
+			for (uint8_t j = 0; j < wiMaxLocos; j++)
+				if ((&wiClients[i].locos[j] != thisLoco) && (wiClients[i].locos[j].slotNr == thisLoco->slotNr) && (wiClients[i].locos[j].locoState == 2))
+					return;
+	slotData thisSlot;
+	digitraxBuffer->getSlotSnapshot(thisLoco->slotNr, &thisSlot);
+	queueWIMsg(0xB5, thisLoco->slotNr, (thisSlot[0] & 0x4F) | 0x10); //OPC_SLOT_STAT1, set to common
+}
+
+void IoTT_LBServer::processWIServerCmd(wiClientDef * thisClient, char * c)
+{
+	wiCmdCtr++;
+	thisClient->lastRx = millis();
+	switch (c[0])
+	{
+		case '*': //heartbeat, *+ starts and *- stops monitoring
+			if (c[1] == '+')
+				thisClient->heartbeat = true;
+			if (c[1] == '-')
+				thisClient->heartbeat = false;
+			break;
+		case 'N': //device name
+			Serial.printf("WiThrottle client %s\n", &c[1]);
+			break;
+		case 'M': //multi throttle command
+			processWILocoCmd(thisClient, c);
+			break;
+		case 'P':
+			if ((c[1] == 'P') && (c[2] == 'A')) //track power
+				queueWIMsg(c[3] == '1' ? 0x83 : 0x82, 0, 0);
+			if ((c[1] == 'T') && (c[2] == 'A')) //turnout command PTA<C|T|2><addr>, the address may have a system prefix like LT
+			{
+				char * addrPtr = &c[4];
+				while ((*addrPtr != '\0') && ((*addrPtr < '0') || (*addrPtr > '9')))
+					addrPtr++;
+				uint16_t swiAddr = atoi(addrPtr);
+				if ((swiAddr > 0) && (swiAddr <= wiNumSwi))
+				{
+					uint16_t swiNum = swiAddr - 1;
+					bool swiClosed = (c[3] == 'C') || ((c[3] == '2') && (getWISwiState(swiNum) == 4));
+					if (sendSwitchCommand) //coil on and off, paced like all other switch commands of the application
+					{
+						sendSwitchCommand(0xB0, swiNum, swiClosed ? 1 : 0, 1); //OPC_SW_REQ, target 1: closed 0: thrown
+						sendSwitchCommand(0xB0, swiNum, swiClosed ? 1 : 0, 0);
+					}
+					else
+					{
+						queueWIMsg(0xB0, swiNum & 0x7F, ((swiNum >> 7) & 0x0F) | (swiClosed ? 0x30 : 0x10)); //OPC_SW_REQ
+						queueWIMsg(0xB0, swiNum & 0x7F, ((swiNum >> 7) & 0x0F) | (swiClosed ? 0x20 : 0x00));
+					}
+				}
+			}
+			break;
+		case 'Q': //client quits
+			for (uint8_t i = 0; i < wiMaxLocos; i++)
+				if ((thisClient->locos[i].locoState == 1) || (thisClient->locos[i].locoState == 2))
+				{
+					releaseWILoco(thisClient, &thisClient->locos[i]);
+					thisClient->locos[i].locoState = 0;
+				}
+			break;
+		default: break; //HU and others are ignored
+	}
+}
+
+//M<throttleID><action><key><;><command>, key is S<addr>, L<addr> or * for all locos of the throttle
+void IoTT_LBServer::processWILocoCmd(wiClientDef * thisClient, char * c)
+{
+	char throttleID = c[1];
+	char locoAction = c[2];
+	char * keyStr = &c[3];
+	char * cmdStr = strstr(keyStr, "<;>");
+	if ((throttleID == '\0') || (cmdStr == NULL))
+		return;
+	*cmdStr = '\0';
+	cmdStr += 3;
+	bool allLocos = keyStr[0] == '*';
+	bool longAddr = keyStr[0] == 'L';
+	uint16_t dccAddr = allLocos ? 0 : atoi(&keyStr[1]);
+	switch (locoAction)
+	{
+		case '+':; //add loco
+		case 'S': //steal, handled like add
+		{
+			if ((keyStr[0] != 'L') && (keyStr[0] != 'S'))
+				return;
+			wiLocoDef * newLoco = NULL;
+			for (uint8_t i = 0; i < wiMaxLocos; i++)
+			{
+				wiLocoDef * thisLoco = &thisClient->locos[i];
+				if ((thisLoco->locoState == 2) && (thisLoco->throttleID == throttleID) && (thisLoco->dccAddr == dccAddr))
+				{
+					thisLoco->locoState = 1; //already there, send reply and state again
+					thisLoco->lastSpeed = 0xFF;
+					thisLoco->lastDirf = 0xFF;
+					thisLoco->lastSnd = 0xFF;
+					return;
+				}
+				if ((newLoco == NULL) && (thisLoco->locoState == 0))
+					newLoco = thisLoco;
+			}
+			if (newLoco == NULL)
+			{
+				Serial.println("Too many locos on WiThrottle client");
+				return;
+			}
+			*newLoco = wiLocoDef();
+			newLoco->throttleID = throttleID;
+			newLoco->dccAddr = dccAddr;
+			newLoco->longAddr = longAddr;
+			newLoco->locoState = 1;
+			queueWIMsg(0xBF, (dccAddr >> 7) & 0x7F, dccAddr & 0x7F); //OPC_LOCO_ADR, slot is assigned when SL_RD comes back
+		}
+		break;
+		case '-': //release or dispatch
+		case 'A': //action
+			for (uint8_t i = 0; i < wiMaxLocos; i++)
+			{
+				wiLocoDef * thisLoco = &thisClient->locos[i];
+				if (((thisLoco->locoState == 1) || (thisLoco->locoState == 2)) && (thisLoco->throttleID == throttleID) && (allLocos || ((thisLoco->dccAddr == dccAddr) && (thisLoco->longAddr == longAddr))))
+					if (locoAction == 'A')
+						processWILocoAction(thisClient, thisLoco, cmdStr);
+					else
+					{
+						releaseWILoco(thisClient, thisLoco);
+						thisLoco->locoState = 3;
+					}
+			}
+			break;
+	}
+}
+
+void IoTT_LBServer::processWILocoAction(wiClientDef * thisClient, wiLocoDef * thisLoco, char * c)
+{
+	uint8_t slotNr = thisLoco->slotNr;
+	if (slotNr >= maxSlots) //no slot assigned yet
+		return;
+	slotData thisSlot;
+	digitraxBuffer->getSlotSnapshot(slotNr, &thisSlot);
+	uint32_t slotMask = 1UL << (slotNr & 0x1F);
+	switch (c[0])
+	{
+		case 'V': //speed 0..126, coalesced
+		case 'I': //idle
+		{
+			int16_t newSpeed = c[0] == 'V' ? atoi(&c[1]) : 0;
+			uint8_t lnSpeed = newSpeed < 0 ? 1 : newSpeed == 0 ? 0 : min(newSpeed + 1, 127);
+			wiSpeedReqCtr++;
+			wiSpeedBuffer[slotNr] = lnSpeed;
+			__atomic_or_fetch(&wiSpeedPending[slotNr >> 5], slotMask, __ATOMIC_RELEASE);
+			thisLoco->lastSpeed = lnSpeed; //no echo to this client
+		}
+		break;
+		case 'X': //emergency stop, sent right away
+			__atomic_and_fetch(&wiSpeedPending[slotNr >> 5], ~slotMask, __ATOMIC_ACQ_REL);
+			queueWIMsg(0xA0, slotNr, 1);
+			thisLoco->lastSpeed = 1;
+			break;
+		case 'R': //direction 1: forward 0: reverse
+		{
+			if (__atomic_fetch_and(&wiSpeedPending[slotNr >> 5], ~slotMask, __ATOMIC_ACQ_REL) & slotMask) //pending speed goes out before the direction change
+				queueWIMsg(0xA0, slotNr, wiSpeedBuffer[slotNr]);
+			uint8_t newDirf = c[1] == '0' ? (thisSlot[3] | 0x20) : (thisSlot[3] & 0x5F);
+			queueWIMsg(0xA1, slotNr, newDirf);
+			thisLoco->lastDirf = newDirf;
+		}
+		break;
+		case 'F': //F1<n> button pressed, F0<n> released. Functions are latching, so they toggle when pressed
+		case 'f': //f<0|1><n> sets the function
+		{
+			if ((c[0] == 'F') && (c[1] != '1'))
+				return;
+			uint8_t fctNr = atoi(&c[2]);
+			if (fctNr <= 4) //F0..F4 in DIRF
+			{
+				uint8_t fctMask = fctNr == 0 ? 0x10 : (1 << (fctNr - 1));
+				bool fctOn = c[0] == 'F' ? ((thisSlot[3] & fctMask) == 0) : (c[1] == '1');
+				uint8_t newDirf = fctOn ? (thisSlot[3] | fctMask) : (thisSlot[3] & ~fctMask);
+				queueWIMsg(0xA1, slotNr, newDirf & 0x7F);
+				thisLoco->lastDirf = newDirf & 0x7F;
+			}
+			else if (fctNr <= 8) //F5..F8 in SND
+			{
+				uint8_t fctMask = 1 << (fctNr - 5);
+				bool fctOn = c[0] == 'F' ? ((thisSlot[7] & fctMask) == 0) : (c[1] == '1');
+				uint8_t newSnd = fctOn ? (thisSlot[7] | fctMask) : (thisSlot[7] & ~fctMask);
+				queueWIMsg(0xA2, slotNr, newSnd & 0x7F);
+				thisLoco->lastSnd = newSnd & 0x7F;
+			}
+			else if (fctNr <= 28) //F9..F28 as DCC packet
+			{
+				uint32_t fctMask = 1UL << (fctNr - 9);
+				bool fctOn = c[0] == 'F' ? ((thisLoco->hiFct & fctMask) == 0) : (c[1] == '1');
+				thisLoco->hiFct = fctOn ? (thisLoco->hiFct | fctMask) : (thisLoco->hiFct & ~fctMask);
+				queueWIFctPacket(thisLoco, fctNr);
+			}
+		}
+		break;
+		case 'q': //query, state is sent with the next update
+			if (c[1] == 'V')
+				thisLoco->lastSpeed = 0xFF;
+			if (c[1] == 'R')
+				thisLoco->lastDirf = 0xFF;
+			break;
+	}
+}
+
+void IoTT_LBServer::processWIBufferMsg(lnReceiveBuffer * thisMsg) //LocoNet traffic seen by the application
+{
+	switch (thisMsg->lnData[0])
+	{
+		case 0x82:; //OPC_OFF
+		case 0x83: //OPC_ON
+			queueWIEvent(0, 0, thisMsg->lnData[0] == 0x83 ? 1 : 0);
+			break;
+		case 0xB0:; //OPC_SW_REQ
+		case 0xB1:; //OPC_SW_REP
+		case 0xBD: //OPC_SW_ACK
+		{
+			uint16_t swiNum = (thisMsg->lnData[1] & 0x7F) + ((thisMsg->lnData[2] & 0x0F) << 7);
+			if (swiNum >= wiNumSwi)
+				break;
+			wiKnownSwi[swiNum >> 3] |= (1 << (swiNum & 0x07));
+			if (thisMsg->lnData[0] == 0xB1) //buffer is already updated by the application
+				queueWIEvent(1, swiNum, getWISwiState(swiNum));
+			else
+				queueWIEvent(1, swiNum, (thisMsg->lnData[2] & 0x20) ? 2 : 4);
+		}
+		break;
+		case 0xE7: //OPC_SL_RD, assign the slot to locos waiting for it
+			if ((thisMsg->lnData[1] == 0x0E) && (thisMsg->lnData[2] < maxSlots) && (thisMsg->lnData[2] > 0))
+			{
+				uint8_t slotNr = thisMsg->lnData[2];
+				uint16_t slotAddr = (thisMsg->lnData[4] & 0x7F) + ((thisMsg->lnData[9] & 0x7F) << 7);
+				bool slotUsed = false;
+				for (uint8_t i = 0; i < wiMaxClients; i++)
+					if (wiClients[i].thisClient)
+						for (uint8_t j = 0; j < wiMaxLocos; j++)
+						{
+							wiLocoDef * thisLoco = &wiClients[i].locos[j];
+							if ((thisLoco->locoState > 0) && (thisLoco->locoState < 3) && (thisLoco->slotNr == 0xFF) && (thisLoco->dccAddr == slotAddr))
+							{
+								thisLoco->slotNr = slotNr;
+								slotUsed = true;
+							}
+						}
+				if (slotUsed && ((thisMsg->lnData[3] & 0x30) != 0x30) && wiTxCallback) //NULL move sets the slot in use
+				{
+					lnTransmitMsg txData;
+					prepWIMsg(&txData, 0xBA, slotNr, slotNr);
+					wiTxCallback(txData);
+				}
+			}
+			break;
+	}
+}
+
+bool IoTT_LBServer::addWIText(wiClientDef * thisClient, const char * txtStr, bool endLine)
+{
+	uint16_t txtLen = strlen(txtStr);
+	if (thisClient->thisClient->space() < (txtLen + 2))
+		return false;
+	if (txtLen > 0)
+		thisClient->thisClient->add(txtStr, txtLen);
+	if (endLine)
+	{
+		thisClient->thisClient->add("\r\n", 2);
+		wiLineCtr++;
+	}
+	return true;
+}
+
+bool IoTT_LBServer::sendWIServerSync(wiClientDef * thisClient) //returns true if data was added
+{
+	bool hasData = false;
+	char outStr[100];
+	if (thisClient->syncState == 0) //version, power, turnout states and heartbeat interval
+	{
+		sprintf(outStr, "VN2.0\r\nPPA%i\r\nPTT]\\[Turnouts}|{Turnout]\\[Closed}|{2]\\[Thrown}|{4\r\n*%i", getWIPowerState(), wiHeartbeat);
+		if (!addWIText(thisClient, outStr))
+			return false;
+		thisClient->syncState = 1;
+		thisClient->syncPtr = 0;
+		hasData = true;
+	}
+	if ((thisClient->syncState == 1) || (thisClient->syncState == 4)) //roster list of the slots in use, syncPtr is the slot number
+	{
+		if (thisClient->syncPtr == 0)
+		{
+			uint8_t numLocos = 0;
+			for (uint8_t i = 0; i < 4; i++)
+				numLocos += __builtin_popcount(wiRosterMask[i]);
+			sprintf(outStr, "RL%i", numLocos);
+			if (!addWIText(thisClient, outStr, false))
+				return hasData;
+			thisClient->syncPtr = 1;
+			hasData = true;
+		}
+		uint8_t batchCtr = 0;
+		while ((thisClient->syncPtr < maxSlots) && (batchCtr < wiSyncBatch))
+		{
+			uint8_t slotNr = thisClient->syncPtr;
+			if (wiRosterMask[slotNr >> 5] & (1UL << (slotNr & 0x1F)))
+			{
+				slotData thisSlot;
+				digitraxBuffer->getSlotSnapshot(slotNr, &thisSlot);
+				uint16_t locoAddr = ((thisSlot[6] & 0x7F) << 7) + (thisSlot[1] & 0x7F);
+				sprintf(outStr, "]\\[%i}|{%i}|{%c", locoAddr, locoAddr, locoAddr > 127 ? 'L' : 'S');
+				if (!addWIText(thisClient, outStr, false))
+					return hasData;
+				batchCtr++;
+			}
+			thisClient->syncPtr++;
+		}
+		if (thisClient->syncPtr < maxSlots) //continue next time
+			return true;
+		if (!addWIText(thisClient, ""))
+			return true;
+		thisClient->syncState = thisClient->syncState == 1 ? 2 : 3;
+		thisClient->syncPtr = 0;
+		hasData = true;
+	}
+	if (thisClient->syncState == 2) //turnout list of the turnouts seen so far, syncPtr is turnout number + 1
+	{
+		if (thisClient->syncPtr == 0)
+		{
+			if (!addWIText(thisClient, "PTL", false))
+				return hasData;
+			thisClient->syncPtr = 1;
+			hasData = true;
+		}
+		uint8_t batchCtr = 0;
+		while ((thisClient->syncPtr <= wiNumSwi) && (batchCtr < wiSyncBatch))
+		{
+			uint16_t swiNum = thisClient->syncPtr - 1;
+			if (((swiNum & 0x07) == 0) && (wiKnownSwi[swiNum >> 3] == 0)) //skip empty bytes
+			{
+				thisClient->syncPtr += 8;
+				continue;
+			}
+			if (wiKnownSwi[swiNum >> 3] & (1 << (swiNum & 0x07)))
+			{
+				sprintf(outStr, "]\\[LT%i}|{%i}|{%i", swiNum + 1, swiNum + 1, getWISwiState(swiNum));
+				if (!addWIText(thisClient, outStr, false))
+					return hasData;
+				batchCtr++;
+			}
+			thisClient->syncPtr++;
+		}
+		if (thisClient->syncPtr <= wiNumSwi) //continue next time
+			return true;
+		if (!addWIText(thisClient, ""))
+			return true;
+		thisClient->syncState = 3;
+		thisClient->syncPtr = 0;
+		hasData = true;
+	}
+	return hasData;
+}
+
+bool IoTT_LBServer::sendWIServerEvents(wiClientDef * thisClient) //returns true if data was added
+{
+	bool hasData = false;
+	char outStr[24];
+	if ((uint16_t)(wiEvtWritePtr - thisClient->evtReadPtr) > wiEventQueueSize) //client could not keep up, send everything again
+	{
+		thisClient->evtReadPtr = wiEvtWritePtr;
+		thisClient->syncState = 0;
+		return false;
+	}
+	while ((thisClient->evtReadPtr != wiEvtWritePtr) && (thisClient->syncState == 3))
+	{
+		wiEventDef * thisEvent = &wiEvents[thisClient->evtReadPtr % wiEventQueueSize];
+		switch (thisEvent->evtType)
+		{
+			case 0: //power
+				sprintf(outStr, "PPA%i", thisEvent->evtValue);
+				if (!addWIText(thisClient, outStr))
+					return hasData;
+				break;
+			case 1: //turnout
+				sprintf(outStr, "PTA%iLT%i", thisEvent->evtValue, thisEvent->evtAddr + 1);
+				if (!addWIText(thisClient, outStr))
+					return hasData;
+				break;
+			case 2: //roster changed, new list is sent before the next events
+				thisClient->syncState = 4;
+				thisClient->syncPtr = 0;
+				break;
+		}
+		thisClient->evtReadPtr++;
+		hasData = true;
+	}
+	return hasData;
+}
+
+bool IoTT_LBServer::sendWILocoState(wiClientDef * thisClient) //returns true if data was added
+{
+	bool hasData = false;
+	char outStr[48];
+	char locoKey[8];
+	for (uint8_t i = 0; i < wiMaxLocos; i++)
+	{
+		wiLocoDef * thisLoco = &thisClient->locos[i];
+		if (thisLoco->locoState == 0)
+			continue;
+		if (thisClient->thisClient->space() < 400) //room for a reply and all changes of one loco
+			return hasData;
+		sprintf(locoKey, "%c%i", thisLoco->longAddr ? 'L' : 'S', thisLoco->dccAddr);
+		switch (thisLoco->locoState)
+		{
+			case 1: //add reply
+				sprintf(outStr, "M%c+%s<;>", thisLoco->throttleID, locoKey);
+				addWIText(thisClient, outStr);
+				thisLoco->locoState = 2;
+				hasData = true;
+				break;
+			case 3: //remove reply
+				sprintf(outStr, "M%c-%s<;>", thisLoco->throttleID, locoKey);
+				addWIText(thisClient, outStr);
+				thisLoco->locoState = 0;
+				hasData = true;
+				continue;
+		}
+		if (thisLoco->slotNr >= maxSlots)
+			continue;
+		slotData thisSlot;
+		digitraxBuffer->getSlotSnapshot(thisLoco->slotNr, &thisSlot);
+		uint8_t slotSpeed = thisSlot[2];
+		uint8_t slotDirf = thisSlot[3];
+		uint8_t slotSnd = thisSlot[7];
+		bool speedPending = (wiSpeedPending[thisLoco->slotNr >> 5] & (1UL << (thisLoco->slotNr & 0x1F))) > 0;
+		if ((slotSpeed != thisLoco->lastSpeed) && !speedPending)
+		{
+			sprintf(outStr, "M%cA%s<;>V%i", thisLoco->throttleID, locoKey, slotSpeed > 1 ? slotSpeed - 1 : 0);
+			addWIText(thisClient, outStr);
+			thisLoco->lastSpeed = slotSpeed;
+			hasData = true;
+		}
+		if (slotDirf != thisLoco->lastDirf)
+		{
+			uint8_t chgBits = thisLoco->lastDirf == 0xFF ? 0x3F : (slotDirf ^ thisLoco->lastDirf);
+			if (chgBits & 0x20)
+			{
+				sprintf(outStr, "M%cA%s<;>R%i", thisLoco->throttleID, locoKey, (slotDirf & 0x20) ? 0 : 1);
+				addWIText(thisClient, outStr);
+			}
+			for (uint8_t j = 0; j < 5; j++)
+			{
+				uint8_t fctMask = j == 0 ? 0x10 : (1 << (j - 1));
+				if (chgBits & fctMask)
+				{
+					sprintf(outStr, "M%cA%s<;>F%i%i", thisLoco->throttleID, locoKey, (slotDirf & fctMask) ? 1 : 0, j);
+					addWIText(thisClient, outStr);
+				}
+			}
+			thisLoco->lastDirf = slotDirf;
+			hasData = true;
+		}
+		if (slotSnd != thisLoco->lastSnd)
+		{
+			uint8_t chgBits = thisLoco->lastSnd == 0xFF ? 0x0F : (slotSnd ^ thisLoco->lastSnd);
+			for (uint8_t j = 0; j < 4; j++)
+				if (chgBits & (1 << j))
+				{
+					sprintf(outStr, "M%cA%s<;>F%i%i", thisLoco->throttleID, locoKey, (slotSnd & (1 << j)) ? 1 : 0, j + 5);
+					addWIText(thisClient, outStr);
+				}
+			thisLoco->lastSnd = slotSnd;
+			hasData = true;
+		}
+		uint32_t hiFct = thisLoco->hiFct;
+		if (hiFct != thisLoco->lastHiFct)
+		{
+			uint32_t chgBits = hiFct ^ thisLoco->lastHiFct;
+			for (uint8_t j = 0; j < 20; j++)
+				if (chgBits & (1UL << j))
+				{
+					sprintf(outStr, "M%cA%s<;>F%i%i", thisLoco->throttleID, locoKey, (hiFct & (1UL << j)) ? 1 : 0, j + 9);
+					addWIText(thisClient, outStr);
+				}
+			thisLoco->lastHiFct = hiFct;
+			hasData = true;
+		}
+	}
+	return hasData;
+}
+
+void IoTT_LBServer::sendWITxQueue()
+{
+	lnTransmitMsg txData;
+	while (wiTxQueue.pop(txData))
+		if (wiTxCallback)
+			wiTxCallback(txData);
+}
+
+void IoTT_LBServer::processLoopWIServer()
+{
+	uint32_t loopStart = micros();
+	wiRxLineDef rxLine;
+	while (wiRxQueue.pop(rxLine)) //command lines from the TCP task
+	{
+		wiClientDef * thisClient = &wiClients[rxLine.clientNr];
+		if ((thisClient->thisClient != NULL) && !thisClient->disconnected && (thisClient->sessionNr == rxLine.sessionNr))
+			processWIServerCmd(thisClient, &rxLine.rxLine[0]);
+		sendWITxQueue(); //after every line, a burst of lines like Q of many clients would not fit into wiTxQueue
+	}
+	while (que_wrPos != que_rdPos) //LocoNet messages from the application
+	{
+		que_rdPos = (que_rdPos + 1) % queBufferSize;
+		processWIBufferMsg(&transmitQueue[que_rdPos]);
+	}
+	if ((millis() - wiLastUpdate) < wiUpdateInterval)
+		return;
+	wiLastUpdate = millis();
+	uint32_t newRosterMask[4] = {0,0,0,0};
+	for (uint8_t i = 1; i < maxSlots; i++)
+		if (((*digitraxBuffer->getSlotData(i))[0] & 0x30) == 0x30)
+			newRosterMask[i >> 5] |= (1UL << (i & 0x1F));
+	if (memcmp(newRosterMask, wiRosterMask, sizeof(wiRosterMask)) != 0)
+	{
+		memcpy(wiRosterMask, newRosterMask, sizeof(wiRosterMask));
+		queueWIEvent(2, 0, 0);
+	}
+	for (uint8_t i = 0; i < wiMaxClients; i++)
+	{
+		wiClientDef * thisClient = &wiClients[i];
+		if (thisClient->thisClient == NULL)
+			continue;
+		if (thisClient->disconnected) //locos of the client are set to common, then the entry can be used for a new client
+		{
+			for (uint8_t j = 0; j < wiMaxLocos; j++)
+				if ((thisClient->locos[j].locoState == 1) || (thisClient->locos[j].locoState == 2))
+				{
+					releaseWILoco(thisClient, &thisClient->locos[j]);
+					thisClient->locos[j].locoState = 0; //a loco on two throttles of this client is released with the second one
+				}
+			sendWITxQueue();
+			thisClient->thisClient = NULL;
+			Serial.println("WiThrottle client disconnected");
+			continue;
+		}
+		if (thisClient->heartbeat && ((millis() - thisClient->lastRx) > (wiHeartbeat * 1000))) //client is gone, stop its locos
+		{
+			Serial.println("WiThrottle heartbeat timeout");
+			thisClient->heartbeat = false;
+			for (uint8_t j = 0; j < wiMaxLocos; j++)
+				if ((thisClient->locos[j].locoState == 2) && (thisClient->locos[j].slotNr < maxSlots))
+				{
+					wiSpeedBuffer[thisClient->locos[j].slotNr] = 0;
+					__atomic_or_fetch(&wiSpeedPending[thisClient->locos[j].slotNr >> 5], 1UL << (thisClient->locos[j].slotNr & 0x1F), __ATOMIC_RELEASE);
+				}
+		}
+		bool hasData = sendWIServerSync(thisClient);
+		if (thisClient->syncState == 3)
+			hasData |= sendWIServerEvents(thisClient);
+		if (thisClient->syncState == 3)
+			hasData |= sendWILocoState(thisClient);
+		if (hasData)
+			thisClient->thisClient->send();
+	}
+	lnTransmitMsg txData;
+	for (uint8_t i = 0; i < 4; i++) //send the latest speed of each slot, after the state update, so the clients do not see the old speed
+	{
+		uint32_t pendingBits = __atomic_exchange_n(&wiSpeedPending[i], 0, __ATOMIC_ACQ_REL);
+		while (pendingBits)
+		{
+			uint8_t slotNr = (i << 5) + __builtin_ctz(pendingBits);
+			pendingBits &= (pendingBits - 1);
+			prepWIMsg(&txData, 0xA0, slotNr, wiSpeedBuffer[slotNr]);
+			if (wiTxCallback)
+				wiTxCallback(txData);
+			wiSpeedTxCtr++;
+		}
+	}
+	uint32_t loopTime = micros() - loopStart;
+	if (loopTime > wiMaxLoopTime)
+		wiMaxLoopTime = loopTime;
+}
@@ -29,6 +29,7 @@ Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
 #include <WiFi.h>
 #include <IoTT_CommDef.h>
 #include <IoTT_DigitraxBuffers.h>
+#include <IoTT_CommQueue.h>
 #include <ArduinoJSON.h>
 #include <AsyncTCP.h>
 #include <vector>
@@ -37,8 +38,19 @@ Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
 #define lbs_reconnectStartVal 10000
 #define queBufferSize 50 //messages that can be written in one burst before buffer overflow
 
+#define wiMaxClients 16 //WiThrottle server mode
+#define wiMaxLocos 8 //locos per client over all multi throttles
+#define wiRxBufferSize 128 //max length of a command line from a client
+#define wiEventQueueSize 64 //power, turnout and roster changes waiting to be sent to the clients
+#define wiSyncBatch 16 //roster or turnout list entries sent per client and loop
+#define wiUpdateInterval 100 //ms, speed commands are coalesced and loco state is sent to the clients in this interval
+#define wiHeartbeat 10 //secs, sent to the clients. Locos are stopped if a client with heartbeat monitoring is silent for this time
+#define wiNumSwi 2048 //turnouts tracked for the turnout list
+#define wiRxQueueSize 16 //command lines from the TCP task waiting for processLoop
+
 extern IoTT_DigitraxBuffers * digitraxBuffer;
 extern void prepSlotReadMsg(lnTransmitMsg * msgData, uint8_t slotNr);
+extern void sendSwitchCommand(uint8_t opCode, uint16_t swiNr, uint8_t swiTargetPos, uint8_t coilStatus) __attribute__ ((weak)); //WiThrottle server turnout commands
 //extern void callbackLocoNetMessage(lnReceiveBuffer * newData);
 
 typedef struct
@@ -49,6 +61,49 @@ typedef struct
 	uint32_t nextPing = millis();
 } tcpDef;
 
+typedef struct
+{
+	uint8_t locoState = 0; //0: not used 1: add reply pending 2: active 3: remove reply pending
+	char throttleID = 'T'; //multi throttle identifier, e.g. T, S, 0..9
+	uint16_t dccAddr = 0;
+	bool longAddr = false;
+	uint8_t slotNr = 0xFF; //0xFF: waiting for the slot from the command station
+	uint8_t lastSpeed = 0xFF; //state last sent to the client, 0xFF forces an update
+	uint8_t lastDirf = 0xFF;
+	uint8_t lastSnd = 0xFF;
+	uint32_t hiFct = 0; //F9..F28 in bits 0..19, not in the slot, so the throttle keeps them
+	uint32_t lastHiFct = 0;
+} wiLocoDef;
+
+typedef struct
+{
+	uint8_t evtType = 0; //0: power 1: turnout 2: roster
+	uint16_t evtAddr = 0;
+	uint8_t evtValue = 0;
+} wiEventDef;
+
+typedef struct
+{
+	AsyncClient * thisClient = NULL; //NULL: entry not used
+	uint8_t sessionNr = 0; //changes with every connection, so lines of a previous client still in wiRxQueue are ignored
+	char rxBuffer[wiRxBufferSize]; //TCP task only
+	uint8_t rxPtr = 0;
+	wiLocoDef locos[wiMaxLocos];
+	uint8_t syncState = 0; //0: send header 1: roster and turnout list 2: turnout list 3: in sync 4: roster list only
+	uint16_t syncPtr = 0; //next slot or turnout to send, 0: start new line
+	uint16_t evtReadPtr = 0;
+	uint32_t lastRx = 0; //millis() of last command
+	bool heartbeat = false; //client requested heartbeat monitoring
+	volatile bool disconnected = false; //set by the TCP task, the entry is released in processLoop
+} wiClientDef;
+
+typedef struct
+{
+	uint8_t clientNr = 0;
+	uint8_t sessionNr = 0;
+	char rxLine[wiRxBufferSize];
+} wiRxLineDef;
+
 
 class IoTT_LBServer
 {
@@ -57,12 +112,13 @@ public:
 	~IoTT_LBServer();
 	IoTT_LBServer(Client& client);
 	void initLBServer(bool serverMode = true);
-	void initWIServer(bool serverMode = false); //server mode not supported at this time
+	void initWIServer(bool serverMode = false);
 	void startServer();
 	void processLoop();
 	uint16_t lnWriteMsg(lnTransmitMsg txData);
 	uint16_t lnWriteMsg(lnReceiveBuffer txData);
 	void setLNCallback(cbFct newCB);
+	void setTxCallback(txFct newCB); //WiThrottle server mode, sends the resulting LocoNet commands
 	void loadLBServerCfgJSON(DynamicJsonDocument doc);
 	String getServerIP();
 	uint8_t getConnectionStatus();
@@ -77,6 +133,13 @@ public:
     void handleLNPoll(AsyncClient *client);        //every 125ms when connected
     void handleWIPoll(AsyncClient *client);        //every 125ms when connected
 	void handleDisconnect(AsyncClient* client);
+
+	void resetWIStats();
+	uint32_t wiCmdCtr = 0; //WiThrottle server statistics, commands received
+	uint32_t wiSpeedReqCtr = 0; //speed commands received
+	uint32_t wiSpeedTxCtr = 0; //OPC_LOCO_SPD sent after coalescing
+	uint32_t wiLineCtr = 0; //lines sent to the clients
+	uint32_t wiMaxLoopTime = 0; //micros() of the slowest processLoop pass
   
 private:
    // Member functions
@@ -90,6 +153,25 @@ private:
 
 	void processLoopLN(); //process function for LN over TCP
 	void processLoopWI(); //process function for WiThrottle
+	void processLoopWIServer();
+
+	wiClientDef * getWIClient(AsyncClient* client);
+	void handleWIServerData(wiClientDef * thisClient, char *data, size_t len);
+	void processWIServerCmd(wiClientDef * thisClient, char * c);
+	void processWILocoCmd(wiClientDef * thisClient, char * c);
+	void processWILocoAction(wiClientDef * thisClient, wiLocoDef * thisLoco, char * c);
+	void processWIBufferMsg(lnReceiveBuffer * thisMsg);
+	void releaseWILoco(wiClientDef * thisClient, wiLocoDef * thisLoco);
+	void queueWIMsg(uint8_t opCode, uint8_t data1, uint8_t data2);
+	void queueWIFctPacket(wiLocoDef * thisLoco, uint8_t fctNr);
+	void queueWIEvent(uint8_t evtType, uint16_t evtAddr, uint8_t evtValue);
+	void sendWITxQueue(); //hands the LocoNet commands of wiTxQueue to wiTxCallback
+	bool sendWIServerSync(wiClientDef * thisClient);
+	bool sendWIServerEvents(wiClientDef * thisClient);
+	bool sendWILocoState(wiClientDef * thisClient);
+	bool addWIText(wiClientDef * thisClient, const char * txtStr, bool endLine = true);
+	uint8_t getWIPowerState();
+	uint8_t getWISwiState(uint16_t swiNum);
    // Member variables
     AsyncServer * lntcpServer = NULL;
     tcpDef lntcpClient;
@@ -107,7 +189,6 @@ private:
 	void processLNServerMessage(AsyncClient* client, char * data);
 	bool processWIMessage(AsyncClient* client, char * data);
 	bool processWIClientMessage(AsyncClient* client, char * data);
-	bool processWIServerMessage(AsyncClient* client, char * data);
 	uint8_t numWrite, numRead;
    
 	uint32_t respTime;
@@ -125,6 +206,7 @@ private:
 	uint16_t pingInterval = 10000; //ping every 5-10 secs if there is no other traffic
 
 	std::vector<tcpDef> clients; // a list to hold all clients when in server mode
+	SemaphoreHandle_t clientsLock = NULL; //clients are added and removed in the TCP task while processLoop sends to them
 
 	IPAddress lbs_IP;
 	uint16_t lbs_Port = 1234; // = LocoNet over TCP port number, must be set the same in JMRI or other programs
@@ -136,6 +218,19 @@ private:
 	
 	AsyncClient * lastTxClient = NULL; 
 	lnReceiveBuffer lastTxData;
+
+	wiClientDef * wiClients = NULL; //WiThrottle server mode, allocated in initWIServer
+	uint8_t * wiKnownSwi = NULL; //bit field of turnouts seen on LocoNet, used for the turnout list
+	uint32_t wiRosterMask[4] = {0,0,0,0}; //slots in use, a change triggers a new roster list
+	wiEventDef wiEvents[wiEventQueueSize];
+	uint16_t wiEvtWritePtr = 0;
+	uint8_t wiSessionCtr = 0;
+	IoTT_CommQueue<wiRxLineDef, wiRxQueueSize> wiRxQueue; //command lines from the TCP task to processLoop
+	IoTT_CommQueue<lnTransmitMsg, 32> wiTxQueue; //LocoNet commands created by processLoop, sent with its next pass
+	uint8_t wiSpeedBuffer[maxSlots]; //latest requested speed per slot
+	uint32_t wiSpeedPending[4] = {0,0,0,0}; //slots with a new speed request
+	uint32_t wiLastUpdate = millis();
+	txFct wiTxCallback = NULL;
 };
 
 #endif
@@ -9,6 +9,58 @@
 #include "OneDimKalman.h"
 #include <Arduino.h>
 
+static inline void kalmanStep(kalmanChannel * thisChannel, int32_t measurement)
+{
+	uint32_t errEst = thisChannel->errEst;
+	uint32_t errSum = errEst + thisChannel->errMeasure;
+	if (errSum >= 0x10000) //scale to 16 bit, so the gain is a 32 bit division
+	{
+		uint8_t shiftBits = 16 - __builtin_clz(errSum);
+		errSum >>= shiftBits;
+		errEst >>= shiftBits;
+	}
+	uint32_t kGain = errSum > 0 ? (errEst << 16) / errSum : 0; //Q16
+	if (kGain < kfMinGain)
+		kGain = kfMinGain;
+	int32_t lastEst = thisChannel->currEst;
+	thisChannel->currEst = lastEst + (int32_t)(((((int64_t)measurement - lastEst) * kGain) + 0x8000) >> 16);
+	uint32_t remGain = kfOne - kGain;
+	uint64_t newErr = (((uint64_t)thisChannel->errEst * remGain) >> 16) + abs(thisChannel->currEst - lastEst);
+	newErr = (newErr * remGain) >> 16;
+	thisChannel->errEst = newErr > 0x7FFFFFFF ? 0x7FFFFFFF : newErr;
+}
+
+void kalmanInit(kalmanChannel * channels, uint16_t numChannels, float_t initErrMeasure, float_t initErrEst, float_t initEst)
+{
+	for (uint16_t i = 0; i < numChannels; i++)
+	{
+		channels[i].currEst = kfToFix(initEst);
+		channels[i].errEst = kfToFix(initErrEst);
+		channels[i].errMeasure = kfToFix(initErrMeasure);
+	}
+}
+
+void kalmanUpdate(kalmanChannel * channels, const int32_t * measurements, uint16_t numChannels)
+{
+	for (uint16_t i = 0; i < numChannels; i++)
+		kalmanStep(&channels[i], measurements[i]);
+}
+
+void kalmanUpdateInt(kalmanChannel * channels, const uint16_t * measurements, uint16_t * estimates, uint16_t numChannels)
+{
+	for (uint16_t i = 0; i < numChannels; i++)
+	{
+		kalmanStep(&channels[i], (int32_t)measurements[i] << 16);
+		int32_t newEst = (channels[i].currEst + 0x8000) >> 16;
+		estimates[i] = newEst < 0 ? 0 : newEst > 0xFFFF ? 0xFFFF : newEst;
+	}
+}
+
+void emaUpdate(int32_t * estimates, const int32_t * measurements, uint16_t numChannels, uint16_t alpha)
+{
+	for (uint16_t i = 0; i < numChannels; i++)
+		estimates[i] += (int32_t)(((((int64_t)measurements[i] - estimates[i]) * alpha) + 0x8000) >> 16);
+}
 
 OneDimKalman::OneDimKalman(double_t initErrMeasure, double_t initGain, double_t initErrEst, double_t initEst)
 {
@@ -26,29 +78,22 @@ OneDimKalman::~OneDimKalman()
 
 void OneDimKalman::updateErrorRange(double_t newVal)
 {
-	errMeasure = newVal;
+	filterData.errMeasure = kfToFix(newVal);
 }
 
-void OneDimKalman::setInitValues(double_t initErrMeasure, double_t initGain, double_t initErrEst, double_t initEst)
+void OneDimKalman::setInitValues(double_t initErrMeasure, double_t initGain, double_t initErrEst, double_t initEst) //initGain is not used, the gain is calculated with every estimate
 {
-	kGain = initGain;
-	currEst = initEst;
-	errMeasure = initErrMeasure;
-	errEst = initErrEst;
+	kalmanInit(&filterData, 1, initErrMeasure, initErrEst, initEst);
 }
 
 double_t OneDimKalman::getEstimate(double_t Measurement)
 {
-	double_t lastEst = currEst;
-	kGain = errEst / (errEst + errMeasure);
-	currEst = currEst + (kGain * (Measurement - currEst));
-	errEst = (1.0 - kGain) * errEst + fabs(lastEst - currEst);
-	errEst = errEst * (1 - kGain);
-//	Serial.printf("Gain: %f EstErr %f InVal %f OutVal %f ErrMeas %f LastEst %f \n", kGain, errEst, Measurement, currEst, errMeasure, lastEst);
-	return currEst;
+	int32_t fixMeasurement = kfToFix(Measurement);
+	kalmanUpdate(&filterData, &fixMeasurement, 1);
+	return kfToFloat(filterData.currEst);
 }
 
 double_t OneDimKalman::getCurrVal()
 {
-	return currEst;
+	return kfToFloat(filterData.currEst);
 }
@@ -10,6 +10,30 @@
 #define OneDimKalman_H_
 #include <Arduino.h>
 
+//Filter values are fixed point Q16.16 (1/65536 resolution, range +/-32767), so the filters run on the integer unit. The ESP32 FPU is single
+//precision only, double math is done in software.
+//kalmanUpdate and emaUpdate process an array of channels in one pass, e.g. all analog inputs of a button board. OneDimKalman is the
+//single channel version with the float interface. The host benchmark against the original double version is
+//IoTT_DigitraxBuffers/extras/test/KalmanBenchmark.cpp
+
+#define kfOne 65536 //1.0 in Q16.16
+#define kfMinGain 1 //Q16, a channel with a steady input does not lock up completely
+
+typedef struct
+{
+	int32_t currEst = 10 * kfOne; //Q16.16
+	uint32_t errEst = 10 * kfOne; //Q16.16
+	uint32_t errMeasure = 8 * kfOne; //Q16.16
+} kalmanChannel;
+
+inline int32_t kfToFix(float_t floatVal) { return (int32_t)lroundf(floatVal * kfOne); }
+inline float_t kfToFloat(int32_t fixVal) { return (float_t)fixVal / kfOne; }
+
+void kalmanInit(kalmanChannel * channels, uint16_t numChannels, float_t initErrMeasure=8, float_t initErrEst=10, float_t initEst=10);
+void kalmanUpdate(kalmanChannel * channels, const int32_t * measurements, uint16_t numChannels); //Q16.16 measurements
+void kalmanUpdateInt(kalmanChannel * channels, const uint16_t * measurements, uint16_t * estimates, uint16_t numChannels); //integer in and out, e.g. ADC readings
+void emaUpdate(int32_t * estimates, const int32_t * measurements, uint16_t numChannels, uint16_t alpha); //est += alpha * (meas - est), alpha Q16
+
 class OneDimKalman {
 public:
 	OneDimKalman(double_t initErrMeasure=8, double_t initGain=10, double_t initErrEst=10, double_t initEst=10);
@@ -20,10 +44,7 @@ public:
 	double_t getEstimate(double_t Measurement);
 	double_t getCurrVal();
 private:
-	double_t kGain = 10;
-	double_t errEst = 10;
-	double_t errMeasure = 8;
-	double_t currEst = 10;
+	kalmanChannel filterData;
 };
 
 
@@ -0,0 +1,126 @@
+#!/usr/bin/env python3
+#Build step for the web pages of LNFP_M5Stick. Run it before building the SPIFFS image:
+#
+#  python3 build_www.py ../../LNFP_M5Stick/data ../../LNFP_M5Stick/build/data [--strip]
+#
+#The data directory of the sketch is copied to the output directory and only the copy is processed, so the sources stay
+#editable and the tree stays clean. Upload the output directory, e.g. with mkspiffs and esptool
+#
+#For every file in the www directory of the copy, a content hash (first 8 hex digits of the SHA-1) is calculated. References to local files
+#in .htm, .js and .css files get the hash attached as ?v=<hash>, so the browser can cache these files forever and a new upload
+#changes the URL. Pages (.htm, .json) keep their name and are revalidated by ETag instead. Text files are gzip compressed to
+#<name>.gz, if that saves at least 10%. The result is listed in assets.man, one line per file:
+#<path on SPIFFS> <hash> <1 if .gz exists, else 0>. The web server reads this file at startup
+#--strip leaves the original of every compressed file out of the output to save flash space. The web server then only sends
+#the .gz version. The output directory is replaced on every run
+
+import argparse
+import gzip
+import hashlib
+import os
+import re
+import shutil
+
+compressTypes = ('.htm', '.html', '.js', '.css', '.json', '.ico', '.svg', '.txt')
+rewriteTypes = ('.htm', '.html', '.js', '.css')
+pageTypes = ('.htm', '.html', '.json') #loaded by name from the scripts, never versioned
+manifestName = 'assets.man'
+minSaving = 0.1
+
+def listFiles(wwwDir):
+	fileList = []
+	for root, dirs, files in os.walk(wwwDir):
+		for fileName in files:
+			if fileName.endswith('.gz') or (fileName == manifestName):
+				continue
+			fileList.append(os.path.relpath(os.path.join(root, fileName), wwwDir).replace(os.sep, '/'))
+	return sorted(fileList)
+
+def getHash(fileData):
+	return hashlib.sha1(fileData).hexdigest()[:8]
+
+def readFile(wwwDir, relPath):
+	with open(os.path.join(wwwDir, relPath), 'rb') as f:
+		return f.read()
+
+def rewriteRefs(fileData, relPath, hashList):
+	#replaces "name", "name?v=xxxxxxxx" with "name?v=<hash>" for every quoted reference to a file in hashList
+	#absolute references start with /, relative ones are resolved from the directory of the referencing file
+	baseDir = os.path.dirname(relPath)
+	def replaceRef(refMatch):
+		quoteChar, refName = refMatch.group(1), refMatch.group(2)
+		if refName.startswith('/'):
+			targetPath = refName[1:]
+		else:
+			targetPath = os.path.normpath(os.path.join(baseDir, refName)).replace(os.sep, '/')
+		if (targetPath not in hashList) or targetPath.endswith(pageTypes):
+			return refMatch.group(0)
+		return quoteChar + refName + '?v=' + hashList[targetPath] + quoteChar
+	return re.sub(r'(["\'])([\w./-]+\.\w+)(?:\?v=[0-9a-f]{8})?\1', replaceRef, fileData.decode('utf-8')).encode('utf-8')
+
+def main():
+	parser = argparse.ArgumentParser(description='gzip and hash the LNFP web pages')
+	parser.add_argument('dataDir', help='data directory of the sketch')
+	parser.add_argument('outDir', help='build directory for the SPIFFS image, replaced on every run')
+	parser.add_argument('--strip', action='store_true', help='leave the originals of compressed files out')
+	args = parser.parse_args()
+
+	dataDir = os.path.abspath(args.dataDir)
+	outDir = os.path.abspath(args.outDir)
+	if (outDir == dataDir) or outDir.startswith(dataDir + os.sep) or dataDir.startswith(outDir + os.sep):
+		parser.error('the output directory must be outside of the data directory')
+	if os.path.exists(outDir):
+		shutil.rmtree(outDir)
+	shutil.copytree(dataDir, outDir, ignore=shutil.ignore_patterns('*.gz', manifestName)) #leftovers of older in place builds
+	wwwDir = os.path.join(outDir, 'www')
+	fileList = listFiles(wwwDir)
+	hashList = {}
+	#files that are not rewritten keep their hash, so do these first. Then the pages that refer to them
+	for relPath in fileList:
+		if not relPath.endswith(rewriteTypes):
+			hashList[relPath] = getHash(readFile(wwwDir, relPath))
+	#scripts and style sheets may refer to each other, repeat until all hashes are stable
+	for passCtr in range(4):
+		changed = False
+		for relPath in fileList:
+			if not relPath.endswith(rewriteTypes):
+				continue
+			fileData = readFile(wwwDir, relPath)
+			newData = rewriteRefs(fileData, relPath, hashList)
+			if newData != fileData:
+				with open(os.path.join(wwwDir, relPath), 'wb') as f:
+					f.write(newData)
+			newHash = getHash(newData)
+			changed |= hashList.get(relPath) != newHash
+			hashList[relPath] = newHash
+		if not changed:
+			break
+
+	origSize = 0
+	sentSize = 0
+	manifest = []
+	for relPath in fileList:
+		fileData = readFile(wwwDir, relPath)
+		origSize += len(fileData)
+		hasGzip = False
+		gzPath = os.path.join(wwwDir, relPath + '.gz')
+		if relPath.endswith(compressTypes):
+			gzData = gzip.compress(fileData, 9, mtime=0)
+			if len(gzData) < (len(fileData) * (1 - minSaving)):
+				with open(gzPath, 'wb') as f:
+					f.write(gzData)
+				hasGzip = True
+		if hasGzip:
+			sentSize += len(gzData)
+			if args.strip:
+				os.remove(os.path.join(wwwDir, relPath))
+		else:
+			sentSize += len(fileData)
+		manifest.append('/www/%s %s %i' % (relPath, hashList[relPath], 1 if hasGzip else 0))
+
+	with open(os.path.join(wwwDir, manifestName), 'w', newline='\n') as f:
+		f.write('\n'.join(manifest) + '\n')
+	print('%i files, %i bytes, %i bytes compressed' % (len(fileList), origSize, sentSize))
+
+if __name__ == '__main__':
+	main()